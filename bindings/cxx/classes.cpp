@@ -28,6 +28,7 @@
 
 #include <sstream>
 #include <cmath>
+#include <chrono>
 
 namespace sigrok
 {
@@ -910,6 +911,155 @@ void DatafeedCallbackData::run(const struct sr_dev_inst *sdi,
 	_callback(move(device), move(packet));
 }
 
+PacketStream::PacketStream(size_t capacity, OverflowPolicy policy) :
+	_policy(policy),
+	_queue(capacity),
+	_head(0),
+	_depth(0),
+	_closed(false),
+	_stats()
+{
+	_stats.capacity = capacity;
+}
+
+PacketStream::~PacketStream()
+{
+}
+
+void PacketStream::push(shared_ptr<Device> device,
+	const struct sr_datafeed_packet *pkt)
+{
+	unique_lock<mutex> lock(_mutex);
+
+	if (_closed)
+		return;
+
+	if (_depth == _queue.size()) {
+		switch (_policy) {
+		case BLOCK:
+			_stats.blocked++;
+			_not_full.wait(lock, [this] {
+				return _closed || _depth < _queue.size(); });
+			if (_closed)
+				return;
+			break;
+		case DROP_OLDEST:
+		case DROP_NEWEST:
+			if (pkt->type == SR_DF_LOGIC || pkt->type == SR_DF_ANALOG) {
+				if (_policy == DROP_NEWEST || !evict_data()) {
+					_stats.dropped++;
+					return;
+				}
+			} else if (!evict_data()) {
+				// Never drop HEADER, META, END and the like.
+				grow();
+			}
+			break;
+		}
+	}
+
+	// The packet is only valid during the datafeed callback.
+	struct sr_datafeed_packet *copy;
+	if (sr_packet_copy(pkt, &copy) != SR_OK) {
+		g_free(copy);
+		_stats.dropped++;
+		return;
+	}
+	shared_ptr<Packet> packet {new Packet{move(device), copy},
+		[copy](Packet *p) {
+			default_delete<Packet>{}(p);
+			sr_packet_free(copy);
+		}};
+
+	_queue[(_head + _depth) % _queue.size()] = move(packet);
+	_depth++;
+	_stats.packets++;
+	if (_depth > _stats.max_depth)
+		_stats.max_depth = _depth;
+	lock.unlock();
+	_not_empty.notify_one();
+}
+
+shared_ptr<Packet> PacketStream::pop()
+{
+	auto packet = move(_queue[_head]);
+	_head = (_head + 1) % _queue.size();
+	_depth--;
+	_not_full.notify_one();
+	return packet;
+}
+
+// Drop the oldest queued data packet, keeping the order of the others.
+bool PacketStream::evict_data()
+{
+	const size_t size = _queue.size();
+
+	for (size_t i = 0; i < _depth; i++) {
+		const auto type = _queue[(_head + i) % size]->_structure->type;
+		if (type != SR_DF_LOGIC && type != SR_DF_ANALOG)
+			continue;
+		for (; i + 1 < _depth; i++)
+			_queue[(_head + i) % size] =
+				move(_queue[(_head + i + 1) % size]);
+		_queue[(_head + _depth - 1) % size].reset();
+		_depth--;
+		_stats.dropped++;
+		return true;
+	}
+
+	return false;
+}
+
+// Make room for one more packet, when only control packets are queued.
+void PacketStream::grow()
+{
+	vector<shared_ptr<Packet> > queue(_queue.size() + 1);
+
+	for (size_t i = 0; i < _depth; i++)
+		queue[i] = move(_queue[(_head + i) % _queue.size()]);
+	_queue.swap(queue);
+	_head = 0;
+}
+
+shared_ptr<Packet> PacketStream::next()
+{
+	unique_lock<mutex> lock(_mutex);
+	_not_empty.wait(lock, [this] { return _closed || _depth > 0; });
+	return _depth ? pop() : nullptr;
+}
+
+shared_ptr<Packet> PacketStream::next(unsigned int timeout_ms)
+{
+	unique_lock<mutex> lock(_mutex);
+	_not_empty.wait_for(lock, chrono::milliseconds(timeout_ms),
+		[this] { return _closed || _depth > 0; });
+	return _depth ? pop() : nullptr;
+}
+
+void PacketStream::close()
+{
+	{
+		lock_guard<mutex> lock(_mutex);
+		_closed = true;
+	}
+	_not_empty.notify_all();
+	_not_full.notify_all();
+}
+
+bool PacketStream::is_closed()
+{
+	lock_guard<mutex> lock(_mutex);
+	return _closed;
+}
+
+PacketStreamStatistics PacketStream::statistics()
+{
+	lock_guard<mutex> lock(_mutex);
+	PacketStreamStatistics stats = _stats;
+	stats.depth = _depth;
+	return stats;
+}
+
 SessionDevice::SessionDevice(struct sr_dev_inst *structure) :
 	Device(structure)
 {
@@ -1047,6 +1197,24 @@ void Session::add_datafeed_callback(DatafeedCallbackFunction callback)
 	_datafeed_callbacks.push_back(move(cb_data));
 }
 
+shared_ptr<PacketStream> Session::create_packet_stream(size_t capacity,
+	PacketStream::OverflowPolicy policy)
+{
+	if (capacity == 0)
+		throw Error(SR_ERR_ARG);
+
+	shared_ptr<PacketStream> stream {new PacketStream{capacity, policy},
+		default_delete<PacketStream>{}};
+	// Don't keep the stream alive, it is owned by the consumer.
+	weak_ptr<PacketStream> weak_stream = stream;
+	add_datafeed_callback([weak_stream](shared_ptr<Device> device,
+		shared_ptr<Packet> packet) {
+			if (auto stream = weak_stream.lock())
+				stream->push(move(device), packet->_structure);
+		});
+	return stream;
+}
+
 void Session::remove_datafeed_callbacks()
 {
 	check(sr_session_datafeed_callback_remove_all(_structure));
@@ -1078,6 +1246,49 @@ shared_ptr<Context> Session::context()
 	return _context;
 }
 
+void Session::set_statistics_enabled(bool enabled)
+{
+	check(sr_session_stats_enable(_structure, enabled));
+}
+
+void Session::reset_statistics()
+{
+	check(sr_session_stats_reset(_structure));
+}
+
+map<shared_ptr<Device>, DeviceStatistics> Session::device_statistics()
+{
+	map<shared_ptr<Device>, DeviceStatistics> result;
+	for (const auto &device : devices()) {
+		struct sr_dev_stats stats;
+		const int ret = sr_session_dev_stats_get(_structure,
+			device->_structure, &stats);
+		if (ret == SR_ERR_NA)
+			continue;
+		check(ret);
+		result[device] = DeviceStatistics{stats.packets, stats.bytes,
+			stats.samples, stats.duration, stats.packet_rate,
+			stats.byte_rate, stats.sample_rate};
+	}
+	return result;
+}
+
+vector<StageStatistics> Session::stage_statistics()
+{
+	GSList *const list = sr_session_stage_stats_get(_structure);
+	vector<StageStatistics> result;
+	for (GSList *l = list; l; l = l->next) {
+		auto *const stats = static_cast<struct sr_stage_stats *>(l->data);
+		result.push_back(StageStatistics{
+			stats->name ? stats->name : "", stats->index,
+			stats->calls, stats->time_total, stats->time_max,
+			vector<uint64_t>(stats->histogram,
+				stats->histogram + SR_STATS_HISTOGRAM_BINS)});
+	}
+	g_slist_free_full(list, g_free);
+	return result;
+}
+
 Packet::Packet(shared_ptr<Device> device,
 	const struct sr_datafeed_packet *structure) :
 	_structure(structure),
@@ -1217,6 +1428,51 @@ unsigned int Logic::unit_size() const
 	return _structure->unitsize;
 }
 
+uint64_t Logic::sample_count() const
+{
+	return _structure->unitsize ? _structure->length / _structure->unitsize : 0;
+}
+
+vector<uint64_t> Logic::bitplane(unsigned int channel) const
+{
+	return move(bitplanes(vector<unsigned int>{channel}).front());
+}
+
+vector<vector<uint64_t> > Logic::bitplanes(
+	const vector<unsigned int> &channels) const
+{
+	const uint64_t count = sample_count();
+	vector<vector<uint64_t> > result(channels.size(),
+		vector<uint64_t>((count + 63) / 64));
+	vector<uint64_t *> planes;
+	for (auto &plane : result)
+		planes.push_back(plane.data());
+	check(sr_logic_to_bitplanes(static_cast<const uint8_t *>(_structure->data),
+		count, _structure->unitsize, channels.data(), channels.size(),
+		planes.data()));
+	return result;
+}
+
+vector<uint64_t> Logic::edges(unsigned int channel) const
+{
+	return move(edges(vector<unsigned int>{channel}).front());
+}
+
+vector<vector<uint64_t> > Logic::edges(
+	const vector<unsigned int> &channels) const
+{
+	const uint64_t count = sample_count();
+	vector<vector<uint64_t> > result;
+	for (const auto &plane : bitplanes(channels)) {
+		vector<uint64_t> positions(sr_bitplane_edges(plane.data(), count,
+			nullptr, 0));
+		sr_bitplane_edges(plane.data(), count,
+			positions.data(), positions.size());
+		result.push_back(move(positions));
+	}
+	return result;
+}
+
 Analog::Analog(const struct sr_datafeed_analog *structure) :
 	PacketPayload(),
 	_structure(structure)
@@ -81,6 +81,8 @@ G_GNUC_END_IGNORE_DEPRECATIONS
 #include <functional>
 #include <stdexcept>
 #include <memory>
+#include <mutex>
+#include <condition_variable>
 #include <vector>
 #include <map>
 #include <set>
@@ -109,6 +111,7 @@ class SR_API TriggerMatch;
 class SR_API TriggerMatchType;
 class SR_API ChannelType;
 class SR_API Packet;
+class SR_API PacketStream;
 class SR_API PacketPayload;
 class SR_API PacketType;
 class SR_API Quantity;
@@ -606,6 +609,118 @@ private:
 	friend struct std::default_delete<SessionDevice>;
 };
 
+/** Datafeed counters of a device in a session */
+struct SR_API DeviceStatistics
+{
+	/** Number of packets sent by the device. */
+	uint64_t packets;
+	/** Number of logic and analog payload bytes. */
+	uint64_t bytes;
+	/** Number of logic and analog samples. */
+	uint64_t samples;
+	/** Time between the first and the latest packet, in microseconds. */
+	uint64_t duration;
+	/** Packets per second. */
+	double packet_rate;
+	/** Payload bytes per second. */
+	double byte_rate;
+	/** Samples per second. */
+	double sample_rate;
+};
+
+/** Time spent in a transform module or datafeed callback, in microseconds */
+struct SR_API StageStatistics
+{
+	/** Transform module ID, empty for a datafeed callback. */
+	std::string name;
+	/** Position in the session's transforms or datafeed callbacks. */
+	unsigned int index;
+	/** Number of calls. */
+	uint64_t calls;
+	/** Time spent in all calls. */
+	uint64_t time_total;
+	/** Time spent in the longest call. */
+	uint64_t time_max;
+	/** Histogram of call durations, see struct sr_stage_stats. */
+	std::vector<uint64_t> histogram;
+};
+
+/** Queue counters of a packet stream */
+struct SR_API PacketStreamStatistics
+{
+	/** Number of packets queued. */
+	uint64_t packets;
+	/** Number of packets dropped because the queue was full. */
+	uint64_t dropped;
+	/** Number of times the session waited for the consumer. */
+	uint64_t blocked;
+	/** Number of packets currently queued. */
+	size_t depth;
+	/** Maximum number of packets queued at a time. */
+	size_t max_depth;
+	/** Maximum number of packets the queue holds. */
+	size_t capacity;
+};
+
+/** A bounded queue of datafeed packets, to be consumed by another thread.
+ *
+ * Packets get copied when they are queued, so they stay valid after the
+ * session's datafeed callbacks returned. The SR_DF_END packet is queued
+ * like any other packet, but doesn't close the stream. */
+class SR_API PacketStream : public UserOwned<PacketStream>
+{
+public:
+	/** What to do with a new packet when the queue is full. Only logic
+	 * and analog packets get dropped. Other packets, which are needed
+	 * to make sense of the data, replace the oldest queued data packet
+	 * instead, or grow the queue. */
+	enum OverflowPolicy {
+		/** Wait for the consumer, this stalls the session. The
+		 * consumer must keep reading, or close the stream. */
+		BLOCK,
+		/** Drop the oldest queued data packet. */
+		DROP_OLDEST,
+		/** Drop the new data packet. */
+		DROP_NEWEST,
+	};
+	/** Get the next packet, waiting until one is available.
+	 * @return The packet, or nullptr when the stream was closed and
+	 * all queued packets were read. */
+	std::shared_ptr<Packet> next();
+	/** Get the next packet, waiting at most the given time.
+	 * @param timeout_ms Maximum time to wait, in milliseconds.
+	 * @return The packet, or nullptr on timeout, or when the stream was
+	 * closed and all queued packets were read. */
+	std::shared_ptr<Packet> next(unsigned int timeout_ms);
+	/** Stop queueing packets and wake up all waiting threads. Packets
+	 * which are already queued can still be read. */
+	void close();
+	/** Return whether the stream was closed. */
+	bool is_closed();
+	/** Get the queue counters. */
+	PacketStreamStatistics statistics();
+private:
+	PacketStream(size_t capacity, OverflowPolicy policy);
+	~PacketStream();
+	void push(std::shared_ptr<Device> device,
+		const struct sr_datafeed_packet *pkt);
+	std::shared_ptr<Packet> pop();
+	bool evict_data();
+	void grow();
+	const OverflowPolicy _policy;
+	std::mutex _mutex;
+	std::condition_variable _not_empty;
+	std::condition_variable _not_full;
+	std::vector<std::shared_ptr<Packet> > _queue;
+	size_t _head;
+	size_t _depth;
+	bool _closed;
+	PacketStreamStatistics _stats;
+
+	friend class Session;
+	friend struct std::default_delete<PacketStream>;
+};
+
 /** A sigrok session */
 class SR_API Session : public UserOwned<Session>
 {
@@ -620,6 +735,13 @@ public:
 	/** Add a datafeed callback to this session.
 	 * @param callback Callback of the form callback(Device, Packet). */
 	void add_datafeed_callback(DatafeedCallbackFunction callback);
+	/** Create a stream which queues the datafeed packets of this session,
+	 * so that they can be pulled from another thread. The stream stops
+	 * receiving packets when remove_datafeed_callbacks() is called.
+	 * @param capacity Maximum number of queued packets.
+	 * @param policy What to do with a new packet when the queue is full. */
+	std::shared_ptr<PacketStream> create_packet_stream(size_t capacity,
+		PacketStream::OverflowPolicy policy = PacketStream::BLOCK);
 	/** Remove all datafeed callbacks from this session. */
 	void remove_datafeed_callbacks();
 	/** Start the session. */
@@ -641,6 +763,15 @@ public:
 	void set_trigger(std::shared_ptr<Trigger> trigger);
 	/** Get filename this session was loaded from. */
 	std::string filename() const;
+	/** Enable or disable the collection of datafeed statistics.
+	 * @param enabled Whether to collect statistics. */
+	void set_statistics_enabled(bool enabled);
+	/** Reset all datafeed statistics. */
+	void reset_statistics();
+	/** Get the datafeed counters of all devices which sent packets. */
+	std::map<std::shared_ptr<Device>, DeviceStatistics> device_statistics();
+	/** Get the timing of all transform modules and datafeed callbacks. */
+	std::vector<StageStatistics> stage_statistics();
 private:
 	explicit Session(std::shared_ptr<Context> context);
 	Session(std::shared_ptr<Context> context, std::string filename);
@@ -680,6 +811,7 @@ private:
 	friend class Session;
 	friend class Output;
 	friend class DatafeedCallbackData;
+	friend class PacketStream;
 	friend class Header;
 	friend class Meta;
 	friend class Logic;
@@ -753,6 +885,24 @@ public:
 	size_t data_length() const;
 	/* Size of each sample in bytes. */
 	unsigned int unit_size() const;
+	/** Number of samples. */
+	uint64_t sample_count() const;
+	/** Levels of a channel as a bit-plane: bit (i % 64) of word (i / 64)
+	 * is the level at sample i.
+	 * @param channel Index of the logic channel, see Channel::index(). */
+	std::vector<uint64_t> bitplane(unsigned int channel) const;
+	/** Levels of several channels as bit-planes, see bitplane().
+	 * @param channels Indices of the logic channels. */
+	std::vector<std::vector<uint64_t> > bitplanes(
+		const std::vector<unsigned int> &channels) const;
+	/** Sample indices where the level of a channel differs from the
+	 * previous sample in this packet.
+	 * @param channel Index of the logic channel, see Channel::index(). */
+	std::vector<uint64_t> edges(unsigned int channel) const;
+	/** Transitions of several channels, see edges().
+	 * @param channels Indices of the logic channels. */
+	std::vector<std::vector<uint64_t> > edges(
+		const std::vector<unsigned int> &channels) const;
 private:
 	explicit Logic(const struct sr_datafeed_logic *structure);
 	~Logic();
@@ -299,6 +299,11 @@ typedef guint pyg_flags_type;
 
 #include "libsigrokcxx/libsigrokcxx.hpp"
 
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 /* Convert from a Python dict to a std::map<std::string, std::string> */
 std::map<std::string, std::string> dict_to_map_string(PyObject *dict)
 {
@@ -396,6 +401,340 @@ std::map<std::string, Glib::VariantBase> dict_to_map_options(PyObject *dict,
     return output;
 }
 
+/* Free the C++ object a NumPy array's memory belongs to. */
+template <class T> void capsule_delete(PyObject *capsule)
+{
+    delete static_cast<T *>(PyCapsule_GetPointer(capsule, nullptr));
+}
+
+/*
+ * Create a NumPy array on memory of a C++ object. The array keeps the
+ * object alive, 'owner' gets deleted when the array is freed.
+ */
+template <class T> PyObject *array_with_owner(int nd, npy_intp *dims,
+    PyArray_Descr *descr, void *data, T *owner)
+{
+    auto array = PyArray_NewFromDescr(&PyArray_Type, descr, nd, dims,
+        nullptr, data, NPY_ARRAY_CARRAY, nullptr);
+    if (!array) {
+        delete owner;
+        return nullptr;
+    }
+    auto capsule = PyCapsule_New(owner, nullptr, capsule_delete<T>);
+    PyArray_SetBaseObject((PyArrayObject *)array, capsule);
+
+    return array;
+}
+
+/* NumPy data type of an analog packet's samples, as they are encoded. */
+PyArray_Descr *analog_descr(sigrok::Analog *analog)
+{
+    int typenum;
+
+    if (analog->is_float())
+        typenum = analog->unitsize() == 8 ? NPY_FLOAT64 : NPY_FLOAT32;
+    else if (analog->unitsize() == 1)
+        typenum = analog->is_signed() ? NPY_INT8 : NPY_UINT8;
+    else if (analog->unitsize() == 2)
+        typenum = analog->is_signed() ? NPY_INT16 : NPY_UINT16;
+    else if (analog->unitsize() == 4)
+        typenum = analog->is_signed() ? NPY_INT32 : NPY_UINT32;
+    else
+        typenum = analog->is_signed() ? NPY_INT64 : NPY_UINT64;
+
+    auto descr = PyArray_DescrFromType(typenum);
+#ifdef WORDS_BIGENDIAN
+    bool swap = !analog->is_bigendian();
+#else
+    bool swap = analog->is_bigendian();
+#endif
+    if (swap && analog->unitsize() > 1) {
+        auto swapped = PyArray_DescrNewByteorder(descr, NPY_SWAP);
+        Py_DECREF(descr);
+        descr = swapped;
+    }
+
+    return descr;
+}
+
+/* Call a datafeed callback, which must return None. */
+bool call_datafeed_callback(PyObject *callback,
+    std::shared_ptr<sigrok::Device> device, PyObject *arg)
+{
+    auto device_obj = SWIG_NewPointerObj(
+        SWIG_as_voidptr(new std::shared_ptr<sigrok::Device>(device)),
+        SWIGTYPE_p_std__shared_ptrT_sigrok__Device_t, SWIG_POINTER_OWN);
+
+    auto arglist = Py_BuildValue("(OO)", device_obj, arg);
+
+    auto result = PyEval_CallObject(callback, arglist);
+
+    Py_XDECREF(arglist);
+    Py_XDECREF(device_obj);
+
+    bool completed = !PyErr_Occurred();
+
+    if (!completed)
+        PyErr_Print();
+
+    bool valid_result = (completed && result == Py_None);
+
+    Py_XDECREF(result);
+
+    if (completed && !valid_result)
+    {
+        PyErr_SetString(PyExc_TypeError,
+            "Datafeed callback did not return None");
+        PyErr_Print();
+    }
+
+    return valid_result;
+}
+
+/*
+ * Collects logic and analog packets in C++, and hands them to a Python
+ * datafeed callback as a dict of contiguous NumPy arrays, once per
+ * max_packets packets or max_ms milliseconds. This saves the GIL round
+ * trip and the wrapper objects per packet. Other packets flush the data
+ * collected so far, and are passed on as they are.
+ *
+ * With max_ms, a timer thread flushes batches which are due while no
+ * packets arrive, so a stalled stream doesn't hold back its last data.
+ */
+class DatafeedBatcher
+{
+public:
+    DatafeedBatcher(PyObject *callback, unsigned int max_packets,
+            unsigned int max_ms) :
+        _callback(callback),
+        _max_packets(max_packets),
+        _max_us((int64_t)max_ms * 1000),
+        _first_us(0),
+        _packets(0),
+        _unit_size(0),
+        _logic(new std::vector<uint8_t>()),
+        _stop(false)
+    {
+        Py_XINCREF(_callback);
+        if (_max_us)
+            _timer = std::thread(&DatafeedBatcher::run_timer, this);
+    }
+
+    /* Owns a reference to the callback, must not be copied. */
+    DatafeedBatcher(const DatafeedBatcher &) = delete;
+    DatafeedBatcher &operator=(const DatafeedBatcher &) = delete;
+
+    ~DatafeedBatcher()
+    {
+        if (_timer.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stop = true;
+            }
+            _cond.notify_one();
+            join_timer();
+        }
+
+        delete _logic;
+        for (auto &entry : _analog)
+            delete entry.second;
+
+        /* The session may drop its callbacks without holding the GIL. */
+        if (Py_IsInitialized()) {
+            auto gstate = PyGILState_Ensure();
+            Py_XDECREF(_callback);
+            PyGILState_Release(gstate);
+        }
+    }
+
+    void receive(std::shared_ptr<sigrok::Device> device,
+        std::shared_ptr<sigrok::Packet> packet)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto type = packet->type();
+
+        if (_packets && device != _device)
+            flush();
+        _device = device;
+
+        if (type == sigrok::PacketType::LOGIC) {
+            auto logic = dynamic_pointer_cast<sigrok::Logic>(packet->payload());
+            if (_unit_size && logic->unit_size() != _unit_size)
+                flush();
+            _unit_size = logic->unit_size();
+            auto data = static_cast<uint8_t *>(logic->data_pointer());
+            _logic->insert(_logic->end(), data, data + logic->data_length());
+        } else if (type == sigrok::PacketType::ANALOG) {
+            auto analog = dynamic_pointer_cast<sigrok::Analog>(packet->payload());
+            auto channels = analog->channels();
+            auto count = analog->num_samples();
+            std::vector<float> values(count * channels.size());
+            analog->get_data_as_float(values.data());
+            for (size_t i = 0; i < channels.size(); i++) {
+                auto &dest = analog_channel(channels[i]->name());
+                dest.insert(dest.end(), values.begin() + i * count,
+                    values.begin() + (i + 1) * count);
+            }
+        } else if (type == sigrok::PacketType::TRIGGER) {
+            _triggers.push_back(_unit_size ? _logic->size() / _unit_size : 0);
+            return;
+        } else {
+            flush();
+            deliver(packet);
+            return;
+        }
+
+        if (!_packets++) {
+            _first_us = g_get_monotonic_time();
+            _cond.notify_one();
+        }
+        if ((_max_packets && _packets >= _max_packets) ||
+                (_max_us && g_get_monotonic_time() - _first_us >= _max_us))
+            flush();
+    }
+
+private:
+    /* Flush batches which are due, runs with max_ms only. */
+    void run_timer()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (!_stop) {
+            if (!_packets) {
+                _cond.wait(lock);
+                continue;
+            }
+            auto now = g_get_monotonic_time();
+            if (now < _first_us + _max_us) {
+                _cond.wait_for(lock,
+                    std::chrono::microseconds(_first_us + _max_us - now));
+                continue;
+            }
+            try {
+                flush();
+            } catch (const sigrok::Error &) {
+                /* The callback's error was printed already. */
+            }
+        }
+    }
+
+    void join_timer()
+    {
+        /* The timer may wait for the GIL, to deliver a batch. */
+        if (Py_IsInitialized() && PyGILState_Check()) {
+            Py_BEGIN_ALLOW_THREADS
+            _timer.join();
+            Py_END_ALLOW_THREADS
+        } else {
+            _timer.join();
+        }
+    }
+
+    std::vector<float> &analog_channel(const std::string &name)
+    {
+        for (auto &entry : _analog)
+            if (entry.first == name)
+                return *entry.second;
+        _analog.emplace_back(name, new std::vector<float>());
+        return *_analog.back().second;
+    }
+
+    void flush()
+    {
+        if (!_packets && _triggers.empty())
+            return;
+
+        auto gstate = PyGILState_Ensure();
+
+        auto batch = PyDict_New();
+        auto value = PyLong_FromUnsignedLong(_packets);
+        PyDict_SetItemString(batch, "packets", value);
+        Py_DECREF(value);
+
+        if (_unit_size) {
+            npy_intp dims[2] = {
+                (npy_intp)(_logic->size() / _unit_size), (npy_intp)_unit_size };
+            auto data = _logic->data();
+            value = array_with_owner(2, dims,
+                PyArray_DescrFromType(NPY_UINT8), data, _logic);
+            _logic = new std::vector<uint8_t>();
+        } else {
+            value = nullptr;
+        }
+        PyDict_SetItemString(batch, "logic", value ? value : Py_None);
+        Py_XDECREF(value);
+
+        auto analog = PyDict_New();
+        for (auto &entry : _analog) {
+            npy_intp dims[1] = { (npy_intp)entry.second->size() };
+            auto data = entry.second->data();
+            value = array_with_owner(1, dims,
+                PyArray_DescrFromType(NPY_FLOAT32), data, entry.second);
+            if (value)
+                PyDict_SetItemString(analog, entry.first.c_str(), value);
+            Py_XDECREF(value);
+        }
+        _analog.clear();
+        PyDict_SetItemString(batch, "analog", analog);
+        Py_DECREF(analog);
+
+        auto triggers = PyList_New(0);
+        for (auto pos : _triggers) {
+            value = PyLong_FromSize_t(pos);
+            PyList_Append(triggers, value);
+            Py_DECREF(value);
+        }
+        _triggers.clear();
+        PyDict_SetItemString(batch, "triggers", triggers);
+        Py_DECREF(triggers);
+
+        _packets = 0;
+        _unit_size = 0;
+
+        bool valid_result = call_datafeed_callback(_callback, _device, batch);
+        Py_DECREF(batch);
+
+        PyGILState_Release(gstate);
+
+        if (!valid_result)
+            throw sigrok::Error(SR_ERR);
+    }
+
+    void deliver(std::shared_ptr<sigrok::Packet> packet)
+    {
+        auto gstate = PyGILState_Ensure();
+
+        auto packet_obj = SWIG_NewPointerObj(
+            SWIG_as_voidptr(new std::shared_ptr<sigrok::Packet>(packet)),
+            SWIGTYPE_p_std__shared_ptrT_sigrok__Packet_t, SWIG_POINTER_OWN);
+
+        bool valid_result = call_datafeed_callback(_callback, _device,
+            packet_obj);
+        Py_XDECREF(packet_obj);
+
+        PyGILState_Release(gstate);
+
+        if (!valid_result)
+            throw sigrok::Error(SR_ERR);
+    }
+
+    PyObject *_callback;
+    std::shared_ptr<sigrok::Device> _device;
+    unsigned int _max_packets;
+    int64_t _max_us;
+    int64_t _first_us;
+    unsigned int _packets;
+    unsigned int _unit_size;
+    /* Owned by the batcher until handed to a NumPy array. */
+    std::vector<uint8_t> *_logic;
+    std::vector<std::pair<std::string, std::vector<float> *> > _analog;
+    std::vector<size_t> _triggers;
+    /* Serializes packets and the timer's flushes. */
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    std::thread _timer;
+    bool _stop;
+};
+
 %}
 
 /* Ignore these methods, we will override them below. */
@@ -539,7 +878,56 @@ std::map<std::string, Glib::VariantBase> dict_to_map_options(PyObject *dict,
     }
 }
 
-/* Return NumPy array from Analog::data(). */
+/* Support batched delivery of logic and analog data to datafeed callbacks. */
+%extend sigrok::Session
+{
+    void _add_batched_datafeed_callback(PyObject *callback,
+        unsigned int max_packets, unsigned int max_ms)
+    {
+        if (!PyCallable_Check(callback))
+            throw sigrok::Error(SR_ERR_ARG);
+
+        auto batcher = std::make_shared<DatafeedBatcher>(callback,
+            max_packets, max_ms);
+        $self->add_datafeed_callback([=] (
+                std::shared_ptr<sigrok::Device> device,
+                std::shared_ptr<sigrok::Packet> packet) {
+            batcher->receive(device, packet);
+        });
+    }
+}
+
+%pythoncode
+{
+    _Session_add_datafeed_callback_single = Session.add_datafeed_callback
+
+    def _Session_add_datafeed_callback(self, callback, batch_packets=0, batch_ms=0):
+        """Add a datafeed callback to this session.
+
+        Without batch_packets and batch_ms, the callback gets called with
+        (device, packet) for every packet.
+
+        Otherwise logic and analog data get collected, and the callback is
+        called with (device, batch) once per batch_packets packets or
+        batch_ms milliseconds, whichever comes first. batch is a dict:
+        'logic' is a (samples, unit_size) uint8 array or None, 'analog'
+        maps channel names to float32 arrays, 'triggers' lists the logic
+        sample positions of triggers and 'packets' is the number of
+        packets collected. Other packets flush the batch, and are passed
+        as (device, packet). The arrays own their memory."""
+        if batch_packets or batch_ms:
+            self._add_batched_datafeed_callback(callback, batch_packets, batch_ms)
+        else:
+            _Session_add_datafeed_callback_single(self, callback)
+
+    Session.add_datafeed_callback = _Session_add_datafeed_callback
+}
+
+/*
+ * Return NumPy array from Analog::data(), with the samples' own data type.
+ * The array owns a copy of the data, since datafeed packet data is only
+ * valid during the callback.
+ */
 %extend sigrok::Analog
 {
     PyObject * _data()
@@ -548,18 +936,36 @@ std::map<std::string, Glib::VariantBase> dict_to_map_options(PyObject *dict,
         npy_intp dims[2];
         dims[0] = $self->channels().size();
         dims[1] = $self->num_samples();
-        int typenum = NPY_FLOAT;
-        void *data = $self->data_pointer();
-        return PyArray_SimpleNewFromData(nd, dims, typenum, data);
+        auto data = static_cast<uint8_t *>($self->data_pointer());
+        auto copy = new std::vector<uint8_t>(data,
+            data + dims[0] * dims[1] * $self->unitsize());
+        return array_with_owner(nd, dims, analog_descr($self), copy->data(),
+            copy);
+    }
+
+    /* Sample values converted to float, with scale and offset applied. */
+    PyObject * _data_as_float()
+    {
+        npy_intp dims[2];
+        dims[0] = $self->channels().size();
+        dims[1] = $self->num_samples();
+        auto values = new std::vector<float>(dims[0] * dims[1]);
+        $self->get_data_as_float(values->data());
+        return array_with_owner(2, dims, PyArray_DescrFromType(NPY_FLOAT32),
+            values->data(), values);
     }
 
 %pythoncode
 {
     data = property(_data)
+    data_as_float = property(_data_as_float)
 }
 }
 
-/* Return NumPy array from Logic::data(). */
+/*
+ * Return NumPy array from Logic::data(). The array owns a copy of the data,
+ * since datafeed packet data is only valid during the callback.
+ */
 %extend sigrok::Logic
 {
     PyObject * _data()
@@ -567,9 +973,11 @@ std::map<std::string, Glib::VariantBase> dict_to_map_options(PyObject *dict,
         npy_intp dims[2];
         dims[0] = $self->data_length() / $self->unit_size();
         dims[1] = $self->unit_size();
-        int typenum = NPY_UINT8;
-        void *data = $self->data_pointer();
-        return PyArray_SimpleNewFromData(2, dims, typenum, data);
+        auto data = static_cast<uint8_t *>($self->data_pointer());
+        auto copy = new std::vector<uint8_t>(data,
+            data + dims[0] * dims[1]);
+        return array_with_owner(2, dims, PyArray_DescrFromType(NPY_UINT8),
+            copy->data(), copy);
     }
 
 %pythoncode
@@ -60,6 +60,7 @@ template< class T > class enable_shared_from_this;
 %shared_ptr(sigrok::Session);
 %shared_ptr(sigrok::SessionDevice);
 %shared_ptr(sigrok::Packet);
+%shared_ptr(sigrok::PacketStream);
 %shared_ptr(sigrok::PacketPayload);
 %shared_ptr(sigrok::Header);
 %shared_ptr(sigrok::Meta);
@@ -26,6 +26,7 @@ using namespace std;
 %include "std_shared_ptr.i"
 %include "std_vector.i"
 %include "std_map.i"
+%include "stdint.i"
 #ifdef SWIGJAVA
 namespace std {
   template <class _Key> class set {};
@@ -94,3 +95,12 @@ namespace std {
 
 %template(TriggerMatchVector)
  std::vector<std::shared_ptr<sigrok::TriggerMatch> >;
+
+%template(Uint64Vector)
+ std::vector<uint64_t>;
+
+%template(StageStatisticsVector)
+ std::vector<sigrok::StageStatistics>;
+
+%template(DeviceStatisticsMap)
+ std::map<std::shared_ptr<sigrok::Device>, sigrok::DeviceStatistics>;
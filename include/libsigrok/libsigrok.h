@@ -482,6 +482,185 @@ struct sr_context;
  */
 struct sr_session;
 
+/**
+ * @struct sr_edge_index
+ * Opaque structure representing an index of logic channel transitions.
+ *
+ * None of the fields of this structure are meant to be accessed directly.
+ *
+ * @see sr_edge_index_new(), sr_edge_index_free().
+ */
+struct sr_edge_index;
+
+/**
+ * Statistics of the buffer pool which a driver uses for sample packets,
+ * to help tuning its size.
+ *
+ * @see sr_session_dev_stats_get().
+ */
+struct sr_buffer_pool_stats {
+	/** Number of requests served from the pool. */
+	uint64_t hits;
+	/** Number of requests which needed a memory allocation. */
+	uint64_t misses;
+	/** Number of buffers freed when they were put back. */
+	uint64_t releases;
+	/** Size of the buffers handed out, in bytes. */
+	size_t size;
+	/** Number of unused buffers currently held by the pool. */
+	unsigned int num_free;
+};
+
+/**
+ * Statistics of a USB sample data stream.
+ *
+ * @see sr_session_dev_stats_get().
+ */
+struct sr_usb_stream_stats {
+	/** Number of transfers which carried data. */
+	uint64_t transfers;
+	/** Number of transfers which completed without data. */
+	uint64_t empty_transfers;
+	/**
+	 * Number of times the host was late to handle a completion, such
+	 * that most of the queued transfers may have been filled already.
+	 */
+	uint64_t near_overruns;
+	/** Number of transfer size changes. */
+	uint64_t resizes;
+	/** Maximum delay of a completion beyond its expected time (us). */
+	int64_t jitter_max_us;
+	/** Current transfer size, in bytes. */
+	size_t size;
+	/** Number of transfers kept in flight. */
+	unsigned int depth;
+};
+
+/** Stages of the threaded session datafeed pipeline. */
+enum sr_pipeline_stage {
+	/** Transform modules. */
+	SR_PIPELINE_STAGE_TRANSFORM,
+	/** Datafeed callbacks. */
+	SR_PIPELINE_STAGE_CALLBACK,
+};
+
+/**
+ * How the session dispatcher takes turns between device threads.
+ *
+ * @see sr_session_dev_threads_set().
+ */
+enum sr_dev_thread_policy {
+	/** One packet of each device in turn. */
+	SR_DEV_THREAD_ROUND_ROBIN,
+	/** Deficit round robin, each device gets the same share of bytes. */
+	SR_DEV_THREAD_BYTES,
+	/** The packet which was sent first, whichever device sent it. */
+	SR_DEV_THREAD_OLDEST_FIRST,
+};
+
+/**
+ * Counters of one stage of the threaded session datafeed pipeline.
+ *
+ * Latencies are measured from the time a packet got queued for the
+ * stage until the stage finished processing it, in microseconds.
+ *
+ * @see sr_session_pipeline_set(), sr_session_pipeline_stats_get().
+ */
+struct sr_pipeline_stats {
+	/** Number of packets processed by the stage. */
+	uint64_t packets;
+	/** Number of packets currently waiting in the stage's queue. */
+	uint64_t queue_depth;
+	/** Highest number of packets which were waiting at a time. */
+	uint64_t queue_depth_max;
+	/** Sum of all packet latencies. */
+	uint64_t latency_total;
+	/** Highest packet latency. */
+	uint64_t latency_max;
+};
+
+/** Number of bins of the timing histogram in struct sr_stage_stats. */
+#define SR_STATS_HISTOGRAM_BINS 16
+
+/**
+ * Datafeed counters of a device in a session.
+ *
+ * @see sr_session_stats_enable(), sr_session_dev_stats_get().
+ */
+struct sr_dev_stats {
+	/** Number of packets sent by the device. */
+	uint64_t packets;
+	/** Number of logic and analog payload bytes. */
+	uint64_t bytes;
+	/** Number of logic and analog samples. */
+	uint64_t samples;
+	/** Time between the first and the latest packet, in microseconds. */
+	uint64_t duration;
+	/** Packets per second over the duration. */
+	double packet_rate;
+	/** Payload bytes per second over the duration. */
+	double byte_rate;
+	/** Samples per second over the duration. */
+	double sample_rate;
+	/**
+	 * Transfers of the device's USB sample data stream. All zero for
+	 * devices whose driver does not size its transfers at runtime.
+	 */
+	struct sr_usb_stream_stats usb;
+	/**
+	 * Sample buffers of the device's driver. All zero for devices
+	 * whose driver does not use a buffer pool.
+	 */
+	struct sr_buffer_pool_stats pool;
+};
+
+/**
+ * Time spent in a transform module or a datafeed callback.
+ *
+ * Times are in microseconds. Bin 0 of the histogram counts calls which
+ * took less than 1us, bin n counts calls which took [2^(n-1), 2^n) us,
+ * the last bin also counts all longer calls.
+ *
+ * @see sr_session_stats_enable(), sr_session_stage_stats_get().
+ */
+struct sr_stage_stats {
+	/** Transform module ID, or NULL for a datafeed callback. */
+	const char *name;
+	/** Position in the session's transforms or datafeed callbacks. */
+	unsigned int index;
+	/** Number of calls. */
+	uint64_t calls;
+	/** Time spent in all calls. */
+	uint64_t time_total;
+	/** Time spent in the longest call. */
+	uint64_t time_max;
+	/** Histogram of the call durations. */
+	uint64_t histogram[SR_STATS_HISTOGRAM_BINS];
+};
+
+/**
+ * Position of a frame in a session file.
+ *
+ * Sample offsets count from the start of the acquisition. Analog samples
+ * are counted per channel.
+ *
+ * @see sr_session_frames_load().
+ */
+struct sr_frame_info {
+	/** Start of the frame, in microseconds since the Epoch. */
+	int64_t timestamp;
+	/** Number of logic samples before the frame. */
+	uint64_t logic_offset;
+	/** Number of logic samples in the frame. */
+	uint64_t logic_samples;
+	/** Number of analog samples before the frame. */
+	uint64_t analog_offset;
+	/** Number of analog samples in the frame. */
+	uint64_t analog_samples;
+	/** Trigger position within the frame, or -1 if there is none. */
+	int64_t trigger_offset;
+};
+
 struct sr_rational {
 	/** Numerator of the rational number. */
 	int64_t p;
@@ -1116,8 +1295,17 @@ enum sr_configkey {
 	/** The device supports specifying the capturefile unit size. */
 	SR_CONF_CAPTURE_UNITSIZE,
 
+	/**
+	 * Replay a single frame of a session file, counting from 1.
+	 * 0 replays the whole file.
+	 *
+	 * Listed with the other session file options, but numbered after
+	 * SR_CONF_ADC_POWERLINE_CYCLES to keep the values of the keys below.
+	 */
+	SR_CONF_CAPTURE_FRAME = 40007,
+
 	/** Power off the device. */
-	SR_CONF_POWER_OFF,
+	SR_CONF_POWER_OFF = SR_CONF_CAPTURE_UNITSIZE + 1,
 
 	/**
 	 * Data source for acquisition. If not present, acquisition from
@@ -1139,6 +1327,8 @@ enum sr_configkey {
 	/** Number of powerline cycles for ADC integration time. */
 	SR_CONF_ADC_POWERLINE_CYCLES,
 
+	/* The next key in this group is 40008, see SR_CONF_CAPTURE_FRAME. */
+
 	/* Update sr_key_info_config[] (hwdriver.c) upon changes! */
 
 	/*--- Acquisition modes, sample limiting ----------------------------*/
@@ -1178,6 +1368,13 @@ enum sr_configkey {
 	/** Self test mode. */
 	SR_CONF_TEST_MODE,
 
+	/**
+	 * Generate data as fast as the session accepts it, instead of
+	 * pacing it to the samplerate in real time. Time limits then
+	 * refer to the wall clock. Useful as a load generator.
+	 */
+	SR_CONF_UNPACED,
+
 	/* Update sr_key_info_config[] (hwdriver.c) upon changes! */
 };
 
@@ -1284,6 +1481,14 @@ struct sr_dev_driver {
 	void *context;
 };
 
+/** A single scan request, see sr_driver_scan_concurrent(). */
+struct sr_scan_request {
+	/** The driver that should scan. Must have been initialized. */
+	struct sr_dev_driver *driver;
+	/** List of 'struct sr_config' scan options. Can be NULL. */
+	GSList *options;
+};
+
 /** Serial port descriptor. */
 struct sr_serial_port {
 	/** The OS dependent name of the serial port. */
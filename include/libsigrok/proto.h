@@ -57,6 +57,30 @@ SR_API int sr_a2l_threshold(const struct sr_datafeed_analog *analog,
 SR_API int sr_a2l_schmitt_trigger(const struct sr_datafeed_analog *analog,
 		float lo_thr, float hi_thr, uint8_t *state, uint8_t *output,
 		uint64_t count);
+SR_API int sr_logic_to_bitplanes(const uint8_t *data, uint64_t num_samples,
+		unsigned int unitsize, const unsigned int *channels,
+		unsigned int num_channels, uint64_t **planes);
+SR_API uint64_t sr_bitplane_edges(const uint64_t *plane, uint64_t num_samples,
+		uint64_t *edges, uint64_t max_edges);
+
+/*--- edge-index.c ----------------------------------------------------------*/
+
+SR_API struct sr_edge_index *sr_edge_index_new(unsigned int num_channels);
+SR_API void sr_edge_index_free(struct sr_edge_index *idx);
+SR_API int sr_edge_index_append(struct sr_edge_index *idx,
+		const struct sr_datafeed_logic *logic);
+SR_API uint64_t sr_edge_index_num_samples(const struct sr_edge_index *idx);
+SR_API int sr_edge_index_next(const struct sr_edge_index *idx,
+		unsigned int channel, uint64_t sample, uint64_t *edge);
+SR_API int sr_edge_index_prev(const struct sr_edge_index *idx,
+		unsigned int channel, uint64_t sample, uint64_t *edge);
+SR_API int sr_edge_index_count(const struct sr_edge_index *idx,
+		unsigned int channel, uint64_t start, uint64_t end,
+		uint64_t *count);
+SR_API int sr_edge_index_serialize(const struct sr_edge_index *idx,
+		uint8_t **data, size_t *size);
+SR_API int sr_edge_index_deserialize(const uint8_t *data, size_t size,
+		struct sr_edge_index **idx);
 
 /*--- log.c -----------------------------------------------------------------*/
 
@@ -105,6 +129,8 @@ SR_API int sr_driver_init(struct sr_context *ctx,
 		struct sr_dev_driver *driver);
 SR_API GArray *sr_driver_scan_options_list(const struct sr_dev_driver *driver);
 SR_API GSList *sr_driver_scan(struct sr_dev_driver *driver, GSList *options);
+SR_API GSList *sr_driver_scan_concurrent(const struct sr_scan_request *requests,
+		size_t count, int max_workers, int timeout_ms);
 SR_API int sr_config_get(const struct sr_dev_driver *driver,
 		const struct sr_dev_inst *sdi,
 		const struct sr_channel_group *cg,
@@ -120,6 +146,12 @@ SR_API int sr_config_list(const struct sr_dev_driver *driver,
 SR_API const struct sr_key_info *sr_key_info_get(int keytype, uint32_t key);
 SR_API const struct sr_key_info *sr_key_info_name_get(int keytype, const char *keyid);
 
+/*--- idcache.c -------------------------------------------------------------*/
+
+SR_API int sr_idcache_enable(const char *filename);
+SR_API int sr_idcache_disable(void);
+SR_API int sr_idcache_remove_all(void);
+
 /*--- session.c -------------------------------------------------------------*/
 
 typedef void (*sr_session_stopped_callback)(void *data);
@@ -131,6 +163,10 @@ SR_API struct sr_trigger *sr_session_trigger_get(struct sr_session *session);
 /* Session setup */
 SR_API int sr_session_load(struct sr_context *ctx, const char *filename,
 	struct sr_session **session);
+SR_API int sr_session_edge_index_load(const char *filename,
+	struct sr_edge_index **idx);
+SR_API int sr_session_frames_load(const char *filename,
+	struct sr_frame_info **frames, size_t *num_frames);
 SR_API int sr_session_new(struct sr_context *ctx, struct sr_session **session);
 SR_API int sr_session_destroy(struct sr_session *session);
 SR_API int sr_session_dev_remove_all(struct sr_session *session);
@@ -153,6 +189,31 @@ SR_API int sr_session_stop(struct sr_session *session);
 SR_API int sr_session_is_running(struct sr_session *session);
 SR_API int sr_session_stopped_callback_set(struct sr_session *session,
 		sr_session_stopped_callback cb, void *cb_data);
+SR_API int sr_session_pipeline_set(struct sr_session *session,
+		gboolean enable, size_t queue_size);
+SR_API int sr_session_pipeline_stats_get(struct sr_session *session,
+		enum sr_pipeline_stage stage, struct sr_pipeline_stats *stats);
+SR_API int sr_session_dev_threads_set(struct sr_session *session,
+		gboolean enable, enum sr_dev_thread_policy policy,
+		size_t queue_size);
+SR_API int sr_session_dev_queue_stats_get(struct sr_session *session,
+		const struct sr_dev_inst *sdi, struct sr_pipeline_stats *stats);
+SR_API int sr_session_packet_time_get(struct sr_session *session,
+		int64_t *time);
+SR_API int sr_session_timestamps_set(struct sr_session *session,
+		gboolean enable, gboolean trigger_align);
+SR_API int sr_session_merge_set(struct sr_session *session,
+		gboolean enable, uint64_t window);
+SR_API int sr_session_packet_timestamp_get(struct sr_session *session,
+		int64_t *timestamp);
+
+/* Statistics */
+SR_API int sr_session_stats_enable(struct sr_session *session,
+		gboolean enable);
+SR_API int sr_session_stats_reset(struct sr_session *session);
+SR_API int sr_session_dev_stats_get(struct sr_session *session,
+		const struct sr_dev_inst *sdi, struct sr_dev_stats *stats);
+SR_API GSList *sr_session_stage_stats_get(struct sr_session *session);
 
 SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
 		struct sr_datafeed_packet **copy);
@@ -157,6 +157,42 @@ SR_PRIV int sr_analog_init(struct sr_datafeed_analog *analog,
 	return SR_OK;
 }
 
+/* Approximate a factor by a decimal fraction, to about float precision. */
+static void rational_from_double(struct sr_rational *r, double value)
+{
+	uint64_t q;
+
+	q = 1;
+	while (fabs(value * q - llround(value * q)) > fabs(value * q) * 1e-8
+			&& fabs(value) * q < 1e15)
+		q *= 10;
+	sr_rational_set(r, llround(value * q), q);
+}
+
+/**
+ * Describe native integer sample data in an analog encoding.
+ *
+ * Drivers can send raw ADC values this way, consumers apply the linear
+ * conversion (value * scale + offset) only when they need to.
+ *
+ * @param encoding The encoding, as set up by sr_analog_init().
+ * @param unitsize The size of a sample value in bytes.
+ * @param is_signed Whether the sample values are signed.
+ * @param scale The factor to convert a sample value to the measured quantity.
+ * @param offset The offset to add after scaling.
+ *
+ * @private
+ */
+SR_PRIV void sr_analog_encoding_set_integer(struct sr_analog_encoding *encoding,
+		unsigned int unitsize, gboolean is_signed, double scale, double offset)
+{
+	encoding->unitsize = unitsize;
+	encoding->is_signed = is_signed;
+	encoding->is_float = FALSE;
+	rational_from_double(&encoding->scale, scale);
+	rational_from_double(&encoding->offset, offset);
+}
+
 /**
  * Convert an analog datafeed payload to an array of floats.
  *
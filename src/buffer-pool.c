@@ -0,0 +1,287 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdint.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+/** @cond PRIVATE */
+#define LOG_PREFIX "buffer-pool"
+/** @endcond */
+
+/*
+ * Bookkeeping of a buffer, stored right in front of its (aligned) data.
+ * Unused buffers are chained through 'next', so that putting a buffer
+ * back doesn't need any memory allocation either.
+ */
+struct pool_buffer {
+	void *mem;
+	size_t size;
+	struct sr_buffer_pool *pool;
+	struct pool_buffer *next;
+};
+
+#define HEADER_SIZE \
+	((sizeof(struct pool_buffer) + SR_BUFFER_POOL_ALIGN - 1) \
+		& ~(size_t)(SR_BUFFER_POOL_ALIGN - 1))
+
+static struct pool_buffer *buffer_header(void *buf)
+{
+	return (struct pool_buffer *)((uint8_t *)buf - sizeof(struct pool_buffer));
+}
+
+static void *buffer_data(struct pool_buffer *pb)
+{
+	return (uint8_t *)pb + sizeof(struct pool_buffer);
+}
+
+static void *buffer_alloc(size_t size)
+{
+	struct pool_buffer *pb;
+	uint8_t *mem;
+	uintptr_t data;
+
+	mem = g_try_malloc(HEADER_SIZE + size + SR_BUFFER_POOL_ALIGN - 1);
+	if (!mem)
+		return NULL;
+
+	data = (uintptr_t)mem + HEADER_SIZE;
+	data = (data + SR_BUFFER_POOL_ALIGN - 1)
+		& ~(uintptr_t)(SR_BUFFER_POOL_ALIGN - 1);
+	pb = buffer_header((void *)data);
+	pb->mem = mem;
+	pb->size = size;
+	pb->next = NULL;
+
+	return (void *)data;
+}
+
+static void buffer_release(struct pool_buffer *pb)
+{
+	g_free(pb->mem);
+}
+
+static void pool_drain(struct sr_buffer_pool *pool)
+{
+	struct pool_buffer *pb;
+
+	while ((pb = pool->free_list)) {
+		pool->free_list = pb->next;
+		buffer_release(pb);
+	}
+	pool->num_free = 0;
+}
+
+/* Hand the pool's counters to the session's device statistics. */
+static void pool_stats_update(const struct sr_buffer_pool *pool)
+{
+	struct sr_buffer_pool_stats stats;
+
+	if (!pool->sdi)
+		return;
+	sr_buffer_pool_stats_get(pool, &stats);
+	sr_session_dev_pool_stats_update(pool->sdi, &stats);
+}
+
+/**
+ * Create a pool of sample buffers.
+ *
+ * Drivers which send a packet from a freshly allocated buffer per chunk
+ * of data can get their buffers from a pool instead, and put them back
+ * after sr_session_send() returned. Buffers are aligned to
+ * SR_BUFFER_POOL_ALIGN bytes.
+ *
+ * A pool is meant to be used by one device, it isn't thread-safe. Its
+ * counters show up in the device's session statistics, see
+ * sr_session_dev_stats_get().
+ *
+ * @param sdi The device, or NULL for a pool without statistics.
+ * @param max_free The number of unused buffers to keep around.
+ *
+ * @return The new pool.
+ *
+ * @private
+ */
+SR_PRIV struct sr_buffer_pool *sr_buffer_pool_new(
+		const struct sr_dev_inst *sdi, unsigned int max_free)
+{
+	struct sr_buffer_pool *pool;
+
+	pool = g_malloc0(sizeof(*pool));
+	pool->sdi = sdi;
+	pool->max_free = MAX(max_free, 1);
+
+	return pool;
+}
+
+/**
+ * Free a pool and all its unused buffers.
+ *
+ * Buffers which were not put back must not be used anymore.
+ *
+ * @param pool The pool. NULL is accepted and ignored.
+ *
+ * @private
+ */
+SR_PRIV void sr_buffer_pool_free(struct sr_buffer_pool *pool)
+{
+	if (!pool)
+		return;
+
+	pool_drain(pool);
+	g_free(pool);
+}
+
+/**
+ * Get a buffer of at least the given size from a pool.
+ *
+ * When a larger buffer than before is requested, the pool's buffer size
+ * grows and its smaller buffers get dropped. Acquisitions which always
+ * use the same chunk size quickly run without any memory allocation.
+ *
+ * @param pool The pool.
+ * @param size The size in bytes.
+ *
+ * @return The buffer, or NULL when out of memory or if pool is NULL.
+ *
+ * @private
+ */
+SR_PRIV void *sr_buffer_pool_get(struct sr_buffer_pool *pool, size_t size)
+{
+	struct pool_buffer *pb;
+	void *buf;
+
+	if (!pool)
+		return NULL;
+
+	if (size > pool->size) {
+		pool_drain(pool);
+		pool->size = size;
+	}
+
+	if ((pb = pool->free_list)) {
+		pool->free_list = pb->next;
+		pool->num_free--;
+		pool->stats.hits++;
+		pool_stats_update(pool);
+		return buffer_data(pb);
+	}
+
+	pool->stats.misses++;
+	buf = buffer_alloc(pool->size);
+	if (buf)
+		buffer_header(buf)->pool = pool;
+	pool_stats_update(pool);
+
+	return buf;
+}
+
+/**
+ * Return a buffer to the pool it came from.
+ *
+ * @param pool The pool.
+ * @param buf The buffer. NULL is accepted and ignored.
+ *
+ * @private
+ */
+SR_PRIV void sr_buffer_pool_put(struct sr_buffer_pool *pool, void *buf)
+{
+	struct pool_buffer *pb;
+
+	if (!pool || !buf)
+		return;
+
+	pb = buffer_header(buf);
+	if (pb->size < pool->size || pool->num_free >= pool->max_free) {
+		/* Too small since the pool grew, or enough spare buffers. */
+		pool->stats.releases++;
+		buffer_release(pb);
+		pool_stats_update(pool);
+		return;
+	}
+
+	pb->next = pool->free_list;
+	pool->free_list = pb;
+	pool->num_free++;
+	pool_stats_update(pool);
+}
+
+static void pool_bytes_free(gpointer data)
+{
+	sr_buffer_pool_put(buffer_header(data)->pool, data);
+}
+
+/**
+ * Wrap a buffer of a pool in a GBytes.
+ *
+ * The buffer goes back to its pool when the last reference to the
+ * GBytes is dropped. This allows to hand the buffer to code which may
+ * keep it for a while, like the soft trigger's pre-trigger history.
+ * All references must be dropped before the pool gets freed.
+ *
+ * @param buf The buffer, as returned by sr_buffer_pool_get().
+ * @param len The length of the data in the buffer.
+ *
+ * @return The new GBytes, which takes ownership of the buffer.
+ *
+ * @private
+ */
+SR_PRIV GBytes *sr_buffer_pool_bytes_new(void *buf, size_t len)
+{
+	return g_bytes_new_with_free_func(buf, len, pool_bytes_free, buf);
+}
+
+/**
+ * Get the statistics of a pool.
+ *
+ * @param[in] pool The pool.
+ * @param[out] stats Where to store the statistics.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @private
+ */
+SR_PRIV int sr_buffer_pool_stats_get(const struct sr_buffer_pool *pool,
+		struct sr_buffer_pool_stats *stats)
+{
+	if (!pool || !stats)
+		return SR_ERR_ARG;
+
+	*stats = pool->stats;
+	stats->size = pool->size;
+	stats->num_free = pool->num_free;
+
+	return SR_OK;
+}
+
+/**
+ * Log the statistics of a pool, typically at the end of an acquisition.
+ *
+ * @private
+ */
+SR_PRIV void sr_buffer_pool_log_stats(const struct sr_buffer_pool *pool)
+{
+	const struct sr_buffer_pool_stats *stats;
+
+	stats = &pool->stats;
+	sr_dbg("Buffer pool: %" PRIu64 " hits, %" PRIu64 " misses, %" PRIu64
+		" releases, buffer size %zu.", stats->hits, stats->misses,
+		stats->releases, pool->size);
+}
+
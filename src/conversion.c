@@ -23,6 +23,7 @@
  * Conversion helper functions.
  */
 
+#include <string.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
@@ -30,6 +31,52 @@
 #define LOG_PREFIX "conv"
 /** @endcond */
 
+/*
+ * Number of values which get converted to float at a time. Integer
+ * encoded data is converted in blocks on the stack, instead of into
+ * a heap buffer for the whole packet.
+ */
+#define A2L_BLOCK_SIZE 1024
+
+/* Convert the values [first, first + count) of a packet to float. */
+static int a2l_get_floats(const struct sr_datafeed_analog *analog,
+		uint64_t first, uint64_t count, float *outbuf)
+{
+	struct sr_datafeed_analog block;
+	struct sr_analog_meaning meaning;
+	GSList single = { NULL, NULL };
+
+	/* The values are taken as a flat array, whatever the channels. */
+	meaning = *analog->meaning;
+	meaning.channels = &single;
+	block = *analog;
+	block.meaning = &meaning;
+	block.data = (uint8_t *)analog->data + first * analog->encoding->unitsize;
+	block.num_samples = count;
+
+	return sr_analog_to_float(&block, outbuf);
+}
+
+static void threshold_block(const float *input, float threshold,
+		uint8_t *output, uint64_t count)
+{
+	for (uint64_t i = 0; i < count; i++)
+		output[i] = (input[i] >= threshold) ? 1 : 0;
+}
+
+static void schmitt_trigger_block(const float *input, float lo_thr,
+		float hi_thr, uint8_t *state, uint8_t *output, uint64_t count)
+{
+	for (uint64_t i = 0; i < count; i++) {
+		if (input[i] < lo_thr)
+			*state = 0;
+		else if (input[i] > hi_thr)
+			*state = 1;
+
+		output[i] = *state;
+	}
+}
+
 /**
  * Convert analog values to logic values by using a fixed threshold.
  *
@@ -44,22 +91,20 @@
 SR_API int sr_a2l_threshold(const struct sr_datafeed_analog *analog,
 		float threshold, uint8_t *output, uint64_t count)
 {
-	float *input;
-
-	if (!analog->encoding->is_float) {
-		input = g_try_malloc(sizeof(float) * count);
-		if (!input)
-			return SR_ERR;
+	float input[A2L_BLOCK_SIZE];
+	uint64_t done, n;
 
-		sr_analog_to_float(analog, input);
-	} else
-		input = analog->data;
-
-	for (uint64_t i = 0; i < count; i++)
-		output[i] = (input[i] >= threshold) ? 1 : 0;
+	if (analog->encoding->is_float) {
+		threshold_block(analog->data, threshold, output, count);
+		return SR_OK;
+	}
 
-	if (!analog->encoding->is_float)
-		g_free(input);
+	for (done = 0; done < count; done += n) {
+		n = MIN(count - done, A2L_BLOCK_SIZE);
+		if (a2l_get_floats(analog, done, n, input) != SR_OK)
+			return SR_ERR;
+		threshold_block(input, threshold, output + done, n);
+	}
 
 	return SR_OK;
 }
@@ -82,28 +127,173 @@ SR_API int sr_a2l_schmitt_trigger(const struct sr_datafeed_analog *analog,
 		float lo_thr, float hi_thr, uint8_t *state, uint8_t *output,
 		uint64_t count)
 {
-	float *input;
+	float input[A2L_BLOCK_SIZE];
+	uint64_t done, n;
+
+	if (analog->encoding->is_float) {
+		schmitt_trigger_block(analog->data, lo_thr, hi_thr, state,
+			output, count);
+		return SR_OK;
+	}
 
-	if (!analog->encoding->is_float) {
-		input = g_try_malloc(sizeof(float) * count);
-		if (!input)
+	for (done = 0; done < count; done += n) {
+		n = MIN(count - done, A2L_BLOCK_SIZE);
+		if (a2l_get_floats(analog, done, n, input) != SR_OK)
 			return SR_ERR;
+		schmitt_trigger_block(input, lo_thr, hi_thr, state,
+			output + done, n);
+	}
 
-		sr_analog_to_float(analog, input);
-	} else
-		input = analog->data;
+	return SR_OK;
+}
 
-	for (uint64_t i = 0; i < count; i++) {
-		if (input[i] < lo_thr)
-			*state = 0;
-		else if (input[i] > hi_thr)
-			*state = 1;
+/*
+ * Transpose an 8x8 bit matrix, with row j in byte j and column k in
+ * bit k. See "Hacker's Delight", section 7-3.
+ */
+static inline uint64_t transpose8(uint64_t x)
+{
+	uint64_t t;
 
-		output[i] = *state;
+	t = (x ^ (x >> 7)) & 0x00aa00aa00aa00aaULL;
+	x ^= t ^ (t << 7);
+	t = (x ^ (x >> 14)) & 0x0000cccc0000ccccULL;
+	x ^= t ^ (t << 14);
+	t = (x ^ (x >> 28)) & 0x00000000f0f0f0f0ULL;
+	x ^= t ^ (t << 28);
+
+	return x;
+}
+
+/*
+ * Transpose one byte lane of (up to) 64 samples. Bit i of bits[k] is
+ * the level of channel (lane * 8 + k) at sample i. The byte gather is
+ * strided by the unitsize and stays scalar, the transposition works on
+ * eight samples per 64bit word.
+ */
+static void bitplane_lane(const uint8_t *data, uint64_t count,
+		unsigned int unitsize, uint64_t *bits)
+{
+	uint64_t x, i;
+	unsigned int g, j, k;
+
+	memset(bits, 0, 8 * sizeof(*bits));
+	for (g = 0, i = 0; i < count; g++) {
+		/* Gather 8 samples, one per byte. */
+		x = 0;
+		for (j = 0; j < 8 && i < count; j++, i++)
+			x |= (uint64_t)data[i * unitsize] << (8 * j);
+		x = transpose8(x);
+		for (k = 0; k < 8; k++)
+			bits[k] |= ((x >> (8 * k)) & 0xff) << (8 * g);
+	}
+}
+
+/**
+ * Extract the levels of logic channels into channel-major bit-planes.
+ *
+ * Bit (i % 64) of word (i / 64) of a bit-plane holds the level of the
+ * channel at sample i. Unused bits of the last word are zero. Samples
+ * are transposed 8x8 bits at a time, so the cost grows with the number
+ * of bytes per sample which hold a requested channel, not with the
+ * number of channels.
+ *
+ * @param[in] data The logic samples.
+ * @param[in] num_samples The number of samples.
+ * @param[in] unitsize The size of a sample in bytes.
+ * @param[in] channels The (bit) indices of the requested channels.
+ * @param[in] num_channels The number of requested channels.
+ * @param[out] planes A bit-plane per requested channel, each must provide
+ *                    space for (num_samples + 63) / 64 words.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument, or a channel index beyond unitsize.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_logic_to_bitplanes(const uint8_t *data, uint64_t num_samples,
+		unsigned int unitsize, const unsigned int *channels,
+		unsigned int num_channels, uint64_t **planes)
+{
+	uint64_t *lanes, base, word, count;
+	gboolean *needed;
+	unsigned int i;
+
+	if ((num_samples && !data) || !unitsize)
+		return SR_ERR_ARG;
+	if (num_channels && (!channels || !planes))
+		return SR_ERR_ARG;
+	for (i = 0; i < num_channels; i++) {
+		if (channels[i] >= unitsize * 8 || (num_samples && !planes[i]))
+			return SR_ERR_ARG;
+	}
+
+	/* Only transpose the bytes which hold a requested channel. */
+	needed = g_malloc0(unitsize * sizeof(*needed));
+	for (i = 0; i < num_channels; i++)
+		needed[channels[i] / 8] = TRUE;
+	lanes = g_malloc(unitsize * 8 * sizeof(*lanes));
+
+	for (base = 0, word = 0; base < num_samples; base += 64, word++) {
+		count = MIN(num_samples - base, 64);
+		for (i = 0; i < unitsize; i++) {
+			if (needed[i])
+				bitplane_lane(data + base * unitsize + i, count,
+					unitsize, &lanes[i * 8]);
+		}
+		for (i = 0; i < num_channels; i++)
+			planes[i][word] = lanes[channels[i]];
 	}
 
-	if (!analog->encoding->is_float)
-		g_free(input);
+	g_free(lanes);
+	g_free(needed);
 
 	return SR_OK;
 }
+
+/**
+ * Find the transitions of a channel in a bit-plane.
+ *
+ * A transition at sample i means the level at sample i differs from
+ * the level at sample i - 1. The first sample is never a transition.
+ * Whole words without any transition are skipped at once.
+ *
+ * To count the transitions only, pass NULL and 0 for edges and max_edges.
+ *
+ * @param[in] plane The bit-plane, as filled in by sr_logic_to_bitplanes().
+ * @param[in] num_samples The number of samples in the bit-plane.
+ * @param[out] edges The sample indices of the first max_edges transitions,
+ *                   in ascending order. Can be NULL if max_edges is 0.
+ * @param[in] max_edges The number of entries edges can hold.
+ *
+ * @return The total number of transitions, which can exceed max_edges.
+ *
+ * @since 0.6.0
+ */
+SR_API uint64_t sr_bitplane_edges(const uint64_t *plane, uint64_t num_samples,
+		uint64_t *edges, uint64_t max_edges)
+{
+	uint64_t w, diff, carry, total, base;
+	size_t i, words;
+
+	if (!plane || !num_samples)
+		return 0;
+
+	words = (num_samples + 63) / 64;
+	total = 0;
+	carry = plane[0] & 1;
+	for (i = 0; i < words; i++) {
+		w = plane[i];
+		/* Compare each sample to its predecessor. */
+		diff = w ^ ((w << 1) | carry);
+		carry = w >> 63;
+		if (i == words - 1 && num_samples % 64)
+			diff &= (1ULL << (num_samples % 64)) - 1;
+		base = i * 64;
+		for (; diff && total < max_edges; diff &= diff - 1)
+			edges[total++] = base + bit_lowest_u64(diff);
+		total += bit_count_u64(diff);
+	}
+
+	return total;
+}
@@ -0,0 +1,644 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+/** @cond PRIVATE */
+#define LOG_PREFIX "edge-index"
+/** @endcond */
+
+/**
+ * @file
+ *
+ * Index of the transitions of logic channels.
+ */
+
+/**
+ * @defgroup grp_edge_index Edge index
+ *
+ * Index of the transitions of logic channels.
+ *
+ * An edge index gets built from the logic packets of an acquisition, as
+ * they pass through a datafeed callback, or from a loaded session. It
+ * then answers "next/previous transition of channel X from sample N"
+ * and "number of transitions in a range" without scanning sample data.
+ *
+ * @{
+ */
+
+/*
+ * The transitions of a channel are stored in blocks of up to BLOCK_EDGES
+ * sample numbers. The first sample number of a block is kept as is, the
+ * others as LEB128 coded distances to their predecessor. Since all
+ * blocks but the last one are full, the block holding the k-th edge is
+ * found without a search, and a sample number is located by a binary
+ * search over the blocks, plus decoding at most one block.
+ */
+#define BLOCK_EDGES 128
+
+#define INDEX_MAGIC "SREI"
+#define INDEX_VERSION 1
+
+struct edge_block {
+	uint64_t first;
+	uint64_t last;
+	/* Number of edges in all blocks before this one. */
+	uint64_t rank;
+	/* Start of the distances in the channel's data. */
+	size_t offset;
+	uint32_t count;
+};
+
+struct edge_channel {
+	GArray *blocks;
+	GByteArray *data;
+	/* Level at the last indexed sample. */
+	uint8_t level;
+};
+
+struct sr_edge_index {
+	unsigned int num_channels;
+	uint64_t num_samples;
+	struct edge_channel *channels;
+	/* Scratch buffers of sr_edge_index_append(). */
+	unsigned int *channel_list;
+	uint64_t **planes;
+	uint64_t *plane_buf;
+	size_t plane_words;
+	uint64_t *edges;
+	uint64_t edges_size;
+};
+
+static void put_varint(GByteArray *data, uint64_t value)
+{
+	uint8_t buf[10];
+	size_t len;
+
+	len = 0;
+	while (value >= 0x80) {
+		buf[len++] = (value & 0x7f) | 0x80;
+		value >>= 7;
+	}
+	buf[len++] = value;
+	g_byte_array_append(data, buf, len);
+}
+
+static uint64_t get_varint(const uint8_t **p)
+{
+	uint64_t value;
+	unsigned int shift;
+	uint8_t b;
+
+	value = 0;
+	shift = 0;
+	do {
+		b = *(*p)++;
+		value |= (uint64_t)(b & 0x7f) << shift;
+		shift += 7;
+	} while (b & 0x80);
+
+	return value;
+}
+
+static void add_edge(struct edge_channel *ch, uint64_t sample)
+{
+	struct edge_block *last, block;
+
+	last = NULL;
+	if (ch->blocks->len)
+		last = &g_array_index(ch->blocks, struct edge_block,
+			ch->blocks->len - 1);
+
+	if (!last || last->count == BLOCK_EDGES) {
+		block.first = block.last = sample;
+		block.rank = last ? last->rank + last->count : 0;
+		block.offset = ch->data->len;
+		block.count = 1;
+		g_array_append_val(ch->blocks, block);
+		return;
+	}
+
+	put_varint(ch->data, sample - last->last);
+	last->last = sample;
+	last->count++;
+}
+
+static uint64_t edge_total(const struct edge_channel *ch)
+{
+	const struct edge_block *last;
+
+	if (!ch->blocks->len)
+		return 0;
+	last = &g_array_index(ch->blocks, struct edge_block,
+		ch->blocks->len - 1);
+
+	return last->rank + last->count;
+}
+
+/* Sample number of the k-th edge, k must be below edge_total(). */
+static uint64_t edge_select(const struct edge_channel *ch, uint64_t k)
+{
+	const struct edge_block *block;
+	const uint8_t *p;
+	uint64_t sample;
+	unsigned int i;
+
+	block = &g_array_index(ch->blocks, struct edge_block, k / BLOCK_EDGES);
+	p = ch->data->data + block->offset;
+	sample = block->first;
+	for (i = 0; i < k % BLOCK_EDGES; i++)
+		sample += get_varint(&p);
+
+	return sample;
+}
+
+/* Number of edges before the given sample number. */
+static uint64_t edge_rank(const struct edge_channel *ch, uint64_t sample)
+{
+	const struct edge_block *block;
+	const uint8_t *p;
+	uint64_t pos, rank;
+	guint lo, hi, mid;
+	uint32_t i;
+
+	/* Find the last block which starts before the sample. */
+	lo = 0;
+	hi = ch->blocks->len;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		block = &g_array_index(ch->blocks, struct edge_block, mid);
+		if (block->first < sample)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (!lo)
+		return 0;
+
+	block = &g_array_index(ch->blocks, struct edge_block, lo - 1);
+	if (block->last < sample)
+		return block->rank + block->count;
+
+	p = ch->data->data + block->offset;
+	pos = block->first;
+	rank = block->rank + 1;
+	for (i = 1; i < block->count; i++) {
+		pos += get_varint(&p);
+		if (pos >= sample)
+			break;
+		rank++;
+	}
+
+	return rank;
+}
+
+/*
+ * Set the data offsets of freshly loaded blocks. Returns FALSE if the
+ * distances don't match the blocks, or the edges are not ascending.
+ */
+static gboolean channel_check(struct edge_channel *ch)
+{
+	struct edge_block *block;
+	const uint8_t *p, *end;
+	uint64_t sample, delta, prev;
+	unsigned int shift;
+	guint i;
+	uint32_t j;
+	uint8_t b;
+
+	p = ch->data->data;
+	end = p + ch->data->len;
+	prev = 0;
+	for (i = 0; i < ch->blocks->len; i++) {
+		block = &g_array_index(ch->blocks, struct edge_block, i);
+		if (i && block->first <= prev)
+			return FALSE;
+		block->offset = p - ch->data->data;
+		sample = block->first;
+		for (j = 1; j < block->count; j++) {
+			delta = 0;
+			shift = 0;
+			do {
+				if (p == end || shift > 63)
+					return FALSE;
+				b = *p++;
+				delta |= (uint64_t)(b & 0x7f) << shift;
+				shift += 7;
+			} while (b & 0x80);
+			if (!delta || sample + delta < sample)
+				return FALSE;
+			sample += delta;
+		}
+		if (sample != block->last)
+			return FALSE;
+		prev = sample;
+	}
+
+	return p == end;
+}
+
+static struct edge_channel *get_channel(const struct sr_edge_index *idx,
+		unsigned int channel)
+{
+	if (!idx || channel >= idx->num_channels)
+		return NULL;
+
+	return &idx->channels[channel];
+}
+
+/**
+ * Create a new, empty edge index.
+ *
+ * @param num_channels The number of logic channels to index. These are
+ *                     the bits 0 to num_channels - 1 of the logic samples.
+ *
+ * @return The new edge index, or NULL if num_channels is 0 or more than 64.
+ *
+ * @since 0.6.0
+ */
+SR_API struct sr_edge_index *sr_edge_index_new(unsigned int num_channels)
+{
+	struct sr_edge_index *idx;
+	unsigned int i;
+
+	if (!num_channels || num_channels > 64)
+		return NULL;
+
+	idx = g_malloc0(sizeof(*idx));
+	idx->num_channels = num_channels;
+	idx->channels = g_malloc0(num_channels * sizeof(*idx->channels));
+	idx->channel_list = g_malloc(num_channels * sizeof(*idx->channel_list));
+	idx->planes = g_malloc0(num_channels * sizeof(*idx->planes));
+	for (i = 0; i < num_channels; i++) {
+		idx->channels[i].blocks = g_array_new(FALSE, FALSE,
+			sizeof(struct edge_block));
+		idx->channels[i].data = g_byte_array_new();
+		idx->channel_list[i] = i;
+	}
+
+	return idx;
+}
+
+/**
+ * Free an edge index.
+ *
+ * @param idx The edge index. NULL is accepted and ignored.
+ *
+ * @since 0.6.0
+ */
+SR_API void sr_edge_index_free(struct sr_edge_index *idx)
+{
+	unsigned int i;
+
+	if (!idx)
+		return;
+
+	for (i = 0; i < idx->num_channels; i++) {
+		g_array_free(idx->channels[i].blocks, TRUE);
+		g_byte_array_free(idx->channels[i].data, TRUE);
+	}
+	g_free(idx->channels);
+	g_free(idx->channel_list);
+	g_free(idx->planes);
+	g_free(idx->plane_buf);
+	g_free(idx->edges);
+	g_free(idx);
+}
+
+/**
+ * Add the transitions in a logic packet to an edge index.
+ *
+ * The packets of an acquisition must be passed in order. Their samples
+ * get numbered consecutively, starting at 0.
+ *
+ * @param idx The edge index.
+ * @param logic The logic packet payload.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument, or the samples don't hold all
+ *                    indexed channels.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_edge_index_append(struct sr_edge_index *idx,
+		const struct sr_datafeed_logic *logic)
+{
+	struct edge_channel *ch;
+	uint64_t count, words, n, k, *plane;
+	unsigned int i;
+	uint8_t level;
+	int ret;
+
+	if (!idx || !logic || !logic->unitsize)
+		return SR_ERR_ARG;
+	if (logic->unitsize * 8 < idx->num_channels)
+		return SR_ERR_ARG;
+
+	count = logic->length / logic->unitsize;
+	if (!count)
+		return SR_OK;
+
+	words = (count + 63) / 64;
+	if (idx->plane_words < words) {
+		g_free(idx->plane_buf);
+		idx->plane_buf = g_malloc(words * idx->num_channels * sizeof(uint64_t));
+		idx->plane_words = words;
+	}
+	for (i = 0; i < idx->num_channels; i++)
+		idx->planes[i] = idx->plane_buf + i * words;
+	ret = sr_logic_to_bitplanes(logic->data, count, logic->unitsize,
+		idx->channel_list, idx->num_channels, idx->planes);
+	if (ret != SR_OK)
+		return ret;
+
+	for (i = 0; i < idx->num_channels; i++) {
+		ch = &idx->channels[i];
+		plane = idx->planes[i];
+
+		/* A transition between the previous packet and this one. */
+		if (idx->num_samples && (plane[0] & 1) != ch->level)
+			add_edge(ch, idx->num_samples);
+
+		n = sr_bitplane_edges(plane, count, idx->edges, idx->edges_size);
+		if (n > idx->edges_size) {
+			g_free(idx->edges);
+			idx->edges = g_malloc(n * sizeof(uint64_t));
+			idx->edges_size = n;
+			sr_bitplane_edges(plane, count, idx->edges, n);
+		}
+		for (k = 0; k < n; k++)
+			add_edge(ch, idx->num_samples + idx->edges[k]);
+
+		level = (plane[(count - 1) / 64] >> ((count - 1) % 64)) & 1;
+		ch->level = level;
+	}
+	idx->num_samples += count;
+
+	return SR_OK;
+}
+
+/**
+ * Get the number of samples which were added to an edge index.
+ *
+ * @param idx The edge index.
+ *
+ * @return The number of samples.
+ *
+ * @since 0.6.0
+ */
+SR_API uint64_t sr_edge_index_num_samples(const struct sr_edge_index *idx)
+{
+	return idx ? idx->num_samples : 0;
+}
+
+/**
+ * Find the next transition of a channel after a sample.
+ *
+ * @param idx The edge index.
+ * @param channel The channel number.
+ * @param sample The sample number to search from.
+ * @param[out] edge The number of the first sample after 'sample' whose
+ *                  level differs from its predecessor.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_NA There is no transition after 'sample'.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_edge_index_next(const struct sr_edge_index *idx,
+		unsigned int channel, uint64_t sample, uint64_t *edge)
+{
+	const struct edge_channel *ch;
+	uint64_t k;
+
+	if (!(ch = get_channel(idx, channel)) || !edge)
+		return SR_ERR_ARG;
+
+	if (sample == UINT64_MAX)
+		return SR_ERR_NA;
+	k = edge_rank(ch, sample + 1);
+	if (k == edge_total(ch))
+		return SR_ERR_NA;
+	*edge = edge_select(ch, k);
+
+	return SR_OK;
+}
+
+/**
+ * Find the previous transition of a channel before a sample.
+ *
+ * @param idx The edge index.
+ * @param channel The channel number.
+ * @param sample The sample number to search from.
+ * @param[out] edge The number of the last sample before 'sample' whose
+ *                  level differs from its predecessor.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_NA There is no transition before 'sample'.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_edge_index_prev(const struct sr_edge_index *idx,
+		unsigned int channel, uint64_t sample, uint64_t *edge)
+{
+	const struct edge_channel *ch;
+	uint64_t k;
+
+	if (!(ch = get_channel(idx, channel)) || !edge)
+		return SR_ERR_ARG;
+
+	k = edge_rank(ch, sample);
+	if (!k)
+		return SR_ERR_NA;
+	*edge = edge_select(ch, k - 1);
+
+	return SR_OK;
+}
+
+/**
+ * Count the transitions of a channel in a range of samples.
+ *
+ * @param idx The edge index.
+ * @param channel The channel number.
+ * @param start The first sample of the range.
+ * @param end The sample after the last one of the range.
+ * @param[out] count The number of transitions at samples start to end - 1.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_edge_index_count(const struct sr_edge_index *idx,
+		unsigned int channel, uint64_t start, uint64_t end,
+		uint64_t *count)
+{
+	const struct edge_channel *ch;
+
+	if (!(ch = get_channel(idx, channel)) || !count || end < start)
+		return SR_ERR_ARG;
+
+	*count = edge_rank(ch, end) - edge_rank(ch, start);
+
+	return SR_OK;
+}
+
+/**
+ * Store an edge index in a buffer.
+ *
+ * @param idx The edge index.
+ * @param[out] data The buffer, to be freed with g_free().
+ * @param[out] size The size of the buffer.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_edge_index_serialize(const struct sr_edge_index *idx,
+		uint8_t **data, size_t *size)
+{
+	const struct edge_channel *ch;
+	const struct edge_block *block;
+	uint8_t *p;
+	size_t len;
+	unsigned int i;
+	guint j;
+
+	if (!idx || !data || !size)
+		return SR_ERR_ARG;
+
+	len = 4 + 1 + 4 + 8;
+	for (i = 0; i < idx->num_channels; i++) {
+		ch = &idx->channels[i];
+		len += 1 + 4 + 8 + ch->blocks->len * (8 + 8 + 4) + ch->data->len;
+	}
+
+	*data = p = g_malloc(len);
+	*size = len;
+	memcpy(p, INDEX_MAGIC, 4);
+	p += 4;
+	write_u8_inc(&p, INDEX_VERSION);
+	write_u32le_inc(&p, idx->num_channels);
+	write_u64le_inc(&p, idx->num_samples);
+	for (i = 0; i < idx->num_channels; i++) {
+		ch = &idx->channels[i];
+		write_u8_inc(&p, ch->level);
+		write_u32le_inc(&p, ch->blocks->len);
+		write_u64le_inc(&p, ch->data->len);
+		for (j = 0; j < ch->blocks->len; j++) {
+			block = &g_array_index(ch->blocks, struct edge_block, j);
+			write_u64le_inc(&p, block->first);
+			write_u64le_inc(&p, block->last);
+			write_u32le_inc(&p, block->count);
+		}
+		if (ch->data->len)
+			memcpy(p, ch->data->data, ch->data->len);
+		p += ch->data->len;
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Restore an edge index from a buffer.
+ *
+ * @param data The buffer, as filled in by sr_edge_index_serialize().
+ * @param size The size of the buffer.
+ * @param[out] idx The new edge index, to be freed with sr_edge_index_free().
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_DATA Malformed or unsupported data.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_edge_index_deserialize(const uint8_t *data, size_t size,
+		struct sr_edge_index **idx)
+{
+	struct sr_edge_index *new_idx;
+	struct edge_channel *ch;
+	struct edge_block block;
+	const uint8_t *p, *end;
+	uint64_t data_len, rank;
+	uint32_t num_channels, num_blocks, j;
+	unsigned int i;
+
+	if (!data || !idx)
+		return SR_ERR_ARG;
+
+	p = data;
+	end = data + size;
+	if (size < 4 + 1 + 4 + 8 || memcmp(p, INDEX_MAGIC, 4) != 0)
+		return SR_ERR_DATA;
+	p += 4;
+	if (read_u8_inc(&p) != INDEX_VERSION)
+		return SR_ERR_DATA;
+	num_channels = read_u32le_inc(&p);
+	if (!(new_idx = sr_edge_index_new(num_channels)))
+		return SR_ERR_DATA;
+	new_idx->num_samples = read_u64le_inc(&p);
+
+	for (i = 0; i < num_channels; i++) {
+		ch = &new_idx->channels[i];
+		if ((size_t)(end - p) < 1 + 4 + 8)
+			goto malformed;
+		ch->level = read_u8_inc(&p) & 1;
+		num_blocks = read_u32le_inc(&p);
+		data_len = read_u64le_inc(&p);
+		if ((uint64_t)(end - p) / (8 + 8 + 4) < num_blocks)
+			goto malformed;
+		rank = 0;
+		for (j = 0; j < num_blocks; j++) {
+			block.first = read_u64le_inc(&p);
+			block.last = read_u64le_inc(&p);
+			block.count = read_u32le_inc(&p);
+			block.rank = rank;
+			block.offset = 0;
+			if (!block.count || block.count > BLOCK_EDGES)
+				goto malformed;
+			if (block.count < BLOCK_EDGES && j + 1 < num_blocks)
+				goto malformed;
+			rank += block.count;
+			g_array_append_val(ch->blocks, block);
+		}
+		if ((uint64_t)(end - p) < data_len)
+			goto malformed;
+		g_byte_array_append(ch->data, p, data_len);
+		p += data_len;
+		/* Locate each block's distances, and check them. */
+		if (!channel_check(ch))
+			goto malformed;
+	}
+
+	*idx = new_idx;
+
+	return SR_OK;
+
+malformed:
+	sr_err("Malformed edge index.");
+	sr_edge_index_free(new_idx);
+
+	return SR_ERR_DATA;
+}
+
+/** @} */
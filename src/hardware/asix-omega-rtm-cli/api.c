@@ -371,13 +371,12 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	/*
 	 * Start supervising acquisition limits. Arrange for a stricter
 	 * "samples count" check than supported by the common approach.
+	 * The fixed samplerate turns time limits into a samples count.
 	 */
+	sr_sw_limits_set_samplerate(&devc->limits, samplerates[0]);
 	sr_sw_limits_acquisition_start(&devc->limits);
-	ret = sr_sw_limits_get_remain(&devc->limits,
-		&remain_count, NULL, NULL, NULL);
-	if (ret != SR_OK)
-		return ret;
-	if (remain_count) {
+	remain_count = sr_sw_limits_samples_budget(&devc->limits);
+	if (remain_count != UINT64_MAX) {
 		devc->samples.remain_count = remain_count;
 		devc->samples.check_count = TRUE;
 	}
@@ -1260,39 +1260,86 @@ static int flush_submit_buffer(struct dev_context *devc)
 	return SR_OK;
 }
 
-static int addto_submit_buffer(struct dev_context *devc,
-	uint16_t sample, size_t count)
+/*
+ * Determine how many of 'count' samples may still get submitted. Only
+ * a samples limit is involved (see setup_submit_limit()), and it does
+ * not apply when triggers are used. Checking the limit once per block
+ * keeps its enforcement exact, without per sample overhead.
+ */
+static size_t clamp_submit_count(struct dev_context *devc, size_t count)
+{
+	uint64_t budget;
+
+	if (devc->use_triggers)
+		return count;
+
+	budget = sr_sw_limits_samples_budget(&devc->limit.submit);
+	if (budget < count)
+		count = budget;
+
+	return count;
+}
+
+/* Fill memory with 'count' copies of a sample, doubling the copy size. */
+static void fill_u16le(uint8_t *p, uint16_t sample, size_t count)
+{
+	size_t done, len;
+
+	if (!count)
+		return;
+	write_u16le(p, sample);
+	done = 1;
+	while (done < count) {
+		len = MIN(done, count - done);
+		memcpy(&p[done * sizeof(uint16_t)], p, len * sizeof(uint16_t));
+		done += len;
+	}
+}
+
+/*
+ * Queue 'count' samples for submission, either 'count' repetitions of
+ * a single value (samples is NULL), or the values of an array. Works
+ * in blocks which fit the local storage, and accounts for whole blocks.
+ */
+static int addto_submit_buffer_block(struct dev_context *devc,
+	uint16_t sample, const uint16_t *samples, size_t count)
 {
 	struct submit_buffer *buffer;
-	struct sr_sw_limits *limits;
+	size_t chunk, idx;
 	int ret;
 
 	buffer = devc->buffer;
-	limits = &devc->limit.submit;
-	if (!devc->use_triggers && sr_sw_limits_check(limits))
-		count = 0;
-
-	/*
-	 * Individually accumulate and check each sample, such that
-	 * accumulation between flushes won't exceed local storage, and
-	 * enforcement of user specified limits is exact.
-	 */
-	while (count--) {
-		write_u16le_inc(&buffer->write_pointer, sample);
-		buffer->curr_samples++;
+	count = clamp_submit_count(devc, count);
+	while (count) {
+		chunk = buffer->max_samples - buffer->curr_samples;
+		if (chunk > count)
+			chunk = count;
+		if (samples) {
+			for (idx = 0; idx < chunk; idx++)
+				write_u16le_inc(&buffer->write_pointer, *samples++);
+		} else {
+			fill_u16le(buffer->write_pointer, sample, chunk);
+			buffer->write_pointer += chunk * sizeof(uint16_t);
+		}
+		buffer->curr_samples += chunk;
+		sr_sw_limits_update_samples_read(&devc->limit.submit, chunk);
+		count -= chunk;
 		if (buffer->curr_samples == buffer->max_samples) {
 			ret = flush_submit_buffer(devc);
 			if (ret != SR_OK)
 				return ret;
 		}
-		sr_sw_limits_update_samples_read(limits, 1);
-		if (!devc->use_triggers && sr_sw_limits_check(limits))
-			break;
 	}
 
 	return SR_OK;
 }
 
+static int addto_submit_buffer(struct dev_context *devc,
+	uint16_t sample, size_t count)
+{
+	return addto_submit_buffer_block(devc, sample, NULL, count);
+}
+
 static void sigma_location_break_down(struct sigma_location *loc)
 {
 
@@ -1480,10 +1527,16 @@ static int fetch_sample_buffer(struct dev_context *devc)
 	count = interp->fetch.lines_total - interp->fetch.lines_done;
 	if (count > interp->fetch.lines_per_read)
 		count = interp->fetch.lines_per_read;
-	ret = sigma_read_dram(devc, interp->iter.line, count,
-		(uint8_t *)interp->fetch.rcvd_lines);
-	if (ret != SR_OK)
-		return ret;
+	if (interp->fetch.replay) {
+		memcpy(interp->fetch.rcvd_lines,
+			&interp->fetch.replay[interp->fetch.lines_done],
+			count * sizeof(interp->fetch.rcvd_lines[0]));
+	} else {
+		ret = sigma_read_dram(devc, interp->iter.line, count,
+			(uint8_t *)interp->fetch.rcvd_lines);
+		if (ret != SR_OK)
+			return ret;
+	}
 	interp->fetch.lines_rcvd = count;
 	interp->fetch.curr_line = &interp->fetch.rcvd_lines[0];
 
@@ -1848,40 +1901,119 @@ static uint16_t sigma_deinterlace_data_4x4(uint16_t indata, int idx)
 	return outdata;
 }
 
-static void sigma_decode_dram_cluster(struct dev_context *devc,
-	struct sigma_dram_cluster *dram_cluster,
-	size_t events_in_cluster)
+/*
+ * Lookup tables for the deinterlacing of a whole DRAM cluster. Each
+ * table entry holds the contribution of one byte of a 16bit item, one
+ * nibble per sample. The bits of the low byte end up in the low half
+ * of the sample, the bits of the high byte in the upper half.
+ */
+static uint16_t deinterlace_lut_4x4[256];
+static uint16_t deinterlace_lut_2x8[256];
+
+static void sigma_deinterlace_lut_init(void)
 {
-	uint16_t tsdiff, ts, sample, item16;
-	size_t count;
+	static gsize done;
+	size_t byte;
+	int idx;
+
+	if (!g_once_init_enter(&done))
+		return;
+	for (byte = 0; byte < 256; byte++) {
+		for (idx = 0; idx < 4; idx++) {
+			deinterlace_lut_4x4[byte] |=
+				sigma_deinterlace_data_4x4(byte, idx) << (4 * idx);
+		}
+		for (idx = 0; idx < 2; idx++) {
+			deinterlace_lut_2x8[byte] |=
+				sigma_deinterlace_data_2x8(byte, idx) << (4 * idx);
+		}
+	}
+	g_once_init_leave(&done, 1);
+}
+
+/*
+ * Deinterlace the sample data of a DRAM cluster in a single pass.
+ * Returns the number of samples which were written to 'samples'.
+ */
+static size_t sigma_deinterlace_cluster(struct sigma_dram_cluster *cl,
+	size_t events, size_t samples_per_event, uint16_t *samples)
+{
+	uint16_t item16, lo, hi;
 	size_t evt;
+	int idx;
+
+	switch (samples_per_event) {
+	case 4:
+		for (evt = 0; evt < events; evt++) {
+			item16 = sigma_dram_cluster_data(cl, evt);
+			lo = deinterlace_lut_4x4[item16 & 0xff];
+			hi = deinterlace_lut_4x4[item16 >> 8];
+			for (idx = 0; idx < 4; idx++) {
+				*samples++ = ((lo >> (4 * idx)) & 0x3) |
+					(((hi >> (4 * idx)) & 0x3) << 2);
+			}
+		}
+		return events * 4;
+	case 2:
+		for (evt = 0; evt < events; evt++) {
+			item16 = sigma_dram_cluster_data(cl, evt);
+			lo = deinterlace_lut_2x8[item16 & 0xff];
+			hi = deinterlace_lut_2x8[item16 >> 8];
+			for (idx = 0; idx < 2; idx++) {
+				*samples++ = ((lo >> (4 * idx)) & 0xf) |
+					(((hi >> (4 * idx)) & 0xf) << 4);
+			}
+		}
+		return events * 2;
+	default:
+		for (evt = 0; evt < events; evt++)
+			*samples++ = sigma_dram_cluster_data(cl, evt);
+		return events;
+	}
+}
 
-	/*
-	 * If this cluster is not adjacent to the previously received
-	 * cluster, then send the appropriate number of samples with the
-	 * previous values to the sigrok session. This "decodes RLE".
-	 *
-	 * These samples cannot match the trigger since they just repeat
-	 * the previously submitted data pattern. (This assumption holds
-	 * for simple level and edge triggers. It would not for timed or
-	 * counted conditions, which currently are not supported.)
-	 */
-	ts = sigma_dram_cluster_ts(dram_cluster);
-	tsdiff = ts - devc->interp.last.ts;
-	if (tsdiff > 0) {
-		sample = devc->interp.last.sample;
-		count = tsdiff * devc->interp.samples_per_event;
-		(void)check_and_submit_sample(devc, sample, count);
+/*
+ * Check whether software trigger supervision is involved while the
+ * events of the current cluster get processed. Only then do samples
+ * need individual inspection.
+ */
+static gboolean sigma_cluster_needs_trigger_check(struct dev_context *devc,
+	size_t events)
+{
+	struct sigma_sample_interp *interp;
+	struct sigma_location loc;
+
+	if (!devc->use_triggers)
+		return FALSE;
+	interp = &devc->interp;
+	if (interp->trig_chk.armed)
+		return TRUE;
+	if (interp->trig_chk.matched)
+		return FALSE;
+
+	/* Would supervision start within this cluster? */
+	loc = interp->iter;
+	while (events--) {
+		sigma_location_increment(&loc);
+		if (sigma_location_is_eq(&loc, &interp->trig_arm, TRUE))
+			return TRUE;
 	}
-	devc->interp.last.ts = ts + EVENTS_PER_CLUSTER;
 
-	/*
-	 * Grab sample data from the current cluster and prepare their
-	 * submission to the session feed. Handle samplerate dependent
-	 * memory layout of sample data. Accumulation of data chunks
-	 * before submission is transparent to this code path, specific
-	 * buffer depth is neither assumed nor required here.
-	 */
+	return FALSE;
+}
+
+/*
+ * Submit the samples of a DRAM cluster one event at a time, and check
+ * each of them for trigger matches. Used while software supervises the
+ * trigger position, the block path gets compared to it in tests.
+ */
+static void sigma_decode_dram_events(struct dev_context *devc,
+	struct sigma_dram_cluster *dram_cluster,
+	size_t events_in_cluster)
+{
+	uint16_t sample, item16;
+	size_t evt;
+
 	sample = 0;
 	for (evt = 0; evt < events_in_cluster; evt++) {
 		item16 = sigma_dram_cluster_data(dram_cluster, evt);
@@ -1915,6 +2047,63 @@ static void sigma_decode_dram_cluster(struct dev_context *devc,
 	}
 }
 
+static void sigma_decode_dram_cluster(struct dev_context *devc,
+	struct sigma_dram_cluster *dram_cluster,
+	size_t events_in_cluster)
+{
+	uint16_t samples[EVENTS_PER_CLUSTER * 4];
+	uint16_t tsdiff, ts, sample;
+	size_t count, spe;
+	size_t evt;
+
+	/*
+	 * If this cluster is not adjacent to the previously received
+	 * cluster, then send the appropriate number of samples with the
+	 * previous values to the sigrok session. This "decodes RLE".
+	 *
+	 * These samples cannot match the trigger since they just repeat
+	 * the previously submitted data pattern. (This assumption holds
+	 * for simple level and edge triggers. It would not for timed or
+	 * counted conditions, which currently are not supported.)
+	 */
+	ts = sigma_dram_cluster_ts(dram_cluster);
+	tsdiff = ts - devc->interp.last.ts;
+	if (tsdiff > 0) {
+		sample = devc->interp.last.sample;
+		count = tsdiff * devc->interp.samples_per_event;
+		(void)check_and_submit_sample(devc, sample, count);
+	}
+	devc->interp.last.ts = ts + EVENTS_PER_CLUSTER;
+
+	/*
+	 * Grab sample data from the current cluster and prepare their
+	 * submission to the session feed. Handle samplerate dependent
+	 * memory layout of sample data. Accumulation of data chunks
+	 * before submission is transparent to this code path, specific
+	 * buffer depth is neither assumed nor required here.
+	 */
+	spe = devc->interp.samples_per_event;
+	count = sigma_deinterlace_cluster(dram_cluster, events_in_cluster,
+		spe, samples);
+	if (!count)
+		return;
+
+	/*
+	 * Outside of the short period of software trigger checks, the
+	 * cluster's samples get submitted as a block.
+	 */
+	if (!devc->interp.per_event &&
+	    !sigma_cluster_needs_trigger_check(devc, events_in_cluster)) {
+		(void)addto_submit_buffer_block(devc, 0, samples, count);
+		devc->interp.last.sample = samples[count - 1];
+		for (evt = 0; evt < events_in_cluster; evt++)
+			sigma_location_increment(&devc->interp.iter);
+		return;
+	}
+
+	sigma_decode_dram_events(devc, dram_cluster, events_in_cluster);
+}
+
 /*
  * Decode chunk of 1024 bytes, 64 clusters, 7 events per cluster.
  * Each event is 20ns apart, and can contain multiple samples.
@@ -1956,6 +2145,58 @@ static int decode_chunk_ts(struct dev_context *devc,
 	return SR_OK;
 }
 
+/*
+ * Prepare the interpretation of sample memory content, given the
+ * positions which the device reported. With disabled triggers, use a
+ * value for the trigger location that will never match.
+ */
+static int setup_download(struct sr_dev_inst *sdi,
+	uint32_t stoppos, uint32_t triggerpos, uint8_t modestatus)
+{
+	struct dev_context *devc;
+	int ret;
+
+	devc = sdi->priv;
+
+	sigma_deinterlace_lut_init();
+	if (!devc->use_triggers)
+		triggerpos = ~0;
+	if (!(modestatus & RMR_TRIGGERED))
+		triggerpos = ~0;
+
+	ret = alloc_sample_buffer(devc, stoppos, triggerpos, modestatus);
+	if (ret != SR_OK)
+		return ret;
+
+	ret = alloc_submit_buffer(sdi);
+	if (ret != SR_OK)
+		return ret;
+	ret = setup_submit_limit(devc);
+	if (ret != SR_OK)
+		return ret;
+
+	return SR_OK;
+}
+
+/* Process the most recently fetched lines. The last line may be short. */
+static void decode_fetched_lines(struct dev_context *devc)
+{
+	struct sigma_sample_interp *interp;
+	size_t dl_events_in_line;
+
+	interp = &devc->interp;
+	while (interp->fetch.lines_rcvd--) {
+		dl_events_in_line = EVENTS_PER_ROW;
+		if (interp->iter.line == interp->stop.line) {
+			dl_events_in_line = interp->stop.raw & ROW_MASK;
+		}
+		decode_chunk_ts(devc, interp->fetch.curr_line,
+			dl_events_in_line);
+		interp->fetch.curr_line++;
+		interp->fetch.lines_done++;
+	}
+}
+
 static int download_capture(struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
@@ -2023,19 +2264,8 @@ static int download_capture(struct sr_dev_inst *sdi)
 			sr_err("Could not query capture positions/state.");
 			return FALSE;
 		}
-		if (!devc->use_triggers)
-			triggerpos = ~0;
-		if (!(modestatus & RMR_TRIGGERED))
-			triggerpos = ~0;
-
-		ret = alloc_sample_buffer(devc, stoppos, triggerpos, modestatus);
-		if (ret != SR_OK)
-			return FALSE;
 
-		ret = alloc_submit_buffer(sdi);
-		if (ret != SR_OK)
-			return FALSE;
-		ret = setup_submit_limit(devc);
+		ret = setup_download(sdi, stoppos, triggerpos, modestatus);
 		if (ret != SR_OK)
 			return FALSE;
 	}
@@ -2051,24 +2281,12 @@ static int download_capture(struct sr_dev_inst *sdi)
 	 */
 	chunks_per_receive_call = 50;
 	while (interp->fetch.lines_done < interp->fetch.lines_total) {
-		size_t dl_events_in_line;
-
 		/* Read another chunk of sample memory (several lines). */
 		ret = fetch_sample_buffer(devc);
 		if (ret != SR_OK)
 			return FALSE;
 
-		/* Process lines of sample data. Last line may be short. */
-		while (interp->fetch.lines_rcvd--) {
-			dl_events_in_line = EVENTS_PER_ROW;
-			if (interp->iter.line == interp->stop.line) {
-				dl_events_in_line = interp->stop.raw & ROW_MASK;
-			}
-			decode_chunk_ts(devc, interp->fetch.curr_line,
-				dl_events_in_line);
-			interp->fetch.curr_line++;
-			interp->fetch.lines_done++;
-		}
+		decode_fetched_lines(devc);
 
 		/* Keep returning to application code for large data sets. */
 		if (!--chunks_per_receive_call) {
@@ -2198,6 +2416,46 @@ SR_PRIV int sigma_receive_data(int fd, int revents, void *cb_data)
 	return TRUE;
 }
 
+/*
+ * Interpret sample memory content which was not read from the device,
+ * but taken from 'lines', starting with the first line to download.
+ * Takes the positions which the device would report, and submits the
+ * samples to the session feed like a download does. Lets recorded or
+ * synthesized captures get replayed, optionally decoding each event
+ * individually for comparison with the block path.
+ */
+SR_PRIV int sigma_replay_capture(struct sr_dev_inst *sdi,
+	const struct sigma_dram_line *lines, uint32_t stoppos,
+	uint32_t triggerpos, uint8_t modestatus, gboolean per_event)
+{
+	struct dev_context *devc;
+	struct sigma_sample_interp *interp;
+	int ret;
+
+	if (!sdi || !sdi->priv || !lines)
+		return SR_ERR_ARG;
+	devc = sdi->priv;
+	interp = &devc->interp;
+
+	interp->per_event = per_event;
+	ret = setup_download(sdi, stoppos, triggerpos, modestatus);
+	interp->fetch.replay = lines;
+	while (ret == SR_OK &&
+	    interp->fetch.lines_done < interp->fetch.lines_total) {
+		ret = fetch_sample_buffer(devc);
+		if (ret == SR_OK)
+			decode_fetched_lines(devc);
+	}
+	if (ret == SR_OK)
+		ret = flush_submit_buffer(devc);
+	interp->fetch.replay = NULL;
+	interp->per_event = FALSE;
+	free_submit_buffer(devc);
+	free_sample_buffer(devc);
+
+	return ret;
+}
+
 /* Build a LUT entry used by the trigger functions. */
 static void build_lut_entry(uint16_t *lut_entry,
 	uint16_t spec_value, uint16_t spec_mask)
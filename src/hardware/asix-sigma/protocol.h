@@ -369,7 +369,11 @@ struct dev_context {
 			size_t lines_rcvd;
 			struct sigma_dram_line *rcvd_lines;
 			struct sigma_dram_line *curr_line;
+			/* Memory content to replay instead of reading DRAM. */
+			const struct sigma_dram_line *replay;
 		} fetch;
+		/* Decode all clusters event by event (reference path). */
+		gboolean per_event;
 		struct {
 			gboolean armed;
 			gboolean matched;
@@ -423,4 +427,9 @@ SR_PRIV int sigma_build_basic_trigger(struct dev_context *devc,
 /* Callback to periodically drive acuisition progress. */
 SR_PRIV int sigma_receive_data(int fd, int revents, void *cb_data);
 
+/* Interpret sample memory content which was not read from the device. */
+SR_PRIV int sigma_replay_capture(struct sr_dev_inst *sdi,
+	const struct sigma_dram_line *lines, uint32_t stoppos,
+	uint32_t triggerpos, uint8_t modestatus, gboolean per_event);
+
 #endif
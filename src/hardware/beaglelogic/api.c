@@ -316,6 +316,7 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 
 	/* Clear capture state */
 	devc->bytes_read = 0;
+	devc->tcp_fill = 0;
 	devc->offset = 0;
 
 	/* Configure channels */
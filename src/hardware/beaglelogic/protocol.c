@@ -60,7 +60,7 @@ SR_PRIV int beaglelogic_native_receive_data(int fd, int revents, void *cb_data)
 	logic.unitsize = SAMPLEUNIT_TO_BYTES(devc->sampleunit);
 
 	if (revents == G_IO_IN) {
-		sr_info("In callback G_IO_IN, offset=%d", devc->offset);
+		sr_spew("In callback G_IO_IN, offset=%d", devc->offset);
 
 		bytes_remaining = (devc->limit_samples * logic.unitsize) -
 				devc->bytes_read;
@@ -117,6 +117,47 @@ SR_PRIV int beaglelogic_native_receive_data(int fd, int revents, void *cb_data)
 	return TRUE;
 }
 
+/*
+ * Drain the socket into the receive buffer, behind the 'fill' bytes
+ * which are kept from the previous call. Only the first read may block
+ * (the main loop found the socket readable), subsequent reads take what
+ * is available without waiting. Platforms without non-blocking reads
+ * get a single read per call.
+ *
+ * Returns the number of buffered bytes, or -1 upon receive errors.
+ * Sets 'eof' when the peer closed the connection.
+ */
+static int tcp_recv_batch(int fd, struct dev_context *devc, int fill,
+	gboolean *eof)
+{
+	int len, flags;
+
+	*eof = FALSE;
+	flags = 0;
+	while (fill < TCP_BUFFER_SIZE) {
+		len = recv(fd, devc->tcp_buffer + fill,
+			TCP_BUFFER_SIZE - fill, flags);
+		if (len == 0) {
+			*eof = TRUE;
+			break;
+		}
+		if (len < 0) {
+			if (flags && (errno == EAGAIN || errno == EWOULDBLOCK))
+				break;
+			sr_err("Receive error: %s", g_strerror(errno));
+			return -1;
+		}
+		fill += len;
+#ifdef MSG_DONTWAIT
+		flags = MSG_DONTWAIT;
+#else
+		break;
+#endif
+	}
+
+	return fill;
+}
+
 SR_PRIV int beaglelogic_tcp_receive_data(int fd, int revents, void *cb_data)
 {
 	const struct sr_dev_inst *sdi;
@@ -124,28 +165,36 @@ SR_PRIV int beaglelogic_tcp_receive_data(int fd, int revents, void *cb_data)
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
 
-	int len;
+	int fill;
 	int pre_trigger_samples;
 	int trigger_offset;
 	uint32_t packetsize;
 	uint64_t bytes_remaining;
+	gboolean eof, done;
 
 	if (!(sdi = cb_data) || !(devc = sdi->priv))
 		return TRUE;
 
-	packetsize = TCP_BUFFER_SIZE;
+	done = FALSE;
 	logic.unitsize = SAMPLEUNIT_TO_BYTES(devc->sampleunit);
 
 	if (revents == G_IO_IN) {
-		sr_info("In callback G_IO_IN");
-
-		len = recv(fd, devc->tcp_buffer, TCP_BUFFER_SIZE, 0);
-		if (len < 0) {
-			sr_err("Receive error: %s", g_strerror(errno));
-			return SR_ERR;
+		fill = tcp_recv_batch(fd, devc, devc->tcp_fill, &eof);
+		if (fill < 0) {
+			/* Receive errors end the acquisition like an EOF. */
+			fill = devc->tcp_fill;
+			eof = TRUE;
 		}
 
-		packetsize = len;
+		/*
+		 * Keep partial samples for the next call. A short read may
+		 * not even complete one sample, that's no end of data.
+		 */
+		packetsize = fill - fill % logic.unitsize;
+		devc->tcp_fill = fill - packetsize;
+		if (!packetsize && !eof)
+			return TRUE;
+		sr_spew("Received %" PRIu32 " bytes.", packetsize);
 
 		bytes_remaining = (devc->limit_samples * logic.unitsize) -
 				devc->bytes_read;
@@ -156,7 +205,9 @@ SR_PRIV int beaglelogic_tcp_receive_data(int fd, int revents, void *cb_data)
 		logic.data = devc->tcp_buffer;
 		logic.length = MIN(packetsize, bytes_remaining);
 
-		if (devc->trigger_fired) {
+		if (!packetsize) {
+			/* Only the EOF or error, nothing to send. */
+		} else if (devc->trigger_fired) {
 			/* Send the incoming transfer to the session bus. */
 			sr_session_send(sdi, &packet);
 		} else {
@@ -176,6 +227,10 @@ SR_PRIV int beaglelogic_tcp_receive_data(int fd, int revents, void *cb_data)
 			}
 		}
 
+		if (devc->tcp_fill)
+			memmove(devc->tcp_buffer, devc->tcp_buffer + packetsize,
+				devc->tcp_fill);
+
 		/* Update byte count and offset (roll over if needed) */
 		devc->bytes_read += logic.length;
 		if ((devc->offset += packetsize) >= devc->buffersize) {
@@ -184,16 +239,19 @@ SR_PRIV int beaglelogic_tcp_receive_data(int fd, int revents, void *cb_data)
 			if (devc->triggerflags == BL_TRIGGERFLAGS_CONTINUOUS)
 				devc->offset = 0;
 			else
-				packetsize = 0;
+				done = TRUE;
 		}
+		if (eof)
+			done = TRUE;
 	}
 
 	/* EOF Received or we have reached the limit */
 	if (devc->bytes_read >= devc->limit_samples * logic.unitsize ||
-			packetsize == 0) {
+			done) {
 		/* Send EOA Packet, stop polling */
 		std_session_send_df_end(sdi);
 		devc->beaglelogic->stop(devc);
+		devc->tcp_fill = 0;
 
 		/* Drain the receive buffer */
 		beaglelogic_tcp_drain(devc);
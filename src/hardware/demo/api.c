@@ -45,6 +45,10 @@ static const char *logic_pattern_str[] = {
 	"all-high",
 	"squid",
 	"graycode",
+	"uart",
+	"spi",
+	"i2c",
+	"bursty",
 };
 
 static const uint32_t scanopts[] = {
@@ -69,10 +73,13 @@ static const uint32_t devopts[] = {
 	SR_CONF_AVG_SAMPLES | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_TRIGGER_MATCH | SR_CONF_LIST,
 	SR_CONF_CAPTURE_RATIO | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_UNPACED | SR_CONF_GET | SR_CONF_SET,
 };
 
 static const uint32_t devopts_cg_logic[] = {
 	SR_CONF_PATTERN_MODE | SR_CONF_GET | SR_CONF_SET | SR_CONF_LIST,
+	SR_CONF_OUTPUT_FREQUENCY | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_DUTY_CYCLE | SR_CONF_GET | SR_CONF_SET,
 };
 
 static const uint32_t devopts_cg_analog_group[] = {
@@ -144,10 +151,13 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 	devc->all_logic_channels_mask <<= devc->num_logic_channels;
 	devc->all_logic_channels_mask--;
 	devc->logic_pattern = DEFAULT_LOGIC_PATTERN;
+	devc->bus_freq = DEFAULT_BUS_FREQ;
+	devc->bus_duty = DEFAULT_BUS_DUTY;
 	devc->num_analog_channels = num_analog_channels;
 	devc->limit_frames = limit_frames;
 	devc->capture_ratio = 20;
 	devc->stl = NULL;
+	devc->prng_state = 0x9e3779b97f4a7c15ULL;
 
 	if (num_logic_channels > 0) {
 		/* Logic channels, all in one channel group. */
@@ -198,7 +208,7 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 			ag->packet.meaning->unit = ag->unit;
 			ag->packet.encoding->digits = DEFAULT_ANALOG_ENCODING_DIGITS;
 			ag->packet.spec->spec_digits = DEFAULT_ANALOG_SPEC_DIGITS;
-			ag->packet.data = devc->analog_patterns[pattern];
+			ag->packet.data = ag->data;
 			ag->pattern = pattern;
 			ag->avg_val = 0.0f;
 			ag->num_avgs = 0;
@@ -220,6 +230,7 @@ static void clear_helper(struct dev_context *devc)
 	void *value;
 
 	demo_free_analog_pattern(devc);
+	demo_free_logic_period(devc);
 
 	/* Analog generators. */
 	g_hash_table_iter_init(&iter, devc->ch_ag);
@@ -312,9 +323,28 @@ static int config_get(uint32_t key, GVariant **data,
 		ag = g_hash_table_lookup(devc->ch_ag, ch);
 		*data = g_variant_new_double(ag->offset);
 		break;
+	case SR_CONF_OUTPUT_FREQUENCY:
+		if (!cg)
+			return SR_ERR_CHANNEL_GROUP;
+		ch = cg->channels->data;
+		if (ch->type != SR_CHANNEL_LOGIC)
+			return SR_ERR_ARG;
+		*data = g_variant_new_double(devc->bus_freq);
+		break;
+	case SR_CONF_DUTY_CYCLE:
+		if (!cg)
+			return SR_ERR_CHANNEL_GROUP;
+		ch = cg->channels->data;
+		if (ch->type != SR_CHANNEL_LOGIC)
+			return SR_ERR_ARG;
+		*data = g_variant_new_double(devc->bus_duty);
+		break;
 	case SR_CONF_CAPTURE_RATIO:
 		*data = g_variant_new_uint64(devc->capture_ratio);
 		break;
+	case SR_CONF_UNPACED:
+		*data = g_variant_new_boolean(devc->unpaced);
+		break;
 	default:
 		return SR_ERR_NA;
 	}
@@ -331,6 +361,7 @@ static int config_set(uint32_t key, GVariant *data,
 	GVariant *mq_tuple_child;
 	GSList *l;
 	int logic_pattern, analog_pattern;
+	double value_f;
 
 	devc = sdi->priv;
 
@@ -425,9 +456,37 @@ static int config_set(uint32_t key, GVariant *data,
 			ag->offset = g_variant_get_double(data);
 		}
 		break;
+	case SR_CONF_OUTPUT_FREQUENCY:
+		/* Bit rate of the bus traffic patterns. */
+		if (!cg)
+			return SR_ERR_CHANNEL_GROUP;
+		ch = cg->channels->data;
+		if (ch->type != SR_CHANNEL_LOGIC)
+			return SR_ERR_ARG;
+		value_f = g_variant_get_double(data);
+		if (value_f <= 0.0)
+			return SR_ERR_ARG;
+		devc->bus_freq = value_f;
+		break;
+	case SR_CONF_DUTY_CYCLE:
+		/* Percentage of time the bus traffic patterns are busy. */
+		if (!cg)
+			return SR_ERR_CHANNEL_GROUP;
+		ch = cg->channels->data;
+		if (ch->type != SR_CHANNEL_LOGIC)
+			return SR_ERR_ARG;
+		value_f = g_variant_get_double(data);
+		if (value_f <= 0.0 || value_f > 100.0)
+			return SR_ERR_ARG;
+		devc->bus_duty = value_f;
+		break;
 	case SR_CONF_CAPTURE_RATIO:
 		devc->capture_ratio = g_variant_get_uint64(data);
 		break;
+	case SR_CONF_UNPACED:
+		devc->unpaced = g_variant_get_boolean(data);
+		sr_dbg("%s unpaced generation", devc->unpaced ? "Enabling" : "Disabling");
+		break;
 	default:
 		return SR_ERR_NA;
 	}
@@ -561,7 +620,11 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 		devc->first_partial_logic_index,
 		devc->first_partial_logic_mask);
 
-	sr_session_source_add(sdi->session, -1, 0, 100,
+	/*
+	 * Unpaced mode gets called back whenever the mainloop is idle,
+	 * and reuses pre-generated periodic patterns.
+	 */
+	sr_session_source_add(sdi->session, -1, 0, devc->unpaced ? 0 : 100,
 			demo_prepare_data, (struct sr_dev_inst *)sdi);
 
 	std_session_send_df_header(sdi);
@@ -573,6 +636,9 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	devc->start_us = g_get_monotonic_time();
 	devc->spent_us = 0;
 	devc->step = 0;
+	demo_reset_bus_pattern(devc);
+	if (devc->unpaced)
+		demo_prepare_logic_period((struct sr_dev_inst *)sdi);
 
 	return SR_OK;
 }
@@ -580,10 +646,19 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 static int dev_acquisition_stop(struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
+	int64_t elapsed_us;
 
 	sr_session_source_remove(sdi->session, -1);
 
 	devc = sdi->priv;
+	if (devc->unpaced) {
+		elapsed_us = MAX(1, g_get_monotonic_time() - devc->start_us);
+		sr_info("Sent %" PRIu64 " samples in %.3f s (%.0f samples/s).",
+			devc->sent_samples, elapsed_us / 1e6,
+			devc->sent_samples * 1e6 / elapsed_us);
+		demo_free_logic_period(devc);
+	}
+
 	if (devc->limit_frames > 0)
 		std_session_send_df_frame_end(sdi);
 
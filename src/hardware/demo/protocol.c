@@ -274,6 +274,248 @@ static void set_logic_data(uint64_t bits, uint8_t *data, size_t len)
 	}
 }
 
+/*
+ * xorshift64* generator. Much cheaper than rand(), and yields eight
+ * bytes of random data per call. Quality is plenty for test patterns.
+ */
+static inline uint64_t prng_next(uint64_t *state)
+{
+	uint64_t x;
+
+	x = *state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+
+	return x * 0x2545f4914f6cdd1dULL;
+}
+
+static void fill_random(uint64_t *state, uint8_t *data, size_t len)
+{
+	uint64_t r;
+	size_t i;
+
+	for (i = 0; i + sizeof(r) <= len; i += sizeof(r)) {
+		r = prng_next(state);
+		memcpy(&data[i], &r, sizeof(r));
+	}
+	if (i < len) {
+		r = prng_next(state);
+		memcpy(&data[i], &r, len - i);
+	}
+}
+
+/*
+ * The bus traffic patterns compose one message at a time, as a list
+ * of runs of constant line levels. Filling the logic buffer then costs
+ * one memset() or memcpy() per run, not per sample. Runs get merged
+ * when the levels don't change.
+ */
+static void bus_add(struct dev_context *devc, uint64_t value, uint64_t count)
+{
+	struct bus_segment *seg;
+
+	if (!count)
+		return;
+	value &= devc->all_logic_channels_mask;
+	if (devc->bus_seg_count) {
+		seg = &devc->bus_segs[devc->bus_seg_count - 1];
+		if (seg->value == value) {
+			seg->count += count;
+			return;
+		}
+	}
+	if (devc->bus_seg_count == BUS_MAX_SEGMENTS) {
+		sr_err("Bus message too long, truncating.");
+		return;
+	}
+	seg = &devc->bus_segs[devc->bus_seg_count++];
+	seg->value = value;
+	seg->count = count;
+}
+
+static void bus_compose_uart(struct dev_context *devc, uint64_t bit)
+{
+	size_t count, i, j;
+	uint8_t byte;
+
+	/* 8N1, LSB first, idle high. */
+	count = 1 + prng_next(&devc->prng_state) % 16;
+	for (i = 0; i < count; i++) {
+		byte = prng_next(&devc->prng_state) & 0xff;
+		bus_add(devc, 0, bit);
+		for (j = 0; j < 8; j++)
+			bus_add(devc, (byte >> j) & 1, bit);
+		bus_add(devc, 1, bit);
+	}
+}
+
+static void bus_compose_spi(struct dev_context *devc, uint64_t bit)
+{
+	size_t count, i;
+	uint64_t half, data;
+	int j;
+
+	/*
+	 * Mode 0, MSB first. CS# (D3) is asserted for the whole message,
+	 * and deasserted for at least half a bit time at its end, also
+	 * without an idle gap.
+	 */
+	half = MAX(1, bit / 2);
+	count = 1 + prng_next(&devc->prng_state) % 16;
+	bus_add(devc, 0, half);
+	for (i = 0; i < count; i++) {
+		data = prng_next(&devc->prng_state);
+		for (j = 7; j >= 0; j--) {
+			/* MOSI on D1, MISO on D2, sampled on the rising CLK edge. */
+			bus_add(devc, ((data >> j) & 1) << 1
+				| ((data >> (8 + j)) & 1) << 2, half);
+			bus_add(devc, ((data >> j) & 1) << 1
+				| ((data >> (8 + j)) & 1) << 2 | 1, half);
+		}
+	}
+	bus_add(devc, 0, half);
+	bus_add(devc, 1 << 3, half);
+}
+
+static void bus_compose_i2c_byte(struct dev_context *devc, uint64_t half,
+	uint16_t bits)
+{
+	uint64_t sda;
+	int j;
+
+	/* Eight data bits and the ACK bit (driven low by the receiver). */
+	for (j = 8; j >= 0; j--) {
+		sda = ((bits >> j) & 1) << 1;
+		bus_add(devc, sda, half);
+		bus_add(devc, sda | 1, half);
+	}
+}
+
+static void bus_compose_i2c(struct dev_context *devc, uint64_t bit)
+{
+	size_t count, i;
+	uint64_t half, addr;
+
+	half = MAX(1, bit / 2);
+	count = 1 + prng_next(&devc->prng_state) % 8;
+
+	/*
+	 * The bus is free (SCL and SDA high) for at least a bit time
+	 * between messages, also without an idle gap.
+	 * START: SDA falls while SCL is high.
+	 */
+	bus_add(devc, 3, half);
+	bus_add(devc, 1, half);
+	/* 7-bit address and write flag. */
+	addr = prng_next(&devc->prng_state) & 0x7f;
+	bus_compose_i2c_byte(devc, half, addr << 2);
+	for (i = 0; i < count; i++)
+		bus_compose_i2c_byte(devc, half,
+			(prng_next(&devc->prng_state) & 0xff) << 1);
+	/* STOP: SDA rises while SCL is high. */
+	bus_add(devc, 0, half);
+	bus_add(devc, 1, half);
+	bus_add(devc, 3, half);
+}
+
+static void bus_compose_bursty(struct dev_context *devc, uint64_t bit)
+{
+	size_t count, i;
+
+	count = 1 + prng_next(&devc->prng_state) % 64;
+	for (i = 0; i < count; i++)
+		bus_add(devc, prng_next(&devc->prng_state), bit);
+}
+
+/*
+ * Compose the next message, followed by an idle gap. The gap's length
+ * is random, with a mean that yields the configured busy percentage.
+ */
+static void bus_compose(struct dev_context *devc)
+{
+	uint64_t bit, busy, idle, idle_value;
+	double mean;
+	size_t i;
+
+	devc->bus_seg_count = 0;
+	devc->bus_seg_pos = 0;
+
+	bit = devc->cur_samplerate / devc->bus_freq;
+	bit = MAX(1, bit);
+	switch (devc->logic_pattern) {
+	case PATTERN_UART:
+		bus_compose_uart(devc, bit);
+		idle_value = 1;
+		break;
+	case PATTERN_SPI:
+		bus_compose_spi(devc, bit);
+		idle_value = 1 << 3;
+		break;
+	case PATTERN_I2C:
+		bus_compose_i2c(devc, bit);
+		idle_value = 3;
+		break;
+	default:
+		bus_compose_bursty(devc, bit);
+		idle_value = 0;
+		break;
+	}
+
+	if (devc->bus_duty >= 100.)
+		return;
+	busy = 0;
+	for (i = 0; i < devc->bus_seg_count; i++)
+		busy += devc->bus_segs[i].count;
+	mean = busy * (100. - devc->bus_duty) / devc->bus_duty;
+	idle = prng_next(&devc->prng_state) % ((uint64_t)(2 * mean) + 1);
+	bus_add(devc, idle_value, idle);
+}
+
+/* Forget about a partially sent message. */
+SR_PRIV void demo_reset_bus_pattern(struct dev_context *devc)
+{
+	devc->bus_seg_count = 0;
+	devc->bus_seg_pos = 0;
+	devc->bus_left = 0;
+}
+
+static void bus_generator(struct dev_context *devc, uint64_t size)
+{
+	struct bus_segment *seg;
+	uint8_t *data;
+	size_t unitsize, count, done;
+	uint64_t samples, pos;
+
+	unitsize = devc->logic_unitsize;
+	samples = size / unitsize;
+	data = devc->logic_data;
+	pos = 0;
+	while (pos < samples) {
+		if (!devc->bus_left) {
+			if (devc->bus_seg_pos >= devc->bus_seg_count)
+				bus_compose(devc);
+			seg = &devc->bus_segs[devc->bus_seg_pos++];
+			devc->bus_value = seg->value;
+			devc->bus_left = seg->count;
+		}
+		count = MIN(devc->bus_left, samples - pos);
+		if (unitsize == 1) {
+			memset(&data[pos], devc->bus_value, count);
+		} else {
+			/* Write one sample, then double the filled range. */
+			set_logic_data(devc->bus_value, &data[pos * unitsize], unitsize);
+			for (done = 1; done < count; done *= 2)
+				memcpy(&data[(pos + done) * unitsize],
+					&data[pos * unitsize],
+					MIN(done, count - done) * unitsize);
+		}
+		pos += count;
+		devc->bus_left -= count;
+	}
+}
+
 static void logic_generator(struct sr_dev_inst *sdi, uint64_t size)
 {
 	struct dev_context *devc;
@@ -298,8 +540,7 @@ static void logic_generator(struct sr_dev_inst *sdi, uint64_t size)
 		}
 		break;
 	case PATTERN_RANDOM:
-		for (i = 0; i < size; i++)
-			devc->logic_data[i] = (uint8_t)(rand() & 0xff);
+		fill_random(&devc->prng_state, devc->logic_data, size);
 		break;
 	case PATTERN_INC:
 		for (i = 0; i < size; i++) {
@@ -365,6 +606,12 @@ static void logic_generator(struct sr_dev_inst *sdi, uint64_t size)
 			set_logic_data(gray, &devc->logic_data[i], devc->logic_unitsize);
 		}
 		break;
+	case PATTERN_UART:
+	case PATTERN_SPI:
+	case PATTERN_I2C:
+	case PATTERN_BURSTY:
+		bus_generator(devc, size);
+		break;
 	default:
 		sr_err("Unknown pattern: %d.", devc->logic_pattern);
 		break;
@@ -399,6 +646,79 @@ static void logic_fixup_feed(struct dev_context *devc,
 	}
 }
 
+/*
+ * Length of a pattern's period in samples, or 0 for patterns which are
+ * not periodic (or have periods too long to keep them in memory).
+ */
+static size_t logic_period_length(enum logic_pattern_type pattern)
+{
+	switch (pattern) {
+	case PATTERN_SIGROK:
+		return sizeof(pattern_sigrok);
+	case PATTERN_SQUID:
+		return ARRAY_SIZE(pattern_squid);
+	case PATTERN_ALL_LOW:
+	case PATTERN_ALL_HIGH:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Pre-generate one period of a periodic logic pattern, followed by one
+ * buffer's worth of samples. Any LOGIC_BUFSIZE chunk of the pattern
+ * then is a contiguous slice of this memory, which already had the
+ * disabled channels masked out. Used in unpaced mode, where per-chunk
+ * generation and fixup would dominate the cost of an acquisition.
+ */
+SR_PRIV void demo_prepare_logic_period(struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+	struct sr_datafeed_logic logic;
+	size_t period, chunk, total, done, count, unitsize;
+
+	devc = sdi->priv;
+	demo_free_logic_period(devc);
+
+	unitsize = devc->logic_unitsize;
+	period = logic_period_length(devc->logic_pattern);
+	if (!unitsize || !period)
+		return;
+
+	chunk = LOGIC_BUFSIZE / unitsize;
+	total = period + chunk;
+	devc->logic_period_data = g_malloc(total * unitsize);
+	devc->step = 0;
+	for (done = 0; done < total; done += count) {
+		count = MIN(total - done, chunk);
+		logic_generator(sdi, count * unitsize);
+		memcpy(devc->logic_period_data + done * unitsize,
+			devc->logic_data, count * unitsize);
+	}
+	devc->step = 0;
+
+	logic.unitsize = unitsize;
+	logic.length = total * unitsize;
+	logic.data = devc->logic_period_data;
+	logic_fixup_feed(devc, &logic);
+
+	devc->logic_period = g_bytes_new_take(devc->logic_period_data,
+		total * unitsize);
+	devc->logic_period_samples = period;
+	devc->logic_period_pos = 0;
+}
+
+SR_PRIV void demo_free_logic_period(struct dev_context *devc)
+{
+	if (devc->logic_period)
+		g_bytes_unref(devc->logic_period);
+	devc->logic_period = NULL;
+	devc->logic_period_data = NULL;
+	devc->logic_period_samples = 0;
+	devc->logic_period_pos = 0;
+}
+
 static void send_analog_packet(struct analog_gen *ag,
 		struct sr_dev_inst *sdi, uint64_t *analog_sent,
 		uint64_t analog_pos, uint64_t analog_todo)
@@ -495,6 +815,10 @@ static void send_analog_packet(struct analog_gen *ag,
 	else
 		ag->packet.meaning->unit = SR_UNIT_UNITLESS;
 
+	/* Transforms may have modified the previous packet's encoding. */
+	sr_rational_set(&ag->encoding.scale, 1, 1);
+	sr_rational_set(&ag->encoding.offset, 0, 1);
+
 	if (!devc->avg) {
 		ag_pattern_pos = analog_pos % pattern->num_samples;
 		sending_now = MIN(analog_todo, pattern->num_samples - ag_pattern_pos);
@@ -512,17 +836,23 @@ static void send_analog_packet(struct analog_gen *ag,
 				amplitude = ag->amplitude / DEFAULT_ANALOG_AMPLITUDE;
 				offset = ag->offset - DEFAULT_ANALOG_OFFSET;
 			}
-			data = ag->packet.data;
+			data = ag->data;
 			for (i = 0; i < sending_now; i++) {
 				if (ag->pattern == PATTERN_ANALOG_RANDOM)
-					data[i] = (rand() % 1000) * amplitude + offset;
+					data[i] = (prng_next(&devc->prng_state) % 1000) * amplitude + offset;
 				else
 					data[i] = pattern->data[ag_pattern_pos + i] * amplitude + offset;
 			}
 		} else {
-			/* Amplitude and offset unchanged, use the fast way. */
-			ag->packet.data = pattern->data + ag_pattern_pos;
+			/*
+			 * Amplitude and offset unchanged, use the fast way.
+			 * Transforms may modify the data, never send the
+			 * pattern itself.
+			 */
+			memcpy(ag->data, pattern->data + ag_pattern_pos,
+				sending_now * sizeof(float));
 		}
+		ag->packet.data = ag->data;
 		ag->packet.num_samples = sending_now;
 		sr_session_send(sdi, &packet);
 
@@ -541,7 +871,7 @@ static void send_analog_packet(struct analog_gen *ag,
 
 		for (i = 0; i < to_avg; i++) {
 			if (ag->pattern == PATTERN_ANALOG_RANDOM)
-				value = (rand() % 1000) * amplitude + offset;
+				value = (prng_next(&devc->prng_state) % 1000) * amplitude + offset;
 			else
 				value = *(pattern->data + ag_pattern_pos + i) * amplitude + offset;
 			ag->avg_val = (ag->avg_val + value) / 2;
@@ -586,6 +916,9 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 	int64_t elapsed_us, limit_us, todo_us;
 	int64_t trigger_offset;
 	int pre_trigger_samples;
+	uint8_t *logic_data;
+	GBytes *logic_bytes;
+	gboolean need_fixup;
 
 	(void)fd;
 	(void)revents;
@@ -601,17 +934,22 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 		return G_SOURCE_CONTINUE;
 	}
 
-	/* What time span should we send samples for? */
-	elapsed_us = g_get_monotonic_time() - devc->start_us;
 	limit_us = 1000 * devc->limit_msec;
-	if (limit_us > 0 && limit_us < elapsed_us)
-		todo_us = MAX(0, limit_us - devc->spent_us);
-	else
-		todo_us = MAX(0, elapsed_us - devc->spent_us);
+	if (devc->unpaced) {
+		/* Don't care about time, send as much as the session takes. */
+		samples_todo = UNPACED_SAMPLES_PER_RUN;
+	} else {
+		/* What time span should we send samples for? */
+		elapsed_us = g_get_monotonic_time() - devc->start_us;
+		if (limit_us > 0 && limit_us < elapsed_us)
+			todo_us = MAX(0, limit_us - devc->spent_us);
+		else
+			todo_us = MAX(0, elapsed_us - devc->spent_us);
 
-	/* How many samples are outstanding since the last round? */
-	samples_todo = (todo_us * devc->cur_samplerate + G_USEC_PER_SEC - 1)
-			/ G_USEC_PER_SEC;
+		/* How many samples are outstanding since the last round? */
+		samples_todo = (todo_us * devc->cur_samplerate + G_USEC_PER_SEC - 1)
+				/ G_USEC_PER_SEC;
+	}
 
 	if (devc->limit_samples > 0) {
 		if (devc->limit_samples < devc->sent_samples)
@@ -650,12 +988,40 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 		if (logic_done < samples_todo) {
 			sending_now = MIN(samples_todo - logic_done,
 					LOGIC_BUFSIZE / devc->logic_unitsize);
-			logic_generator(sdi, sending_now * devc->logic_unitsize);
+			logic_bytes = NULL;
+			if (devc->logic_period_data) {
+				/*
+				 * Pre-generated and already masked. Transforms
+				 * may modify the data, so send a copy.
+				 */
+				memcpy(devc->logic_data, devc->logic_period_data
+					+ devc->logic_period_pos * devc->logic_unitsize,
+					sending_now * devc->logic_unitsize);
+				logic_data = devc->logic_data;
+				if (devc->stl && !devc->trigger_fired)
+					logic_bytes = g_bytes_new_from_bytes(devc->logic_period,
+						devc->logic_period_pos * devc->logic_unitsize,
+						sending_now * devc->logic_unitsize);
+				devc->logic_period_pos += sending_now;
+				devc->logic_period_pos %= devc->logic_period_samples;
+				need_fixup = FALSE;
+			} else {
+				logic_generator(sdi, sending_now * devc->logic_unitsize);
+				logic_data = devc->logic_data;
+				need_fixup = TRUE;
+			}
 			/* Check for trigger and send pre-trigger data if needed */
 			if (devc->stl && (!devc->trigger_fired)) {
-				trigger_offset = soft_trigger_logic_check(devc->stl,
-						devc->logic_data, sending_now * devc->logic_unitsize,
-						&pre_trigger_samples);
+				if (logic_bytes) {
+					/* Pre-trigger history refers to the pattern memory. */
+					trigger_offset = soft_trigger_logic_check_bytes(devc->stl,
+							logic_bytes, &pre_trigger_samples);
+					g_bytes_unref(logic_bytes);
+				} else {
+					trigger_offset = soft_trigger_logic_check(devc->stl,
+							logic_data, sending_now * devc->logic_unitsize,
+							&pre_trigger_samples);
+				}
 				if (trigger_offset > -1) {
 					devc->trigger_fired = TRUE;
 					logic_done = pre_trigger_samples;
@@ -672,8 +1038,9 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 				if (devc->trigger_fired && (trigger_offset < (int)sending_now)) {
 					/* Send after-trigger data */
 					logic.length = (sending_now - trigger_offset) * devc->logic_unitsize;
-					logic.data = devc->logic_data + trigger_offset * devc->logic_unitsize;
-					logic_fixup_feed(devc, &logic);
+					logic.data = logic_data + trigger_offset * devc->logic_unitsize;
+					if (need_fixup)
+						logic_fixup_feed(devc, &logic);
 					sr_session_send(sdi, &packet);
 					logic_done += sending_now - trigger_offset;
 					/* End acquisition */
@@ -687,8 +1054,9 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 			} else if (!devc->stl) {
 				/* No trigger defined, send logic samples */
 				logic.length = sending_now * devc->logic_unitsize;
-				logic.data = devc->logic_data;
-				logic_fixup_feed(devc, &logic);
+				logic.data = logic_data;
+				if (need_fixup)
+					logic_fixup_feed(devc, &logic);
 				sr_session_send(sdi, &packet);
 				logic_done += sending_now;
 			}
@@ -711,7 +1079,10 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 	uint64_t min = MIN(logic_done, analog_done);
 	devc->sent_samples += min;
 	devc->sent_frame_samples += min;
-	devc->spent_us += todo_us;
+	if (devc->unpaced)
+		devc->spent_us = g_get_monotonic_time() - devc->start_us;
+	else
+		devc->spent_us += todo_us;
 
 	if (devc->limit_frames && devc->sent_frame_samples >= SAMPLES_PER_FRAME) {
 		std_session_send_df_frame_end(sdi);
@@ -735,6 +1106,8 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 				packet.payload = &ag->packet;
 				ag->packet.data = &ag->avg_val;
 				ag->packet.num_samples = 1;
+				sr_rational_set(&ag->encoding.scale, 1, 1);
+				sr_rational_set(&ag->encoding.offset, 0, 1);
 				sr_session_send(sdi, &packet);
 			}
 		}
@@ -36,6 +36,8 @@
 #define ANALOG_BUFSIZE			4096
 /* This is a development feature: it starts a new frame every n samples. */
 #define SAMPLES_PER_FRAME		1000UL
+/* Number of samples to generate per callback in unpaced mode. */
+#define UNPACED_SAMPLES_PER_RUN		(64 * LOGIC_BUFSIZE)
 #define DEFAULT_LIMIT_FRAMES		0
 
 #define DEFAULT_ANALOG_ENCODING_DIGITS	4
@@ -43,6 +45,12 @@
 #define DEFAULT_ANALOG_AMPLITUDE		10
 #define DEFAULT_ANALOG_OFFSET			0.
 
+/* Bit rate and busy percentage of the bus traffic patterns. */
+#define DEFAULT_BUS_FREQ		SR_KHZ(10)
+#define DEFAULT_BUS_DUTY		50.
+/* Enough for the longest message any bus pattern composes. */
+#define BUS_MAX_SEGMENTS		512
+
 /* Logic patterns we can generate. */
 enum logic_pattern_type {
 	/**
@@ -87,6 +95,30 @@ enum logic_pattern_type {
 
 	/** Gray encoded data, like rotary encoder signals. */
 	PATTERN_GRAYCODE,
+
+	/*
+	 * Bus traffic of random content. The bit rate and the fraction
+	 * of time the bus is busy (as opposed to idle) are configurable.
+	 * Messages are separated by idle gaps of random length.
+	 */
+
+	/** UART frames (8N1) on D0. */
+	PATTERN_UART,
+
+	/** SPI transfers (mode 0): CLK on D0, MOSI on D1, MISO on D2, CS# on D3. */
+	PATTERN_SPI,
+
+	/** I2C writes including start, ACK and stop: SCL on D0, SDA on D1. */
+	PATTERN_I2C,
+
+	/** Bursts of random data on all channels, at the bit rate. */
+	PATTERN_BURSTY,
+};
+
+/* A run of samples with identical line levels. */
+struct bus_segment {
+	uint64_t value;
+	uint64_t count;
 };
 
 /* Analog patterns we can generate. */
@@ -121,6 +153,9 @@ struct dev_context {
 	int64_t start_us;
 	int64_t spent_us;
 	uint64_t step;
+	/* Generate as fast as the session accepts data (benchmark). */
+	gboolean unpaced;
+	uint64_t prng_state;
 	/* Logic */
 	int32_t num_logic_channels;
 	size_t logic_unitsize;
@@ -128,6 +163,24 @@ struct dev_context {
 	/* There is only ever one logic channel group, so its pattern goes here. */
 	enum logic_pattern_type logic_pattern;
 	uint8_t logic_data[LOGIC_BUFSIZE];
+	/*
+	 * Periodic patterns in unpaced mode: one period plus one buffer
+	 * of already masked samples, so that any position can be sent
+	 * without copying or generating data. Refcounted, so that the
+	 * soft trigger can keep pre-trigger data without copying.
+	 */
+	GBytes *logic_period;
+	uint8_t *logic_period_data;
+	size_t logic_period_samples;
+	size_t logic_period_pos;
+	/* Bus traffic patterns: the message currently being sent. */
+	double bus_freq;
+	double bus_duty;
+	struct bus_segment bus_segs[BUS_MAX_SEGMENTS];
+	size_t bus_seg_count;
+	size_t bus_seg_pos;
+	uint64_t bus_value;
+	uint64_t bus_left;
 	/* Analog */
 	struct analog_pattern *analog_patterns[ARRAY_SIZE(analog_pattern_str)];
 	int32_t num_analog_channels;
@@ -156,12 +209,16 @@ struct analog_gen {
 	struct sr_analog_encoding encoding;
 	struct sr_analog_meaning meaning;
 	struct sr_analog_spec spec;
+	float data[ANALOG_BUFSIZE]; /* Sent data, transforms may modify it */
 	float avg_val; /* Average value */
 	unsigned int num_avgs; /* Number of samples averaged */
 };
 
 SR_PRIV void demo_generate_analog_pattern(struct dev_context *devc);
 SR_PRIV void demo_free_analog_pattern(struct dev_context *devc);
+SR_PRIV void demo_prepare_logic_period(struct sr_dev_inst *sdi);
+SR_PRIV void demo_free_logic_period(struct dev_context *devc);
+SR_PRIV void demo_reset_bus_pattern(struct dev_context *devc);
 SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data);
 
 #endif
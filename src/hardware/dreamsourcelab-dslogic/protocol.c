@@ -682,6 +682,7 @@ static void finish_acquisition(struct sr_dev_inst *sdi)
 
 	usb_source_remove(sdi->session, devc->ctx);
 
+	sr_usb_stream_log_stats(&devc->stream);
 	devc->num_transfers = 0;
 	g_free(devc->transfers);
 	g_free(devc->deinterleave_buffer);
@@ -714,9 +715,14 @@ static void free_transfer(struct libusb_transfer *transfer)
 
 static void resubmit_transfer(struct libusb_transfer *transfer)
 {
+	struct sr_dev_inst *sdi;
+	struct dev_context *devc;
 	int ret;
 
-	if ((ret = libusb_submit_transfer(transfer)) == LIBUSB_SUCCESS)
+	sdi = transfer->user_data;
+	devc = sdi->priv;
+
+	if ((ret = sr_usb_stream_resubmit(&devc->stream, transfer)) == LIBUSB_SUCCESS)
 		return;
 
 	sr_err("%s: %s", __func__, libusb_error_name(ret));
@@ -791,7 +797,7 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 	sr_dbg("receive_transfer(): status %s received %d bytes.",
 		libusb_error_name(transfer->status), transfer->actual_length);
 
-	/* Save incoming transfer before reusing the transfer struct. */
+	sr_usb_stream_completed(&devc->stream, transfer);
 
 	switch (transfer->status) {
 	case LIBUSB_TRANSFER_NO_DEVICE:
@@ -905,50 +911,34 @@ static size_t to_bytes_per_ms(const struct sr_dev_inst *sdi)
 	return 35000000 / (1000 * 10);
 }
 
-static size_t get_buffer_size(const struct sr_dev_inst *sdi)
+/*
+ * Transfers hold 10ms of data and are multiples of the size of a data
+ * atom, about 100ms are kept in flight. The transfer size gets adjusted
+ * at runtime.
+ */
+static void init_stream(const struct sr_dev_inst *sdi)
 {
-	/*
-	 * The buffer should be large enough to hold 10ms of data and
-	 * a multiple of the size of a data atom.
-	 */
+	struct dev_context *const devc = sdi->priv;
 	const size_t block_size = enabled_channel_count(sdi) * 512;
-	const size_t s = 10 * to_bytes_per_ms(sdi);
-	if (!block_size)
-		return s;
-	return ((s + block_size - 1) / block_size) * block_size;
-}
 
-static unsigned int get_number_of_transfers(const struct sr_dev_inst *sdi)
-{
-	/* Total buffer size should be able to hold about 100ms of data. */
-	const unsigned int s = get_buffer_size(sdi);
-	const unsigned int n = (100 * to_bytes_per_ms(sdi) + s - 1) / s;
-	return (n > NUM_SIMUL_TRANSFERS) ? NUM_SIMUL_TRANSFERS : n;
-}
-
-static unsigned int get_timeout(const struct sr_dev_inst *sdi)
-{
-	const size_t total_size = get_buffer_size(sdi) *
-		get_number_of_transfers(sdi);
-	const unsigned int timeout = total_size / to_bytes_per_ms(sdi);
-	return timeout + timeout / 4; /* Leave a headroom of 25% percent. */
+	sr_usb_stream_init(&devc->stream, sdi, to_bytes_per_ms(sdi),
+		block_size, 100, NUM_SIMUL_TRANSFERS);
 }
 
 static int start_transfers(const struct sr_dev_inst *sdi)
 {
+	struct dev_context *const devc = sdi->priv;
 	const size_t channel_count = enabled_channel_count(sdi);
-	const size_t size = get_buffer_size(sdi);
-	const unsigned int num_transfers = get_number_of_transfers(sdi);
-	const unsigned int timeout = get_timeout(sdi);
+	const size_t size = devc->stream.size;
+	const unsigned int num_transfers = devc->stream.depth;
+	const unsigned int timeout = sr_usb_stream_timeout(&devc->stream);
 
-	struct dev_context *devc;
 	struct sr_usb_dev_inst *usb;
 	struct libusb_transfer *transfer;
 	unsigned int i;
 	int ret;
 	unsigned char *buf;
 
-	devc = sdi->priv;
 	usb = sdi->conn;
 
 	devc->sent_samples = 0;
@@ -963,8 +953,10 @@ static int start_transfers(const struct sr_dev_inst *sdi)
 		return SR_ERR_MALLOC;
 	}
 
+	/* Transfers may grow up to the stream's maximum size. */
 	devc->deinterleave_buffer = g_try_malloc(DSLOGIC_ATOMIC_SAMPLES *
-		(size / (channel_count * DSLOGIC_ATOMIC_BYTES)) * sizeof(uint16_t));
+		(devc->stream.max_size / (channel_count * DSLOGIC_ATOMIC_BYTES)) *
+		sizeof(uint16_t));
 	if (!devc->deinterleave_buffer) {
 		sr_err("Deinterleave buffer malloc failed.");
 		g_free(devc->deinterleave_buffer);
@@ -1028,8 +1020,6 @@ static void LIBUSB_CALL trigger_receive(struct libusb_transfer *transfer)
 
 SR_PRIV int dslogic_acquisition_start(const struct sr_dev_inst *sdi)
 {
-	const unsigned int timeout = get_timeout(sdi);
-
 	struct sr_dev_driver *di;
 	struct drv_context *drvc;
 	struct dev_context *devc;
@@ -1048,7 +1038,9 @@ SR_PRIV int dslogic_acquisition_start(const struct sr_dev_inst *sdi)
 	devc->empty_transfer_count = 0;
 	devc->acq_aborted = FALSE;
 
-	usb_source_add(sdi->session, devc->ctx, timeout, receive_data, drvc);
+	init_stream(sdi);
+	usb_source_add(sdi->session, devc->ctx,
+		sr_usb_stream_timeout(&devc->stream), receive_data, drvc);
 
 	if ((ret = command_stop_acquisition(sdi)) != SR_OK)
 		return ret;
@@ -128,6 +128,7 @@ struct dev_context {
 	int submitted_transfers;
 	int empty_transfer_count;
 
+	struct sr_usb_stream stream;
 	unsigned int num_transfers;
 	struct libusb_transfer **transfers;
 	struct sr_context *ctx;
@@ -185,6 +185,52 @@ static gboolean is_plausible(const struct libusb_device_descriptor *des)
 	return FALSE;
 }
 
+/*
+ * Get the string descriptors of a device from the identification cache.
+ * The cache ID includes the VID:PID, which the firmware upload changes,
+ * and the serial number, so cached strings refer to the current firmware
+ * of the very same unit.
+ */
+static gboolean idcache_get_strings(const char *cache_id,
+	char *manufacturer, char *product, char *serial_num, size_t len)
+{
+	char *value;
+	char **fields;
+	gboolean found;
+
+	if (!cache_id[0] || !sr_idcache_enabled())
+		return FALSE;
+
+	value = sr_idcache_lookup(cache_id, "usb-strings");
+	if (!value)
+		return FALSE;
+	fields = g_strsplit(value, "\t", 3);
+	found = g_strv_length(fields) == 3;
+	if (found) {
+		g_strlcpy(manufacturer, fields[0], len);
+		g_strlcpy(product, fields[1], len);
+		g_strlcpy(serial_num, fields[2], len);
+		sr_spew("Using cached strings for %s.", cache_id);
+	}
+	g_strfreev(fields);
+	g_free(value);
+
+	return found;
+}
+
+static void idcache_put_strings(const char *cache_id,
+	const char *manufacturer, const char *product, const char *serial_num)
+{
+	char *value;
+
+	if (!cache_id[0] || !sr_idcache_enabled())
+		return;
+
+	value = g_strjoin("\t", manufacturer, product, serial_num, NULL);
+	sr_idcache_store(cache_id, "usb-strings", value);
+	g_free(value);
+}
+
 static GSList *scan(struct sr_dev_driver *di, GSList *options)
 {
 	struct drv_context *drvc;
@@ -205,6 +251,7 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 	const char *conn;
 	const char *probe_names;
 	char manufacturer[64], product[64], serial_num[64], connection_id[64];
+	char cache_id[160];
 	size_t ch_max, ch_idx;
 	const char *channel_name;
 
@@ -258,6 +305,16 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 			continue;
 		}
 
+		/* Only devices with a serial number have a fingerprint. */
+		if (usb_get_idcache_id(devlist[i], hdl, cache_id,
+				sizeof(cache_id)) != SR_OK)
+			cache_id[0] = '\0';
+		if (idcache_get_strings(cache_id, manufacturer, product,
+				serial_num, sizeof(manufacturer))) {
+			libusb_close(hdl);
+			goto identified;
+		}
+
 		if (des.iManufacturer == 0) {
 			manufacturer[0] = '\0';
 		} else if ((ret = libusb_get_string_descriptor_ascii(hdl,
@@ -290,6 +347,9 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 
 		libusb_close(hdl);
 
+		idcache_put_strings(cache_id, manufacturer, product, serial_num);
+
+identified:
 		if (usb_get_port_path(devlist[i], connection_id, sizeof(connection_id)) < 0)
 			continue;
 
@@ -369,8 +429,8 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 
 		devc->samplerates = samplerates;
 		devc->num_samplerates = ARRAY_SIZE(samplerates);
-		has_firmware = usb_match_manuf_prod(devlist[i],
-				"sigrok", "fx2lafw");
+		has_firmware = !strcmp(manufacturer, "sigrok") &&
+				!strcmp(product, "fx2lafw");
 
 		if (has_firmware) {
 			/* Already has the firmware, so fix the new address. */
@@ -290,6 +290,7 @@ static void finish_acquisition(struct sr_dev_inst *sdi)
 
 	usb_source_remove(sdi->session, devc->ctx);
 
+	sr_usb_stream_log_stats(&devc->stream);
 	devc->num_transfers = 0;
 	g_free(devc->transfers);
 
@@ -303,6 +304,12 @@ static void finish_acquisition(struct sr_dev_inst *sdi)
 		soft_trigger_logic_free(devc->stl);
 		devc->stl = NULL;
 	}
+
+	/* All transfer buffers are back now, also the pre-trigger ones. */
+	sr_buffer_pool_log_stats(devc->pool);
+	sr_buffer_pool_free(devc->pool);
+	devc->pool = NULL;
+	devc->stream.pool = NULL;
 }
 
 static void free_transfer(struct libusb_transfer *transfer)
@@ -314,7 +321,7 @@ static void free_transfer(struct libusb_transfer *transfer)
 	sdi = transfer->user_data;
 	devc = sdi->priv;
 
-	g_free(transfer->buffer);
+	sr_buffer_pool_put(devc->pool, transfer->buffer);
 	transfer->buffer = NULL;
 	libusb_free_transfer(transfer);
 
@@ -332,9 +339,14 @@ static void free_transfer(struct libusb_transfer *transfer)
 
 static void resubmit_transfer(struct libusb_transfer *transfer)
 {
+	struct sr_dev_inst *sdi;
+	struct dev_context *devc;
 	int ret;
 
-	if ((ret = libusb_submit_transfer(transfer)) == LIBUSB_SUCCESS)
+	sdi = transfer->user_data;
+	devc = sdi->priv;
+
+	if ((ret = sr_usb_stream_resubmit(&devc->stream, transfer)) == LIBUSB_SUCCESS)
 		return;
 
 	sr_err("%s: %s", __func__, libusb_error_name(ret));
@@ -411,6 +423,46 @@ static void la_send_data_proc(struct sr_dev_inst *sdi,
 	sr_session_send(sdi, &packet);
 }
 
+/*
+ * Hand the transfer's data over to a GBytes, which the soft trigger can
+ * keep as pre-trigger history without copying it. The transfer gets a
+ * fresh buffer from the pool for its resubmission, the old buffer goes
+ * back to the pool when the history drops it.
+ */
+static GBytes *transfer_bytes_take(struct dev_context *devc,
+	struct libusb_transfer *transfer)
+{
+	GBytes *bytes;
+	uint8_t *buf;
+
+	buf = sr_buffer_pool_get(devc->pool, transfer->length);
+	if (!buf)
+		return NULL;
+	bytes = sr_buffer_pool_bytes_new(transfer->buffer,
+		transfer->actual_length);
+	transfer->buffer = buf;
+
+	return bytes;
+}
+
+static int check_trigger_bytes(struct dev_context *devc, GBytes *bytes,
+	uint8_t *data, size_t offset, size_t length, int *pre_trigger_samples)
+{
+	GBytes *part;
+	int trigger_offset;
+
+	if (!bytes)
+		return soft_trigger_logic_check(devc->stl, data + offset,
+			length, pre_trigger_samples);
+
+	part = g_bytes_new_from_bytes(bytes, offset, length);
+	trigger_offset = soft_trigger_logic_check_bytes(devc->stl, part,
+		pre_trigger_samples);
+	g_bytes_unref(part);
+
+	return trigger_offset;
+}
+
 static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 {
 	struct sr_dev_inst *sdi;
@@ -419,6 +471,8 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 	unsigned int num_samples;
 	int trigger_offset, cur_sample_count, unitsize, processed_samples;
 	int pre_trigger_samples;
+	uint8_t *data;
+	GBytes *bytes;
 
 	sdi = transfer->user_data;
 	devc = sdi->priv;
@@ -435,6 +489,8 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 	sr_dbg("receive_transfer(): status %s received %d bytes.",
 		libusb_error_name(transfer->status), transfer->actual_length);
 
+	sr_usb_stream_completed(&devc->stream, transfer);
+
 	/* Save incoming transfer before reusing the transfer struct. */
 	unitsize = devc->sample_wide ? 2 : 1;
 	cur_sample_count = transfer->actual_length / unitsize;
@@ -470,6 +526,15 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 		devc->empty_transfer_count = 0;
 	}
 
+	/*
+	 * Data before the trigger may be kept in the pre-trigger history.
+	 * Rather than copying it, swap the transfer's buffer.
+	 */
+	data = transfer->buffer;
+	bytes = NULL;
+	if (!devc->trigger_fired)
+		bytes = transfer_bytes_take(devc, transfer);
+
 check_trigger:
 	if (devc->trigger_fired) {
 		if (!devc->limit_samples || devc->sent_samples < devc->limit_samples) {
@@ -478,14 +543,14 @@ check_trigger:
 			if (devc->limit_samples && devc->sent_samples + num_samples > devc->limit_samples)
 				num_samples = devc->limit_samples - devc->sent_samples;
 
-			devc->send_data_proc(sdi, (uint8_t *)transfer->buffer + processed_samples * unitsize,
+			devc->send_data_proc(sdi, data + processed_samples * unitsize,
 				num_samples * unitsize, unitsize);
 			devc->sent_samples += num_samples;
 			processed_samples += num_samples;
 		}
 	} else {
-		trigger_offset = soft_trigger_logic_check(devc->stl,
-			transfer->buffer + processed_samples * unitsize,
+		trigger_offset = check_trigger_bytes(devc, bytes, data,
+			processed_samples * unitsize,
 			transfer->actual_length - processed_samples * unitsize,
 			&pre_trigger_samples);
 		if (trigger_offset > -1) {
@@ -496,7 +561,7 @@ check_trigger:
 					devc->sent_samples + num_samples > devc->limit_samples)
 				num_samples = devc->limit_samples - devc->sent_samples;
 
-			devc->send_data_proc(sdi, (uint8_t *)transfer->buffer
+			devc->send_data_proc(sdi, data
 					+ processed_samples * unitsize
 					+ trigger_offset * unitsize,
 					num_samples * unitsize, unitsize);
@@ -529,6 +594,9 @@ check_trigger:
 				goto check_trigger;
 		}
 	}
+	if (bytes)
+		g_bytes_unref(bytes);
+
 	if (frame_ended && final_frame) {
 		fx2lafw_abort_acquisition(devc);
 		free_transfer(transfer);
@@ -570,46 +638,9 @@ static int configure_channels(const struct sr_dev_inst *sdi)
 	return SR_OK;
 }
 
-static unsigned int to_bytes_per_ms(unsigned int samplerate)
-{
-	return samplerate / 1000;
-}
-
-static size_t get_buffer_size(struct dev_context *devc)
-{
-	size_t s;
-
-	/*
-	 * The buffer should be large enough to hold 10ms of data and
-	 * a multiple of 512.
-	 */
-	s = 10 * to_bytes_per_ms(devc->cur_samplerate);
-	return (s + 511) & ~511;
-}
-
-static unsigned int get_number_of_transfers(struct dev_context *devc)
+static uint64_t to_bytes_per_ms(struct dev_context *devc)
 {
-	unsigned int n;
-
-	/* Total buffer size should be able to hold about 500ms of data. */
-	n = (500 * to_bytes_per_ms(devc->cur_samplerate) /
-		get_buffer_size(devc));
-
-	if (n > NUM_SIMUL_TRANSFERS)
-		return NUM_SIMUL_TRANSFERS;
-
-	return n;
-}
-
-static unsigned int get_timeout(struct dev_context *devc)
-{
-	size_t total_size;
-	unsigned int timeout;
-
-	total_size = get_buffer_size(devc) *
-			get_number_of_transfers(devc);
-	timeout = total_size / to_bytes_per_ms(devc->cur_samplerate);
-	return timeout + timeout / 4; /* Leave a headroom of 25% percent. */
+	return devc->cur_samplerate / 1000 * (devc->sample_wide ? 2 : 1);
 }
 
 static int receive_data(int fd, int revents, void *cb_data)
@@ -659,21 +690,26 @@ static int start_transfers(const struct sr_dev_inst *sdi)
 		devc->trigger_fired = TRUE;
 	}
 
-	num_transfers = get_number_of_transfers(devc);
+	num_transfers = devc->stream.depth;
 
-	size = get_buffer_size(devc);
+	size = devc->stream.size;
 	devc->submitted_transfers = 0;
 
+	/* Spare buffers to swap in, see transfer_bytes_take(). */
+	if (!devc->pool)
+		devc->pool = sr_buffer_pool_new(sdi, num_transfers);
+	devc->stream.pool = devc->pool;
+
 	devc->transfers = g_try_malloc0(sizeof(*devc->transfers) * num_transfers);
 	if (!devc->transfers) {
 		sr_err("USB transfers malloc failed.");
 		return SR_ERR_MALLOC;
 	}
 
-	timeout = get_timeout(devc);
+	timeout = sr_usb_stream_timeout(&devc->stream);
 	devc->num_transfers = num_transfers;
 	for (i = 0; i < num_transfers; i++) {
-		if (!(buf = g_try_malloc(size))) {
+		if (!(buf = sr_buffer_pool_get(devc->pool, size))) {
 			sr_err("USB transfer buffer malloc failed.");
 			return SR_ERR_MALLOC;
 		}
@@ -686,7 +722,7 @@ static int start_transfers(const struct sr_dev_inst *sdi)
 			sr_err("Failed to submit transfer: %s.",
 			       libusb_error_name(ret));
 			libusb_free_transfer(transfer);
-			g_free(buf);
+			sr_buffer_pool_put(devc->pool, buf);
 			fx2lafw_abort_acquisition(devc);
 			return SR_ERR;
 		}
@@ -732,13 +768,20 @@ SR_PRIV int fx2lafw_start_acquisition(const struct sr_dev_inst *sdi)
 		return SR_ERR;
 	}
 
-	timeout = get_timeout(devc);
+	/*
+	 * Transfers hold 10ms of data, about 500ms are kept in flight.
+	 * The transfer size gets adjusted at runtime.
+	 */
+	sr_usb_stream_init(&devc->stream, sdi, to_bytes_per_ms(devc),
+		512, 500, NUM_SIMUL_TRANSFERS);
+
+	timeout = sr_usb_stream_timeout(&devc->stream);
 	usb_source_add(sdi->session, devc->ctx, timeout, receive_data, drvc);
 
-	size = get_buffer_size(devc);
 	/* Prepare for analog sampling. */
 	if (g_slist_length(devc->enabled_analog_channels) > 0) {
-		/* We need a buffer half the size of a transfer. */
+		/* We need a buffer half the size of the largest transfer. */
+		size = devc->stream.max_size;
 		devc->logic_buffer = g_try_malloc(size / 2);
 		devc->analog_buffer = g_try_malloc(
 			sizeof(float) * size / 2);
@@ -117,6 +117,9 @@ struct dev_context {
 	int submitted_transfers;
 	int empty_transfer_count;
 
+	struct sr_usb_stream stream;
+	/* Transfer buffers, see transfer_bytes_take(). */
+	struct sr_buffer_pool *pool;
 	unsigned int num_transfers;
 	struct libusb_transfer **transfers;
 	struct sr_context *ctx;
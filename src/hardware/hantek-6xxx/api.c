@@ -145,6 +145,7 @@ static struct sr_dev_inst *hantek_6xxx_dev_new(const struct hantek_6xxx_profile
 	}
 
 	devc = g_malloc0(sizeof(struct dev_context));
+	devc->pool = sr_buffer_pool_new(sdi, 2);
 
 	for (i = 0; i < NUM_CHANNELS; i++) {
 		devc->ch_enabled[i] = TRUE;
@@ -192,6 +193,7 @@ static int configure_channels(const struct sr_dev_inst *sdi)
 static void clear_helper(struct dev_context *devc)
 {
 	g_slist_free(devc->enabled_channels);
+	sr_buffer_pool_free(devc->pool);
 }
 
 static int dev_clear(const struct sr_dev_driver *di)
@@ -564,7 +566,7 @@ static void send_chunk(struct sr_dev_inst *sdi, unsigned char *buf,
 	analog.meaning->unit = SR_UNIT_VOLT;
 	analog.meaning->mqflags = 0;
 
-	analog.data = g_try_malloc(num_samples * sizeof(float));
+	analog.data = sr_buffer_pool_get(devc->pool, num_samples);
 	if (!analog.data) {
 		sr_err("Analog data buffer malloc failed.");
 		devc->dev_state = STOPPING;
@@ -580,6 +582,9 @@ static void send_chunk(struct sr_dev_inst *sdi, unsigned char *buf,
 		analog.encoding->digits = digits;
 		analog.spec->spec_digits = digits;
 		analog.meaning->channels = g_slist_append(NULL, channels->data);
+		/* Send the raw values, consumers convert them when needed. */
+		sr_analog_encoding_set_integer(analog.encoding, 1, FALSE,
+			ch_bit[ch], -ch_center[ch]);
 
 		for (int i = 0; i < num_samples; i++) {
 			/*
@@ -593,7 +598,7 @@ static void send_chunk(struct sr_dev_inst *sdi, unsigned char *buf,
 			 * setting. There are 10 vertical divs, so e.g. 500mV/div
 			 * represents 5V peak-to-peak where 0 = -2.5V and 255 = +2.5V.
 			 */
-			((float *)analog.data)[i] = ch_bit[ch] * *(buf + i * 2 + ch) - ch_center[ch];
+			((uint8_t *)analog.data)[i] = *(buf + i * 2 + ch);
 		}
 
 		sr_session_send(sdi, &packet);
@@ -601,7 +606,7 @@ static void send_chunk(struct sr_dev_inst *sdi, unsigned char *buf,
 
 		channels = channels->next;
 	}
-	g_free(analog.data);
+	sr_buffer_pool_put(devc->pool, analog.data);
 }
 
 /*
@@ -757,6 +762,7 @@ static int dev_acquisition_stop(struct sr_dev_inst *sdi)
 
 	devc = sdi->priv;
 	devc->dev_state = STOPPING;
+	sr_buffer_pool_log_stats(devc->pool);
 
 	return SR_OK;
 }
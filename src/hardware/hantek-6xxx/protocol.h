@@ -145,6 +145,9 @@ struct dev_context {
 
 	uint64_t limit_msec;
 	uint64_t limit_samples;
+
+	/* Buffers for one channel's raw samples, from the interleaved data. */
+	struct sr_buffer_pool *pool;
 };
 
 SR_PRIV int hantek_6xxx_open(struct sr_dev_inst *sdi);
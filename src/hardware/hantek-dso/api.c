@@ -204,6 +204,7 @@ static struct sr_dev_inst *dso_dev_new(const struct dso_profile *prof)
 	}
 
 	devc = g_malloc0(sizeof(struct dev_context));
+	devc->pool = sr_buffer_pool_new(sdi, 2);
 	devc->profile = prof;
 	devc->dev_state = IDLE;
 	devc->timebase = DEFAULT_TIMEBASE;
@@ -255,6 +256,7 @@ static void clear_helper(struct dev_context *devc)
 {
 	g_free(devc->triggersource);
 	g_slist_free(devc->enabled_channels);
+	sr_buffer_pool_free(devc->pool);
 }
 
 static int dev_clear(const struct sr_dev_driver *di)
@@ -659,8 +661,11 @@ static void send_chunk(struct sr_dev_inst *sdi, unsigned char *buf,
 	analog.meaning->mq = SR_MQ_VOLTAGE;
 	analog.meaning->unit = SR_UNIT_VOLT;
 	analog.meaning->mqflags = 0;
-	/* TODO: Check malloc return value. */
-	analog.data = g_try_malloc(num_samples * sizeof(float));
+	analog.data = sr_buffer_pool_get(devc->pool, num_samples);
+	if (!analog.data) {
+		sr_err("Analog data buffer malloc failed.");
+		return;
+	}
 
 	for (int ch = 0; ch < NUM_CHANNELS; ch++) {
 		if (!devc->ch_enabled[ch])
@@ -672,6 +677,9 @@ static void send_chunk(struct sr_dev_inst *sdi, unsigned char *buf,
 		analog.encoding->digits = digits;
 		analog.spec->spec_digits = digits;
 		analog.meaning->channels = g_slist_append(NULL, channels->data);
+		/* Send the raw values, consumers convert them when needed. */
+		sr_analog_encoding_set_integer(analog.encoding, 1, FALSE,
+			range / 255, -range / 2);
 
 		for (int i = 0; i < num_samples; i++) {
 			/*
@@ -687,14 +695,14 @@ static void send_chunk(struct sr_dev_inst *sdi, unsigned char *buf,
 			 * and 255 = +2V.
 			 */
 			/* TODO: Support for DSO-5xxx series 9-bit samples. */
-			((float *)analog.data)[i] = range / 255 * *(buf + i * 2 + 1 - ch) - range / 2;
+			((uint8_t *)analog.data)[i] = *(buf + i * 2 + 1 - ch);
 		}
 		sr_session_send(sdi, &packet);
 		g_slist_free(analog.meaning->channels);
 
 		channels = channels->next;
 	}
-	g_free(analog.data);
+	sr_buffer_pool_put(devc->pool, analog.data);
 }
 
 /*
@@ -937,6 +945,7 @@ static int dev_acquisition_stop(struct sr_dev_inst *sdi)
 
 	devc = sdi->priv;
 	devc->dev_state = STOPPING;
+	sr_buffer_pool_log_stats(devc->pool);
 	devc->num_frames = 0;
 
 	return SR_OK;
@@ -212,6 +212,8 @@ struct dev_context {
 	unsigned int samp_buffered;
 	unsigned int trigger_offset;
 	unsigned char *framebuf;
+	/* Buffers for one channel's raw samples, from the interleaved data. */
+	struct sr_buffer_pool *pool;
 };
 
 SR_PRIV int dso_open(struct sr_dev_inst *sdi);
@@ -252,6 +252,8 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	sr_session_source_add(sdi->session, tcp->socket, G_IO_IN, 100,
 		ipdbg_la_receive_data, (struct sr_dev_inst *)sdi);
 
+	std_session_send_df_header(sdi);
+
 	ipdbg_la_send_start(tcp);
 
 	return SR_OK;
@@ -37,6 +37,9 @@
 
 #define BUFFER_SIZE 4
 
+/* Sample data gets received and forwarded in chunks of this size. */
+#define RECV_BUFFER_SIZE (64 * 1024)
+
 /* Top-level command opcodes */
 #define CMD_SET_TRIGGER            0x00
 #define CMD_CFG_TRIGGER            0xF0
@@ -221,7 +224,9 @@ SR_PRIV int ipdbg_la_convert_trigger(const struct sr_dev_inst *sdi)
 
 	devc->num_stages = 0;
 	devc->num_transfers = 0;
-	devc->raw_sample_buf = NULL;
+	devc->recv_fill = 0;
+	devc->samples_sent = 0;
+	devc->trigger_sent = FALSE;
 
 	for (uint64_t i = 0; i < devc->data_width_bytes; i++) {
 		devc->trigger_mask[i] = 0;
@@ -279,10 +284,50 @@ SR_PRIV int ipdbg_la_convert_trigger(const struct sr_dev_inst *sdi)
 	return SR_OK;
 }
 
+/*
+ * Forward samples to the session, and insert the trigger marker at the
+ * position where the device placed the trigger (after delay_value
+ * pre-trigger samples).
+ */
+static void send_samples(const struct sr_dev_inst *sdi,
+	uint8_t *data, uint64_t count)
+{
+	struct dev_context *devc;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	uint64_t chunk;
+
+	devc = sdi->priv;
+
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.unitsize = devc->data_width_bytes;
+
+	while (count) {
+		if (!devc->trigger_sent && devc->samples_sent == devc->delay_value) {
+			std_session_send_df_trigger(sdi);
+			devc->trigger_sent = TRUE;
+		}
+		chunk = count;
+		if (!devc->trigger_sent)
+			chunk = MIN(chunk, devc->delay_value - devc->samples_sent);
+		logic.length = chunk * devc->data_width_bytes;
+		logic.data = data;
+		sr_session_send(sdi, &packet);
+		data += logic.length;
+		count -= chunk;
+		devc->samples_sent += chunk;
+	}
+}
+
 SR_PRIV int ipdbg_la_receive_data(int fd, int revents, void *cb_data)
 {
 	const struct sr_dev_inst *sdi;
 	struct dev_context *devc;
+	struct ipdbg_la_tcp *tcp;
+	uint64_t total, count, keep;
+	size_t space, used;
+	int recd;
 
 	(void)fd;
 	(void)revents;
@@ -294,67 +339,40 @@ SR_PRIV int ipdbg_la_receive_data(int fd, int revents, void *cb_data)
 	if (!(devc = sdi->priv))
 		return FALSE;
 
-	struct ipdbg_la_tcp *tcp = sdi->conn;
-	struct sr_datafeed_packet packet;
-	struct sr_datafeed_logic logic;
-
-	if (!devc->raw_sample_buf) {
-		devc->raw_sample_buf =
-			g_try_malloc(devc->limit_samples * devc->data_width_bytes);
-		if (!devc->raw_sample_buf) {
-			sr_err("Sample buffer malloc failed.");
-			return FALSE;
+	tcp = sdi->conn;
+
+	if (!devc->recv_buf)
+		devc->recv_buf = g_malloc(RECV_BUFFER_SIZE);
+
+	/*
+	 * The device always sends its full memory. Forward the requested
+	 * number of samples as they arrive, and discard the rest.
+	 */
+	total = devc->limit_samples_max * devc->data_width_bytes;
+	while (devc->num_transfers < total) {
+		space = RECV_BUFFER_SIZE - devc->recv_fill;
+		space = MIN(space, total - devc->num_transfers);
+		recd = ipdbg_la_tcp_receive(tcp,
+			devc->recv_buf + devc->recv_fill, space);
+		if (recd <= 0)
+			break;
+		devc->num_transfers += recd;
+		devc->recv_fill += recd;
+
+		count = devc->recv_fill / devc->data_width_bytes;
+		used = count * devc->data_width_bytes;
+		if (devc->samples_sent < devc->limit_samples) {
+			keep = MIN(count, devc->limit_samples - devc->samples_sent);
+			send_samples(sdi, devc->recv_buf, keep);
 		}
+		/* Keep an incomplete sample for the next round. */
+		memmove(devc->recv_buf, devc->recv_buf + used,
+			devc->recv_fill - used);
+		devc->recv_fill -= used;
 	}
 
-	if (devc->num_transfers <
-		(devc->limit_samples_max * devc->data_width_bytes)) {
-		const size_t bufsize = 1024;
-		uint8_t buffer[bufsize];
-
-		const int recd = ipdbg_la_tcp_receive(tcp, buffer, bufsize);
-		if ( recd > 0) {
-			int num_move = (((devc->num_transfers + recd) <=
-							 (devc->limit_samples * devc->data_width_bytes))
-			?
-				recd
-			:
-				(int)((devc->limit_samples * devc->data_width_bytes) -
-						devc->num_transfers));
-			if ( num_move > 0 )
-				memcpy(&(devc->raw_sample_buf[devc->num_transfers]),
-						buffer, num_move);
-			devc->num_transfers += recd;
-		}
-	} else {
-		if (devc->delay_value > 0) {
-			/* There are pre-trigger samples, send those first. */
-			packet.type = SR_DF_LOGIC;
-			packet.payload = &logic;
-			logic.length = devc->delay_value * devc->data_width_bytes;
-			logic.unitsize = devc->data_width_bytes;
-			logic.data = devc->raw_sample_buf;
-			sr_session_send(cb_data, &packet);
-		}
-
-		/* Send the trigger. */
-		std_session_send_df_trigger(cb_data);
-
-		/* Send post-trigger samples. */
-		packet.type = SR_DF_LOGIC;
-		packet.payload = &logic;
-		logic.length = (devc->limit_samples - devc->delay_value) *
-			devc->data_width_bytes;
-		logic.unitsize = devc->data_width_bytes;
-		logic.data = devc->raw_sample_buf +
-			(devc->delay_value * devc->data_width_bytes);
-		sr_session_send(cb_data, &packet);
-
-		g_free(devc->raw_sample_buf);
-		devc->raw_sample_buf = NULL;
-
+	if (devc->num_transfers >= total)
 		ipdbg_la_abort_acquisition(sdi);
-	}
 
 	return TRUE;
 }
@@ -555,9 +573,13 @@ SR_PRIV int ipdbg_la_request_id(struct ipdbg_la_tcp *tcp)
 SR_PRIV void ipdbg_la_abort_acquisition(const struct sr_dev_inst *sdi)
 {
 	struct ipdbg_la_tcp *tcp = sdi->conn;
+	struct dev_context *devc = sdi->priv;
 
 	sr_session_source_remove(sdi->session, tcp->socket);
 
+	g_free(devc->recv_buf);
+	devc->recv_buf = NULL;
+
 	std_session_send_df_end(sdi);
 }
 
@@ -51,7 +51,11 @@ struct dev_context {
 	uint64_t delay_value;
 	int num_stages;
 	uint64_t num_transfers;
-	uint8_t *raw_sample_buf;
+	/* Received bytes which don't form a complete sample yet. */
+	uint8_t *recv_buf;
+	size_t recv_fill;
+	uint64_t samples_sent;
+	gboolean trigger_sent;
 };
 
 SR_PRIV struct ipdbg_la_tcp *ipdbg_la_tcp_new(void);
@@ -1076,6 +1076,14 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 		devc->packets_per_chunk /= unitsize + repsize;
 	}
 
+	/*
+	 * In stream mode the samples arrive at the samplerate, which
+	 * turns a time limit into an exact samples count. Capture mode
+	 * checks the time limit against the clock while the device is
+	 * busy, before any samples were received.
+	 */
+	sr_sw_limits_set_samplerate(&devc->sw_limits,
+		devc->continuous ? devc->samplerate : 0);
 	sr_sw_limits_acquisition_start(&devc->sw_limits);
 
 	voltage = threshold_voltage(sdi, NULL);
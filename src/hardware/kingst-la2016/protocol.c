@@ -1351,6 +1351,7 @@ static void send_chunk(struct sr_dev_inst *sdi,
 	uint32_t sample_value;
 	size_t repetitions;
 	uint8_t sample_buff[sizeof(sample_value)];
+	uint64_t budget;
 
 	devc = sdi->priv;
 
@@ -1373,7 +1374,11 @@ static void send_chunk(struct sr_dev_inst *sdi,
 	else
 		devc->n_bytes_to_read -= data_length;
 
-	/* Process the received chunk of capture data. */
+	/*
+	 * Process the received chunk of capture data. Clamp the run
+	 * lengths to the samples limit, so that it is met exactly.
+	 */
+	budget = sr_sw_limits_samples_budget(&devc->sw_limits);
 	sample_value = 0;
 	rp = data_buffer;
 	num_xfers = data_length / devc->transfer_size;
@@ -1386,6 +1391,9 @@ static void send_chunk(struct sr_dev_inst *sdi,
 			else if (devc->model->channel_count == 16)
 				sample_value = read_u16le_inc(&rp);
 			repetitions = read_u8_inc(&rp);
+			if (repetitions > budget)
+				repetitions = budget;
+			budget -= repetitions;
 
 			devc->total_samples += repetitions;
 
@@ -1462,12 +1470,13 @@ static void stream_data(struct sr_dev_inst *sdi,
 {
 	struct dev_context *devc;
 	struct stream_state_t *stream;
-	size_t bit_count;
+	size_t bit_count, count;
 	const uint8_t *rp;
 	uint32_t sample_value;
 	uint8_t sample_buff[sizeof(sample_value)];
 	size_t bit_idx;
 	uint32_t ch_mask;
+	uint64_t budget;
 
 	devc = sdi->priv;
 	stream = &devc->stream;
@@ -1504,15 +1513,20 @@ static void stream_data(struct sr_dev_inst *sdi,
 		stream->channel_index++;
 		if (stream->channel_index != stream->enabled_count)
 			continue;
-		for (bit_idx = 0; bit_idx < bit_count; bit_idx++) {
+		/* Stop at the samples or time limit, within the block. */
+		budget = sr_sw_limits_samples_budget(&devc->sw_limits);
+		count = MIN(bit_count, budget);
+		for (bit_idx = 0; bit_idx < count; bit_idx++) {
 			sample_value = stream->sample_data[bit_idx];
 			write_u32le(sample_buff, sample_value);
 			feed_queue_logic_submit(devc->feed_queue, sample_buff, 1);
 		}
-		sr_sw_limits_update_samples_read(&devc->sw_limits, bit_count);
-		devc->total_samples += bit_count;
+		sr_sw_limits_update_samples_read(&devc->sw_limits, count);
+		devc->total_samples += count;
 		memset(stream->sample_data, 0, sizeof(stream->sample_data));
 		stream->channel_index = 0;
+		if (count < bit_count)
+			break;
 	}
 
 	/*
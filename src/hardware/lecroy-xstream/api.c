@@ -88,6 +88,8 @@ static struct sr_dev_inst *probe_device(struct sr_scpi_dev_inst *scpi)
 	if (lecroy_xstream_init_device(sdi) != SR_OK)
 		goto fail;
 
+	devc->pool = sr_buffer_pool_new(sdi, 2);
+
 	return sdi;
 
 fail:
@@ -107,6 +109,7 @@ static void clear_helper(struct dev_context *devc)
 {
 	lecroy_xstream_state_free(devc->model_state);
 	g_free(devc->analog_groups);
+	sr_buffer_pool_free(devc->pool);
 }
 
 static int dev_clear(const struct sr_dev_driver *di)
@@ -481,6 +484,7 @@ static int dev_acquisition_stop(struct sr_dev_inst *sdi)
 	devc->num_frames = 0;
 	g_slist_free(devc->enabled_channels);
 	devc->enabled_channels = NULL;
+	sr_buffer_pool_log_stats(devc->pool);
 	scpi = sdi->conn;
 	sr_scpi_source_remove(sdi->session, scpi);
 
@@ -539,8 +539,9 @@ SR_PRIV int lecroy_xstream_init_device(struct sr_dev_inst *sdi)
 	return SR_OK;
 }
 
-static int lecroy_waveform_2_x_to_analog(GByteArray *data,
-		struct lecroy_wavedesc *desc, struct sr_datafeed_analog *analog)
+static int lecroy_waveform_2_x_to_analog(struct sr_buffer_pool *pool,
+		GByteArray *data, struct lecroy_wavedesc *desc,
+		struct sr_datafeed_analog *analog)
 {
 	struct sr_analog_encoding *encoding = analog->encoding;
 	struct sr_analog_meaning *meaning = analog->meaning;
@@ -549,8 +550,10 @@ static int lecroy_waveform_2_x_to_analog(GByteArray *data,
 	int16_t *waveform_data;
 	unsigned int i, num_samples;
 
-	data_float = g_malloc(desc->version_2_x.wave_array_count * sizeof(float));
 	num_samples = desc->version_2_x.wave_array_count;
+	data_float = sr_buffer_pool_get(pool, num_samples * sizeof(float));
+	if (!data_float)
+		return SR_ERR_MALLOC;
 
 	waveform_data = (int16_t*)(data->data +
 		+ desc->version_2_x.wave_descriptor_length
@@ -591,8 +594,8 @@ static int lecroy_waveform_2_x_to_analog(GByteArray *data,
 	return SR_OK;
 }
 
-static int lecroy_waveform_to_analog(GByteArray *data,
-		struct sr_datafeed_analog *analog)
+static int lecroy_waveform_to_analog(struct sr_buffer_pool *pool,
+		GByteArray *data, struct sr_datafeed_analog *analog)
 {
 	struct lecroy_wavedesc *desc;
 
@@ -603,7 +606,7 @@ static int lecroy_waveform_to_analog(GByteArray *data,
 
 	if (!strncmp(desc->template_name, "LECROY_2_2", 16) ||
 	    !strncmp(desc->template_name, "LECROY_2_3", 16)) {
-		return lecroy_waveform_2_x_to_analog(data, desc, analog);
+		return lecroy_waveform_2_x_to_analog(pool, data, desc, analog);
 	}
 
 	sr_err("Waveformat template '%.16s' not supported.", desc->template_name);
@@ -650,11 +653,11 @@ SR_PRIV int lecroy_xstream_receive_data(int fd, int revents, void *cb_data)
 	analog.meaning = &meaning;
 	analog.spec = &spec;
 
-	if (lecroy_waveform_to_analog(data, &analog) != SR_OK)
+	if (lecroy_waveform_to_analog(devc->pool, data, &analog) != SR_OK)
 		return SR_ERR;
 
 	if (analog.num_samples == 0) {
-		g_free(analog.data);
+		sr_buffer_pool_put(devc->pool, analog.data);
 		g_byte_array_free(data, TRUE);
 
 		/* No data available, we have to acquire data first. */
@@ -667,7 +670,7 @@ SR_PRIV int lecroy_xstream_receive_data(int fd, int revents, void *cb_data)
 		/* Update sample rate if needed. */
 		if (state->sample_rate == 0)
 			if (lecroy_xstream_update_sample_rate(sdi, analog.num_samples) != SR_OK) {
-				g_free(analog.data);
+				sr_buffer_pool_put(devc->pool, analog.data);
 				g_byte_array_free(data, TRUE);
 				return SR_ERR;
 			}
@@ -689,7 +692,7 @@ SR_PRIV int lecroy_xstream_receive_data(int fd, int revents, void *cb_data)
 	data = NULL;
 
 	g_slist_free(meaning.channels);
-	g_free(analog.data);
+	sr_buffer_pool_put(devc->pool, analog.data);
 
 	/*
 	 * Advance to the next enabled channel. When data for all enabled
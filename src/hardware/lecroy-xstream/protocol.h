@@ -88,6 +88,9 @@ struct dev_context {
 	uint64_t num_frames;
 
 	uint64_t frame_limit;
+
+	/* Buffers for the converted waveform data. */
+	struct sr_buffer_pool *pool;
 };
 
 SR_PRIV int lecroy_xstream_init_device(struct sr_dev_inst *sdi);
@@ -351,6 +351,25 @@ SR_PRIV void abort_acquisition(const struct sr_dev_inst *sdi)
 	std_session_send_df_end(sdi);
 }
 
+/*
+ * Store 'count' copies of a 4-byte sample. The filled area doubles
+ * with every copy, which keeps long RLE runs cheap.
+ */
+static void fill_samples(uint8_t *dst, const uint8_t *sample, size_t count)
+{
+	size_t done, len;
+
+	if (!count)
+		return;
+	memcpy(dst, sample, 4);
+	done = 1;
+	while (done < count) {
+		len = MIN(done, count - done);
+		memcpy(dst + done * 4, dst, len * 4);
+		done += len;
+	}
+}
+
 SR_PRIV int ols_receive_data(int fd, int revents, void *cb_data)
 {
 	struct dev_context *devc;
@@ -361,7 +380,10 @@ SR_PRIV int ols_receive_data(int fd, int revents, void *cb_data)
 	uint32_t sample;
 	int num_changroups, offset, j;
 	unsigned int i;
-	unsigned char byte;
+	uint8_t buf[4096];
+	uint8_t tmp_sample[4];
+	int group_pos[4];
+	int len, pos;
 
 	(void)fd;
 
@@ -392,17 +414,28 @@ SR_PRIV int ols_receive_data(int fd, int revents, void *cb_data)
 	}
 
 	if (revents == G_IO_IN && devc->num_samples < devc->limit_samples) {
-		if (serial_read_nonblocking(serial, &byte, 1) != 1)
+		/* Get all received data which is available. */
+		len = serial_read_nonblocking(serial, buf, sizeof(buf));
+		if (len < 1)
 			return FALSE;
-		devc->cnt_bytes++;
+		devc->cnt_bytes += len;
 
-		/* Ignore it if we've read enough. */
-		if (devc->num_samples >= devc->limit_samples)
-			return TRUE;
+		/* Map received bytes to the enabled channel groups. */
+		j = 0;
+		for (i = 0; i < 4; i++) {
+			if (((devc->capture_flags >> 2) & (1 << i)) == 0)
+				group_pos[j++] = i;
+		}
+
+		for (pos = 0; pos < len; pos++) {
+			/* Ignore it if we've read enough. */
+			if (devc->num_samples >= devc->limit_samples)
+				break;
+
+			devc->sample[devc->num_bytes++] = buf[pos];
+			if (devc->num_bytes != num_changroups)
+				continue;
 
-		devc->sample[devc->num_bytes++] = byte;
-		sr_spew("Received byte 0x%.2x.", byte);
-		if (devc->num_bytes == num_changroups) {
 			devc->cnt_samples++;
 			devc->cnt_samples_rle++;
 			/*
@@ -412,8 +445,8 @@ SR_PRIV int ols_receive_data(int fd, int revents, void *cb_data)
 			sample = devc->sample[0] | (devc->sample[1] << 8) |
 				 (devc->sample[2] << 16) |
 				 (devc->sample[3] << 24);
-			sr_dbg("Received sample 0x%.*x.", devc->num_bytes * 2,
-			       sample);
+			sr_spew("Received sample 0x%.*x.", devc->num_bytes * 2,
+				sample);
 			if (devc->capture_flags & CAPTURE_FLAG_RLE) {
 				/*
 				 * In RLE mode the high bit of the sample is the
@@ -427,10 +460,10 @@ SR_PRIV int ols_receive_data(int fd, int revents, void *cb_data)
 					devc->rle_count = sample;
 					devc->cnt_samples_rle +=
 						devc->rle_count;
-					sr_dbg("RLE count: %u.",
-					       devc->rle_count);
+					sr_spew("RLE count: %u.",
+						devc->rle_count);
 					devc->num_bytes = 0;
-					return TRUE;
+					continue;
 				}
 			}
 			devc->num_samples += devc->rle_count + 1;
@@ -451,24 +484,10 @@ SR_PRIV int ols_receive_data(int fd, int revents, void *cb_data)
 				 * expecting a full 32-bit sample, based on
 				 * the number of channels.
 				 */
-				j = 0;
-				uint8_t tmp_sample[4] = { 0, 0, 0, 0 };
-				for (i = 0; i < 4; i++) {
-					if (((devc->capture_flags >> 2) &
-					     (1 << i)) == 0) {
-						/*
-						 * This channel group was
-						 * enabled, copy from received
-						 * sample.
-						 */
-						tmp_sample[i] =
-							devc->sample[j++];
-					}
-				}
+				memset(tmp_sample, 0, sizeof(tmp_sample));
+				for (j = 0; j < num_changroups; j++)
+					tmp_sample[group_pos[j]] = devc->sample[j];
 				memcpy(devc->sample, tmp_sample, 4);
-				sr_spew("Expanded sample: 0x%.2hhx%.2hhx%.2hhx%.2hhx ",
-					devc->sample[3], devc->sample[2],
-					devc->sample[1], devc->sample[0]);
 			}
 
 			/*
@@ -477,10 +496,8 @@ SR_PRIV int ols_receive_data(int fd, int revents, void *cb_data)
 			 * this on the session bus later.
 			 */
 			offset = (devc->limit_samples - devc->num_samples) * 4;
-			for (i = 0; i <= devc->rle_count; i++) {
-				memcpy(devc->raw_sample_buf + offset + (i * 4),
-				       devc->sample, 4);
-			}
+			fill_samples(devc->raw_sample_buf + offset, devc->sample,
+				devc->rle_count + 1);
 			memset(devc->sample, 0, 4);
 			devc->num_bytes = 0;
 			devc->rle_count = 0;
@@ -222,6 +222,8 @@ static struct sr_key_info sr_key_info_config[] = {
 		"Capture file", NULL},
 	{SR_CONF_CAPTURE_UNITSIZE, SR_T_UINT64, "capture_unitsize",
 		"Capture unitsize", NULL},
+	{SR_CONF_CAPTURE_FRAME, SR_T_UINT64, "capture_frame",
+		"Capture frame", NULL},
 	{SR_CONF_POWER_OFF, SR_T_BOOL, "power_off",
 		"Power off", NULL},
 	{SR_CONF_DATA_SOURCE, SR_T_STRING, "data_source",
@@ -246,6 +248,8 @@ static struct sr_key_info sr_key_info_config[] = {
 		"Device mode", NULL},
 	{SR_CONF_TEST_MODE, SR_T_STRING, "test_mode",
 		"Test mode", NULL},
+	{SR_CONF_UNPACED, SR_T_BOOL, "unpaced",
+		"Unpaced generation", NULL},
 
 	ALL_ZERO
 };
@@ -572,6 +576,147 @@ SR_API GSList *sr_driver_scan(struct sr_dev_driver *driver, GSList *options)
 	return l;
 }
 
+/** @cond PRIVATE */
+struct scan_job {
+	const struct sr_scan_request *request;
+	gint64 deadline;
+	gboolean skipped;
+	GSList *devices;
+};
+/** @endcond */
+
+static void scan_job_run(gpointer data, gpointer user_data)
+{
+	struct scan_job *job;
+
+	(void)user_data;
+
+	job = data;
+
+	/* Probes which could not start before the deadline are dropped. */
+	if (job->deadline && g_get_monotonic_time() > job->deadline) {
+		job->skipped = TRUE;
+		return;
+	}
+
+	std_scan_deferred_set(TRUE);
+	job->devices = sr_driver_scan(job->request->driver,
+		job->request->options);
+	std_scan_deferred_set(FALSE);
+}
+
+/**
+ * Run several driver scans concurrently.
+ *
+ * Each entry of @p requests describes one sr_driver_scan() call. The
+ * scans are executed on a pool of at most @p max_workers threads. This
+ * way slow probes (serial port detection with its timeouts, SCPI
+ * identification over the network) for different drivers or different
+ * ports do not add up. The same driver may appear several times, e.g.
+ * with different SR_CONF_CONN options.
+ *
+ * The results are merged in the order of @p requests, regardless of the
+ * order in which the scans complete. Devices are added to their driver's
+ * instance list in that same order, so the outcome matches a sequence of
+ * sr_driver_scan() calls for the same requests.
+ *
+ * When @p timeout_ms is positive, probes which did not get started within
+ * that time are skipped. Probes which already run are not interrupted,
+ * those are bounded by the driver's own I/O timeouts.
+ *
+ * All drivers must have been initialized by sr_driver_init() before.
+ * Drivers are expected to not share state between their scan() calls
+ * other than their instance list, which is taken care of here.
+ *
+ * @param requests The scan requests. Must not be NULL.
+ * @param count The number of entries in @p requests.
+ * @param max_workers The maximum number of scans running at the same time.
+ *                    Zero or a negative value selects the number of
+ *                    processors.
+ * @param timeout_ms Deadline in milliseconds for starting probes, or zero
+ *                   for no deadline.
+ *
+ * @return A GSList * of 'struct sr_dev_inst', or NULL if no devices were
+ *         found (or errors were encountered). This list must be freed by the
+ *         caller using g_slist_free(), but without freeing the data pointed
+ *         to in the list.
+ *
+ * @since 0.6.0
+ */
+SR_API GSList *sr_driver_scan_concurrent(const struct sr_scan_request *requests,
+		size_t count, int max_workers, int timeout_ms)
+{
+	struct scan_job *jobs, *job;
+	struct drv_context *drvc;
+	GThreadPool *pool;
+	GError *error;
+	GSList *devices;
+	gint64 deadline;
+	size_t i;
+
+	if (!requests || !count)
+		return NULL;
+
+	for (i = 0; i < count; i++) {
+		if (!requests[i].driver || !requests[i].driver->context) {
+			sr_err("Driver not initialized, can't scan for devices.");
+			return NULL;
+		}
+	}
+
+	if (max_workers <= 0)
+		max_workers = g_get_num_processors();
+	if ((size_t)max_workers > count)
+		max_workers = count;
+
+	deadline = 0;
+	if (timeout_ms > 0)
+		deadline = g_get_monotonic_time() + timeout_ms * (gint64)1000;
+
+	jobs = g_malloc0(count * sizeof(*jobs));
+	for (i = 0; i < count; i++) {
+		jobs[i].request = &requests[i];
+		jobs[i].deadline = deadline;
+	}
+
+	sr_dbg("Running %zu scans on up to %d threads.", count, max_workers);
+
+	error = NULL;
+	pool = g_thread_pool_new(scan_job_run, NULL, max_workers, TRUE, &error);
+	if (!pool) {
+		sr_warn("Cannot create scan thread pool (%s), scanning sequentially.",
+			error ? error->message : "unknown error");
+		g_clear_error(&error);
+	}
+	for (i = 0; i < count; i++) {
+		if (pool && g_thread_pool_push(pool, &jobs[i], &error))
+			continue;
+		g_clear_error(&error);
+		scan_job_run(&jobs[i], NULL);
+	}
+	/* Wait for all queued scans to complete. */
+	if (pool)
+		g_thread_pool_free(pool, FALSE, TRUE);
+
+	devices = NULL;
+	for (i = 0; i < count; i++) {
+		job = &jobs[i];
+		if (job->skipped) {
+			sr_warn("Scan deadline expired, skipped driver %s.",
+				job->request->driver->name);
+			continue;
+		}
+		if (!job->devices)
+			continue;
+		drvc = job->request->driver->context;
+		std_scan_instances_add(drvc, job->devices);
+		devices = g_slist_concat(devices, job->devices);
+	}
+	g_free(jobs);
+
+	return devices;
+}
+
 /**
  * Call driver cleanup function for all drivers.
  *
@@ -0,0 +1,260 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+/** @cond PRIVATE */
+#define LOG_PREFIX "idcache"
+/** @endcond */
+
+/**
+ * @file
+ *
+ * Persistent cache of device identification results.
+ */
+
+/**
+ * @defgroup grp_idcache Device identification cache
+ *
+ * Persistent cache of device identification results.
+ *
+ * Identifying attached hardware can be expensive: SCPI instruments get
+ * queried for their *IDN? response, USB devices get opened to read their
+ * string descriptors. Yet the set of attached devices rarely changes
+ * between application runs. When enabled, the cache keeps identification
+ * results in a file, keyed by a fingerprint of the connection (USB bus,
+ * address, port path and VID:PID, or the SCPI connection string). Scans
+ * can then skip the re-identification of devices which still match.
+ *
+ * The cache is disabled by default. Applications should only enable it
+ * when they can accept stale results after the hardware was swapped
+ * in a way which keeps the fingerprint intact.
+ *
+ * @{
+ */
+
+static GMutex idcache_mutex;
+static GKeyFile *idcache_keyfile;
+static char *idcache_filename;
+
+static void idcache_save(void)
+{
+	GError *error;
+	gchar *data;
+	gsize len;
+
+	data = g_key_file_to_data(idcache_keyfile, &len, NULL);
+	if (!data)
+		return;
+	error = NULL;
+	if (!g_file_set_contents(idcache_filename, data, len, &error)) {
+		sr_warn("Cannot write cache file %s: %s.",
+			idcache_filename, error->message);
+		g_error_free(error);
+	}
+	g_free(data);
+}
+
+/**
+ * Enable the device identification cache.
+ *
+ * Loads previously stored identification results (if any), and keeps
+ * storing new results in the same file. Calling this routine while the
+ * cache is enabled switches to the new file.
+ *
+ * @param[in] filename The cache file. NULL selects the default location
+ *                     in the user's cache directory.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR Cannot create the cache file's directory.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_idcache_enable(const char *filename)
+{
+	GKeyFile *keyfile;
+	char *fn, *dir;
+
+	if (filename)
+		fn = g_strdup(filename);
+	else
+		fn = g_build_filename(g_get_user_cache_dir(),
+			"sigrok", "idcache.ini", NULL);
+
+	dir = g_path_get_dirname(fn);
+	if (g_mkdir_with_parents(dir, 0755) != 0) {
+		sr_err("Cannot create cache directory %s.", dir);
+		g_free(dir);
+		g_free(fn);
+		return SR_ERR;
+	}
+	g_free(dir);
+
+	keyfile = g_key_file_new();
+	if (g_file_test(fn, G_FILE_TEST_IS_REGULAR) &&
+			!g_key_file_load_from_file(keyfile, fn,
+			G_KEY_FILE_NONE, NULL))
+		sr_warn("Ignoring unreadable cache file %s.", fn);
+
+	g_mutex_lock(&idcache_mutex);
+	if (idcache_keyfile)
+		g_key_file_free(idcache_keyfile);
+	g_free(idcache_filename);
+	idcache_keyfile = keyfile;
+	idcache_filename = fn;
+	g_mutex_unlock(&idcache_mutex);
+
+	sr_dbg("Using identification cache %s.", fn);
+
+	return SR_OK;
+}
+
+/**
+ * Disable the device identification cache.
+ *
+ * The cache file is kept, and can be used again later.
+ *
+ * @retval SR_OK Success.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_idcache_disable(void)
+{
+	g_mutex_lock(&idcache_mutex);
+	if (idcache_keyfile)
+		g_key_file_free(idcache_keyfile);
+	idcache_keyfile = NULL;
+	g_free(idcache_filename);
+	idcache_filename = NULL;
+	g_mutex_unlock(&idcache_mutex);
+
+	return SR_OK;
+}
+
+/**
+ * Remove all entries from the device identification cache.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_NA The cache is not enabled.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_idcache_remove_all(void)
+{
+	g_mutex_lock(&idcache_mutex);
+	if (!idcache_keyfile) {
+		g_mutex_unlock(&idcache_mutex);
+		return SR_ERR_NA;
+	}
+	g_key_file_free(idcache_keyfile);
+	idcache_keyfile = g_key_file_new();
+	idcache_save();
+	g_mutex_unlock(&idcache_mutex);
+
+	return SR_OK;
+}
+
+/**
+ * Look up a cached identification item.
+ *
+ * @param[in] id The device fingerprint.
+ * @param[in] item The name of the item.
+ *
+ * @return A newly allocated copy of the item's value, or NULL when the
+ *         cache is disabled or has no such item. Must be g_free()'d
+ *         by the caller.
+ *
+ * @private
+ */
+SR_PRIV char *sr_idcache_lookup(const char *id, const char *item)
+{
+	char *value;
+
+	if (!id || !item)
+		return NULL;
+
+	g_mutex_lock(&idcache_mutex);
+	value = NULL;
+	if (idcache_keyfile)
+		value = g_key_file_get_string(idcache_keyfile, id, item, NULL);
+	g_mutex_unlock(&idcache_mutex);
+
+	return value;
+}
+
+/**
+ * Store an identification item in the cache.
+ *
+ * Does nothing when the cache is disabled.
+ *
+ * @param[in] id The device fingerprint.
+ * @param[in] item The name of the item.
+ * @param[in] value The item's value. NULL removes the item.
+ *
+ * @private
+ */
+SR_PRIV void sr_idcache_store(const char *id, const char *item,
+	const char *value)
+{
+	char *old;
+
+	if (!id || !item)
+		return;
+
+	g_mutex_lock(&idcache_mutex);
+	if (!idcache_keyfile) {
+		g_mutex_unlock(&idcache_mutex);
+		return;
+	}
+	old = g_key_file_get_string(idcache_keyfile, id, item, NULL);
+	if (g_strcmp0(old, value) != 0) {
+		if (value)
+			g_key_file_set_string(idcache_keyfile, id, item, value);
+		else
+			g_key_file_remove_key(idcache_keyfile, id, item, NULL);
+		idcache_save();
+	}
+	g_free(old);
+	g_mutex_unlock(&idcache_mutex);
+}
+
+/**
+ * Check whether the device identification cache is enabled.
+ *
+ * Lets callers skip the construction of fingerprints.
+ *
+ * @return TRUE when the cache is enabled, FALSE otherwise.
+ *
+ * @private
+ */
+SR_PRIV gboolean sr_idcache_enabled(void)
+{
+	gboolean enabled;
+
+	g_mutex_lock(&idcache_mutex);
+	enabled = idcache_keyfile != NULL;
+	g_mutex_unlock(&idcache_mutex);
+
+	return enabled;
+}
+
+/** @} */
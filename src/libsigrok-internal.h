@@ -1030,6 +1030,40 @@ static inline void write_dblle_inc(uint8_t **p, double x)
 	*p += sizeof(x);
 }
 
+/**
+ * Get the index of the lowest set bit of a 64bit value.
+ * @param[in] x The value, must not be zero.
+ * @return The bit index.
+ */
+static inline unsigned int bit_lowest_u64(uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_ctzll(x);
+#else
+	/* g_bit_nth_lsf() takes a gulong, which may only have 32 bits. */
+	if ((uint32_t)x)
+		return g_bit_nth_lsf((uint32_t)x, -1);
+	return 32 + g_bit_nth_lsf((uint32_t)(x >> 32), -1);
+#endif
+}
+
+/**
+ * Count the set bits of a 64bit value.
+ * @param[in] x The value.
+ * @return The number of set bits.
+ */
+static inline unsigned int bit_count_u64(uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_popcountll(x);
+#else
+	x -= (x >> 1) & 0x5555555555555555ULL;
+	x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+	x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+	return (x * 0x0101010101010101ULL) >> 56;
+#endif
+}
+
 /* Portability fixes for FreeBSD. */
 #ifdef __FreeBSD__
 #define LIBUSB_CLASS_APPLICATION 0xfe
@@ -1521,6 +1555,36 @@ struct sr_usb_dev_inst {
 	/** libusb device handle */
 	struct libusb_device_handle *devhdl;
 };
+
+/**
+ * Sizing of the bulk transfers which stream sample data from a device.
+ *
+ * The transfer size gets adjusted at runtime: transfers grow when
+ * completions get handled late (host or consumers are busy, the device
+ * FIFO would be at risk), and shrink again when completions arrive in
+ * time for a while, which reduces the latency at low data rates.
+ */
+struct sr_usb_stream {
+	/** The device whose session gets the statistics. */
+	const struct sr_dev_inst *sdi;
+	uint64_t bytes_per_ms;
+	/** Transfer sizes are multiples of this. */
+	size_t granularity;
+	size_t min_size;
+	size_t max_size;
+	/** Current transfer size. */
+	size_t size;
+	/** Number of transfers to keep in flight. */
+	unsigned int depth;
+	unsigned int calm;
+	int64_t last_us;
+	/**
+	 * Where transfer buffers come from, when set by the driver.
+	 * Otherwise they must have been allocated with g_malloc().
+	 */
+	struct sr_buffer_pool *pool;
+	struct sr_usb_stream_stats stats;
+};
 #endif
 
 struct sr_serial_dev_inst;
@@ -1760,7 +1824,10 @@ struct sr_session {
 	/** Context of the session main loop. */
 	GMainContext *main_context;
 
-	/** Registered event sources for this session. */
+	/**
+	 * Registered event sources for this session. Those added on a
+	 * device thread are kept in the device thread's own table.
+	 */
 	GHashTable *event_sources;
 	/** Session main loop. */
 	GMainLoop *main_loop;
@@ -1768,6 +1835,47 @@ struct sr_session {
 	unsigned int stop_check_id;
 	/** Whether the session has been started. */
 	gboolean running;
+
+	/** Whether to run the datafeed pipeline on worker threads. */
+	gboolean pipeline_enabled;
+	/** Maximum number of packets queued per pipeline stage. */
+	size_t pipeline_queue_size;
+	/** Worker threads and queues while the session runs. */
+	struct session_pipeline *pipeline;
+
+	/** Whether to run the acquisition of each device on its own thread. */
+	gboolean dev_threads_enabled;
+	/** How the dispatcher takes turns between the devices. */
+	enum sr_dev_thread_policy dev_threads_policy;
+	/** Maximum number of packets queued per device. */
+	size_t dev_threads_queue_size;
+	/** Device threads, their queues and the dispatcher thread. */
+	struct session_dev_threads *dev_threads;
+	/**
+	 * First error of a transform module which ran on a worker thread,
+	 * returned from the next sr_session_send() call. Atomic.
+	 */
+	int deferred_error;
+	/** Mutex protecting the event source tables. */
+	GMutex sources_mutex;
+
+	/** Whether to put the packets of all devices on a common timeline. */
+	gboolean timestamps_enabled;
+	/** Whether to align the devices' timelines at their first trigger. */
+	gboolean timestamps_trigger_align;
+	/** Reorder window of the merge stage in ns, 0 if it is disabled. */
+	uint64_t merge_window;
+	/** Timeline state of the devices, and the merge stage's packets. */
+	struct session_timeline *timeline;
+
+	/** Whether to collect datafeed statistics. */
+	gboolean stats_enabled;
+	/** Mutex protecting the statistics. */
+	GMutex stats_mutex;
+	/** Per-device counters, indexed by struct sr_dev_inst pointer. */
+	GHashTable *dev_stats;
+	/** Timing per transform or datafeed callback, indexed by pointer. */
+	GHashTable *stage_stats;
 };
 
 SR_PRIV int sr_session_source_add_internal(struct sr_session *session,
@@ -1798,6 +1906,10 @@ SR_PRIV int sr_session_send_meta(const struct sr_dev_inst *sdi,
 		uint32_t key, GVariant *var);
 SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 		const struct sr_datafeed_packet *packet);
+SR_PRIV void sr_session_dev_usb_stats_update(const struct sr_dev_inst *sdi,
+		const struct sr_usb_stream_stats *stats);
+SR_PRIV void sr_session_dev_pool_stats_update(const struct sr_dev_inst *sdi,
+		const struct sr_buffer_pool_stats *stats);
 SR_PRIV int sr_sessionfile_check(const char *filename);
 SR_PRIV struct sr_dev_inst *sr_session_prepare_sdi(const char *filename,
 		struct sr_session **session);
@@ -1812,6 +1924,42 @@ SR_PRIV void sr_zip_discard(struct zip *archive);
 
 SR_PRIV GKeyFile *sr_sessionfile_read_metadata(struct zip *archive,
 			const struct zip_stat *entry);
+SR_PRIV int sr_sessionfile_read_frames(struct zip *archive,
+		struct sr_frame_info **frames, size_t *num_frames);
+SR_PRIV void sr_sessionfile_write_frames(const struct sr_frame_info *frames,
+		size_t num_frames, uint8_t **buf, size_t *size);
+SR_PRIV int sr_sessionfile_read_version(struct zip *archive,
+		uint64_t *version);
+
+/* Session file version from which on analog chunks are coded. */
+#define SR_SESSIONFILE_VERSION_CODED_ANALOG 3
+
+/* How the samples of a coded analog chunk are predicted. */
+enum sr_analog_coding {
+	/* Difference to the previous integer value. */
+	SR_ANALOG_CODING_DELTA = 1,
+	/* Bits of a float, XORed with the previous one. */
+	SR_ANALOG_CODING_XOR_FLOAT = 2,
+};
+
+/* Header of a coded analog chunk in a session file. */
+struct sr_analog_chunk {
+	enum sr_analog_coding coding;
+	/* Bytes per sample, little endian. */
+	uint8_t unitsize;
+	gboolean is_signed;
+	/* Like struct sr_analog_encoding, for the decoded values. */
+	struct sr_rational scale;
+	struct sr_rational offset;
+	uint64_t num_samples;
+};
+
+#define SR_ANALOG_CHUNK_HEADER_SIZE (4 + 4 + 5 * 8)
+
+SR_PRIV void sr_sessionfile_write_analog_header(
+		const struct sr_analog_chunk *chunk, uint8_t *buf);
+SR_PRIV int sr_sessionfile_read_analog_header(struct sr_analog_chunk *chunk,
+		const uint8_t *buf);
 
 /*--- analog.c --------------------------------------------------------------*/
 
@@ -1820,6 +1968,37 @@ SR_PRIV int sr_analog_init(struct sr_datafeed_analog *analog,
                            struct sr_analog_meaning *meaning,
                            struct sr_analog_spec *spec,
                            int digits);
+SR_PRIV void sr_analog_encoding_set_integer(struct sr_analog_encoding *encoding,
+		unsigned int unitsize, gboolean is_signed, double scale, double offset);
+
+/*--- buffer-pool.c ---------------------------------------------------------*/
+
+/** Alignment of the buffers handed out by a struct sr_buffer_pool. */
+#define SR_BUFFER_POOL_ALIGN 64
+
+struct pool_buffer;
+
+/** Per-device freelist of sample buffers (see sr_buffer_pool_new()). */
+struct sr_buffer_pool {
+	/** The device whose session gets the statistics, or NULL. */
+	const struct sr_dev_inst *sdi;
+	/** Size of the buffers handed out. */
+	size_t size;
+	struct pool_buffer *free_list;
+	unsigned int num_free;
+	unsigned int max_free;
+	struct sr_buffer_pool_stats stats;
+};
+
+SR_PRIV struct sr_buffer_pool *sr_buffer_pool_new(
+		const struct sr_dev_inst *sdi, unsigned int max_free);
+SR_PRIV void sr_buffer_pool_free(struct sr_buffer_pool *pool);
+SR_PRIV void *sr_buffer_pool_get(struct sr_buffer_pool *pool, size_t size);
+SR_PRIV void sr_buffer_pool_put(struct sr_buffer_pool *pool, void *buf);
+SR_PRIV GBytes *sr_buffer_pool_bytes_new(void *buf, size_t len);
+SR_PRIV int sr_buffer_pool_stats_get(const struct sr_buffer_pool *pool,
+		struct sr_buffer_pool_stats *stats);
+SR_PRIV void sr_buffer_pool_log_stats(const struct sr_buffer_pool *pool);
 
 /*--- std.c -----------------------------------------------------------------*/
 
@@ -1847,6 +2026,8 @@ SR_PRIV int std_dev_clear(const struct sr_dev_driver *driver);
 SR_PRIV GSList *std_dev_list(const struct sr_dev_driver *di);
 SR_PRIV int std_serial_dev_close(struct sr_dev_inst *sdi);
 SR_PRIV GSList *std_scan_complete(struct sr_dev_driver *di, GSList *devices);
+SR_PRIV void std_scan_instances_add(struct drv_context *drvc, GSList *devices);
+SR_PRIV void std_scan_deferred_set(gboolean deferred);
 
 SR_PRIV int std_opts_config_list(uint32_t key, GVariant **data,
 	const struct sr_dev_inst *sdi, const struct sr_channel_group *cg,
@@ -1936,10 +2117,28 @@ struct soft_trigger_logic {
 	int unitsize;
 	int cur_stage;
 	uint8_t *prev_sample;
-	uint8_t *pre_trigger_buffer;
-	uint8_t *pre_trigger_head;
+	/*
+	 * Pre-trigger history, as references to the caller's data where
+	 * possible (see soft_trigger_logic_check_bytes()), copies in a
+	 * ring of the pre-trigger size otherwise.
+	 */
+	GQueue *pre_trigger_chunks;
 	int pre_trigger_size;
 	int pre_trigger_fill;
+	uint8_t *pre_trigger_ring;
+	int pre_trigger_ring_pos;
+	/* Copies of referenced data get sent from here. */
+	uint8_t *pre_trigger_scratch;
+	/*
+	 * Single stage triggers on up to 64 channels get compiled to bit
+	 * masks, which allow to quickly skip over non-matching data.
+	 */
+	gboolean prefilter;
+	uint64_t level_mask;
+	uint64_t level_value;
+	uint64_t rising_mask;
+	uint64_t falling_mask;
+	uint64_t edge_mask;
 };
 
 SR_PRIV int logic_channel_unitsize(GSList *channels);
@@ -1949,6 +2148,10 @@ SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
 SR_PRIV void soft_trigger_logic_free(struct soft_trigger_logic *st);
 SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *st, uint8_t *buf,
 		int len, int *pre_trigger_samples);
+SR_PRIV int soft_trigger_logic_check_bytes(struct soft_trigger_logic *stl,
+		GBytes *data, int *pre_trigger_samples);
+SR_PRIV int soft_trigger_logic_skip(struct soft_trigger_logic *stl,
+		uint8_t *buf, int len);
 
 /*--- serial.c --------------------------------------------------------------*/
 
@@ -1970,6 +2173,7 @@ SR_PRIV int serial_open(struct sr_serial_dev_inst *serial, int flags);
 SR_PRIV int serial_close(struct sr_serial_dev_inst *serial);
 SR_PRIV int serial_flush(struct sr_serial_dev_inst *serial);
 SR_PRIV int serial_drain(struct sr_serial_dev_inst *serial);
+SR_PRIV int serial_get_usb_id(struct sr_serial_dev_inst *serial, char **id);
 SR_PRIV size_t serial_has_receive_data(struct sr_serial_dev_inst *serial);
 SR_PRIV int serial_write_blocking(struct sr_serial_dev_inst *serial,
 		const void *buf, size_t count, unsigned int timeout_ms);
@@ -2037,6 +2241,7 @@ struct ser_lib_functions {
 	int (*get_frame_format)(struct sr_serial_dev_inst *serial,
 			int *baud, int *bits);
 	size_t (*get_rx_avail)(struct sr_serial_dev_inst *serial);
+	int (*get_usb_id)(struct sr_serial_dev_inst *serial, char **id);
 };
 extern SR_PRIV struct ser_lib_functions *ser_lib_funcs_libsp;
 SR_PRIV int ser_name_is_hid(struct sr_serial_dev_inst *serial);
@@ -2136,10 +2341,29 @@ SR_PRIV int usb_source_add(struct sr_session *session, struct sr_context *ctx,
 		int timeout, sr_receive_data_callback cb, void *cb_data);
 SR_PRIV int usb_source_remove(struct sr_session *session, struct sr_context *ctx);
 SR_PRIV int usb_get_port_path(libusb_device *dev, char *path, int path_len);
+SR_PRIV int usb_get_idcache_id(libusb_device *dev,
+		libusb_device_handle *hdl, char *id, int id_len);
 SR_PRIV gboolean usb_match_manuf_prod(libusb_device *dev,
 		const char *manufacturer, const char *product);
+SR_PRIV void sr_usb_stream_init(struct sr_usb_stream *stream,
+		const struct sr_dev_inst *sdi,
+		uint64_t bytes_per_ms, size_t granularity,
+		unsigned int queue_ms, unsigned int max_depth);
+SR_PRIV unsigned int sr_usb_stream_timeout(const struct sr_usb_stream *stream);
+SR_PRIV void sr_usb_stream_completed(struct sr_usb_stream *stream,
+		const struct libusb_transfer *transfer);
+SR_PRIV int sr_usb_stream_resubmit(struct sr_usb_stream *stream,
+		struct libusb_transfer *transfer);
+SR_PRIV void sr_usb_stream_log_stats(const struct sr_usb_stream *stream);
 #endif
 
+/*--- idcache.c -------------------------------------------------------------*/
+
+SR_PRIV char *sr_idcache_lookup(const char *id, const char *item);
+SR_PRIV void sr_idcache_store(const char *id, const char *item,
+	const char *value);
+SR_PRIV gboolean sr_idcache_enabled(void);
+
 /*--- binary_helpers.c ------------------------------------------------------*/
 
 /** Binary value type */
@@ -2746,6 +2970,10 @@ struct sr_sw_limits {
 	uint64_t samples_read;
 	uint64_t frames_read;
 	uint64_t start_time;
+	/* Monotonic time when limit_msec expires, 0 when not limited. */
+	uint64_t deadline;
+	/* Converts limit_msec into a samples count when non-zero. */
+	uint64_t samplerate;
 };
 
 SR_PRIV int sr_sw_limits_config_get(const struct sr_sw_limits *limits, uint32_t key,
@@ -2761,6 +2989,9 @@ SR_PRIV void sr_sw_limits_update_samples_read(struct sr_sw_limits *limits,
 	uint64_t samples_read);
 SR_PRIV void sr_sw_limits_update_frames_read(struct sr_sw_limits *limits,
 	uint64_t frames_read);
+SR_PRIV void sr_sw_limits_set_samplerate(struct sr_sw_limits *limits,
+	uint64_t samplerate);
+SR_PRIV uint64_t sr_sw_limits_samples_budget(const struct sr_sw_limits *limits);
 SR_PRIV void sr_sw_limits_init(struct sr_sw_limits *limits);
 
 /*--- feed_queue.h ----------------------------------------------------------*/
@@ -125,8 +125,7 @@ SR_PRIV GSList *sr_modbus_scan(struct drv_context *drvc, GSList *options,
 	}
 
 	/* Tack a copy of the newly found devices onto the driver list. */
-	if (devices)
-		drvc->instances = g_slist_concat(drvc->instances, g_slist_copy(devices));
+	std_scan_instances_add(drvc, devices);
 
 	return devices;
 }
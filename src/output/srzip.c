@@ -47,15 +47,28 @@ struct out_context {
 		size_t alloc_size;
 		float *samples;
 		size_t fill_size;
+		/* With compact_analog: the chunk header, then the coded samples. */
+		uint8_t *coded;
+		size_t coded_size;
+		struct sr_analog_chunk chunk;
+		uint32_t prev;
 	} *analog_buff;
+	gboolean compact_analog;
+	gboolean edge_index;
+	struct sr_edge_index *edges;
+	/* Frame positions, counted in samples of the logic data and of
+	 * the first analog channel. */
+	uint64_t logic_samples;
+	uint64_t analog_samples;
+	gboolean in_frame;
+	struct sr_frame_info frame;
+	GArray *frames;
 };
 
 static int init(struct sr_output *o, GHashTable *options)
 {
 	struct out_context *outc;
 
-	(void)options;
-
 	if (!o->filename || o->filename[0] == '\0') {
 		sr_info("srzip output module requires a file name, cannot save.");
 		return SR_ERR_ARG;
@@ -63,6 +76,11 @@ static int init(struct sr_output *o, GHashTable *options)
 
 	outc = g_malloc0(sizeof(*outc));
 	outc->filename = g_strdup(o->filename);
+	outc->edge_index = g_variant_get_boolean(g_hash_table_lookup(options,
+		"edge_index"));
+	outc->compact_analog = g_variant_get_boolean(g_hash_table_lookup(options,
+		"compact_analog"));
+	outc->frames = g_array_new(FALSE, FALSE, sizeof(struct sr_frame_info));
 	o->priv = outc;
 
 	return SR_OK;
@@ -73,6 +91,7 @@ static int zip_create(const struct sr_output *o)
 	struct out_context *outc;
 	struct zip *zipfile;
 	struct zip_source *versrc, *metasrc;
+	const char *version;
 	struct sr_channel *ch;
 	size_t ch_nr;
 	size_t alloc_size;
@@ -100,8 +119,9 @@ static int zip_create(const struct sr_output *o)
 	if (!zipfile)
 		return SR_ERR;
 
-	/* "version" */
-	versrc = zip_source_buffer(zipfile, "2", 1, FALSE);
+	/* "version", 3 keeps older readers away from coded analog chunks. */
+	version = outc->compact_analog ? "3" : "2";
+	versrc = zip_source_buffer(zipfile, version, 1, FALSE);
 	if (zip_add(zipfile, "version", versrc) < 0) {
 		sr_err("Error saving version into zipfile: %s",
 			zip_strerror(zipfile));
@@ -219,6 +239,12 @@ static int zip_create(const struct sr_output *o)
 	outc->analog_buff = g_malloc0(alloc_size);
 	for (index = 0; index < outc->analog_ch_count; index++) {
 		alloc_size = CHUNK_SIZE;
+		if (outc->compact_analog) {
+			outc->analog_buff[index].coded = g_try_malloc0(alloc_size);
+			if (!outc->analog_buff[index].coded)
+				return SR_ERR_MALLOC;
+			continue;
+		}
 		outc->analog_buff[index].samples = g_try_malloc0(alloc_size);
 		if (!outc->analog_buff[index].samples)
 			return SR_ERR_MALLOC;
@@ -454,20 +480,19 @@ static int zip_append_queue(const struct sr_output *o,
  * Append analog data of a channel to an srzip archive.
  *
  * @param[in] o Output module instance.
- * @param[in] values Sample data as array of floating point values.
- * @param[in] count Number of samples (float items, not bytes).
+ * @param[in] buf Sample data, as float values or as a coded chunk.
+ * @param[in] size Size of the sample data (in bytes, not samples).
  * @param[in] ch_nr 1-based channel number.
  *
  * @returns SR_OK et al error codes.
  */
 static int zip_append_analog(const struct sr_output *o,
-	const float *values, size_t count, size_t ch_nr)
+	const void *buf, size_t size, size_t ch_nr)
 {
 	struct out_context *outc;
 	struct zip *archive;
 	struct zip_source *analogsrc;
 	int64_t i, num_files;
-	size_t size;
 	struct zip_stat zs;
 	uint64_t chunk_num;
 	const char *entry_name;
@@ -502,8 +527,7 @@ static int zip_append_analog(const struct sr_output *o,
 		}
 	}
 
-	size = sizeof(values[0]) * count;
-	analogsrc = zip_source_buffer(archive, values, size, FALSE);
+	analogsrc = zip_source_buffer(archive, buf, size, FALSE);
 	chunkname = g_strdup_printf("%s-%u", basename, next_chunk_num);
 	i = zip_add(archive, chunkname, analogsrc);
 	if (i < 0) {
@@ -527,6 +551,180 @@ static int zip_append_analog(const struct sr_output *o,
 	return SR_OK;
 }
 
+/**
+ * Append the coded analog data of a channel to an srzip archive.
+ *
+ * @param[in] o Output module instance.
+ * @param[in] idx Index of the analog channel.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int zip_append_analog_coded(const struct sr_output *o, size_t idx)
+{
+	struct out_context *outc;
+	struct analog_buff *buff;
+	int ret;
+
+	outc = o->priv;
+	buff = &outc->analog_buff[idx];
+	if (!buff->chunk.num_samples)
+		return SR_OK;
+
+	sr_sessionfile_write_analog_header(&buff->chunk, buff->coded);
+	ret = zip_append_analog(o, buff->coded, buff->coded_size,
+		outc->first_analog_index + idx);
+	buff->chunk.num_samples = 0;
+
+	return ret;
+}
+
+/*
+ * Determine how to store the samples of an analog packet. Integer values
+ * are kept as they are, with their scale and offset, so that samples of
+ * 8-bit and 12-bit scopes take one or two bytes instead of a float each.
+ * All other values get converted to float.
+ */
+static void analog_chunk_select(const struct sr_analog_encoding *encoding,
+	struct sr_analog_chunk *chunk)
+{
+	memset(chunk, 0, sizeof(*chunk));
+	if (!encoding->is_float && (encoding->unitsize == 1
+			|| encoding->unitsize == 2 || encoding->unitsize == 4)) {
+		chunk->coding = SR_ANALOG_CODING_DELTA;
+		chunk->unitsize = encoding->unitsize;
+		chunk->is_signed = encoding->is_signed;
+		chunk->scale = encoding->scale;
+		chunk->offset = encoding->offset;
+	} else {
+		chunk->coding = SR_ANALOG_CODING_XOR_FLOAT;
+		chunk->unitsize = sizeof(float);
+		chunk->scale.p = chunk->scale.q = 1;
+		chunk->offset.q = 1;
+	}
+}
+
+static gboolean analog_chunk_equal(const struct sr_analog_chunk *a,
+	const struct sr_analog_chunk *b)
+{
+	return a->coding == b->coding && a->unitsize == b->unitsize
+		&& a->is_signed == b->is_signed
+		&& a->scale.p == b->scale.p && a->scale.q == b->scale.q
+		&& a->offset.p == b->offset.p && a->offset.q == b->offset.q;
+}
+
+static uint32_t analog_read_raw(const uint8_t *p, size_t unitsize,
+	gboolean is_bigendian)
+{
+	switch (unitsize) {
+	case 1:
+		return read_u8(p);
+	case 2:
+		return is_bigendian ? read_u16be(p) : read_u16le(p);
+	default:
+		return is_bigendian ? read_u32be(p) : read_u32le(p);
+	}
+}
+
+/**
+ * Queue analog data of a channel in its compact form.
+ *
+ * Each value gets stored as its difference to the previous value of the
+ * channel (integers), or XORed with it (the bits of floats). Slowly
+ * changing signals leave mostly zero bits, which compress well. Each
+ * chunk starts over, and describes its coding in a header, so that a
+ * change of the encoding just starts a new chunk.
+ *
+ * @param[in] o Output module instance.
+ * @param[in] analog Sample data (session feed packet format).
+ * @param[in] idx Index of the analog channel.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int zip_append_analog_queue_coded(const struct sr_output *o,
+	const struct sr_datafeed_analog *analog, size_t idx)
+{
+	struct out_context *outc;
+	struct analog_buff *buff;
+	struct sr_analog_chunk chunk;
+	const uint8_t *rdptr;
+	float *values;
+	uint32_t value, mask, bits;
+	size_t i, unitsize;
+	int ret;
+
+	outc = o->priv;
+	buff = &outc->analog_buff[idx];
+
+	analog_chunk_select(analog->encoding, &chunk);
+	values = NULL;
+	if (chunk.coding == SR_ANALOG_CODING_XOR_FLOAT) {
+		values = g_try_malloc0(analog->num_samples * sizeof(values[0]));
+		if (!values)
+			return SR_ERR_MALLOC;
+		ret = sr_analog_to_float(analog, values);
+		if (ret != SR_OK) {
+			g_free(values);
+			return ret;
+		}
+	}
+
+	if (buff->chunk.num_samples && !analog_chunk_equal(&buff->chunk, &chunk)) {
+		ret = zip_append_analog_coded(o, idx);
+		if (ret != SR_OK) {
+			g_free(values);
+			return ret;
+		}
+	}
+
+	unitsize = chunk.unitsize;
+	mask = (unitsize == 4) ? UINT32_MAX : (1U << (8 * unitsize)) - 1;
+	rdptr = analog->data;
+	for (i = 0; i < analog->num_samples; i++) {
+		if (!buff->chunk.num_samples) {
+			/* Start a new chunk. */
+			buff->chunk = chunk;
+			buff->coded_size = SR_ANALOG_CHUNK_HEADER_SIZE;
+			buff->prev = 0;
+		}
+
+		if (values) {
+			memcpy(&bits, &values[i], sizeof(bits));
+			value = bits ^ buff->prev;
+			buff->prev = bits;
+		} else {
+			bits = analog_read_raw(rdptr, unitsize,
+				analog->encoding->is_bigendian);
+			rdptr += unitsize;
+			value = (bits - buff->prev) & mask;
+			buff->prev = bits;
+		}
+		switch (unitsize) {
+		case 1:
+			write_u8(buff->coded + buff->coded_size, value);
+			break;
+		case 2:
+			write_u16le(buff->coded + buff->coded_size, value);
+			break;
+		default:
+			write_u32le(buff->coded + buff->coded_size, value);
+			break;
+		}
+		buff->coded_size += unitsize;
+		buff->chunk.num_samples++;
+
+		if (buff->coded_size + unitsize > CHUNK_SIZE) {
+			ret = zip_append_analog_coded(o, idx);
+			if (ret != SR_OK) {
+				g_free(values);
+				return ret;
+			}
+		}
+	}
+	g_free(values);
+
+	return SR_OK;
+}
+
 /**
  * Queue analog data of a channel for srzip archive writes.
  *
@@ -552,12 +750,18 @@ static int zip_append_analog_queue(const struct sr_output *o,
 	/* Is this the DF_END flush call without samples submission? */
 	if (!analog && flush) {
 		for (idx = 0; idx < outc->analog_ch_count; idx++) {
+			if (outc->compact_analog) {
+				ret = zip_append_analog_coded(o, idx);
+				if (ret != SR_OK)
+					return ret;
+				continue;
+			}
 			nr = outc->first_analog_index + idx;
 			buff = &outc->analog_buff[idx];
 			if (!buff->fill_size)
 				continue;
-			ret = zip_append_analog(o,
-				buff->samples, buff->fill_size, nr);
+			ret = zip_append_analog(o, buff->samples,
+				buff->fill_size * sizeof(buff->samples[0]), nr);
 			if (ret != SR_OK)
 				return ret;
 			buff->fill_size = 0;
@@ -581,6 +785,13 @@ static int zip_append_analog_queue(const struct sr_output *o,
 	nr = outc->first_analog_index + idx;
 	buff = &outc->analog_buff[idx];
 
+	if (outc->compact_analog) {
+		ret = zip_append_analog_queue_coded(o, analog, idx);
+		if (ret == SR_OK && flush)
+			ret = zip_append_analog_coded(o, idx);
+		return ret;
+	}
+
 	/* Convert the analog data to an array of float values. */
 	values = g_try_malloc0(analog->num_samples * sizeof(values[0]));
 	if (!values)
@@ -609,8 +820,8 @@ static int zip_append_analog_queue(const struct sr_output *o,
 			remain -= copy_size;
 		}
 		if (send_size && !remain) {
-			ret = zip_append_analog(o,
-				buff->samples, buff->fill_size, nr);
+			ret = zip_append_analog(o, buff->samples,
+				buff->fill_size * sizeof(buff->samples[0]), nr);
 			if (ret != SR_OK) {
 				g_free(values);
 				return ret;
@@ -623,7 +834,8 @@ static int zip_append_analog_queue(const struct sr_output *o,
 
 	/* Flush to the ZIP archive if the caller wants us to. */
 	if (flush && buff->fill_size) {
-		ret = zip_append_analog(o, buff->samples, buff->fill_size, nr);
+		ret = zip_append_analog(o, buff->samples,
+			buff->fill_size * sizeof(buff->samples[0]), nr);
 		if (ret != SR_OK)
 			return ret;
 		buff->fill_size = 0;
@@ -632,6 +844,97 @@ static int zip_append_analog_queue(const struct sr_output *o,
 	return SR_OK;
 }
 
+/**
+ * Add a member to an srzip archive, or replace it.
+ *
+ * @param[in] o Output module instance.
+ * @param[in] name The name of the archive member.
+ * @param[in] buf The content.
+ * @param[in] size The size of the content.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int zip_write_member(const struct sr_output *o, const char *name,
+	const uint8_t *buf, size_t size)
+{
+	struct out_context *outc;
+	struct zip *archive;
+	struct zip_source *src;
+	struct zip_stat zs;
+	int64_t ret;
+
+	outc = o->priv;
+	if (!(archive = zip_open(outc->filename, 0, NULL)))
+		return SR_ERR;
+
+	src = zip_source_buffer(archive, buf, size, FALSE);
+	/* Subsequent acquisitions extend the data of the previous ones. */
+	if (zip_stat(archive, name, 0, &zs) == 0)
+		ret = zip_replace(archive, zs.index, src);
+	else
+		ret = zip_add(archive, name, src);
+	if (ret < 0) {
+		sr_err("Failed to add '%s': %s", name, zip_strerror(archive));
+		zip_source_free(src);
+		zip_discard(archive);
+		return SR_ERR;
+	}
+	if (zip_close(archive) < 0) {
+		sr_err("Error saving session file: %s", zip_strerror(archive));
+		zip_discard(archive);
+		return SR_ERR;
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Store the index of logic channel transitions in an srzip archive.
+ *
+ * @param[in] o Output module instance.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int zip_write_edge_index(const struct sr_output *o)
+{
+	struct out_context *outc;
+	uint8_t *buf;
+	size_t size;
+	int ret;
+
+	outc = o->priv;
+	ret = sr_edge_index_serialize(outc->edges, &buf, &size);
+	if (ret != SR_OK)
+		return ret;
+	ret = zip_write_member(o, "edges-1", buf, size);
+	g_free(buf);
+
+	return ret;
+}
+
+/**
+ * Store the position of all frames in an srzip archive.
+ *
+ * @param[in] o Output module instance.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int zip_write_frames(const struct sr_output *o)
+{
+	struct out_context *outc;
+	uint8_t *buf;
+	size_t size;
+	int ret;
+
+	outc = o->priv;
+	sr_sessionfile_write_frames((const struct sr_frame_info *)outc->frames->data,
+		outc->frames->len, &buf, &size);
+	ret = zip_write_member(o, "frames-1", buf, size);
+	g_free(buf);
+
+	return ret;
+}
+
 static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
 		GString **out)
 {
@@ -640,6 +943,7 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 	const struct sr_datafeed_logic *logic;
 	const struct sr_datafeed_analog *analog;
 	const struct sr_config *src;
+	const struct sr_channel *ch;
 	GSList *l;
 	int ret;
 
@@ -668,6 +972,16 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 			logic->unitsize, logic->length, FALSE);
 		if (ret != SR_OK)
 			return ret;
+		if (logic->unitsize)
+			outc->logic_samples += logic->length / logic->unitsize;
+		if (outc->edge_index) {
+			if (!outc->edges)
+				outc->edges = sr_edge_index_new(
+					MIN(logic->unitsize * 8, 64));
+			ret = sr_edge_index_append(outc->edges, logic);
+			if (ret != SR_OK)
+				return ret;
+		}
 		break;
 	case SR_DF_ANALOG:
 		if (!outc->zip_created) {
@@ -679,6 +993,36 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		ret = zip_append_analog_queue(o, analog, FALSE);
 		if (ret != SR_OK)
 			return ret;
+		ch = analog->meaning->channels->data;
+		if (ch->index == outc->analog_index_map[0])
+			outc->analog_samples += analog->num_samples;
+		break;
+	case SR_DF_FRAME_BEGIN:
+		outc->in_frame = TRUE;
+		outc->frame.timestamp = g_get_real_time();
+		outc->frame.logic_offset = outc->logic_samples;
+		outc->frame.analog_offset = outc->analog_samples;
+		outc->frame.trigger_offset = -1;
+		break;
+	case SR_DF_TRIGGER:
+		if (!outc->in_frame || outc->frame.trigger_offset >= 0)
+			break;
+		if (outc->analog_ch_count)
+			outc->frame.trigger_offset = outc->analog_samples
+				- outc->frame.analog_offset;
+		else
+			outc->frame.trigger_offset = outc->logic_samples
+				- outc->frame.logic_offset;
+		break;
+	case SR_DF_FRAME_END:
+		if (!outc->in_frame)
+			break;
+		outc->in_frame = FALSE;
+		outc->frame.logic_samples = outc->logic_samples
+			- outc->frame.logic_offset;
+		outc->frame.analog_samples = outc->analog_samples
+			- outc->frame.analog_offset;
+		g_array_append_val(outc->frames, outc->frame);
 		break;
 	case SR_DF_END:
 		if (outc->zip_created) {
@@ -689,6 +1033,16 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 			if (ret != SR_OK)
 				return ret;
 		}
+		if (outc->edges) {
+			ret = zip_write_edge_index(o);
+			if (ret != SR_OK)
+				return ret;
+		}
+		if (outc->zip_created && outc->frames->len) {
+			ret = zip_write_frames(o);
+			if (ret != SR_OK)
+				return ret;
+		}
 		break;
 	}
 
@@ -696,11 +1050,18 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 }
 
 static struct sr_option options[] = {
+	{"edge_index", "Edge index", "Store an index of the logic channel transitions", NULL, NULL},
+	{"compact_analog", "Compact analog", "Store analog data in its original encoding, predictively coded", NULL, NULL},
 	ALL_ZERO
 };
 
 static const struct sr_option *get_options(void)
 {
+	if (!options[0].def) {
+		options[0].def = g_variant_ref_sink(g_variant_new_boolean(FALSE));
+		options[1].def = g_variant_ref_sink(g_variant_new_boolean(FALSE));
+	}
+
 	return options;
 }
 
@@ -714,9 +1075,13 @@ static int cleanup(struct sr_output *o)
 	g_free(outc->analog_index_map);
 	g_free(outc->filename);
 	g_free(outc->logic_buff.samples);
-	for (idx = 0; idx < outc->analog_ch_count; idx++)
+	for (idx = 0; idx < outc->analog_ch_count; idx++) {
 		g_free(outc->analog_buff[idx].samples);
+		g_free(outc->analog_buff[idx].coded);
+	}
 	g_free(outc->analog_buff);
+	sr_edge_index_free(outc->edges);
+	g_array_free(outc->frames, TRUE);
 
 	g_free(outc);
 	o->priv = NULL;
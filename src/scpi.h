@@ -27,6 +27,7 @@
 
 #define SCPI_CMD_IDN "*IDN?"
 #define SCPI_CMD_OPC "*OPC?"
+#define SCPI_CMD_STB "*STB?"
 
 enum {
 	SCPI_CMD_GET_TIMEBASE = 1,
@@ -97,6 +98,11 @@ struct sr_scpi_dev_inst {
 		const char *resource, char **params, const char *serialcomm);
 	int (*open)(struct sr_scpi_dev_inst *scpi);
 	int (*connection_id)(struct sr_scpi_dev_inst *scpi, char **connection_id);
+	/*
+	 * Fingerprint of the instrument itself for the identification
+	 * cache. NULL, or SR_ERR_NA, when the transport can't tell it.
+	 */
+	int (*idcache_id)(struct sr_scpi_dev_inst *scpi, char **idcache_id);
 	int (*source_add)(struct sr_session *session, void *priv, int events,
 		int timeout, sr_receive_data_callback cb, void *cb_data);
 	int (*source_remove)(struct sr_session *session, void *priv);
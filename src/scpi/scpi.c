@@ -356,8 +356,7 @@ SR_PRIV GSList *sr_scpi_scan(struct drv_context *drvc, GSList *options,
 	}
 
 	/* Tack a copy of the newly found devices onto the driver list. */
-	if (devices)
-		drvc->instances = g_slist_concat(drvc->instances, g_slist_copy(devices));
+	std_scan_instances_add(drvc, devices);
 
 	return devices;
 }
@@ -1143,14 +1142,65 @@ SR_PRIV int sr_scpi_get_hw_id(struct sr_scpi_dev_inst *scpi,
 	gchar **tokens;
 	struct sr_scpi_hw_info *hw_info;
 	gchar *idn_substr;
+	char *cache_id, *no_stb;
+	gboolean cached, fingerprint, stb_failed;
+	int status;
 
 	*scpi_response = NULL;
 	response = NULL;
 	tokens = NULL;
 
-	ret = sr_scpi_get_string(scpi, SCPI_CMD_IDN, &response);
-	if (ret != SR_OK && !response)
-		return ret;
+	/*
+	 * Prefer a previously stored response for this connection when
+	 * the identification cache is enabled. Only keep responses in
+	 * the cache which could get parsed.
+	 *
+	 * Transports which can fingerprint the instrument itself (USB
+	 * devices with a serial number) use that as the key, a hit then
+	 * needs no communication at all. Otherwise the key is just the
+	 * connection, and a cheap status query checks that an instrument
+	 * still answers there. Instruments which don't implement *STB?
+	 * get marked, and are always identified by *IDN? instead. Callers
+	 * need to sr_idcache_remove_all() when swapping instruments on
+	 * such connections.
+	 */
+	cache_id = NULL;
+	fingerprint = FALSE;
+	if (sr_idcache_enabled()) {
+		if (scpi->idcache_id && scpi->idcache_id(scpi, &cache_id) == SR_OK)
+			fingerprint = TRUE;
+		else if (scpi->connection_id)
+			(void)sr_scpi_connection_id(scpi, &cache_id);
+	}
+	no_stb = fingerprint ? NULL : sr_idcache_lookup(cache_id, "no-stb");
+	response = no_stb ? NULL : sr_idcache_lookup(cache_id, "idn");
+	cached = response != NULL;
+	stb_failed = FALSE;
+	if (cached && !fingerprint
+			&& sr_scpi_get_int(scpi, SCPI_CMD_STB, &status) != SR_OK) {
+		g_free(response);
+		response = NULL;
+		cached = FALSE;
+		stb_failed = TRUE;
+	}
+	if (cached) {
+		sr_dbg("Using cached IDN response for %s.", cache_id);
+	} else {
+		ret = sr_scpi_get_string(scpi, SCPI_CMD_IDN, &response);
+		if (ret != SR_OK && !response) {
+			/* Nothing answers on this connection anymore. */
+			sr_idcache_store(cache_id, "idn", NULL);
+			g_free(no_stb);
+			g_free(cache_id);
+			return ret;
+		}
+	}
+	if (stb_failed) {
+		sr_dbg("No status from %s, not caching its IDN response.",
+			cache_id);
+		sr_idcache_store(cache_id, "idn", NULL);
+		sr_idcache_store(cache_id, "no-stb", "1");
+	}
 
 	/*
 	 * The response to a '*IDN?' is specified by the SCPI spec. It contains
@@ -1167,14 +1217,22 @@ SR_PRIV int sr_scpi_get_hw_id(struct sr_scpi_dev_inst *scpi,
 	num_tokens = g_strv_length(tokens);
 	if (num_tokens < 3) {
 		sr_dbg("IDN response not according to spec: '%s'", response);
+		if (cached)
+			sr_idcache_store(cache_id, "idn", NULL);
 		g_strfreev(tokens);
 		g_free(response);
+		g_free(no_stb);
+		g_free(cache_id);
 		return SR_ERR_DATA;
 	}
 	if (num_tokens < 4) {
 		sr_warn("Short IDN response, assume missing serial number.");
 	}
+	if (!cached && !no_stb && !stb_failed)
+		sr_idcache_store(cache_id, "idn", response);
 	g_free(response);
+	g_free(no_stb);
+	g_free(cache_id);
 
 	hw_info = g_malloc0(sizeof(*hw_info));
 
@@ -132,6 +132,28 @@ static int scpi_serial_connection_id(struct sr_scpi_dev_inst *scpi,
 	return SR_OK;
 }
 
+/*
+ * Only USB serial ports with a serial number identify the instrument
+ * behind them. The port name stays the same when it gets replaced.
+ */
+static int scpi_serial_idcache_id(struct sr_scpi_dev_inst *scpi,
+		char **idcache_id)
+{
+	struct scpi_serial *sscpi = scpi->priv;
+	struct sr_serial_dev_inst *serial = sscpi->serial;
+	char *usb_id;
+	int ret;
+
+	usb_id = NULL;
+	ret = serial_get_usb_id(serial, &usb_id);
+	if (ret != SR_OK)
+		return ret;
+	*idcache_id = g_strdup_printf("%s@%s", serial->port, usb_id);
+	g_free(usb_id);
+
+	return SR_OK;
+}
+
 static int scpi_serial_source_add(struct sr_session *session, void *priv,
 		int events, int timeout, sr_receive_data_callback cb, void *cb_data)
 {
@@ -233,6 +255,7 @@ SR_PRIV const struct sr_scpi_dev_inst scpi_serial_dev = {
 	.dev_inst_new  = scpi_serial_dev_inst_new,
 	.open          = scpi_serial_open,
 	.connection_id = scpi_serial_connection_id,
+	.idcache_id    = scpi_serial_idcache_id,
 	.source_add    = scpi_serial_source_add,
 	.source_remove = scpi_serial_source_remove,
 	.send          = scpi_serial_send,
@@ -427,6 +427,23 @@ static int scpi_usbtmc_libusb_connection_id(struct sr_scpi_dev_inst *scpi,
 	return SR_OK;
 }
 
+static int scpi_usbtmc_libusb_idcache_id(struct sr_scpi_dev_inst *scpi,
+		char **idcache_id)
+{
+	struct scpi_usbtmc_libusb *uscpi = scpi->priv;
+	struct sr_usb_dev_inst *usb = uscpi->usb;
+	char id[160];
+	int ret;
+
+	ret = usb_get_idcache_id(libusb_get_device(usb->devhdl), usb->devhdl,
+		id, sizeof(id));
+	if (ret != SR_OK)
+		return ret;
+	*idcache_id = g_strdup_printf("%s/%s", scpi->prefix, id);
+
+	return SR_OK;
+}
+
 static int scpi_usbtmc_libusb_source_add(struct sr_session *session,
 		void *priv, int events, int timeout, sr_receive_data_callback cb,
 		void *cb_data)
@@ -699,6 +716,7 @@ SR_PRIV const struct sr_scpi_dev_inst scpi_usbtmc_libusb_dev = {
 	.dev_inst_new  = scpi_usbtmc_libusb_dev_inst_new,
 	.open          = scpi_usbtmc_libusb_open,
 	.connection_id = scpi_usbtmc_libusb_connection_id,
+	.idcache_id    = scpi_usbtmc_libusb_idcache_id,
 	.source_add    = scpi_usbtmc_libusb_source_add,
 	.source_remove = scpi_usbtmc_libusb_source_remove,
 	.send          = scpi_usbtmc_libusb_send,
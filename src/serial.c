@@ -227,6 +227,35 @@ SR_PRIV int serial_drain(struct sr_serial_dev_inst *serial)
 	return serial->lib_funcs->drain(serial);
 }
 
+/**
+ * Get the identity of the USB device behind a serial port.
+ *
+ * The identity is made of the VID:PID and the serial number, so it tells
+ * apart different units of the same model on the same port.
+ *
+ * @param serial Previously initialized serial port structure.
+ * @param[out] id The identity, to be freed with g_free().
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_NA The port is not a USB device, or it has no serial
+ *                   number.
+ * @retval SR_ERR Failure.
+ *
+ * @private
+ */
+SR_PRIV int serial_get_usb_id(struct sr_serial_dev_inst *serial, char **id)
+{
+	if (!serial || !id) {
+		sr_dbg("Invalid serial port.");
+		return SR_ERR;
+	}
+
+	if (!serial->lib_funcs || !serial->lib_funcs->get_usb_id)
+		return SR_ERR_NA;
+
+	return serial->lib_funcs->get_usb_id(serial, id);
+}
+
 /*
  * Provide an internal RX data buffer for the serial port. This is not
  * supposed to be used directly by applications. Instead optional and
@@ -517,6 +517,30 @@ static size_t sr_ser_libsp_get_rx_avail(struct sr_serial_dev_inst *serial)
 	return rc;
 }
 
+static int sr_ser_libsp_get_usb_id(struct sr_serial_dev_inst *serial,
+	char **id)
+{
+	struct sp_port *port;
+	int vid, pid;
+	const char *usb_serial;
+	int ret;
+
+	if (sp_get_port_by_name(serial->port, &port) != SP_OK)
+		return SR_ERR;
+
+	ret = SR_ERR_NA;
+	if (sp_get_port_transport(port) == SP_TRANSPORT_USB
+			&& sp_get_port_usb_vid_pid(port, &vid, &pid) == SP_OK
+			&& (usb_serial = sp_get_port_usb_serial(port))
+			&& *usb_serial) {
+		*id = g_strdup_printf("usb/%04x.%04x/%s", vid, pid, usb_serial);
+		ret = SR_OK;
+	}
+	sp_free_port(port);
+
+	return ret;
+}
+
 static struct ser_lib_functions serlib_sp = {
 	.open = sr_ser_libsp_open,
 	.close = sr_ser_libsp_close,
@@ -532,6 +556,7 @@ static struct ser_lib_functions serlib_sp = {
 	.find_usb = sr_ser_libsp_find_usb,
 	.get_frame_format = sr_ser_libsp_get_frame_format,
 	.get_rx_avail = sr_ser_libsp_get_rx_avail,
+	.get_usb_id = sr_ser_libsp_get_usb_id,
 };
 SR_PRIV struct ser_lib_functions *ser_lib_funcs_libsp = &serlib_sp;
 
@@ -51,6 +51,221 @@ struct datafeed_callback {
 	void *cb_data;
 };
 
+/** @cond PRIVATE */
+#define PIPELINE_QUEUE_SIZE_DEFAULT 64
+#define PIPELINE_STAGES (SR_PIPELINE_STAGE_CALLBACK + 1)
+/** @endcond */
+
+struct pipeline_item {
+	const struct sr_dev_inst *sdi;
+	/** The packet, NULL tells the worker thread to terminate. */
+	struct sr_datafeed_packet *packet;
+	/** Monotonic time (us) when the device sent the packet. */
+	gint64 sent;
+	/** Monotonic time (us) when the item was queued for the stage. */
+	gint64 queued;
+};
+
+/** Bounded FIFO in front of a pipeline stage, plus its counters. */
+struct pipeline_queue {
+	GMutex mutex;
+	GCond cond;
+	GQueue items;
+	size_t size;
+	struct sr_pipeline_stats stats;
+};
+
+struct session_pipeline {
+	/** Whether the worker threads are running. */
+	gboolean active;
+	struct pipeline_queue queue[PIPELINE_STAGES];
+	GThread *thread[PIPELINE_STAGES];
+};
+
+/** Datafeed counters of a device, plus the time of its first and latest packet. */
+struct dev_stats {
+	struct sr_dev_stats stats;
+	gint64 first;
+	gint64 last;
+};
+
+/** @cond PRIVATE */
+#define DEV_THREAD_QUEUE_SIZE_DEFAULT 64
+/* Payload bytes a device may deliver per turn with SR_DEV_THREAD_BYTES. */
+#define DEV_THREAD_QUANTUM (64 * 1024)
+/** @endcond */
+
+/*
+ * Intrusive multi-producer, single-consumer queue (after D. Vyukov).
+ * Producers replace the head pointer with a compare-and-exchange loop,
+ * the consumer owns the tail. So pushing never takes a lock and never
+ * waits for the consumer.
+ */
+struct mpsc_node {
+	struct mpsc_node *next;
+};
+
+struct mpsc_queue {
+	/** The most recently pushed node. */
+	struct mpsc_node *head;
+	/** The oldest node, only accessed by the consumer. */
+	struct mpsc_node *tail;
+	struct mpsc_node stub;
+};
+
+/** A packet sent by a device, waiting for the dispatcher. */
+struct dev_packet {
+	struct mpsc_node node;
+	struct sr_datafeed_packet *packet;
+	/** Monotonic time (us) when the device sent the packet. */
+	gint64 sent;
+	/** Size of the logic or analog payload. */
+	uint64_t bytes;
+};
+
+/** The acquisition thread of a device, and the packets it sent. */
+struct dev_thread {
+	struct session_dev_threads *owner;
+	struct sr_dev_inst *sdi;
+	/**
+	 * USB devices share the context and loop of the first one, whose
+	 * thread handles the libusb events of all of them. Thread is NULL
+	 * for the others.
+	 */
+	GMainContext *context;
+	GMainLoop *loop;
+	GThread *thread;
+	/** Event sources added on this thread, indexed by key. */
+	GHashTable *event_sources;
+	struct mpsc_queue queue;
+	/** Number of packets which were sent but not yet delivered. */
+	gint depth;
+	gint depth_max;
+	/** Number of senders waiting for the dispatcher to catch up. */
+	gint blocked;
+	/** Protects the counters, and lets senders and callers wait. */
+	GMutex mutex;
+	GCond cond;
+	struct sr_pipeline_stats stats;
+	/* Dispatcher state: the oldest packet, and the byte credit. */
+	struct dev_packet *next;
+	uint64_t deficit;
+};
+
+struct session_dev_threads {
+	struct sr_session *session;
+	/** Whether the threads are running. */
+	gboolean active;
+	enum sr_dev_thread_policy policy;
+	size_t queue_size;
+	/** List of struct dev_thread, in the order of the session's devices. */
+	GSList *threads;
+	/** The struct dev_thread of each device instance. */
+	GHashTable *by_dev;
+	/** Where the dispatcher continues taking turns. */
+	GSList *turn;
+	GThread *dispatcher;
+	/** Number of packets of all devices which were not yet delivered. */
+	gint pending;
+	/** Whether the dispatcher waits for packets. */
+	gint sleeping;
+	gint quit;
+	GMutex mutex;
+	GCond cond;
+};
+
+/** The packet a thread currently passes to the datafeed callbacks. */
+struct delivery {
+	struct sr_session *session;
+	gint64 sent;
+	/** Position on the session timeline (ns), if timestamps are enabled. */
+	gboolean has_timestamp;
+	int64_t timestamp;
+};
+
+/** Where a stream of samples is on the session timeline. */
+struct stream_pos {
+	/** Time of sample 0 since the last samplerate change, in ns. */
+	int64_t base;
+	/** Number of samples since then. */
+	uint64_t count;
+};
+
+/** When the samples of a device were taken. */
+struct dev_timeline {
+	uint64_t samplerate;
+	/**
+	 * Samplerate when the session started, taken before the device
+	 * ran. SR_DF_META packets update it later on.
+	 */
+	uint64_t start_samplerate;
+	/** Time of the SR_DF_HEADER packet, in ns. */
+	int64_t start;
+	/** Time of the latest packet, used while the samplerate is unknown. */
+	int64_t last;
+	/*
+	 * Position of the logic data (key NULL) and of each analog channel
+	 * (key struct sr_channel *), as each of them is sent separately.
+	 */
+	GHashTable *streams;
+	/** The stream which the first data packet was sent for. */
+	struct stream_pos *primary;
+	/** Merge order of the device's latest packet, see struct merge_item. */
+	int64_t merge_last;
+	gboolean triggered;
+	gboolean ended;
+};
+
+/** A packet held back by the merge stage. */
+struct merge_item {
+	const struct sr_dev_inst *sdi;
+	struct sr_datafeed_packet *packet;
+	gint64 sent;
+	int64_t timestamp;
+	/*
+	 * The timestamp, or that of the device's previous packet if it was
+	 * later. The streams of a device need not be sent in time order, the
+	 * packets get merged in this order so that each device's stay FIFO.
+	 */
+	int64_t order;
+};
+
+struct session_timeline {
+	struct sr_session *session;
+	GMutex mutex;
+	/** The struct dev_timeline of each device instance. */
+	GHashTable *devs;
+	gboolean trigger_align;
+	gboolean have_trigger;
+	/** Time of the first trigger of any device, in ns. */
+	int64_t trigger;
+	/** Reorder window in ns, 0 if packets are not merged. */
+	uint64_t window;
+	/** Held back packets (struct merge_item), in merge order. */
+	GQueue pending;
+};
+
+static GPrivate current_dev_thread = G_PRIVATE_INIT(NULL);
+static GPrivate current_delivery = G_PRIVATE_INIT(NULL);
+
+static void pipeline_start(struct sr_session *session);
+static void pipeline_stop(struct sr_session *session);
+static void pipeline_free(struct sr_session *session);
+static struct dev_thread *dev_thread_get(struct sr_session *session,
+		const struct sr_dev_inst *sdi);
+static int dev_thread_call(struct dev_thread *dt,
+		int (*func)(struct sr_dev_inst *sdi));
+static void dev_thread_invoke(struct dev_thread *dt, GSourceFunc func);
+static gboolean dev_thread_stop_cb(gpointer data);
+static void dev_threads_start(struct sr_session *session);
+static void dev_threads_stop(struct sr_session *session);
+static void dev_threads_free(struct sr_session *session);
+static void timeline_start(struct sr_session *session);
+static void timeline_dev_add(struct sr_session *session,
+		const struct sr_dev_inst *sdi);
+static void timeline_stop(struct sr_session *session);
+static void timeline_free(struct sr_session *session);
+
 /** Custom GLib event source for generic descriptor I/O.
  * @see https://developer.gnome.org/glib/stable/glib-The-Main-Event-Loop.html
  */
@@ -225,6 +440,11 @@ SR_API int sr_session_new(struct sr_context *ctx,
 	session->ctx = ctx;
 
 	g_mutex_init(&session->main_mutex);
+	g_mutex_init(&session->sources_mutex);
+
+	g_mutex_init(&session->stats_mutex);
+	session->dev_stats = g_hash_table_new_full(NULL, NULL, NULL, g_free);
+	session->stage_stats = g_hash_table_new_full(NULL, NULL, NULL, g_free);
 
 	/* To maintain API compatibility, we need a lookup table
 	 * which maps poll_object IDs to GSource* pointers.
@@ -259,8 +479,17 @@ SR_API int sr_session_destroy(struct sr_session *session)
 
 	sr_session_datafeed_callback_remove_all(session);
 
+	dev_threads_free(session);
+	pipeline_free(session);
+	timeline_free(session);
+
+	g_hash_table_unref(session->dev_stats);
+	g_hash_table_unref(session->stage_stats);
+	g_mutex_clear(&session->stats_mutex);
+
 	g_hash_table_unref(session->event_sources);
 
+	g_mutex_clear(&session->sources_mutex);
 	g_mutex_clear(&session->main_mutex);
 
 	g_free(session);
@@ -366,6 +595,7 @@ SR_API int sr_session_dev_add(struct sr_session *session,
 			       sr_strerror(ret));
 			return ret;
 		}
+		timeline_dev_add(session, sdi);
 		if ((ret = sr_dev_acquisition_start(sdi)) != SR_OK) {
 			sr_err("Failed to start acquisition of device in "
 			       "running session (%s)", sr_strerror(ret));
@@ -654,7 +884,7 @@ static int unset_main_context(struct sr_session *session)
 	return ret;
 }
 
-static unsigned int session_source_attach(struct sr_session *session,
+static unsigned int main_context_attach(struct sr_session *session,
 		GSource *source)
 {
 	unsigned int id = 0;
@@ -671,6 +901,88 @@ static unsigned int session_source_attach(struct sr_session *session,
 	return id;
 }
 
+/* Attach a source to the main context, or to the calling device thread's. */
+static unsigned int session_source_attach(struct sr_session *session,
+		GSource *source)
+{
+	struct dev_thread *dt;
+
+	dt = g_private_get(&current_dev_thread);
+	if (dt && dt->owner->session == session)
+		return g_source_attach(source, dt->context);
+
+	return main_context_attach(session, source);
+}
+
+/* The event source table of the calling thread's device, or the session's. */
+static GHashTable *source_table(struct sr_session *session)
+{
+	struct dev_thread *dt;
+
+	dt = g_private_get(&current_dev_thread);
+	if (dt && dt->owner->session == session)
+		return dt->event_sources;
+
+	return session->event_sources;
+}
+
+static gboolean source_table_has(GHashTable *table, void *key,
+		GSource *source)
+{
+	if (!source)
+		return g_hash_table_contains(table, key);
+
+	return g_hash_table_lookup(table, key) == source;
+}
+
+/*
+ * Find the table holding an event source, looking at the calling thread's
+ * table first. If @a source is NULL, any source with @a key matches.
+ * Must be called with the sources mutex held.
+ */
+static GHashTable *source_table_find(struct sr_session *session,
+		void *key, GSource *source)
+{
+	GHashTable *table;
+	struct dev_thread *dt;
+	GSList *l;
+
+	table = source_table(session);
+	if (source_table_has(table, key, source))
+		return table;
+	if (source_table_has(session->event_sources, key, source))
+		return session->event_sources;
+	if (!session->dev_threads)
+		return NULL;
+	for (l = session->dev_threads->threads; l; l = l->next) {
+		dt = l->data;
+		if (source_table_has(dt->event_sources, key, source))
+			return dt->event_sources;
+	}
+
+	return NULL;
+}
+
+/* Number of event sources, including those of the device threads. */
+static unsigned int sources_count(struct sr_session *session)
+{
+	struct dev_thread *dt;
+	unsigned int count;
+	GSList *l;
+
+	g_mutex_lock(&session->sources_mutex);
+	count = g_hash_table_size(session->event_sources);
+	if (session->dev_threads) {
+		for (l = session->dev_threads->threads; l; l = l->next) {
+			dt = l->data;
+			count += g_hash_table_size(dt->event_sources);
+		}
+	}
+	g_mutex_unlock(&session->sources_mutex);
+
+	return count;
+}
+
 /* Idle handler; invoked when the number of registered event sources
  * for a running session drops to zero.
  */
@@ -679,16 +991,23 @@ static gboolean delayed_stop_check(void *data)
 	struct sr_session *session;
 
 	session = data;
+	g_mutex_lock(&session->sources_mutex);
 	session->stop_check_id = 0;
+	g_mutex_unlock(&session->sources_mutex);
 
 	/* Session already ended? */
 	if (!session->running)
 		return G_SOURCE_REMOVE;
 
 	/* New event sources may have been installed in the meantime. */
-	if (g_hash_table_size(session->event_sources) != 0)
+	if (sources_count(session) != 0)
 		return G_SOURCE_REMOVE;
 
+	/* Let the worker threads deliver all pending packets. */
+	dev_threads_stop(session);
+	pipeline_stop(session);
+	timeline_stop(session);
+
 	session->running = FALSE;
 	unset_main_context(session);
 
@@ -715,14 +1034,19 @@ static int stop_check_later(struct sr_session *session)
 	GSource *source;
 	unsigned int source_id;
 
-	if (session->stop_check_id != 0)
+	/* Device threads may drop their last event source concurrently. */
+	g_mutex_lock(&session->sources_mutex);
+	if (session->stop_check_id != 0) {
+		g_mutex_unlock(&session->sources_mutex);
 		return SR_OK; /* idle handler already installed */
+	}
 
 	source = g_idle_source_new();
 	g_source_set_callback(source, &delayed_stop_check, session, NULL);
 
-	source_id = session_source_attach(session, source);
+	source_id = main_context_attach(session, source);
 	session->stop_check_id = source_id;
+	g_mutex_unlock(&session->sources_mutex);
 
 	g_source_unref(source);
 
@@ -753,6 +1077,7 @@ static int stop_check_later(struct sr_session *session)
 SR_API int sr_session_start(struct sr_session *session)
 {
 	struct sr_dev_inst *sdi;
+	struct dev_thread *dt;
 	struct sr_channel *ch;
 	GSList *l, *c, *lend;
 	int ret;
@@ -808,6 +1133,11 @@ SR_API int sr_session_start(struct sr_session *session)
 
 	sr_info("Starting.");
 
+	g_atomic_int_set(&session->deferred_error, SR_OK);
+	timeline_start(session);
+	pipeline_start(session);
+	dev_threads_start(session);
+
 	session->running = TRUE;
 
 	/* Have all devices start acquisition. */
@@ -817,7 +1147,10 @@ SR_API int sr_session_start(struct sr_session *session)
 			ret = SR_ERR;
 			break;
 		}
-		ret = sr_dev_acquisition_start(sdi);
+		if ((dt = dev_thread_get(session, sdi)))
+			ret = dev_thread_call(dt, sr_dev_acquisition_start);
+		else
+			ret = sr_dev_acquisition_start(sdi);
 		if (ret != SR_OK) {
 			sr_err("Could not start %s device %s acquisition.",
 				sdi->driver->name, sdi->connection_id);
@@ -831,17 +1164,23 @@ SR_API int sr_session_start(struct sr_session *session)
 		lend = l->next;
 		for (l = session->devs; l != lend; l = l->next) {
 			sdi = l->data;
-			sr_dev_acquisition_stop(sdi);
+			if ((dt = dev_thread_get(session, sdi)))
+				dev_thread_call(dt, sr_dev_acquisition_stop);
+			else
+				sr_dev_acquisition_stop(sdi);
 		}
 		/* TODO: Handle delayed stops. Need to iterate the event
 		 * sources... */
+		dev_threads_stop(session);
+		pipeline_stop(session);
+		timeline_stop(session);
 		session->running = FALSE;
 
 		unset_main_context(session);
 		return ret;
 	}
 
-	if (g_hash_table_size(session->event_sources) == 0)
+	if (sources_count(session) == 0)
 		stop_check_later(session);
 
 	return SR_OK;
@@ -903,6 +1242,7 @@ static gboolean session_stop_sync(void *user_data)
 {
 	struct sr_session *session;
 	struct sr_dev_inst *sdi;
+	struct dev_thread *dt;
 	GSList *node;
 
 	session = user_data;
@@ -914,7 +1254,11 @@ static gboolean session_stop_sync(void *user_data)
 
 	for (node = session->devs; node; node = node->next) {
 		sdi = node->data;
-		sr_dev_acquisition_stop(sdi);
+		/* Drivers handle a device on its own thread only. */
+		if ((dt = dev_thread_get(session, sdi)))
+			dev_thread_invoke(dt, dev_thread_stop_cb);
+		else
+			sr_dev_acquisition_stop(sdi);
 	}
 
 	return G_SOURCE_REMOVE;
@@ -1072,94 +1416,353 @@ static void datafeed_dump(const struct sr_datafeed_packet *packet)
 	}
 }
 
+/* Account for a call of a transform module or datafeed callback. */
+static void stage_stats_add(struct sr_session *session, const void *key,
+		const char *name, unsigned int index, gint64 start)
+{
+	struct sr_stage_stats *st;
+	uint64_t duration;
+	unsigned int bin;
+
+	duration = g_get_monotonic_time() - start;
+	bin = MIN(g_bit_storage(duration), SR_STATS_HISTOGRAM_BINS - 1);
+	if (!duration)
+		bin = 0;
+
+	g_mutex_lock(&session->stats_mutex);
+	st = g_hash_table_lookup(session->stage_stats, key);
+	if (!st) {
+		st = g_malloc0(sizeof(*st));
+		g_hash_table_insert(session->stage_stats, (void *)key, st);
+	}
+	st->name = name;
+	st->index = index;
+	st->calls++;
+	st->time_total += duration;
+	if (st->time_max < duration)
+		st->time_max = duration;
+	st->histogram[bin]++;
+	g_mutex_unlock(&session->stats_mutex);
+}
+
+/* Size of the logic or analog payload of a packet, in bytes and samples. */
+static uint64_t packet_payload_size(const struct sr_datafeed_packet *packet,
+		uint64_t *samples)
+{
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	uint64_t bytes;
+
+	bytes = *samples = 0;
+	if (packet->type == SR_DF_LOGIC) {
+		logic = packet->payload;
+		bytes = logic->length;
+		if (logic->unitsize)
+			*samples = logic->length / logic->unitsize;
+	} else if (packet->type == SR_DF_ANALOG) {
+		analog = packet->payload;
+		*samples = analog->num_samples;
+		bytes = *samples * analog->encoding->unitsize *
+			MAX(g_slist_length(analog->meaning->channels), 1);
+	}
+
+	return bytes;
+}
+
+/* Find the counters of a device, or add them. Call with stats_mutex held. */
+static struct dev_stats *dev_stats_lookup(struct sr_session *session,
+		const struct sr_dev_inst *sdi)
+{
+	struct dev_stats *ds;
+
+	ds = g_hash_table_lookup(session->dev_stats, sdi);
+	if (!ds) {
+		ds = g_malloc0(sizeof(*ds));
+		g_hash_table_insert(session->dev_stats, (void *)sdi, ds);
+	}
+
+	return ds;
+}
+
+/* Account for a packet sent by a device. */
+static void dev_stats_add(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet)
+{
+	struct sr_session *session;
+	struct dev_stats *ds;
+	uint64_t bytes, samples;
+	gint64 now;
+
+	bytes = packet_payload_size(packet, &samples);
+	now = g_get_monotonic_time();
+
+	session = sdi->session;
+	g_mutex_lock(&session->stats_mutex);
+	ds = dev_stats_lookup(session, sdi);
+	if (!ds->stats.packets)
+		ds->first = now;
+	ds->last = now;
+	ds->stats.packets++;
+	ds->stats.bytes += bytes;
+	ds->stats.samples += samples;
+	g_mutex_unlock(&session->stats_mutex);
+}
+
 /**
- * Helper to send a meta datafeed package (SR_DF_META) to the session bus.
+ * Update the USB transfer statistics of a device.
  *
- * @param sdi The device instance to send the package from. Must not be NULL.
- * @param key The config key to send to the session bus.
- * @param var The value to send to the session bus.
+ * Called by the USB stream helpers for every completed transfer. Does
+ * nothing unless the collection of statistics is enabled.
  *
- * @retval SR_OK Success.
- * @retval SR_ERR_ARG Invalid argument.
+ * @param sdi The device instance.
+ * @param stats The current statistics of the device's USB stream.
  *
  * @private
  */
-SR_PRIV int sr_session_send_meta(const struct sr_dev_inst *sdi,
-		uint32_t key, GVariant *var)
+SR_PRIV void sr_session_dev_usb_stats_update(const struct sr_dev_inst *sdi,
+		const struct sr_usb_stream_stats *stats)
 {
-	struct sr_config *cfg;
-	struct sr_datafeed_packet packet;
-	struct sr_datafeed_meta meta;
-	int ret;
-
-	cfg = sr_config_new(key, var);
+	struct sr_session *session;
+	struct dev_stats *ds;
 
-	memset(&meta, 0, sizeof(meta));
+	session = sdi->session;
+	if (!session || !session->stats_enabled)
+		return;
 
-	packet.type = SR_DF_META;
-	packet.payload = &meta;
+	g_mutex_lock(&session->stats_mutex);
+	ds = dev_stats_lookup(session, sdi);
+	ds->stats.usb = *stats;
+	g_mutex_unlock(&session->stats_mutex);
+}
 
-	meta.config = g_slist_append(NULL, cfg);
+/**
+ * Update the buffer pool statistics of a device.
+ *
+ * Called by the buffer pool whenever its counters change. Does nothing
+ * unless the collection of statistics is enabled.
+ *
+ * @param sdi The device instance.
+ * @param stats The current statistics of the device's buffer pool.
+ *
+ * @private
+ */
+SR_PRIV void sr_session_dev_pool_stats_update(const struct sr_dev_inst *sdi,
+		const struct sr_buffer_pool_stats *stats)
+{
+	struct sr_session *session;
+	struct dev_stats *ds;
 
-	ret = sr_session_send(sdi, &packet);
-	g_slist_free(meta.config);
-	sr_config_free(cfg);
+	session = sdi->session;
+	if (!session || !session->stats_enabled)
+		return;
 
-	return ret;
+	g_mutex_lock(&session->stats_mutex);
+	ds = dev_stats_lookup(session, sdi);
+	ds->stats.pool = *stats;
+	g_mutex_unlock(&session->stats_mutex);
 }
 
 /**
- * Send a packet to whatever is listening on the datafeed bus.
+ * Enable or disable the collection of datafeed statistics.
  *
- * Hardware drivers use this to send a data packet to the frontend.
+ * When enabled, the session counts the packets, bytes and samples each
+ * device sends, and measures the time spent in each transform module
+ * and datafeed callback. Collection costs two clock reads per call and
+ * a short critical section per packet, so it is disabled by default.
  *
- * @param sdi TODO.
- * @param packet The datafeed packet to send to the session bus.
+ * Disabling the collection keeps the counters collected so far.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param enable TRUE to enable the collection, FALSE to disable it.
  *
  * @retval SR_OK Success.
- * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_ARG Invalid session passed.
  *
- * @private
+ * @since 0.6.0
  */
-SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
-		const struct sr_datafeed_packet *packet)
+SR_API int sr_session_stats_enable(struct sr_session *session,
+		gboolean enable)
 {
-	GSList *l;
-	struct datafeed_callback *cb_struct;
-	struct sr_datafeed_packet *packet_in, *packet_out;
-	struct sr_transform *t;
-	int ret;
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_ARG;
+	}
 
-	if (!sdi) {
-		sr_err("%s: sdi was NULL", __func__);
+	session->stats_enabled = enable;
+
+	return SR_OK;
+}
+
+/**
+ * Reset all datafeed statistics of a session.
+ *
+ * @param session The session to use. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid session passed.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_stats_reset(struct sr_session *session)
+{
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
 		return SR_ERR_ARG;
 	}
 
-	if (!packet) {
-		sr_err("%s: packet was NULL", __func__);
+	g_mutex_lock(&session->stats_mutex);
+	g_hash_table_remove_all(session->dev_stats);
+	g_hash_table_remove_all(session->stage_stats);
+	g_mutex_unlock(&session->stats_mutex);
+
+	return SR_OK;
+}
+
+/**
+ * Get the datafeed counters of a device.
+ *
+ * For devices which stream sample data over USB, the statistics also
+ * cover the device's bulk transfers and their sizing. For drivers which
+ * take sample buffers from a pool, they cover the pool's counters.
+ *
+ * May be called from any thread, also while the session runs.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param sdi The device instance. Must not be NULL.
+ * @param stats Receives the counters. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_NA Nothing of this device was counted.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_dev_stats_get(struct sr_session *session,
+		const struct sr_dev_inst *sdi, struct sr_dev_stats *stats)
+{
+	struct dev_stats *ds;
+	double seconds;
+
+	if (!session || !sdi || !stats)
 		return SR_ERR_ARG;
+
+	g_mutex_lock(&session->stats_mutex);
+	ds = g_hash_table_lookup(session->dev_stats, sdi);
+	if (ds) {
+		*stats = ds->stats;
+		stats->duration = ds->last - ds->first;
+	}
+	g_mutex_unlock(&session->stats_mutex);
+	if (!ds)
+		return SR_ERR_NA;
+
+	seconds = stats->duration / (double)G_USEC_PER_SEC;
+	if (seconds > 0) {
+		stats->packet_rate = stats->packets / seconds;
+		stats->byte_rate = stats->bytes / seconds;
+		stats->sample_rate = stats->samples / seconds;
+	} else {
+		stats->packet_rate = stats->byte_rate = stats->sample_rate = 0;
 	}
 
-	if (!sdi->session) {
-		sr_err("%s: session was NULL", __func__);
-		return SR_ERR_BUG;
+	return SR_OK;
+}
+
+static gint stage_stats_compare(gconstpointer a, gconstpointer b)
+{
+	const struct sr_stage_stats *sa, *sb;
+
+	sa = a;
+	sb = b;
+
+	/* Transform modules run first. */
+	if (!sa->name != !sb->name)
+		return sa->name ? -1 : 1;
+
+	return (int)sa->index - (int)sb->index;
+}
+
+/**
+ * Get the timing of all transform modules and datafeed callbacks.
+ *
+ * May be called from any thread, also while the session runs.
+ *
+ * @param session The session to use. Must not be NULL.
+ *
+ * @return A list of newly allocated struct sr_stage_stats, transform
+ *         modules first, each in the order they are invoked. Must be
+ *         freed with g_slist_free_full(list, g_free) by the caller.
+ *         NULL if no calls were measured.
+ *
+ * @since 0.6.0
+ */
+SR_API GSList *sr_session_stage_stats_get(struct sr_session *session)
+{
+	GHashTableIter iter;
+	GSList *list;
+	void *st;
+
+	if (!session)
+		return NULL;
+
+	list = NULL;
+	g_mutex_lock(&session->stats_mutex);
+	g_hash_table_iter_init(&iter, session->stage_stats);
+	while (g_hash_table_iter_next(&iter, NULL, &st)) {
+#if GLIB_CHECK_VERSION(2, 67, 3)
+		list = g_slist_prepend(list,
+			g_memdup2(st, sizeof(struct sr_stage_stats)));
+#else
+		list = g_slist_prepend(list,
+			g_memdup(st, sizeof(struct sr_stage_stats)));
+#endif
 	}
+	g_mutex_unlock(&session->stats_mutex);
+
+	return g_slist_sort(list, stage_stats_compare);
+}
+
+/**
+ * Pass a packet through the session's transform modules.
+ *
+ * @param sdi The device instance the packet originates from.
+ * @param packet The packet to pass to the first transform module.
+ * @param packet_out The last transform module's output packet. NULL
+ *                   if one of the modules consumed the packet.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR A transform module failed.
+ */
+static int session_run_transforms(const struct sr_dev_inst *sdi,
+		struct sr_datafeed_packet *packet,
+		struct sr_datafeed_packet **packet_out)
+{
+	GSList *l;
+	struct sr_datafeed_packet *packet_in;
+	struct sr_transform *t;
+	unsigned int index;
+	gint64 start;
+	int ret;
 
 	/*
 	 * Pass the packet to the first transform module. If that returns
 	 * another packet (instead of NULL), pass that packet to the next
 	 * transform module in the list, and so on.
 	 */
-	packet_in = (struct sr_datafeed_packet *)packet;
-	for (l = sdi->session->transforms; l; l = l->next) {
+	packet_in = packet;
+	for (l = sdi->session->transforms, index = 0; l; l = l->next, index++) {
 		t = l->data;
 		sr_spew("Running transform module '%s'.", t->module->id);
-		ret = t->module->receive(t, packet_in, &packet_out);
+		start = sdi->session->stats_enabled ? g_get_monotonic_time() : 0;
+		ret = t->module->receive(t, packet_in, packet_out);
+		if (start)
+			stage_stats_add(sdi->session, t, t->module->id, index, start);
 		if (ret < 0) {
 			sr_err("Error while running transform module: %d.", ret);
+			*packet_out = NULL;
 			return SR_ERR;
 		}
-		if (!packet_out) {
+		if (!*packet_out) {
 			/*
 			 * If any of the transforms don't return an output
 			 * packet, abort.
@@ -1171,23 +1774,1581 @@ SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 			 * Use this transform module's output packet as input
 			 * for the next transform module.
 			 */
-			packet_in = packet_out;
+			packet_in = *packet_out;
 		}
 	}
-	packet = packet_in;
+	*packet_out = packet_in;
 
-	/*
-	 * If the last transform did output a packet, pass it to all datafeed
-	 * callbacks.
-	 */
-	for (l = sdi->session->datafeed_callbacks; l; l = l->next) {
-		if (sr_log_loglevel_get() >= SR_LOG_DBG)
-			datafeed_dump(packet);
+	return SR_OK;
+}
+
+/** Pass a packet to all datafeed callbacks of the session. */
+static void session_run_callbacks(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, gint64 sent,
+		const int64_t *timestamp)
+{
+	GSList *l;
+	struct datafeed_callback *cb_struct;
+	struct delivery delivery, *outer;
+	unsigned int index;
+	gint64 start;
+
+	if (!sdi->session->datafeed_callbacks)
+		return;
+
+	if (sr_log_loglevel_get() >= SR_LOG_DBG)
+		datafeed_dump(packet);
+
+	/* For sr_session_packet_time_get(). */
+	delivery.session = sdi->session;
+	delivery.sent = sent;
+	delivery.has_timestamp = timestamp != NULL;
+	delivery.timestamp = timestamp ? *timestamp : 0;
+	outer = g_private_get(&current_delivery);
+	g_private_set(&current_delivery, &delivery);
+
+	for (l = sdi->session->datafeed_callbacks, index = 0; l;
+			l = l->next, index++) {
 		cb_struct = l->data;
+		start = sdi->session->stats_enabled ? g_get_monotonic_time() : 0;
 		cb_struct->cb(sdi, packet, cb_struct->cb_data);
+		if (start)
+			stage_stats_add(sdi->session, cb_struct, NULL, index, start);
 	}
-
-	return SR_OK;
+	g_private_set(&current_delivery, outer);
+}
+
+static void session_emit(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, gint64 sent);
+
+/*
+ * Keep the first error of a packet which got processed on a worker
+ * thread, the sender only learns about it on its next send.
+ */
+static void session_error_defer(const struct sr_dev_inst *sdi, int ret)
+{
+	if (ret == SR_OK)
+		return;
+	if (g_atomic_int_compare_and_exchange(&sdi->session->deferred_error,
+			SR_OK, ret))
+		sr_err("Datafeed processing of %s device failed: %d.",
+			sdi->driver ? sdi->driver->name : "unknown", ret);
+}
+
+static void pipeline_queue_push(struct pipeline_queue *q,
+		struct pipeline_item *item)
+{
+	uint64_t depth;
+
+	g_mutex_lock(&q->mutex);
+	/* Backpressure: block the producer while the stage is behind. */
+	while (item->packet && q->items.length >= q->size)
+		g_cond_wait(&q->cond, &q->mutex);
+	item->queued = g_get_monotonic_time();
+	g_queue_push_tail(&q->items, item);
+	depth = q->items.length;
+	if (q->stats.queue_depth_max < depth)
+		q->stats.queue_depth_max = depth;
+	g_cond_broadcast(&q->cond);
+	g_mutex_unlock(&q->mutex);
+}
+
+static struct pipeline_item *pipeline_queue_pop(struct pipeline_queue *q)
+{
+	struct pipeline_item *item;
+
+	g_mutex_lock(&q->mutex);
+	while (!q->items.length)
+		g_cond_wait(&q->cond, &q->mutex);
+	item = g_queue_pop_head(&q->items);
+	g_cond_broadcast(&q->cond);
+	g_mutex_unlock(&q->mutex);
+
+	return item;
+}
+
+/* Account for a packet which the stage has finished processing. */
+static void pipeline_queue_done(struct pipeline_queue *q,
+		const struct pipeline_item *item)
+{
+	uint64_t latency;
+
+	latency = g_get_monotonic_time() - item->queued;
+	g_mutex_lock(&q->mutex);
+	q->stats.packets++;
+	q->stats.latency_total += latency;
+	if (q->stats.latency_max < latency)
+		q->stats.latency_max = latency;
+	g_mutex_unlock(&q->mutex);
+}
+
+static void pipeline_item_free(struct pipeline_item *item)
+{
+	if (item->packet)
+		sr_packet_free(item->packet);
+	g_free(item);
+}
+
+static gpointer pipeline_transform_thread(gpointer data)
+{
+	struct session_pipeline *p;
+	struct pipeline_queue *q;
+	struct pipeline_item *item;
+	struct sr_datafeed_packet *packet_out, *copy;
+	int ret;
+
+	p = data;
+	q = &p->queue[SR_PIPELINE_STAGE_TRANSFORM];
+	while ((item = pipeline_queue_pop(q))->packet) {
+		ret = session_run_transforms(item->sdi, item->packet, &packet_out);
+		if (ret == SR_OK && packet_out && packet_out != item->packet) {
+			/*
+			 * Packets owned by a transform module only live
+			 * until its next receive() call.
+			 */
+			if (sr_packet_copy(packet_out, &copy) == SR_OK) {
+				sr_packet_free(item->packet);
+				item->packet = copy;
+			} else {
+				packet_out = NULL;
+			}
+		}
+		session_error_defer(item->sdi, ret);
+		pipeline_queue_done(q, item);
+		if (ret != SR_OK || !packet_out) {
+			pipeline_item_free(item);
+			continue;
+		}
+		pipeline_queue_push(&p->queue[SR_PIPELINE_STAGE_CALLBACK], item);
+	}
+	/* Pass the termination request on to the next stage. */
+	pipeline_queue_push(&p->queue[SR_PIPELINE_STAGE_CALLBACK], item);
+
+	return NULL;
+}
+
+static gpointer pipeline_callback_thread(gpointer data)
+{
+	struct session_pipeline *p;
+	struct pipeline_queue *q;
+	struct pipeline_item *item;
+
+	p = data;
+	q = &p->queue[SR_PIPELINE_STAGE_CALLBACK];
+	while ((item = pipeline_queue_pop(q))->packet) {
+		session_emit(item->sdi, item->packet, item->sent);
+		pipeline_queue_done(q, item);
+		pipeline_item_free(item);
+	}
+	pipeline_item_free(item);
+
+	return NULL;
+}
+
+/*
+ * Queue a copy of a packet for the worker threads. Both stages process
+ * their queue in order on a single thread each, so packets get delivered
+ * in the order they were sent, and transform modules still see the
+ * packets of a device strictly in sequence.
+ */
+static int pipeline_send(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, gint64 sent)
+{
+	struct pipeline_item *item;
+	struct sr_datafeed_packet *copy;
+	int ret;
+
+	ret = sr_packet_copy(packet, &copy);
+	if (ret != SR_OK)
+		return ret;
+	item = g_malloc0(sizeof(*item));
+	item->sdi = sdi;
+	item->packet = copy;
+	item->sent = sent;
+	pipeline_queue_push(&sdi->session->pipeline->queue[SR_PIPELINE_STAGE_TRANSFORM],
+		item);
+
+	return SR_OK;
+}
+
+/* Start the worker threads, if the session is configured to use them. */
+static void pipeline_start(struct sr_session *session)
+{
+	struct session_pipeline *p;
+	int i;
+
+	if (!session->pipeline_enabled)
+		return;
+
+	if (!session->pipeline) {
+		p = g_malloc0(sizeof(*p));
+		for (i = 0; i < PIPELINE_STAGES; i++) {
+			g_mutex_init(&p->queue[i].mutex);
+			g_cond_init(&p->queue[i].cond);
+			g_queue_init(&p->queue[i].items);
+		}
+		session->pipeline = p;
+	}
+	p = session->pipeline;
+	for (i = 0; i < PIPELINE_STAGES; i++) {
+		p->queue[i].size = session->pipeline_queue_size;
+		memset(&p->queue[i].stats, 0, sizeof(p->queue[i].stats));
+	}
+
+	p->thread[SR_PIPELINE_STAGE_TRANSFORM] = g_thread_new("sr-transform",
+		pipeline_transform_thread, p);
+	p->thread[SR_PIPELINE_STAGE_CALLBACK] = g_thread_new("sr-datafeed",
+		pipeline_callback_thread, p);
+	p->active = TRUE;
+
+	sr_dbg("Running datafeed pipeline on worker threads, "
+		"%zu packets per queue.", session->pipeline_queue_size);
+}
+
+/* Drain the queues and terminate the worker threads. */
+static void pipeline_stop(struct sr_session *session)
+{
+	struct session_pipeline *p;
+	struct pipeline_item *item;
+	int i;
+
+	p = session->pipeline;
+	if (!p || !p->active)
+		return;
+
+	item = g_malloc0(sizeof(*item));
+	pipeline_queue_push(&p->queue[SR_PIPELINE_STAGE_TRANSFORM], item);
+	for (i = 0; i < PIPELINE_STAGES; i++) {
+		g_thread_join(p->thread[i]);
+		p->thread[i] = NULL;
+	}
+	p->active = FALSE;
+}
+
+static void pipeline_free(struct sr_session *session)
+{
+	struct session_pipeline *p;
+	int i;
+
+	p = session->pipeline;
+	if (!p)
+		return;
+
+	pipeline_stop(session);
+	for (i = 0; i < PIPELINE_STAGES; i++) {
+		g_mutex_clear(&p->queue[i].mutex);
+		g_cond_clear(&p->queue[i].cond);
+	}
+	g_free(p);
+	session->pipeline = NULL;
+}
+
+/**
+ * Configure the threaded datafeed pipeline of a session.
+ *
+ * By default, sr_session_send() runs all transform modules and all
+ * datafeed callbacks on the thread which produced a packet, often the
+ * thread handling USB transfers. With the pipeline enabled, a copy of
+ * each packet gets queued instead. One worker thread runs the transform
+ * modules, another one runs the datafeed callbacks, so that expensive
+ * transforms and output modules run in parallel with the acquisition.
+ *
+ * Packets are delivered to the datafeed callbacks in the order they were
+ * sent. When a stage's queue is full, the sending thread blocks until
+ * the stage caught up. All queued packets get delivered before the
+ * session's stopped callback is invoked.
+ *
+ * Note that datafeed callbacks are invoked from the worker thread when
+ * the pipeline is enabled.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param enable TRUE to enable the pipeline, FALSE to disable it.
+ * @param queue_size Maximum number of packets queued per stage, 0 selects
+ *                   the default.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid session passed.
+ * @retval SR_ERR The session is running.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_pipeline_set(struct sr_session *session,
+		gboolean enable, size_t queue_size)
+{
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+	if (session->running) {
+		sr_err("Cannot change the pipeline while the session is running.");
+		return SR_ERR;
+	}
+
+	session->pipeline_enabled = enable;
+	session->pipeline_queue_size = queue_size ? queue_size
+		: PIPELINE_QUEUE_SIZE_DEFAULT;
+
+	return SR_OK;
+}
+
+/**
+ * Get the counters of a threaded datafeed pipeline stage.
+ *
+ * May be called from any thread while the session runs. After the
+ * session stopped, the counters of the last run remain available.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param stage The pipeline stage.
+ * @param stats Receives the counters. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_NA The session never ran with the pipeline enabled.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_pipeline_stats_get(struct sr_session *session,
+		enum sr_pipeline_stage stage, struct sr_pipeline_stats *stats)
+{
+	struct pipeline_queue *q;
+
+	if (!session || !stats || (int)stage < 0 || stage >= PIPELINE_STAGES)
+		return SR_ERR_ARG;
+	if (!session->pipeline)
+		return SR_ERR_NA;
+
+	q = &session->pipeline->queue[stage];
+	g_mutex_lock(&q->mutex);
+	*stats = q->stats;
+	stats->queue_depth = q->items.length;
+	g_mutex_unlock(&q->mutex);
+
+	return SR_OK;
+}
+
+/*
+ * Run the transform modules and datafeed callbacks on a packet, or
+ * queue it for the pipeline's worker threads.
+ */
+static int session_deliver(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, gint64 sent)
+{
+	struct sr_datafeed_packet *packet_out;
+	int ret;
+
+	if (sdi->session->pipeline && sdi->session->pipeline->active)
+		return pipeline_send(sdi, packet, sent);
+
+	ret = session_run_transforms(sdi, (struct sr_datafeed_packet *)packet,
+		&packet_out);
+	if (ret != SR_OK || !packet_out)
+		return ret;
+	session_emit(sdi, packet_out, sent);
+
+	return SR_OK;
+}
+
+static void mpsc_init(struct mpsc_queue *q)
+{
+	q->stub.next = NULL;
+	q->head = q->tail = &q->stub;
+}
+
+static void mpsc_push(struct mpsc_queue *q, struct mpsc_node *node)
+{
+	struct mpsc_node *prev;
+
+	g_atomic_pointer_set(&node->next, NULL);
+	do {
+		prev = g_atomic_pointer_get(&q->head);
+	} while (!g_atomic_pointer_compare_and_exchange(&q->head, prev, node));
+	/* Until here, the consumer sees the queue end at 'prev'. */
+	g_atomic_pointer_set(&prev->next, node);
+}
+
+/* Returns NULL if the queue is empty, or a push is half-way done. */
+static struct mpsc_node *mpsc_pop(struct mpsc_queue *q)
+{
+	struct mpsc_node *tail, *next;
+
+	tail = q->tail;
+	next = g_atomic_pointer_get(&tail->next);
+	if (tail == &q->stub) {
+		if (!next)
+			return NULL;
+		q->tail = tail = next;
+		next = g_atomic_pointer_get(&next->next);
+	}
+	if (next) {
+		q->tail = next;
+		return tail;
+	}
+	if (tail != g_atomic_pointer_get(&q->head))
+		return NULL;
+
+	/* The last node can only be taken with the stub behind it. */
+	mpsc_push(q, &q->stub);
+	next = g_atomic_pointer_get(&tail->next);
+	if (next) {
+		q->tail = next;
+		return tail;
+	}
+
+	return NULL;
+}
+
+static struct dev_thread *dev_thread_get(struct sr_session *session,
+		const struct sr_dev_inst *sdi)
+{
+	if (!session->dev_threads || !session->dev_threads->active)
+		return NULL;
+
+	return g_hash_table_lookup(session->dev_threads->by_dev, sdi);
+}
+
+/*
+ * Queue a copy of a packet for the dispatcher. Any thread may send on
+ * behalf of a device, the copy gets queued without taking a lock. Only
+ * when the device is queue_size packets ahead of the dispatcher, the
+ * sender blocks until the dispatcher caught up.
+ */
+static int dev_thread_send(struct dev_thread *dt,
+		const struct sr_datafeed_packet *packet, gint64 sent)
+{
+	struct session_dev_threads *dts;
+	struct sr_datafeed_packet *copy;
+	struct dev_packet *item;
+	uint64_t samples;
+	gint depth, max;
+	int ret;
+
+	dts = dt->owner;
+	ret = sr_packet_copy(packet, &copy);
+	if (ret != SR_OK)
+		return ret;
+	item = g_malloc(sizeof(*item));
+	item->packet = copy;
+	item->sent = sent;
+	item->bytes = packet_payload_size(packet, &samples);
+
+	if (g_atomic_int_get(&dt->depth) >= (gint)dts->queue_size) {
+		g_mutex_lock(&dt->mutex);
+		g_atomic_int_inc(&dt->blocked);
+		while (g_atomic_int_get(&dt->depth) >= (gint)dts->queue_size)
+			g_cond_wait(&dt->cond, &dt->mutex);
+		g_atomic_int_add(&dt->blocked, -1);
+		g_mutex_unlock(&dt->mutex);
+	}
+	depth = g_atomic_int_add(&dt->depth, 1) + 1;
+	while ((max = g_atomic_int_get(&dt->depth_max)) < depth
+			&& !g_atomic_int_compare_and_exchange(&dt->depth_max,
+				max, depth))
+		;
+
+	mpsc_push(&dt->queue, &item->node);
+	g_atomic_int_inc(&dts->pending);
+	if (g_atomic_int_get(&dts->sleeping)) {
+		g_mutex_lock(&dts->mutex);
+		g_cond_signal(&dts->cond);
+		g_mutex_unlock(&dts->mutex);
+	}
+
+	return SR_OK;
+}
+
+static void dev_thread_deliver(struct dev_thread *dt, struct dev_packet *item)
+{
+	uint64_t latency;
+
+	g_atomic_int_add(&dt->depth, -1);
+	if (g_atomic_int_get(&dt->blocked)) {
+		g_mutex_lock(&dt->mutex);
+		g_cond_broadcast(&dt->cond);
+		g_mutex_unlock(&dt->mutex);
+	}
+
+	session_error_defer(dt->sdi,
+		session_deliver(dt->sdi, item->packet, item->sent));
+
+	latency = g_get_monotonic_time() - item->sent;
+	g_mutex_lock(&dt->mutex);
+	dt->stats.packets++;
+	dt->stats.latency_total += latency;
+	if (dt->stats.latency_max < latency)
+		dt->stats.latency_max = latency;
+	g_mutex_unlock(&dt->mutex);
+
+	sr_packet_free(item->packet);
+	g_free(item);
+	g_atomic_int_add(&dt->owner->pending, -1);
+}
+
+/* Pick the device whose packet gets delivered next, NULL if none is queued. */
+static struct dev_thread *dispatch_next(struct session_dev_threads *dts)
+{
+	struct dev_thread *dt, *oldest;
+	GSList *l;
+
+	oldest = NULL;
+	for (l = dts->threads; l; l = l->next) {
+		dt = l->data;
+		if (!dt->next)
+			dt->next = (struct dev_packet *)mpsc_pop(&dt->queue);
+		if (dt->next && (!oldest || dt->next->sent < oldest->next->sent))
+			oldest = dt;
+	}
+	if (!oldest || dts->policy == SR_DEV_THREAD_OLDEST_FIRST)
+		return oldest;
+
+	/* At least one device has a packet, so this terminates. */
+	for (;;) {
+		dt = dts->turn->data;
+		if (dts->policy == SR_DEV_THREAD_ROUND_ROBIN) {
+			dts->turn = dts->turn->next ? dts->turn->next : dts->threads;
+			if (dt->next)
+				return dt;
+			continue;
+		}
+		/* Deficit round robin: serve a device while its credit lasts. */
+		if (dt->next && dt->next->bytes <= dt->deficit) {
+			dt->deficit -= dt->next->bytes;
+			return dt;
+		}
+		if (!dt->next)
+			dt->deficit = 0;
+		dts->turn = dts->turn->next ? dts->turn->next : dts->threads;
+		dt = dts->turn->data;
+		if (dt->next)
+			dt->deficit += DEV_THREAD_QUANTUM;
+	}
+}
+
+static gpointer dev_threads_dispatch(gpointer data)
+{
+	struct session_dev_threads *dts;
+	struct dev_thread *dt;
+	struct dev_packet *item;
+
+	dts = data;
+	for (;;) {
+		if ((dt = dispatch_next(dts))) {
+			item = dt->next;
+			dt->next = NULL;
+			dev_thread_deliver(dt, item);
+			continue;
+		}
+		/* The device threads are gone, nothing can be in flight. */
+		if (g_atomic_int_get(&dts->quit))
+			break;
+		g_mutex_lock(&dts->mutex);
+		g_atomic_int_set(&dts->sleeping, 1);
+		while (g_atomic_int_get(&dts->pending) <= 0
+				&& !g_atomic_int_get(&dts->quit))
+			g_cond_wait(&dts->cond, &dts->mutex);
+		g_atomic_int_set(&dts->sleeping, 0);
+		g_mutex_unlock(&dts->mutex);
+	}
+
+	return NULL;
+}
+
+static gpointer dev_thread_run(gpointer data)
+{
+	struct dev_thread *dt;
+
+	dt = data;
+	g_private_set(&current_dev_thread, dt);
+	g_main_context_push_thread_default(dt->context);
+	g_main_loop_run(dt->loop);
+	g_main_context_pop_thread_default(dt->context);
+	g_private_set(&current_dev_thread, NULL);
+
+	return NULL;
+}
+
+/*
+ * Have a device's thread run a function. Unlike g_main_context_invoke(),
+ * this never runs the function on the calling thread.
+ */
+static void dev_thread_invoke(struct dev_thread *dt, GSourceFunc func)
+{
+	GSource *source;
+
+	/* Same priority as g_main_context_invoke(), ahead of idle sources. */
+	source = g_idle_source_new();
+	g_source_set_priority(source, G_PRIORITY_DEFAULT);
+	g_source_set_callback(source, func, dt, NULL);
+	g_source_attach(source, dt->context);
+	g_source_unref(source);
+}
+
+struct dev_thread_call {
+	struct dev_thread *dt;
+	int (*func)(struct sr_dev_inst *sdi);
+	int ret;
+	gboolean done;
+};
+
+static gboolean dev_thread_call_cb(gpointer data)
+{
+	struct dev_thread_call *call;
+	struct dev_thread *dt;
+	int ret;
+
+	call = data;
+	dt = call->dt;
+	ret = call->func(dt->sdi);
+	g_mutex_lock(&dt->mutex);
+	call->ret = ret;
+	call->done = TRUE;
+	g_cond_broadcast(&dt->cond);
+	g_mutex_unlock(&dt->mutex);
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Run a driver function on a device's thread, and wait for its result. */
+static int dev_thread_call(struct dev_thread *dt,
+		int (*func)(struct sr_dev_inst *sdi))
+{
+	struct dev_thread_call call;
+	GSource *source;
+
+	call.dt = dt;
+	call.func = func;
+	call.done = FALSE;
+	source = g_idle_source_new();
+	g_source_set_priority(source, G_PRIORITY_DEFAULT);
+	g_source_set_callback(source, dev_thread_call_cb, &call, NULL);
+	g_source_attach(source, dt->context);
+	g_source_unref(source);
+
+	g_mutex_lock(&dt->mutex);
+	while (!call.done)
+		g_cond_wait(&dt->cond, &dt->mutex);
+	g_mutex_unlock(&dt->mutex);
+
+	return call.ret;
+}
+
+static gboolean dev_thread_stop_cb(gpointer data)
+{
+	struct dev_thread *dt;
+
+	dt = data;
+	sr_dev_acquisition_stop(dt->sdi);
+
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean dev_thread_quit_cb(gpointer data)
+{
+	struct dev_thread *dt;
+
+	dt = data;
+	g_main_loop_quit(dt->loop);
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Start a thread per device and the dispatcher, if the session uses them. */
+static void dev_threads_start(struct sr_session *session)
+{
+	struct session_dev_threads *dts;
+	struct dev_thread *dt, *usb_dt;
+	GSList *l;
+	unsigned int num_threads;
+
+	dev_threads_free(session);
+	if (!session->dev_threads_enabled)
+		return;
+
+	dts = g_malloc0(sizeof(*dts));
+	dts->session = session;
+	dts->policy = session->dev_threads_policy;
+	dts->queue_size = session->dev_threads_queue_size;
+	dts->by_dev = g_hash_table_new(NULL, NULL);
+	g_mutex_init(&dts->mutex);
+	g_cond_init(&dts->cond);
+	usb_dt = NULL;
+	for (l = session->devs; l; l = l->next) {
+		dt = g_malloc0(sizeof(*dt));
+		dt->owner = dts;
+		dt->sdi = l->data;
+		/*
+		 * The events of all libusb devices get handled on one libusb
+		 * context, by whichever thread polls it, and that thread runs
+		 * the transfer callbacks of all of them. So USB devices share
+		 * one thread, which does nothing but their acquisitions.
+		 */
+		if (dt->sdi->inst_type == SR_INST_USB && usb_dt) {
+			dt->context = g_main_context_ref(usb_dt->context);
+			dt->loop = g_main_loop_ref(usb_dt->loop);
+		} else {
+			dt->context = g_main_context_new();
+			dt->loop = g_main_loop_new(dt->context, FALSE);
+			if (dt->sdi->inst_type == SR_INST_USB)
+				usb_dt = dt;
+		}
+		dt->event_sources = g_hash_table_new(NULL, NULL);
+		mpsc_init(&dt->queue);
+		g_mutex_init(&dt->mutex);
+		g_cond_init(&dt->cond);
+		dts->threads = g_slist_append(dts->threads, dt);
+		g_hash_table_insert(dts->by_dev, dt->sdi, dt);
+	}
+	dts->turn = dts->threads;
+	session->dev_threads = dts;
+
+	num_threads = 0;
+	for (l = dts->threads; l; l = l->next) {
+		dt = l->data;
+		if (dt->sdi->inst_type == SR_INST_USB && dt != usb_dt) {
+			sr_dbg("Running %s device on the USB thread.",
+				dt->sdi->driver->name);
+			continue;
+		}
+		dt->thread = g_thread_new(dt == usb_dt ? "sr-usb" : "sr-device",
+			dev_thread_run, dt);
+		num_threads++;
+	}
+	dts->dispatcher = g_thread_new("sr-dispatch", dev_threads_dispatch, dts);
+	dts->active = TRUE;
+
+	sr_dbg("Running %u devices on %u threads, %zu packets per queue.",
+		g_slist_length(dts->threads), num_threads, dts->queue_size);
+}
+
+/* Terminate the device threads, then deliver their pending packets. */
+static void dev_threads_stop(struct sr_session *session)
+{
+	struct session_dev_threads *dts;
+	struct dev_thread *dt;
+	GSList *l;
+
+	dts = session->dev_threads;
+	if (!dts || !dts->active)
+		return;
+
+	for (l = dts->threads; l; l = l->next) {
+		dt = l->data;
+		if (dt->thread)
+			dev_thread_invoke(dt, dev_thread_quit_cb);
+	}
+	for (l = dts->threads; l; l = l->next) {
+		dt = l->data;
+		if (!dt->thread)
+			continue;
+		g_thread_join(dt->thread);
+		dt->thread = NULL;
+	}
+
+	g_mutex_lock(&dts->mutex);
+	g_atomic_int_set(&dts->quit, 1);
+	g_cond_signal(&dts->cond);
+	g_mutex_unlock(&dts->mutex);
+	g_thread_join(dts->dispatcher);
+	dts->dispatcher = NULL;
+	dts->active = FALSE;
+}
+
+static void dev_threads_free(struct sr_session *session)
+{
+	struct session_dev_threads *dts;
+	struct dev_thread *dt;
+	GSList *l;
+
+	dts = session->dev_threads;
+	if (!dts)
+		return;
+
+	dev_threads_stop(session);
+	/* Sources left behind by a failed start get finalized here. */
+	for (l = dts->threads; l; l = l->next) {
+		dt = l->data;
+		g_main_loop_unref(dt->loop);
+		g_main_context_unref(dt->context);
+	}
+	session->dev_threads = NULL;
+	for (l = dts->threads; l; l = l->next) {
+		dt = l->data;
+		g_hash_table_unref(dt->event_sources);
+		g_mutex_clear(&dt->mutex);
+		g_cond_clear(&dt->cond);
+		g_free(dt);
+	}
+	g_slist_free(dts->threads);
+	g_hash_table_unref(dts->by_dev);
+	g_mutex_clear(&dts->mutex);
+	g_cond_clear(&dts->cond);
+	g_free(dts);
+}
+
+/**
+ * Run the acquisition of each device of a session on its own thread.
+ *
+ * By default, the event sources of all devices are handled by the thread
+ * running the session, so one busy device delays all others. With device
+ * threads enabled, each device gets a thread with its own GLib main
+ * context, which starts and stops the acquisition and handles the event
+ * sources the driver adds. The packets of each device are passed to a
+ * dispatcher thread through a queue of their own, without taking a lock.
+ *
+ * The dispatcher runs the transform modules and datafeed callbacks, or
+ * hands the packets on to the pipeline (see sr_session_pipeline_set()).
+ * It takes turns between the devices as selected by @a policy, the
+ * packets of each device stay in order. When a device is @a queue_size
+ * packets ahead of the dispatcher, its sending thread blocks until the
+ * dispatcher caught up.
+ *
+ * Note that datafeed callbacks are invoked from the dispatcher thread.
+ * USB devices share one libusb context, whose events are handled by
+ * whichever thread polls it. So all USB devices of a session run on one
+ * thread of their own, which handles the libusb events and the transfers
+ * of all of them. Each of them still has its own queue.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param enable TRUE to run each device on its own thread.
+ * @param policy How the dispatcher takes turns between the devices.
+ * @param queue_size Maximum number of packets queued per device, 0 selects
+ *                   the default.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR The session is running.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_dev_threads_set(struct sr_session *session,
+		gboolean enable, enum sr_dev_thread_policy policy,
+		size_t queue_size)
+{
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+	if ((int)policy < 0 || policy > SR_DEV_THREAD_OLDEST_FIRST)
+		return SR_ERR_ARG;
+	if (queue_size > G_MAXINT)
+		return SR_ERR_ARG;
+	if (session->running) {
+		sr_err("Cannot change device threads while the session is running.");
+		return SR_ERR;
+	}
+
+	session->dev_threads_enabled = enable;
+	session->dev_threads_policy = policy;
+	session->dev_threads_queue_size = queue_size ? queue_size
+		: DEV_THREAD_QUEUE_SIZE_DEFAULT;
+
+	return SR_OK;
+}
+
+/**
+ * Get the counters of a device's packet queue.
+ *
+ * Latencies are measured from the time the device sent a packet until
+ * the dispatcher delivered it. May be called from any thread while the
+ * session runs. After the session stopped, the counters of the last run
+ * remain available.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param sdi The device instance. Must not be NULL.
+ * @param stats Receives the counters. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_NA The device never ran on its own thread.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_dev_queue_stats_get(struct sr_session *session,
+		const struct sr_dev_inst *sdi, struct sr_pipeline_stats *stats)
+{
+	struct dev_thread *dt;
+
+	if (!session || !sdi || !stats)
+		return SR_ERR_ARG;
+	if (!session->dev_threads)
+		return SR_ERR_NA;
+	dt = g_hash_table_lookup(session->dev_threads->by_dev, sdi);
+	if (!dt)
+		return SR_ERR_NA;
+
+	g_mutex_lock(&dt->mutex);
+	*stats = dt->stats;
+	g_mutex_unlock(&dt->mutex);
+	stats->queue_depth = g_atomic_int_get(&dt->depth);
+	stats->queue_depth_max = g_atomic_int_get(&dt->depth_max);
+
+	return SR_OK;
+}
+
+/**
+ * Get the time at which the packet being delivered was sent.
+ *
+ * To be called from a datafeed callback. The time is taken from the
+ * monotonic clock (see g_get_monotonic_time()) when the driver sent the
+ * packet, before it waited in any queue. This allows to relate packets
+ * of several devices in a session to each other.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param time Receives the time in microseconds. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_NA Not called from a datafeed callback of @a session.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_packet_time_get(struct sr_session *session,
+		int64_t *time)
+{
+	const struct delivery *delivery;
+
+	if (!session || !time)
+		return SR_ERR_ARG;
+
+	delivery = g_private_get(&current_delivery);
+	if (!delivery || delivery->session != session)
+		return SR_ERR_NA;
+	*time = delivery->sent;
+
+	return SR_OK;
+}
+
+/* Order by merge order, keep the order of packets with the same order. */
+static gint merge_item_compare(gconstpointer a, gconstpointer b,
+		gpointer data)
+{
+	const struct merge_item *ia, *ib;
+
+	(void)data;
+	ia = a;
+	ib = b;
+
+	if (ia->order != ib->order)
+		return (ia->order < ib->order) ? -1 : 1;
+
+	return 0;
+}
+
+/* Time of the next sample of a stream, in ns. */
+static int64_t stream_time(const struct stream_pos *pos, uint64_t samplerate)
+{
+	return pos->base + (pos->count / samplerate) * 1000000000
+		+ (pos->count % samplerate) * 1000000000 / samplerate;
+}
+
+static struct dev_timeline *dev_timeline_get(struct session_timeline *tl,
+		const struct sr_dev_inst *sdi)
+{
+	struct dev_timeline *dtl;
+
+	dtl = g_hash_table_lookup(tl->devs, sdi);
+	if (!dtl) {
+		dtl = g_malloc0(sizeof(*dtl));
+		dtl->streams = g_hash_table_new_full(NULL, NULL, NULL, g_free);
+		dtl->merge_last = INT64_MIN;
+		g_hash_table_insert(tl->devs, (void *)sdi, dtl);
+	}
+
+	return dtl;
+}
+
+static void dev_timeline_free(void *data)
+{
+	struct dev_timeline *dtl;
+
+	dtl = data;
+	g_hash_table_unref(dtl->streams);
+	g_free(dtl);
+}
+
+/* Rebase all streams of a device, so that the samplerate can change. */
+static void dev_timeline_rebase(struct dev_timeline *dtl, int64_t shift)
+{
+	GHashTableIter iter;
+	struct stream_pos *pos;
+	void *value;
+
+	g_hash_table_iter_init(&iter, dtl->streams);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		pos = value;
+		if (dtl->samplerate)
+			pos->base = stream_time(pos, dtl->samplerate);
+		pos->base += shift;
+		pos->count = 0;
+	}
+	dtl->start += shift;
+}
+
+/*
+ * The time up to which a device delivered all its streams. The merge
+ * stage doesn't expect packets of the device before that time anymore.
+ */
+static int64_t dev_timeline_horizon(const struct dev_timeline *dtl)
+{
+	GHashTableIter iter;
+	void *value;
+	int64_t horizon;
+
+	if (!dtl->samplerate || !dtl->primary)
+		return dtl->last;
+
+	horizon = INT64_MAX;
+	g_hash_table_iter_init(&iter, dtl->streams);
+	while (g_hash_table_iter_next(&iter, NULL, &value))
+		horizon = MIN(horizon, stream_time(value, dtl->samplerate));
+
+	return horizon;
+}
+
+static uint64_t dev_samplerate(const struct sr_dev_inst *sdi)
+{
+	GVariant *gvar;
+	uint64_t samplerate;
+
+	if (sr_config_get(sdi->driver, sdi, NULL, SR_CONF_SAMPLERATE,
+			&gvar) != SR_OK)
+		return 0;
+	samplerate = g_variant_get_uint64(gvar);
+	g_variant_unref(gvar);
+
+	return samplerate;
+}
+
+/* Shift the timestamps of a device's held back packets, keep them sorted. */
+static void merge_shift(struct session_timeline *tl,
+		struct dev_timeline *dtl, const struct sr_dev_inst *sdi,
+		int64_t shift)
+{
+	struct merge_item *item;
+	GList *l;
+
+	for (l = tl->pending.head; l; l = l->next) {
+		item = l->data;
+		if (item->sdi != sdi)
+			continue;
+		item->timestamp += shift;
+		item->order += shift;
+	}
+	if (dtl->merge_last != INT64_MIN)
+		dtl->merge_last += shift;
+	g_queue_sort(&tl->pending, merge_item_compare, NULL);
+}
+
+/*
+ * Determine the timestamp of a packet: the time its first sample was
+ * taken, derived from the time the device sent SR_DF_HEADER plus the
+ * number of samples before it. For packets without samples, it's the
+ * time of the device's next sample. While the samplerate is unknown,
+ * the time the packet was sent is used instead.
+ */
+static int64_t timeline_stamp(struct session_timeline *tl,
+		const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, gint64 sent)
+{
+	const struct sr_datafeed_meta *meta;
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	const struct sr_config *src;
+	struct dev_timeline *dtl;
+	struct stream_pos *pos;
+	uint64_t samples, samplerate;
+	int64_t now, timestamp, shift;
+	void *key;
+	GSList *l;
+
+	dtl = dev_timeline_get(tl, sdi);
+	now = sent * 1000;
+	key = NULL;
+	samples = 0;
+
+	switch (packet->type) {
+	case SR_DF_HEADER:
+		g_hash_table_remove_all(dtl->streams);
+		dtl->primary = NULL;
+		dtl->start = now;
+		dtl->samplerate = dtl->start_samplerate;
+		dtl->triggered = dtl->ended = FALSE;
+		break;
+	case SR_DF_META:
+		meta = packet->payload;
+		for (l = meta->config; l; l = l->next) {
+			src = l->data;
+			if (src->key != SR_CONF_SAMPLERATE)
+				continue;
+			samplerate = g_variant_get_uint64(src->data);
+			dtl->start_samplerate = samplerate;
+			if (samplerate == dtl->samplerate)
+				continue;
+			dev_timeline_rebase(dtl, 0);
+			dtl->samplerate = samplerate;
+		}
+		break;
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		if (logic->unitsize)
+			samples = logic->length / logic->unitsize;
+		break;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		if (analog->meaning->channels)
+			key = analog->meaning->channels->data;
+		samples = analog->num_samples;
+		break;
+	case SR_DF_END:
+		dtl->ended = TRUE;
+		break;
+	default:
+		break;
+	}
+
+	if (packet->type == SR_DF_LOGIC || packet->type == SR_DF_ANALOG) {
+		pos = g_hash_table_lookup(dtl->streams, key);
+		if (!pos) {
+			/* All streams start at the beginning of the acquisition. */
+			pos = g_malloc0(sizeof(*pos));
+			pos->base = dtl->start;
+			g_hash_table_insert(dtl->streams, key, pos);
+		}
+		if (!dtl->primary)
+			dtl->primary = pos;
+	} else {
+		pos = dtl->primary;
+	}
+	if (!dtl->samplerate)
+		timestamp = now;
+	else if (pos)
+		timestamp = stream_time(pos, dtl->samplerate);
+	else
+		timestamp = dtl->start;
+	if (pos)
+		pos->count += samples;
+
+	if (packet->type == SR_DF_TRIGGER && tl->trigger_align
+			&& !dtl->triggered) {
+		/* Assume all devices saw the same event: move them together. */
+		dtl->triggered = TRUE;
+		if (!tl->have_trigger) {
+			tl->trigger = timestamp;
+			tl->have_trigger = TRUE;
+		} else if ((shift = tl->trigger - timestamp)) {
+			sr_dbg("Shifting %s timeline by %" PRId64 " ns.",
+				sdi->driver ? sdi->driver->name : "device", shift);
+			dev_timeline_rebase(dtl, shift);
+			merge_shift(tl, dtl, sdi, shift);
+			timestamp += shift;
+		}
+	}
+	dtl->last = timestamp;
+
+	return timestamp;
+}
+
+/* Insert in order. Packets mostly arrive in order, so start at the end. */
+static void merge_insert(struct session_timeline *tl, struct merge_item *item)
+{
+	GList *l;
+
+	for (l = tl->pending.tail; l; l = l->prev) {
+		if (merge_item_compare(l->data, item, NULL) <= 0)
+			break;
+	}
+	if (l)
+		g_queue_insert_after(&tl->pending, l, item);
+	else
+		g_queue_push_head(&tl->pending, item);
+}
+
+/*
+ * Take the packets which are due off the merge stage, in order. A packet
+ * is due once every device which is still running has delivered all its
+ * samples up to the packet's timestamp. Packets which were held back for
+ * longer than the window (in sample time) are released regardless.
+ */
+static GSList *merge_due(struct session_timeline *tl, gboolean flush)
+{
+	struct dev_timeline *dtl;
+	struct merge_item *item, *newest;
+	GSList *l, *due;
+	int64_t watermark;
+
+	watermark = INT64_MAX;
+	for (l = tl->session->devs; l; l = l->next) {
+		dtl = g_hash_table_lookup(tl->devs, l->data);
+		if (!dtl) {
+			/* Nothing from this device yet. */
+			watermark = INT64_MIN;
+			break;
+		}
+		if (!dtl->ended)
+			watermark = MIN(watermark, dev_timeline_horizon(dtl));
+	}
+
+	due = NULL;
+	while ((item = g_queue_peek_head(&tl->pending))) {
+		newest = g_queue_peek_tail(&tl->pending);
+		if (!flush && item->order > watermark
+				&& (uint64_t)(newest->order - item->order)
+					<= tl->window)
+			break;
+		due = g_slist_prepend(due, g_queue_pop_head(&tl->pending));
+	}
+
+	return g_slist_reverse(due);
+}
+
+static void merge_deliver(GSList *due)
+{
+	struct merge_item *item;
+	GSList *l;
+
+	for (l = due; l; l = l->next) {
+		item = l->data;
+		session_run_callbacks(item->sdi, item->packet, item->sent,
+			&item->timestamp);
+		sr_packet_free(item->packet);
+		g_free(item);
+	}
+	g_slist_free(due);
+}
+
+/*
+ * Pass a packet on to the datafeed callbacks, once it passed the
+ * transform modules. With timestamps enabled it gets its timestamp
+ * here, and the merge stage may hold it back for a while.
+ */
+static void session_emit(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, gint64 sent)
+{
+	struct session_timeline *tl;
+	struct dev_timeline *dtl;
+	struct merge_item *item;
+	struct sr_datafeed_packet *copy;
+	int64_t timestamp;
+	GSList *due;
+
+	tl = sdi->session->timeline;
+	if (!tl) {
+		session_run_callbacks(sdi, packet, sent, NULL);
+		return;
+	}
+
+	g_mutex_lock(&tl->mutex);
+	timestamp = timeline_stamp(tl, sdi, packet, sent);
+	if (!tl->window) {
+		g_mutex_unlock(&tl->mutex);
+		session_run_callbacks(sdi, packet, sent, &timestamp);
+		return;
+	}
+	/* The packet may only be valid until we return. */
+	if (sr_packet_copy(packet, &copy) != SR_OK) {
+		g_mutex_unlock(&tl->mutex);
+		return;
+	}
+	item = g_malloc(sizeof(*item));
+	item->sdi = sdi;
+	item->packet = copy;
+	item->sent = sent;
+	item->timestamp = timestamp;
+	dtl = dev_timeline_get(tl, sdi);
+	item->order = MAX(timestamp, dtl->merge_last);
+	dtl->merge_last = item->order;
+	merge_insert(tl, item);
+	due = merge_due(tl, FALSE);
+	g_mutex_unlock(&tl->mutex);
+
+	merge_deliver(due);
+}
+
+/*
+ * Take a device's samplerate before it starts. Once it runs, its driver
+ * may be busy on another thread, and SR_DF_META reports changes.
+ */
+static void timeline_dev_add(struct sr_session *session,
+		const struct sr_dev_inst *sdi)
+{
+	struct session_timeline *tl;
+	struct dev_timeline *dtl;
+	uint64_t samplerate;
+
+	if (!(tl = session->timeline))
+		return;
+
+	samplerate = dev_samplerate(sdi);
+	g_mutex_lock(&tl->mutex);
+	dtl = dev_timeline_get(tl, sdi);
+	dtl->start_samplerate = samplerate;
+	g_mutex_unlock(&tl->mutex);
+}
+
+static void timeline_start(struct sr_session *session)
+{
+	struct session_timeline *tl;
+	GSList *l;
+
+	timeline_free(session);
+	if (!session->timestamps_enabled && !session->merge_window)
+		return;
+
+	tl = g_malloc0(sizeof(*tl));
+	tl->session = session;
+	g_mutex_init(&tl->mutex);
+	tl->devs = g_hash_table_new_full(NULL, NULL, NULL, dev_timeline_free);
+	tl->trigger_align = session->timestamps_trigger_align;
+	tl->window = session->merge_window;
+	g_queue_init(&tl->pending);
+	session->timeline = tl;
+	for (l = session->devs; l; l = l->next)
+		timeline_dev_add(session, l->data);
+}
+
+/* Deliver what the merge stage still holds back. */
+static void timeline_stop(struct sr_session *session)
+{
+	struct session_timeline *tl;
+	GSList *due;
+
+	if (!(tl = session->timeline))
+		return;
+
+	g_mutex_lock(&tl->mutex);
+	due = merge_due(tl, TRUE);
+	g_mutex_unlock(&tl->mutex);
+	merge_deliver(due);
+}
+
+static void timeline_free(struct sr_session *session)
+{
+	struct session_timeline *tl;
+
+	if (!(tl = session->timeline))
+		return;
+
+	timeline_stop(session);
+	g_hash_table_unref(tl->devs);
+	g_mutex_clear(&tl->mutex);
+	g_free(tl);
+	session->timeline = NULL;
+}
+
+/**
+ * Put the packets of all devices of a session on a common timeline.
+ *
+ * Each packet gets a timestamp, the time its first sample was taken.
+ * It is derived from the time the device sent its SR_DF_HEADER packet,
+ * plus the number of samples before the packet divided by the device's
+ * samplerate. Packets without samples get the time of the device's next
+ * sample. The samplerate is the one configured when the device started,
+ * SR_DF_META packets of the device update it. While a device's samplerate
+ * is unknown, the time a packet was sent is used (see
+ * sr_session_packet_time_get()).
+ *
+ * When the devices are triggered by the same event, @a trigger_align
+ * refines the timelines: the first trigger of each device gets moved to
+ * the time of the first trigger of any device. This removes the error
+ * from the devices' different start latencies.
+ *
+ * Datafeed callbacks can query the timestamps with
+ * sr_session_packet_timestamp_get().
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param enable TRUE to enable timestamps.
+ * @param trigger_align TRUE to align the devices at their first trigger.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid session passed.
+ * @retval SR_ERR The session is running.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_timestamps_set(struct sr_session *session,
+		gboolean enable, gboolean trigger_align)
+{
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+	if (session->running) {
+		sr_err("Cannot change timestamps while the session is running.");
+		return SR_ERR;
+	}
+
+	session->timestamps_enabled = enable;
+	session->timestamps_trigger_align = trigger_align;
+
+	return SR_OK;
+}
+
+/**
+ * Deliver the packets of all devices of a session in time order.
+ *
+ * The merge stage sits in front of the datafeed callbacks. It holds back
+ * each packet until all devices which are still running have delivered
+ * their samples up to the packet's timestamp, so that the callbacks get
+ * the packets of all devices interleaved on one timeline. The packets of
+ * each device stay in order. A packet is held back at most until packets
+ * @a window ns (in sample time) younger have arrived, so a slow or
+ * stalled device can't hold up the others for longer than that.
+ *
+ * Enabling the merge stage implies timestamps, see
+ * sr_session_timestamps_set().
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param enable TRUE to enable the merge stage.
+ * @param window The reorder window in ns. Must not be 0 when enabling.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR The session is running.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_merge_set(struct sr_session *session,
+		gboolean enable, uint64_t window)
+{
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+	if (enable && (!window || window > INT64_MAX))
+		return SR_ERR_ARG;
+	if (session->running) {
+		sr_err("Cannot change the merge stage while the session is running.");
+		return SR_ERR;
+	}
+
+	session->merge_window = enable ? window : 0;
+
+	return SR_OK;
+}
+
+/**
+ * Get the timestamp of the packet being delivered.
+ *
+ * To be called from a datafeed callback, with timestamps enabled (see
+ * sr_session_timestamps_set()). The timestamp is the time the packet's
+ * first sample was taken on the session's common timeline, in ns on the
+ * scale of g_get_monotonic_time().
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param timestamp Receives the timestamp. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_NA Timestamps are disabled, or not called from a
+ *                   datafeed callback of @a session.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_packet_timestamp_get(struct sr_session *session,
+		int64_t *timestamp)
+{
+	const struct delivery *delivery;
+
+	if (!session || !timestamp)
+		return SR_ERR_ARG;
+
+	delivery = g_private_get(&current_delivery);
+	if (!delivery || delivery->session != session
+			|| !delivery->has_timestamp)
+		return SR_ERR_NA;
+	*timestamp = delivery->timestamp;
+
+	return SR_OK;
+}
+
+/**
+ * Helper to send a meta datafeed package (SR_DF_META) to the session bus.
+ *
+ * @param sdi The device instance to send the package from. Must not be NULL.
+ * @param key The config key to send to the session bus.
+ * @param var The value to send to the session bus.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @private
+ */
+SR_PRIV int sr_session_send_meta(const struct sr_dev_inst *sdi,
+		uint32_t key, GVariant *var)
+{
+	struct sr_config *cfg;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_meta meta;
+	int ret;
+
+	cfg = sr_config_new(key, var);
+
+	memset(&meta, 0, sizeof(meta));
+
+	packet.type = SR_DF_META;
+	packet.payload = &meta;
+
+	meta.config = g_slist_append(NULL, cfg);
+
+	ret = sr_session_send(sdi, &packet);
+	g_slist_free(meta.config);
+	sr_config_free(cfg);
+
+	return ret;
+}
+
+/**
+ * Send a packet to whatever is listening on the datafeed bus.
+ *
+ * Hardware drivers use this to send a data packet to the frontend.
+ *
+ * @param sdi TODO.
+ * @param packet The datafeed packet to send to the session bus.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval other Error of a transform module, for this packet, or for an
+ *         earlier one which got processed on a worker thread.
+ *
+ * @private
+ */
+SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet)
+{
+	struct dev_thread *dt;
+	gint64 sent;
+	int ret;
+
+	if (!sdi) {
+		sr_err("%s: sdi was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	if (!packet) {
+		sr_err("%s: packet was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	if (!sdi->session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_BUG;
+	}
+
+	/*
+	 * Report an error of an earlier packet which got processed on a
+	 * worker thread. The end of the stream still gets delivered.
+	 */
+	ret = g_atomic_int_get(&sdi->session->deferred_error);
+	if (ret != SR_OK && packet->type != SR_DF_END)
+		return ret;
+
+	if (sdi->session->stats_enabled)
+		dev_stats_add(sdi, packet);
+
+	sent = g_get_monotonic_time();
+	if ((dt = dev_thread_get(sdi->session, sdi)))
+		return dev_thread_send(dt, packet, sent);
+
+	return session_deliver(sdi, packet, sent);
 }
 
 /**
@@ -1213,11 +3374,17 @@ SR_PRIV int sr_session_source_add_internal(struct sr_session *session,
 	 * already installed source. (Well it would, if we did not have
 	 * another sanity check there.)
 	 */
-	if (g_hash_table_contains(session->event_sources, key)) {
+	GHashTable *table;
+
+	g_mutex_lock(&session->sources_mutex);
+	table = source_table(session);
+	if (g_hash_table_contains(table, key)) {
+		g_mutex_unlock(&session->sources_mutex);
 		sr_err("Event source with key %p already exists.", key);
 		return SR_ERR_BUG;
 	}
-	g_hash_table_insert(session->event_sources, key, source);
+	g_hash_table_insert(table, key, source);
+	g_mutex_unlock(&session->sources_mutex);
 
 	if (session_source_attach(session, source) == 0)
 		return SR_ERR;
@@ -1355,9 +3522,15 @@ SR_PRIV int sr_session_source_add_channel(struct sr_session *session,
 SR_PRIV int sr_session_source_remove_internal(struct sr_session *session,
 		void *key)
 {
+	GHashTable *table;
 	GSource *source;
 
-	source = g_hash_table_lookup(session->event_sources, key);
+	g_mutex_lock(&session->sources_mutex);
+	table = source_table_find(session, key, NULL);
+	source = table ? g_hash_table_lookup(table, key) : NULL;
+	if (source)
+		g_source_ref(source);
+	g_mutex_unlock(&session->sources_mutex);
 	/*
 	 * Trying to remove an already removed event source is problematic
 	 * since the poll_object handle may have been reused in the meantime.
@@ -1366,7 +3539,9 @@ SR_PRIV int sr_session_source_remove_internal(struct sr_session *session,
 		sr_warn("Cannot remove non-existing event source %p.", key);
 		return SR_ERR_BUG;
 	}
+	/* Finalizing the source takes the sources mutex. */
 	g_source_destroy(source);
+	g_source_unref(source);
 
 	return SR_OK;
 }
@@ -1452,25 +3627,30 @@ SR_PRIV int sr_session_source_remove_channel(struct sr_session *session,
 SR_PRIV int sr_session_source_destroyed(struct sr_session *session,
 		void *key, GSource *source)
 {
-	GSource *registered_source;
-
-	registered_source = g_hash_table_lookup(session->event_sources, key);
+	GHashTable *table;
+	gboolean registered;
+
+	g_mutex_lock(&session->sources_mutex);
+	table = source_table_find(session, key, source);
+	if (table)
+		g_hash_table_remove(table, key);
+	registered = table || source_table_find(session, key, NULL);
+	g_mutex_unlock(&session->sources_mutex);
 	/*
 	 * Trying to remove an already removed event source is problematic
 	 * since the poll_object handle may have been reused in the meantime.
 	 */
-	if (!registered_source) {
+	if (!registered) {
 		sr_err("No event source for key %p found.", key);
 		return SR_ERR_BUG;
 	}
-	if (registered_source != source) {
+	if (!table) {
 		sr_err("Event source for key %p does not match"
 			" destroyed source.", key);
 		return SR_ERR_BUG;
 	}
-	g_hash_table_remove(session->event_sources, key);
 
-	if (g_hash_table_size(session->event_sources) > 0)
+	if (sources_count(session) > 0)
 		return SR_OK;
 
 	/* If no event sources are left, consider the acquisition finished.
@@ -1507,6 +3687,7 @@ SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
 	struct sr_analog_meaning *meaning_copy;
 	struct sr_analog_spec *spec_copy;
 	uint8_t *payload;
+	size_t size;
 
 	*copy = g_malloc0(sizeof(struct sr_datafeed_packet));
 	(*copy)->type = packet->type;
@@ -1514,6 +3695,8 @@ SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
 	switch (packet->type) {
 	case SR_DF_TRIGGER:
 	case SR_DF_END:
+	case SR_DF_FRAME_BEGIN:
+	case SR_DF_FRAME_END:
 		/* No payload. */
 		break;
 	case SR_DF_HEADER:
@@ -1524,7 +3707,7 @@ SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
 	case SR_DF_META:
 		meta = packet->payload;
 		meta_copy = g_malloc0(sizeof(struct sr_datafeed_meta));
-		g_slist_foreach(meta->config, (GFunc)copy_src, meta_copy->config);
+		g_slist_foreach(meta->config, (GFunc)copy_src, meta_copy);
 		(*copy)->payload = meta_copy;
 		break;
 	case SR_DF_LOGIC:
@@ -1534,21 +3717,23 @@ SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
 			return SR_ERR;
 		logic_copy->length = logic->length;
 		logic_copy->unitsize = logic->unitsize;
-		logic_copy->data = g_malloc(logic->length * logic->unitsize);
+		/* The length is in bytes, not samples. */
+		logic_copy->data = g_malloc(logic->length);
 		if (!logic_copy->data) {
 			g_free(logic_copy);
 			return SR_ERR;
 		}
-		memcpy(logic_copy->data, logic->data, logic->length * logic->unitsize);
+		memcpy(logic_copy->data, logic->data, logic->length);
 		(*copy)->payload = logic_copy;
 		break;
 	case SR_DF_ANALOG:
 		analog = packet->payload;
 		analog_copy = g_malloc(sizeof(*analog_copy));
-		analog_copy->data = g_malloc(
-				analog->encoding->unitsize * analog->num_samples);
-		memcpy(analog_copy->data, analog->data,
-				analog->encoding->unitsize * analog->num_samples);
+		/* Samples of multiple channels are interleaved. */
+		size = analog->encoding->unitsize * analog->num_samples;
+		size *= MAX(g_slist_length(analog->meaning->channels), 1);
+		analog_copy->data = g_malloc(size);
+		memcpy(analog_copy->data, analog->data, size);
 		analog_copy->num_samples = analog->num_samples;
 #if GLIB_CHECK_VERSION(2, 67, 3)
 		encoding_copy = g_memdup2(analog->encoding, sizeof(*analog->encoding));
@@ -1585,6 +3770,8 @@ SR_API void sr_packet_free(struct sr_datafeed_packet *packet)
 	switch (packet->type) {
 	case SR_DF_TRIGGER:
 	case SR_DF_END:
+	case SR_DF_FRAME_BEGIN:
+	case SR_DF_FRAME_END:
 		/* No payload. */
 		break;
 	case SR_DF_HEADER:
@@ -50,6 +50,23 @@ struct session_vdev {
 	GArray *analog_channels;
 	int cur_chunk;
 	gboolean finished;
+	/* Replay of a single frame, see SR_CONF_CAPTURE_FRAME. */
+	uint64_t frame;
+	struct sr_frame_info frame_info;
+	gboolean stream_done;
+	uint64_t skip_bytes;
+	uint64_t remain_bytes;
+	uint64_t trigger_bytes;
+	/*
+	 * Analog chunks of newer session files are coded, see
+	 * sr_sessionfile_read_analog_header(). Positions within them are
+	 * still counted in bytes of float values.
+	 */
+	gboolean coded_analog;
+	struct sr_analog_chunk chunk;
+	uint32_t prev;
+	/* Decoded size of each coded analog chunk by name, for frame seeks. */
+	GHashTable *chunk_sizes;
 };
 
 static const uint32_t devopts[] = {
@@ -59,8 +76,259 @@ static const uint32_t devopts[] = {
 	SR_CONF_NUM_ANALOG_CHANNELS | SR_CONF_SET,
 	SR_CONF_SAMPLERATE | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_SESSIONFILE | SR_CONF_SET,
+	SR_CONF_CAPTURE_FRAME | SR_CONF_GET | SR_CONF_SET,
 };
 
+static gboolean capfile_coded(const struct session_vdev *vdev)
+{
+	return vdev->coded_analog && vdev->cur_analog_channel;
+}
+
+static int capfile_read_header(struct zip_file *zf,
+		struct sr_analog_chunk *chunk)
+{
+	uint8_t buf[SR_ANALOG_CHUNK_HEADER_SIZE];
+
+	if (zip_fread(zf, buf, sizeof(buf)) != sizeof(buf)) {
+		sr_err("Truncated analog chunk.");
+		return SR_ERR_DATA;
+	}
+
+	return sr_sessionfile_read_analog_header(chunk, buf);
+}
+
+/* Open a chunk of the current capture file. */
+static int capfile_open(struct session_vdev *vdev, const char *name)
+{
+	if (!(vdev->capfile = zip_fopen(vdev->archive, name, 0)))
+		return SR_ERR;
+	if (!capfile_coded(vdev))
+		return SR_OK;
+
+	vdev->prev = 0;
+	if (capfile_read_header(vdev->capfile, &vdev->chunk) != SR_OK) {
+		zip_fclose(vdev->capfile);
+		vdev->capfile = NULL;
+		return SR_ERR_DATA;
+	}
+
+	return SR_OK;
+}
+
+/*
+ * Read the header of each coded analog chunk once, when the archive is
+ * opened. Seeking to a frame takes the sizes of all chunks before it,
+ * for each analog channel.
+ */
+static int capfile_sizes_load(struct session_vdev *vdev)
+{
+	struct zip_file *zf;
+	struct sr_analog_chunk chunk;
+	const char *name;
+	int64_t *size;
+	zip_int64_t num_entries, i;
+	int ret;
+
+	vdev->chunk_sizes = g_hash_table_new_full(g_str_hash, g_str_equal,
+			g_free, g_free);
+	num_entries = zip_get_num_entries(vdev->archive, 0);
+	for (i = 0; i < num_entries; i++) {
+		name = zip_get_name(vdev->archive, i, 0);
+		if (!name || !g_str_has_prefix(name, "analog-"))
+			continue;
+		if (!(zf = zip_fopen_index(vdev->archive, i, 0)))
+			return SR_ERR;
+		ret = capfile_read_header(zf, &chunk);
+		zip_fclose(zf);
+		if (ret != SR_OK)
+			return ret;
+		size = g_malloc(sizeof(*size));
+		*size = chunk.num_samples * sizeof(float);
+		g_hash_table_insert(vdev->chunk_sizes, g_strdup(name), size);
+	}
+
+	return SR_OK;
+}
+
+/* Close the archive, and drop what was read from it. */
+static void archive_close(struct session_vdev *vdev)
+{
+	if (vdev->chunk_sizes) {
+		g_hash_table_destroy(vdev->chunk_sizes);
+		vdev->chunk_sizes = NULL;
+	}
+	if (vdev->archive) {
+		zip_discard(vdev->archive);
+		vdev->archive = NULL;
+	}
+}
+
+/* Get the size of a chunk of the current capture file, -1 if missing. */
+static int64_t capfile_size(struct session_vdev *vdev, const char *name)
+{
+	struct zip_stat zs;
+	const int64_t *size;
+
+	if (capfile_coded(vdev)) {
+		size = g_hash_table_lookup(vdev->chunk_sizes, name);
+		return size ? *size : -1;
+	}
+	if (zip_stat(vdev->archive, name, 0, &zs) == -1)
+		return -1;
+
+	return zs.size;
+}
+
+/* Undo the predictive coding of samples, in place. */
+static void capfile_decode(struct session_vdev *vdev, uint8_t *buf,
+		size_t count)
+{
+	uint32_t value;
+	float f;
+	size_t i;
+
+	switch (vdev->chunk.unitsize) {
+	case 1:
+		for (i = 0; i < count; i++) {
+			vdev->prev = (vdev->prev + buf[i]) & 0xff;
+			buf[i] = vdev->prev;
+		}
+		break;
+	case 2:
+		for (i = 0; i < count; i++, buf += 2) {
+			vdev->prev = (vdev->prev + read_u16le(buf)) & 0xffff;
+			write_u16le(buf, vdev->prev);
+		}
+		break;
+	default:
+		for (i = 0; i < count; i++, buf += 4) {
+			value = read_u32le(buf);
+			if (vdev->chunk.coding == SR_ANALOG_CODING_DELTA) {
+				vdev->prev += value;
+				write_u32le(buf, vdev->prev);
+			} else {
+				/* Floats get delivered in host byte order. */
+				vdev->prev ^= value;
+				memcpy(&f, &vdev->prev, sizeof(f));
+				memcpy(buf, &f, sizeof(f));
+			}
+		}
+		break;
+	}
+}
+
+/*
+ * Read from the current chunk of the capture file. Coded analog data
+ * gets decoded, @a size and the result then count bytes of float values,
+ * while @a buf receives the samples in the chunk's unitsize.
+ */
+static zip_int64_t capfile_read(struct session_vdev *vdev, void *buf,
+		uint64_t size)
+{
+	zip_int64_t ret;
+	uint64_t count;
+	unsigned int unitsize;
+
+	if (!capfile_coded(vdev))
+		return zip_fread(vdev->capfile, buf, size);
+
+	unitsize = vdev->chunk.unitsize;
+	count = MIN(size / sizeof(float), CHUNKSIZE / unitsize);
+	ret = zip_fread(vdev->capfile, buf, count * unitsize);
+	if (ret <= 0)
+		return ret;
+	if (ret % unitsize)
+		sr_warn("Truncated analog chunk, dropping %d bytes.",
+			(int)(ret % unitsize));
+	count = ret / unitsize;
+	capfile_decode(vdev, buf, count);
+
+	return count * sizeof(float);
+}
+
+/*
+ * Open the chunk of the current capture file which holds the start of
+ * the selected frame, and set up how many bytes to skip and to deliver.
+ * Earlier chunks are neither opened nor decompressed, the chunk sizes
+ * are taken from the archive directory. Those of coded analog chunks
+ * were read from their headers when the archive was opened.
+ */
+static int frame_seek(struct session_vdev *vdev)
+{
+	uint64_t offset, length, unitsize;
+	int64_t size;
+	char *name;
+	gboolean trigger_stream;
+	int chunk;
+
+	if (vdev->cur_analog_channel) {
+		unitsize = sizeof(float);
+		offset = vdev->frame_info.analog_offset * unitsize;
+		length = vdev->frame_info.analog_samples * unitsize;
+		trigger_stream = vdev->cur_analog_channel == 1;
+	} else {
+		unitsize = vdev->unitsize;
+		offset = vdev->frame_info.logic_offset * unitsize;
+		length = vdev->frame_info.logic_samples * unitsize;
+		trigger_stream = !vdev->num_analog_channels;
+	}
+	vdev->remain_bytes = length;
+	vdev->trigger_bytes = UINT64_MAX;
+	if (trigger_stream && vdev->frame_info.trigger_offset >= 0)
+		vdev->trigger_bytes = vdev->frame_info.trigger_offset * unitsize;
+
+	/* Find the chunk which holds the first byte of the frame. */
+	chunk = 0;
+	name = g_strdup(vdev->capturefile);
+	size = capfile_size(vdev, name);
+	if (size < 0) {
+		g_free(name);
+		name = g_strdup_printf("%s-%d", vdev->capturefile, ++chunk);
+		size = capfile_size(vdev, name);
+	}
+	while (length && size >= 0) {
+		if (offset < (uint64_t)size)
+			break;
+		offset -= size;
+		g_free(name);
+		name = g_strdup_printf("%s-%d", vdev->capturefile, ++chunk);
+		size = capfile_size(vdev, name);
+	}
+	if (!length || size < 0) {
+		/* Nothing of this frame in this capture file. */
+		g_free(name);
+		vdev->cur_chunk = MAX(chunk, 1);
+		vdev->stream_done = TRUE;
+		return SR_OK;
+	}
+
+	if (capfile_open(vdev, name) != SR_OK) {
+		g_free(name);
+		return SR_ERR;
+	}
+	sr_dbg("Opened %s, frame starts at byte %" PRIu64 ".", name, offset);
+	g_free(name);
+	vdev->cur_chunk = chunk;
+	vdev->skip_bytes = offset;
+
+	return SR_OK;
+}
+
+/* Read and drop the data of the current chunk before the frame. */
+static gboolean frame_skip(struct session_vdev *vdev, void *buf)
+{
+	zip_int64_t ret;
+
+	while (vdev->skip_bytes) {
+		ret = capfile_read(vdev, buf, MIN(vdev->skip_bytes, CHUNKSIZE));
+		if (ret <= 0)
+			return FALSE;
+		vdev->skip_bytes -= ret;
+	}
+
+	return TRUE;
+}
+
 static gboolean stream_session_data(struct sr_dev_inst *sdi)
 {
 	struct session_vdev *vdev;
@@ -73,6 +341,7 @@ static gboolean stream_session_data(struct sr_dev_inst *sdi)
 	struct zip_stat zs;
 	int ret, got_data;
 	char capturefile[128];
+	uint64_t size;
 	void *buf;
 
 	got_data = FALSE;
@@ -81,13 +350,18 @@ static gboolean stream_session_data(struct sr_dev_inst *sdi)
 	if (!vdev->capfile) {
 		/* No capture file opened yet, or finished with the last
 		 * chunked one. */
-		if (vdev->capturefile && (vdev->cur_chunk == 0)) {
+		if (vdev->frame && vdev->capturefile && (vdev->cur_chunk == 0)
+				&& !vdev->stream_done) {
+			if (frame_seek(vdev) != SR_OK)
+				return FALSE;
+			if (!vdev->capfile)
+				return TRUE;
+		} else if (!vdev->frame && vdev->capturefile && (vdev->cur_chunk == 0)) {
 			/* capturefile is always the unchunked base name. */
 			if (zip_stat(vdev->archive, vdev->capturefile, 0, &zs) != -1) {
 				/* No chunks, just a single capture file. */
 				vdev->cur_chunk = 0;
-				if (!(vdev->capfile = zip_fopen(vdev->archive,
-						vdev->capturefile, 0)))
+				if (capfile_open(vdev, vdev->capturefile) != SR_OK)
 					return FALSE;
 				sr_dbg("Opened %s.", vdev->capturefile);
 			} else {
@@ -95,8 +369,7 @@ static gboolean stream_session_data(struct sr_dev_inst *sdi)
 				snprintf(capturefile, sizeof(capturefile) - 1, "%s-1", vdev->capturefile);
 				if (zip_stat(vdev->archive, capturefile, 0, &zs) != -1) {
 					vdev->cur_chunk = 1;
-					if (!(vdev->capfile = zip_fopen(vdev->archive,
-							capturefile, 0)))
+					if (capfile_open(vdev, capturefile) != SR_OK)
 						return FALSE;
 					sr_dbg("Opened %s.", capturefile);
 				} else {
@@ -110,9 +383,9 @@ static gboolean stream_session_data(struct sr_dev_inst *sdi)
 			vdev->cur_chunk++;
 			snprintf(capturefile, sizeof(capturefile) - 1, "%s-%d", vdev->capturefile,
 					vdev->cur_chunk);
-			if (zip_stat(vdev->archive, capturefile, 0, &zs) != -1) {
-				if (!(vdev->capfile = zip_fopen(vdev->archive,
-						capturefile, 0)))
+			if (!vdev->stream_done &&
+					zip_stat(vdev->archive, capturefile, 0, &zs) != -1) {
+				if (capfile_open(vdev, capturefile) != SR_OK)
 					return FALSE;
 				sr_dbg("Opened %s.", capturefile);
 			} else if (vdev->cur_analog_channel < vdev->num_analog_channels) {
@@ -120,6 +393,7 @@ static gboolean stream_session_data(struct sr_dev_inst *sdi)
 						vdev->num_logic_channels + vdev->cur_analog_channel + 1);
 				vdev->cur_analog_channel++;
 				vdev->cur_chunk = 0;
+				vdev->stream_done = FALSE;
 				return TRUE;
 			} else {
 				/* We got all the chunks, finish up. */
@@ -144,12 +418,35 @@ static gboolean stream_session_data(struct sr_dev_inst *sdi)
 
 	/* unitsize is not defined for purely analog session files. */
 	if (vdev->unitsize)
-		ret = zip_fread(vdev->capfile, buf,
-				CHUNKSIZE / vdev->unitsize * vdev->unitsize);
+		size = CHUNKSIZE / vdev->unitsize * vdev->unitsize;
 	else
-		ret = zip_fread(vdev->capfile, buf, CHUNKSIZE);
+		size = CHUNKSIZE;
+	if (vdev->frame) {
+		/* Stop at the end of the frame, and at its trigger. */
+		size = MIN(size, vdev->remain_bytes);
+		if (vdev->trigger_bytes)
+			size = MIN(size, vdev->trigger_bytes);
+	}
+
+	if (vdev->frame && !vdev->trigger_bytes) {
+		std_session_send_df_trigger(sdi);
+		vdev->trigger_bytes = UINT64_MAX;
+		ret = 1;
+		got_data = TRUE;
+	} else if (vdev->frame && !frame_skip(vdev, buf)) {
+		ret = 0;
+	} else {
+		ret = size ? capfile_read(vdev, buf, size) : 0;
+	}
 
-	if (ret > 0) {
+	if (got_data) {
+		/* Sent the trigger, the data follows. */
+	} else if (ret > 0) {
+		if (vdev->frame) {
+			vdev->remain_bytes -= ret;
+			if (vdev->trigger_bytes != UINT64_MAX)
+				vdev->trigger_bytes -= ret;
+		}
 		if (vdev->cur_analog_channel != 0) {
 			got_data = TRUE;
 			packet.type = SR_DF_ANALOG;
@@ -164,6 +461,16 @@ static gboolean stream_session_data(struct sr_dev_inst *sdi)
 			analog.meaning->unit = SR_UNIT_VOLT;
 			analog.meaning->mqflags = SR_MQFLAG_DC;
 			analog.data = (float *) buf;
+			if (capfile_coded(vdev)
+					&& vdev->chunk.coding == SR_ANALOG_CODING_DELTA) {
+				/* The values as they were acquired. */
+				encoding.unitsize = vdev->chunk.unitsize;
+				encoding.is_signed = vdev->chunk.is_signed;
+				encoding.is_float = FALSE;
+				encoding.is_bigendian = FALSE;
+				encoding.scale = vdev->chunk.scale;
+				encoding.offset = vdev->chunk.offset;
+			}
 		} else if (vdev->unitsize) {
 			got_data = TRUE;
 			if (ret % vdev->unitsize != 0)
@@ -189,7 +496,9 @@ static gboolean stream_session_data(struct sr_dev_inst *sdi)
 		/* done with this capture file */
 		zip_fclose(vdev->capfile);
 		vdev->capfile = NULL;
-		if (vdev->cur_chunk != 0) {
+		if (vdev->frame && (!vdev->remain_bytes || !vdev->cur_chunk))
+			vdev->stream_done = TRUE;
+		if (vdev->cur_chunk != 0 || vdev->stream_done) {
 			/* There might be more chunks, so don't fall through
 			 * to the SR_DF_END here. */
 			got_data = TRUE;
@@ -220,11 +529,10 @@ static int receive_data(int fd, int revents, void *cb_data)
 		zip_fclose(vdev->capfile);
 		vdev->capfile = NULL;
 	}
-	if (vdev->archive) {
-		zip_discard(vdev->archive);
-		vdev->archive = NULL;
-	}
+	archive_close(vdev);
 
+	if (vdev->frame)
+		std_session_send_df_frame_end(sdi);
 	std_session_send_df_end(sdi);
 
 	return G_SOURCE_REMOVE;
@@ -278,6 +586,9 @@ static int config_get(uint32_t key, GVariant **data,
 	case SR_CONF_CAPTURE_UNITSIZE:
 		*data = g_variant_new_uint64(vdev->unitsize);
 		break;
+	case SR_CONF_CAPTURE_FRAME:
+		*data = g_variant_new_uint64(vdev->frame);
+		break;
 	default:
 		return SR_ERR_NA;
 	}
@@ -318,6 +629,9 @@ static int config_set(uint32_t key, GVariant *data,
 	case SR_CONF_NUM_ANALOG_CHANNELS:
 		vdev->num_analog_channels = g_variant_get_int32(data);
 		break;
+	case SR_CONF_CAPTURE_FRAME:
+		vdev->frame = g_variant_get_uint64(data);
+		break;
 	default:
 		return SR_ERR_NA;
 	}
@@ -334,6 +648,9 @@ static int config_list(uint32_t key, GVariant **data,
 static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 {
 	struct session_vdev *vdev;
+	struct sr_frame_info *frames;
+	size_t num_frames;
+	uint64_t version;
 	int ret;
 	GSList *l;
 	struct sr_channel *ch;
@@ -350,6 +667,9 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	}
 	vdev->cur_chunk = 0;
 	vdev->finished = FALSE;
+	vdev->stream_done = FALSE;
+	vdev->skip_bytes = 0;
+	vdev->coded_analog = FALSE;
 
 	sr_info("Opening archive %s file %s", vdev->sessionfile,
 		vdev->capturefile);
@@ -359,8 +679,38 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 		       "zip error %d.", vdev->sessionfile, ret);
 		return SR_ERR;
 	}
+	if (sr_sessionfile_read_version(vdev->archive, &version) == SR_OK)
+		vdev->coded_analog = version >= SR_SESSIONFILE_VERSION_CODED_ANALOG;
+
+	if (vdev->frame) {
+		frames = NULL;
+		ret = sr_sessionfile_read_frames(vdev->archive, &frames, &num_frames);
+		if (ret == SR_ERR_NA)
+			sr_err("Session file '%s' has no frame index.",
+				vdev->sessionfile);
+		if (ret == SR_OK && vdev->frame > num_frames) {
+			sr_err("Frame %" PRIu64 " requested, session file has %zu.",
+				vdev->frame, num_frames);
+			ret = SR_ERR_ARG;
+		}
+		if (ret == SR_OK)
+			vdev->frame_info = frames[vdev->frame - 1];
+		g_free(frames);
+		if (ret == SR_OK && vdev->coded_analog) {
+			ret = capfile_sizes_load(vdev);
+			if (ret != SR_OK)
+				sr_err("Cannot read the analog chunks of '%s'.",
+					vdev->sessionfile);
+		}
+		if (ret != SR_OK) {
+			archive_close(vdev);
+			return ret;
+		}
+	}
 
 	std_session_send_df_header(sdi);
+	if (vdev->frame)
+		std_session_send_df_frame_begin(sdi);
 
 	/* freewheeling source */
 	sr_session_source_add(sdi->session, -1, 0, 0, receive_data, (void *)sdi);
@@ -111,15 +111,254 @@ SR_PRIV GKeyFile *sr_sessionfile_read_metadata(struct zip *archive,
 	return keyfile;
 }
 
+/*
+ * The "frames-1" archive member holds a struct sr_frame_info per frame,
+ * after a magic, a version and the number of frames. All numbers are
+ * little endian.
+ */
+#define FRAMES_MAGIC "SRFR"
+#define FRAMES_VERSION 1
+#define FRAMES_HEADER_SIZE (4 + 1 + 4)
+#define FRAME_RECORD_SIZE (6 * 8)
+
+/**
+ * Encode a frame index for the "frames-1" member of a session archive.
+ *
+ * @param[in] frames The frames.
+ * @param[in] num_frames The number of frames.
+ * @param[out] buf The encoded index, to be freed with g_free().
+ * @param[out] size The size of the encoded index.
+ *
+ * @private
+ */
+SR_PRIV void sr_sessionfile_write_frames(const struct sr_frame_info *frames,
+		size_t num_frames, uint8_t **buf, size_t *size)
+{
+	uint8_t *p;
+	size_t i;
+
+	*size = FRAMES_HEADER_SIZE + num_frames * FRAME_RECORD_SIZE;
+	*buf = p = g_malloc(*size);
+	memcpy(p, FRAMES_MAGIC, 4);
+	p += 4;
+	write_u8_inc(&p, FRAMES_VERSION);
+	write_u32le_inc(&p, num_frames);
+	for (i = 0; i < num_frames; i++) {
+		write_u64le_inc(&p, frames[i].timestamp);
+		write_u64le_inc(&p, frames[i].logic_offset);
+		write_u64le_inc(&p, frames[i].logic_samples);
+		write_u64le_inc(&p, frames[i].analog_offset);
+		write_u64le_inc(&p, frames[i].analog_samples);
+		write_u64le_inc(&p, frames[i].trigger_offset);
+	}
+}
+
+/**
+ * Read the frame index from a session archive.
+ *
+ * @param[in] archive An open ZIP archive.
+ * @param[out] frames The frames, to be freed with g_free().
+ * @param[out] num_frames The number of frames.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_NA The archive has no frame index.
+ * @retval SR_ERR_DATA Malformed frame index.
+ * @retval SR_ERR Read error.
+ *
+ * @private
+ */
+SR_PRIV int sr_sessionfile_read_frames(struct zip *archive,
+		struct sr_frame_info **frames, size_t *num_frames)
+{
+	struct zip_stat zs;
+	struct zip_file *zf;
+	const uint8_t *p;
+	uint8_t *buf;
+	zip_int64_t len;
+	uint32_t count, i;
+
+	if (zip_stat(archive, "frames-1", 0, &zs) < 0)
+		return SR_ERR_NA;
+	if (zs.size < FRAMES_HEADER_SIZE || zs.size > G_MAXINT) {
+		sr_err("Malformed frame index.");
+		return SR_ERR_DATA;
+	}
+
+	buf = g_malloc(zs.size);
+	if (!(zf = zip_fopen_index(archive, zs.index, 0))) {
+		sr_err("Failed to open frame index: %s", zip_strerror(archive));
+		g_free(buf);
+		return SR_ERR;
+	}
+	len = zip_fread(zf, buf, zs.size);
+	zip_fclose(zf);
+	if (len < 0 || (zip_uint64_t)len != zs.size) {
+		sr_err("Failed to read frame index.");
+		g_free(buf);
+		return SR_ERR;
+	}
+
+	p = buf;
+	if (memcmp(p, FRAMES_MAGIC, 4) != 0 || p[4] != FRAMES_VERSION) {
+		sr_err("Malformed or unsupported frame index.");
+		g_free(buf);
+		return SR_ERR_DATA;
+	}
+	p += 5;
+	count = read_u32le_inc(&p);
+	if ((zs.size - FRAMES_HEADER_SIZE) / FRAME_RECORD_SIZE != count) {
+		sr_err("Malformed frame index.");
+		g_free(buf);
+		return SR_ERR_DATA;
+	}
+
+	*frames = g_malloc0_n(MAX(count, 1), sizeof(**frames));
+	*num_frames = count;
+	for (i = 0; i < count; i++) {
+		(*frames)[i].timestamp = read_u64le_inc(&p);
+		(*frames)[i].logic_offset = read_u64le_inc(&p);
+		(*frames)[i].logic_samples = read_u64le_inc(&p);
+		(*frames)[i].analog_offset = read_u64le_inc(&p);
+		(*frames)[i].analog_samples = read_u64le_inc(&p);
+		(*frames)[i].trigger_offset = read_u64le_inc(&p);
+	}
+	g_free(buf);
+
+	return SR_OK;
+}
+
+/*
+ * Analog chunks of session files from version 3 on start with a header,
+ * which holds a magic, a version, the coding, the unitsize, flags, the
+ * scale and offset of the values, and the number of samples. All numbers
+ * are little endian.
+ */
+#define ANALOG_CHUNK_MAGIC "SRAC"
+#define ANALOG_CHUNK_VERSION 1
+#define ANALOG_CHUNK_SIGNED (1 << 0)
+
+/**
+ * Encode the header of a coded analog chunk.
+ *
+ * @param[in] chunk The chunk properties.
+ * @param[out] buf Receives SR_ANALOG_CHUNK_HEADER_SIZE bytes.
+ *
+ * @private
+ */
+SR_PRIV void sr_sessionfile_write_analog_header(
+		const struct sr_analog_chunk *chunk, uint8_t *buf)
+{
+	memcpy(buf, ANALOG_CHUNK_MAGIC, 4);
+	buf += 4;
+	write_u8_inc(&buf, ANALOG_CHUNK_VERSION);
+	write_u8_inc(&buf, chunk->coding);
+	write_u8_inc(&buf, chunk->unitsize);
+	write_u8_inc(&buf, chunk->is_signed ? ANALOG_CHUNK_SIGNED : 0);
+	write_u64le_inc(&buf, chunk->scale.p);
+	write_u64le_inc(&buf, chunk->scale.q);
+	write_u64le_inc(&buf, chunk->offset.p);
+	write_u64le_inc(&buf, chunk->offset.q);
+	write_u64le_inc(&buf, chunk->num_samples);
+}
+
+/**
+ * Decode the header of a coded analog chunk.
+ *
+ * @param[out] chunk The chunk properties.
+ * @param[in] buf SR_ANALOG_CHUNK_HEADER_SIZE bytes.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_DATA Malformed or unsupported header.
+ *
+ * @private
+ */
+SR_PRIV int sr_sessionfile_read_analog_header(struct sr_analog_chunk *chunk,
+		const uint8_t *buf)
+{
+	gboolean valid;
+
+	if (memcmp(buf, ANALOG_CHUNK_MAGIC, 4) != 0
+			|| buf[4] != ANALOG_CHUNK_VERSION) {
+		sr_err("Malformed or unsupported analog chunk.");
+		return SR_ERR_DATA;
+	}
+	buf += 5;
+	chunk->coding = read_u8_inc(&buf);
+	chunk->unitsize = read_u8_inc(&buf);
+	chunk->is_signed = (read_u8_inc(&buf) & ANALOG_CHUNK_SIGNED) != 0;
+	chunk->scale.p = read_u64le_inc(&buf);
+	chunk->scale.q = read_u64le_inc(&buf);
+	chunk->offset.p = read_u64le_inc(&buf);
+	chunk->offset.q = read_u64le_inc(&buf);
+	chunk->num_samples = read_u64le_inc(&buf);
+
+	switch (chunk->coding) {
+	case SR_ANALOG_CODING_DELTA:
+		valid = chunk->unitsize == 1 || chunk->unitsize == 2
+			|| chunk->unitsize == 4;
+		break;
+	case SR_ANALOG_CODING_XOR_FLOAT:
+		valid = chunk->unitsize == sizeof(float);
+		break;
+	default:
+		valid = FALSE;
+		break;
+	}
+	if (!valid) {
+		sr_err("Unsupported analog chunk coding %d, unitsize %d.",
+			chunk->coding, chunk->unitsize);
+		return SR_ERR_DATA;
+	}
+	if (!chunk->scale.q || !chunk->offset.q) {
+		sr_err("Malformed analog chunk.");
+		return SR_ERR_DATA;
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Read the format version of a session archive.
+ *
+ * @param[in] archive An open ZIP archive.
+ * @param[out] version The version.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR Not a session file, or read error.
+ *
+ * @private
+ */
+SR_PRIV int sr_sessionfile_read_version(struct zip *archive,
+		uint64_t *version)
+{
+	struct zip_file *zf;
+	int ret;
+	char s[11];
+
+	if (!(zf = zip_fopen(archive, "version", 0))) {
+		sr_dbg("Not a sigrok session file: no version found.");
+		return SR_ERR;
+	}
+	ret = zip_fread(zf, s, sizeof(s) - 1);
+	if (ret < 0) {
+		sr_err("Failed to read version file: %s",
+			zip_file_strerror(zf));
+		zip_fclose(zf);
+		return SR_ERR;
+	}
+	zip_fclose(zf);
+	s[ret] = '\0';
+	*version = g_ascii_strtoull(s, NULL, 10);
+
+	return SR_OK;
+}
+
 /** @private */
 SR_PRIV int sr_sessionfile_check(const char *filename)
 {
 	struct zip *archive;
-	struct zip_file *zf;
 	struct zip_stat zs;
 	uint64_t version;
-	int ret;
-	char s[11];
 
 	if (!filename)
 		return SR_ERR_ARG;
@@ -135,23 +374,11 @@ SR_PRIV int sr_sessionfile_check(const char *filename)
 		return SR_ERR;
 
 	/* check "version" */
-	if (!(zf = zip_fopen(archive, "version", 0))) {
-		sr_dbg("Not a sigrok session file: no version found.");
-		zip_discard(archive);
-		return SR_ERR;
-	}
-	ret = zip_fread(zf, s, sizeof(s) - 1);
-	if (ret < 0) {
-		sr_err("Failed to read version file: %s",
-			zip_file_strerror(zf));
-		zip_fclose(zf);
+	if (sr_sessionfile_read_version(archive, &version) != SR_OK) {
 		zip_discard(archive);
 		return SR_ERR;
 	}
-	zip_fclose(zf);
-	s[ret] = '\0';
-	version = g_ascii_strtoull(s, NULL, 10);
-	if (version == 0 || version > 2) {
+	if (version == 0 || version > SR_SESSIONFILE_VERSION_CODED_ANALOG) {
 		sr_dbg("Cannot handle sigrok session file version %" PRIu64 ".",
 			version);
 		zip_discard(archive);
@@ -393,4 +620,108 @@ SR_API int sr_session_load(struct sr_context *ctx, const char *filename,
 	return ret;
 }
 
+/**
+ * Load the edge index which was stored in a session file.
+ *
+ * The srzip output module stores an index of the logic channel
+ * transitions in the file, if its "edge_index" option was set.
+ *
+ * @param filename The name of the session file.
+ * @param[out] idx The edge index, to be freed with sr_edge_index_free().
+ *
+ * @retval SR_OK Success
+ * @retval SR_ERR_ARG Invalid argument
+ * @retval SR_ERR_NA The session file holds no edge index
+ * @retval SR_ERR_DATA Malformed edge index
+ * @retval SR_ERR This is not a session file
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_edge_index_load(const char *filename,
+		struct sr_edge_index **idx)
+{
+	struct zip *archive;
+	struct zip_file *zf;
+	struct zip_stat zs;
+	uint8_t *buf;
+	zip_int64_t len;
+	int ret;
+
+	if (!filename || !idx)
+		return SR_ERR_ARG;
+
+	if ((ret = sr_sessionfile_check(filename)) != SR_OK)
+		return ret;
+	if (!(archive = zip_open(filename, 0, NULL)))
+		return SR_ERR;
+
+	if (zip_stat(archive, "edges-1", 0, &zs) < 0) {
+		zip_discard(archive);
+		return SR_ERR_NA;
+	}
+	if (!(buf = g_try_malloc(zs.size))) {
+		sr_err("Edge index buffer allocation failed.");
+		zip_discard(archive);
+		return SR_ERR_MALLOC;
+	}
+	if (!(zf = zip_fopen_index(archive, zs.index, 0))) {
+		sr_err("Failed to open edge index: %s", zip_strerror(archive));
+		g_free(buf);
+		zip_discard(archive);
+		return SR_ERR;
+	}
+	len = zip_fread(zf, buf, zs.size);
+	zip_fclose(zf);
+	zip_discard(archive);
+	if (len < 0 || (zip_uint64_t)len != zs.size) {
+		sr_err("Failed to read edge index.");
+		g_free(buf);
+		return SR_ERR;
+	}
+
+	ret = sr_edge_index_deserialize(buf, zs.size, idx);
+	g_free(buf);
+
+	return ret;
+}
+
+/**
+ * Load the frame index of a session file.
+ *
+ * The srzip output module stores the position of each frame, when the
+ * acquisition device delivers its data in frames (segmented captures of
+ * oscilloscopes, for example). A single frame can be replayed by setting
+ * SR_CONF_CAPTURE_FRAME on the session file's device.
+ *
+ * @param filename The name of the session file.
+ * @param[out] frames The frames, to be freed with g_free().
+ * @param[out] num_frames The number of frames.
+ *
+ * @retval SR_OK Success
+ * @retval SR_ERR_ARG Invalid argument
+ * @retval SR_ERR_NA The session file holds no frame index
+ * @retval SR_ERR_DATA Malformed frame index
+ * @retval SR_ERR This is not a session file
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_frames_load(const char *filename,
+		struct sr_frame_info **frames, size_t *num_frames)
+{
+	struct zip *archive;
+	int ret;
+
+	if (!filename || !frames || !num_frames)
+		return SR_ERR_ARG;
+
+	if ((ret = sr_sessionfile_check(filename)) != SR_OK)
+		return ret;
+	if (!(archive = zip_open(filename, 0, NULL)))
+		return SR_ERR;
+	ret = sr_sessionfile_read_frames(archive, frames, num_frames);
+	zip_discard(archive);
+
+	return ret;
+}
+
 /** @} */
@@ -26,6 +26,29 @@
 #define LOG_PREFIX "soft-trigger"
 /** @endcond */
 
+/* Upper limit for the packets which send copies of referenced data. */
+#define PRE_TRIGGER_SCRATCH_SIZE	(64 * 1024)
+
+/*
+ * A slice of sample data, kept for the pre-trigger history. Either in
+ * the caller's 'bytes', or in the ring when 'bytes' is NULL.
+ */
+struct pre_trigger_chunk {
+	GBytes *bytes;
+	gsize offset;
+	gsize length;
+};
+
+static void pre_trigger_chunk_free(void *data)
+{
+	struct pre_trigger_chunk *chunk;
+
+	chunk = data;
+	if (chunk->bytes)
+		g_bytes_unref(chunk->bytes);
+	g_free(chunk);
+}
+
 SR_PRIV int logic_channel_unitsize(GSList *channels)
 {
 	int number = 0;
@@ -41,6 +64,57 @@ SR_PRIV int logic_channel_unitsize(GSList *channels)
 	return (number + 7) / 8;
 }
 
+/*
+ * Compile a single stage trigger to bit masks. Multi-stage triggers
+ * keep using the generic matcher only.
+ */
+static void prefilter_setup(struct soft_trigger_logic *stl)
+{
+	struct sr_trigger_stage *stage;
+	struct sr_trigger_match *match;
+	GSList *l;
+	uint64_t bit;
+
+	stl->prefilter = FALSE;
+	if (!stl->trigger || g_slist_length(stl->trigger->stages) != 1)
+		return;
+	if (stl->unitsize > (int)sizeof(uint64_t))
+		return;
+	stage = stl->trigger->stages->data;
+	if (!stage->matches)
+		return;
+
+	for (l = stage->matches; l; l = l->next) {
+		match = l->data;
+		if (!match->channel->enabled)
+			continue;
+		if (match->channel->index >= 64)
+			return;
+		bit = 1ULL << match->channel->index;
+		switch (match->match) {
+		case SR_TRIGGER_ZERO:
+			stl->level_mask |= bit;
+			break;
+		case SR_TRIGGER_ONE:
+			stl->level_mask |= bit;
+			stl->level_value |= bit;
+			break;
+		case SR_TRIGGER_RISING:
+			stl->rising_mask |= bit;
+			break;
+		case SR_TRIGGER_FALLING:
+			stl->falling_mask |= bit;
+			break;
+		case SR_TRIGGER_EDGE:
+			stl->edge_mask |= bit;
+			break;
+		default:
+			return;
+		}
+	}
+	stl->prefilter = TRUE;
+}
+
 SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
 		const struct sr_dev_inst *sdi, struct sr_trigger *trigger,
 		int pre_trigger_samples)
@@ -52,66 +126,108 @@ SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
 	stl->trigger = trigger;
 	stl->unitsize = logic_channel_unitsize(sdi->channels);
 	stl->prev_sample = g_malloc0(stl->unitsize);
-	stl->pre_trigger_size = stl->unitsize * pre_trigger_samples;
-	stl->pre_trigger_buffer = g_try_malloc(stl->pre_trigger_size);
-	if (pre_trigger_samples > 0 && !stl->pre_trigger_buffer) {
-		/*
-		 * Error out if g_try_malloc() failed (or was invoked as
-		 * g_try_malloc(0)) *and* more than 0 pretrigger samples
-		 * were requested.
-		 */
-		soft_trigger_logic_free(stl);
-		return NULL;
-	}
-	stl->pre_trigger_head = stl->pre_trigger_buffer;
+	stl->pre_trigger_size = stl->unitsize * MAX(pre_trigger_samples, 0);
+	stl->pre_trigger_chunks = g_queue_new();
 
-	if (stl->pre_trigger_size > 0 && !stl->pre_trigger_buffer) {
-		soft_trigger_logic_free(stl);
-		return NULL;
-	}
+	prefilter_setup(stl);
 
 	return stl;
 }
 
 SR_PRIV void soft_trigger_logic_free(struct soft_trigger_logic *stl)
 {
-	g_free(stl->pre_trigger_buffer);
+	g_queue_free_full(stl->pre_trigger_chunks, pre_trigger_chunk_free);
+	g_free(stl->pre_trigger_ring);
+	g_free(stl->pre_trigger_scratch);
 	g_free(stl->prev_sample);
 	g_free(stl);
 }
 
+static void pre_trigger_chunk_add(struct soft_trigger_logic *stl,
+		GBytes *bytes, gsize offset, gsize length)
+{
+	struct pre_trigger_chunk *chunk;
+
+	chunk = g_malloc(sizeof(*chunk));
+	chunk->bytes = bytes ? g_bytes_ref(bytes) : NULL;
+	chunk->offset = offset;
+	chunk->length = length;
+	g_queue_push_tail(stl->pre_trigger_chunks, chunk);
+	stl->pre_trigger_fill += length;
+}
+
+/*
+ * Add data to the pre-trigger history. When the data is part of 'bytes',
+ * only a reference gets taken. Otherwise the data must be copied, since
+ * the caller is free to reuse its buffer. Copies go to a ring, which
+ * gets allocated once. The history never exceeds the ring's size, the
+ * oldest data in the ring which gets overwritten here always is data
+ * which gets dropped from the history below.
+ */
 static void pre_trigger_append(struct soft_trigger_logic *stl,
-		uint8_t *buf, int len)
+		uint8_t *buf, int len, GBytes *bytes)
 {
-	/* Avoid uselessly copying more than the pre-trigger size. */
+	struct pre_trigger_chunk *chunk;
+	const uint8_t *base;
+	int excess, part;
+
+	/* Avoid uselessly keeping more than the pre-trigger size. */
 	if (len > stl->pre_trigger_size) {
 		buf += len - stl->pre_trigger_size;
 		len = stl->pre_trigger_size;
 	}
+	if (len <= 0)
+		return;
+
+	if (bytes) {
+		base = g_bytes_get_data(bytes, NULL);
+		pre_trigger_chunk_add(stl, bytes, buf - base, len);
+	} else {
+		if (!stl->pre_trigger_ring)
+			stl->pre_trigger_ring = g_malloc(stl->pre_trigger_size);
+		while (len > 0) {
+			if (stl->pre_trigger_ring_pos == stl->pre_trigger_size)
+				stl->pre_trigger_ring_pos = 0;
+			part = MIN(len, stl->pre_trigger_size
+				- stl->pre_trigger_ring_pos);
+			memcpy(stl->pre_trigger_ring + stl->pre_trigger_ring_pos,
+				buf, part);
+			pre_trigger_chunk_add(stl, NULL,
+				stl->pre_trigger_ring_pos, part);
+			stl->pre_trigger_ring_pos += part;
+			buf += part;
+			len -= part;
+		}
+	}
 
-	/* Update the filling level of the pre-trigger circular buffer. */
-	stl->pre_trigger_fill = MIN(stl->pre_trigger_fill + len,
-	                            stl->pre_trigger_size);
-
-	/* Actually copy data to the pre-trigger circular buffer. */
-	while (len > 0) {
-		size_t size = MIN(stl->pre_trigger_buffer + stl->pre_trigger_size
-		                  - stl->pre_trigger_head, len);
-		memcpy(stl->pre_trigger_head, buf, size);
-		stl->pre_trigger_head += size;
-		if (stl->pre_trigger_head >= stl->pre_trigger_buffer
-		                             + stl->pre_trigger_size)
-			stl->pre_trigger_head = stl->pre_trigger_buffer;
-		buf += size;
-		len -= size;
+	/* Drop the oldest data which doesn't fit anymore. */
+	while (stl->pre_trigger_fill > stl->pre_trigger_size) {
+		chunk = g_queue_peek_head(stl->pre_trigger_chunks);
+		excess = stl->pre_trigger_fill - stl->pre_trigger_size;
+		if ((gsize)excess < chunk->length) {
+			chunk->offset += excess;
+			chunk->length -= excess;
+			stl->pre_trigger_fill -= excess;
+			break;
+		}
+		stl->pre_trigger_fill -= chunk->length;
+		pre_trigger_chunk_free(g_queue_pop_head(stl->pre_trigger_chunks));
 	}
 }
 
+/*
+ * Send the pre-trigger history, oldest first. Transform modules may
+ * modify the sent data in place. Referenced data is still in use by
+ * the caller, so copies of it get sent.
+ */
 static void pre_trigger_send(struct soft_trigger_logic *stl,
 		int *pre_trigger_samples)
 {
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
+	struct pre_trigger_chunk *chunk;
+	const uint8_t *base;
+	gsize done, scratch_size;
 
 	packet.type = SR_DF_LOGIC;
 	packet.payload = &logic;
@@ -120,22 +236,32 @@ static void pre_trigger_send(struct soft_trigger_logic *stl,
 	if (pre_trigger_samples)
 		*pre_trigger_samples = 0;
 
-	/* If pre-trigger buffer not full, rewind head to the first valid sample. */
-	if (stl->pre_trigger_fill < stl->pre_trigger_size)
-		stl->pre_trigger_head = stl->pre_trigger_buffer;
-
-	/* Send logic packets for the pre-trigger circular buffer content. */
-	while (stl->pre_trigger_fill > 0) {
-		size_t size = MIN(stl->pre_trigger_buffer + stl->pre_trigger_size
-		                  - stl->pre_trigger_head, stl->pre_trigger_fill);
-		logic.length = size;
-		logic.data = stl->pre_trigger_head;
-		sr_session_send(stl->sdi, &packet);
-		stl->pre_trigger_head = stl->pre_trigger_buffer;
-		stl->pre_trigger_fill -= size;
+	scratch_size = PRE_TRIGGER_SCRATCH_SIZE
+		- PRE_TRIGGER_SCRATCH_SIZE % stl->unitsize;
+	while ((chunk = g_queue_pop_head(stl->pre_trigger_chunks))) {
+		if (!chunk->bytes) {
+			logic.length = chunk->length;
+			logic.data = stl->pre_trigger_ring + chunk->offset;
+			sr_session_send(stl->sdi, &packet);
+		} else {
+			if (!stl->pre_trigger_scratch)
+				stl->pre_trigger_scratch = g_malloc(scratch_size);
+			base = g_bytes_get_data(chunk->bytes, NULL);
+			base += chunk->offset;
+			for (done = 0; done < chunk->length; done += logic.length) {
+				logic.length = MIN(chunk->length - done, scratch_size);
+				memcpy(stl->pre_trigger_scratch, base + done,
+					logic.length);
+				logic.data = stl->pre_trigger_scratch;
+				sr_session_send(stl->sdi, &packet);
+			}
+		}
 		if (pre_trigger_samples)
-			*pre_trigger_samples += size / stl->unitsize;
+			*pre_trigger_samples += chunk->length / stl->unitsize;
+		pre_trigger_chunk_free(chunk);
 	}
+	stl->pre_trigger_fill = 0;
+	stl->pre_trigger_ring_pos = 0;
 }
 
 static gboolean logic_check_match(struct soft_trigger_logic *stl,
@@ -170,18 +296,141 @@ static gboolean logic_check_match(struct soft_trigger_logic *stl,
 	return result;
 }
 
-/* Returns the offset (in samples) within buf of where the trigger
- * occurred, or -1 if not triggered. */
-SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *stl,
-		uint8_t *buf, int len, int *pre_trigger_samples)
+static inline uint64_t read_sample(const uint8_t *p, int unitsize)
+{
+	uint64_t value;
+
+	value = 0;
+	while (unitsize--)
+		value = (value << 8) | p[unitsize];
+
+	return value;
+}
+
+static inline gboolean prefilter_match(const struct soft_trigger_logic *stl,
+		uint64_t prev, uint64_t cur)
+{
+	if ((cur & stl->level_mask) != stl->level_value)
+		return FALSE;
+	if ((~prev & cur & stl->rising_mask) != stl->rising_mask)
+		return FALSE;
+	if ((prev & ~cur & stl->falling_mask) != stl->falling_mask)
+		return FALSE;
+	if (((prev ^ cur) & stl->edge_mask) != stl->edge_mask)
+		return FALSE;
+
+	return TRUE;
+}
+
+/*
+ * Skip over 8-bit samples, eight at a time. Each byte lane of the
+ * words gets checked against all masks at once, the loop stops at
+ * the first word which contains a candidate.
+ */
+static int prefilter_skip_u8(const struct soft_trigger_logic *stl,
+		const uint8_t *buf, int len, int i, uint64_t *prev)
+{
+	const uint64_t ones = 0x0101010101010101ULL;
+	uint64_t lm, lv, rm, fm, em, w, p, t;
+
+	lm = (stl->level_mask & 0xff) * ones;
+	lv = (stl->level_value & 0xff) * ones;
+	rm = (stl->rising_mask & 0xff) * ones;
+	fm = (stl->falling_mask & 0xff) * ones;
+	em = (stl->edge_mask & 0xff) * ones;
+
+	for (; i + 8 <= len; i += 8) {
+		memcpy(&w, buf + i, sizeof(w));
+		w = GUINT64_FROM_LE(w);
+		/* Each lane's previous sample. */
+		p = (w << 8) | (*prev & 0xff);
+		/* A lane is zero when it satisfies all matches. */
+		t = ((w & lm) ^ lv) | ((~p & w & rm) ^ rm)
+			| ((p & ~w & fm) ^ fm) | (((p ^ w) & em) ^ em);
+		if ((t - ones) & ~t & (ones << 7))
+			break;
+		*prev = w >> 56;
+	}
+
+	return i;
+}
+
+static int prefilter_skip(struct soft_trigger_logic *stl,
+		uint8_t *buf, int len, GBytes *bytes)
+{
+	uint64_t prev, cur;
+	int unitsize, i;
+
+	unitsize = stl->unitsize;
+	if (!stl->prefilter || stl->cur_stage > 0 || len < unitsize)
+		return 0;
+
+	i = 0;
+	if (stl->count == 0) {
+		/* Edges can't match on the very first sample. */
+		if (!(stl->rising_mask | stl->falling_mask | stl->edge_mask))
+			return 0;
+		prev = read_sample(buf, unitsize);
+		i = unitsize;
+	} else {
+		prev = read_sample(stl->prev_sample, unitsize);
+	}
+
+	if (unitsize == 1)
+		i = prefilter_skip_u8(stl, buf, len, i, &prev);
+	for (; i + unitsize <= len; i += unitsize) {
+		cur = read_sample(buf + i, unitsize);
+		if (prefilter_match(stl, prev, cur))
+			break;
+		prev = cur;
+	}
+	if (!i)
+		return 0;
+
+	pre_trigger_append(stl, buf, i, bytes);
+	memcpy(stl->prev_sample, buf + i - unitsize, unitsize);
+	stl->count = MAX(stl->count, 1);
+
+	return i;
+}
+
+/**
+ * Skip data which cannot contain a trigger match.
+ *
+ * Only takes effect for single stage triggers (see prefilter_setup()).
+ * The skipped data is added to the pre-trigger buffer in one go.
+ *
+ * @param stl The soft trigger.
+ * @param buf The sample data.
+ * @param len The data's length in bytes.
+ *
+ * @return The number of bytes skipped. The data at this position is
+ *         a trigger candidate, which must be passed to
+ *         soft_trigger_logic_check().
+ *
+ * @private
+ */
+SR_PRIV int soft_trigger_logic_skip(struct soft_trigger_logic *stl,
+		uint8_t *buf, int len)
+{
+	return prefilter_skip(stl, buf, len, NULL);
+}
+
+static int logic_check(struct soft_trigger_logic *stl,
+		uint8_t *buf, int len, GBytes *bytes, int *pre_trigger_samples)
 {
 	struct sr_trigger_stage *stage;
 	struct sr_trigger_match *match;
 	GSList *l, *l_stage;
-	int offset;
+	int offset, skipped;
 	int i;
 	gboolean match_found;
 
+	/* Discard what can't match in bulk. */
+	skipped = prefilter_skip(stl, buf, len, bytes);
+	buf += skipped;
+	len -= skipped;
+
 	offset = -1;
 	for (i = 0; i < len; i += stl->unitsize) {
 		l_stage = g_slist_nth(stl->trigger->stages, stl->cur_stage);
@@ -209,11 +458,11 @@ SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *stl,
 				stl->cur_stage++;
 			} else {
 				/* Matched on last stage, send pre-trigger data. */
-				pre_trigger_append(stl, buf, i);
+				pre_trigger_append(stl, buf, i, bytes);
 				pre_trigger_send(stl, pre_trigger_samples);
 
 				/* Fire trigger. */
-				offset = i / stl->unitsize;
+				offset = (skipped + i) / stl->unitsize;
 
 				std_session_send_df_trigger(stl->sdi);
 				break;
@@ -237,7 +486,45 @@ SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *stl,
 	}
 
 	if (offset == -1)
-		pre_trigger_append(stl, buf, len);
+		pre_trigger_append(stl, buf, len, bytes);
 
 	return offset;
 }
+
+/* Returns the offset (in samples) within buf of where the trigger
+ * occurred, or -1 if not triggered. */
+SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *stl,
+		uint8_t *buf, int len, int *pre_trigger_samples)
+{
+	return logic_check(stl, buf, len, NULL, pre_trigger_samples);
+}
+
+/**
+ * Check for a trigger match, without copying pre-trigger data.
+ *
+ * Works like soft_trigger_logic_check(), but the pre-trigger history
+ * only takes references to 'data'. The caller must not modify the
+ * data afterwards, buffers should be recycled from the GBytes free
+ * function instead. The data only gets copied when the trigger fires
+ * and the history is sent.
+ *
+ * @param stl The soft trigger.
+ * @param data The sample data.
+ * @param pre_trigger_samples Returns the number of pre-trigger samples
+ *        sent when the trigger fired. Can be NULL.
+ *
+ * @return The offset (in samples) of the trigger within data, -1 if it
+ *         didn't fire, or SR_ERR_ARG.
+ *
+ * @private
+ */
+SR_PRIV int soft_trigger_logic_check_bytes(struct soft_trigger_logic *stl,
+		GBytes *data, int *pre_trigger_samples)
+{
+	gsize len;
+	uint8_t *buf;
+
+	buf = (uint8_t *)g_bytes_get_data(data, &len);
+
+	return logic_check(stl, buf, len, data, pre_trigger_samples);
+}
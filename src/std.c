@@ -39,6 +39,13 @@
 
 SR_PRIV const uint32_t NO_OPTS[1] = {};
 
+/*
+ * Set for threads which run a driver's scan() on behalf of
+ * sr_driver_scan_concurrent(). Those threads must not touch the driver's
+ * instance list, the caller merges the results after all scans are done.
+ */
+static GPrivate scan_deferred = G_PRIVATE_INIT(NULL);
+
 /**
  * Standard driver init() callback API helper.
  *
@@ -544,11 +551,45 @@ SR_PRIV GSList *std_scan_complete(struct sr_dev_driver *di, GSList *devices)
 		sdi->driver = di;
 	}
 
-	drvc->instances = g_slist_concat(drvc->instances, g_slist_copy(devices));
+	std_scan_instances_add(drvc, devices);
 
 	return devices;
 }
 
+/**
+ * Add newly discovered devices to a driver's instance list.
+ *
+ * The devices are appended to the driver context's instance list, unless
+ * the calling thread runs a scan on behalf of sr_driver_scan_concurrent().
+ * In that case the list is left alone and the caller of the concurrent
+ * scan merges the results in a deterministic order once all scans have
+ * completed.
+ *
+ * @param[in] drvc The driver context to add the devices to.
+ * @param[in] devices List of newly discovered devices (struct sr_dev_inst).
+ *                    May be NULL.
+ */
+SR_PRIV void std_scan_instances_add(struct drv_context *drvc, GSList *devices)
+{
+	if (!drvc || !devices)
+		return;
+	if (g_private_get(&scan_deferred))
+		return;
+
+	drvc->instances = g_slist_concat(drvc->instances, g_slist_copy(devices));
+}
+
+/**
+ * Select whether the calling thread defers instance list updates.
+ *
+ * @param[in] deferred TRUE when std_scan_instances_add() should not touch
+ *                     the driver's instance list in the calling thread.
+ */
+SR_PRIV void std_scan_deferred_set(gboolean deferred)
+{
+	g_private_set(&scan_deferred, GINT_TO_POINTER(deferred));
+}
+
 SR_PRIV int std_opts_config_list(uint32_t key, GVariant **data,
 	const struct sr_dev_inst *sdi, const struct sr_channel_group *cg,
 	const uint32_t scanopts[], size_t scansize, const uint32_t drvopts[],
@@ -81,7 +81,8 @@ SR_PRIV int sr_sw_limits_config_get(const struct sr_sw_limits *limits, uint32_t
  * Set software limit configuration
  *
  * Configure software limit for the specified key. Should be called from the
- * drivers config_set() callback.
+ * drivers config_set() callback. Limits take effect immediately, also during
+ * a running acquisition. A time limit counts from the acquisition start.
  *
  * @param limits software limit instance
  * @param key config item key
@@ -100,6 +101,9 @@ SR_PRIV int sr_sw_limits_config_set(struct sr_sw_limits *limits, uint32_t key,
 		break;
 	case SR_CONF_LIMIT_MSEC:
 		limits->limit_msec = g_variant_get_uint64(data) * 1000;
+		limits->deadline = 0;
+		if (limits->limit_msec && limits->start_time)
+			limits->deadline = limits->start_time + limits->limit_msec;
 		break;
 	default:
 		return SR_ERR_NA;
@@ -121,6 +125,21 @@ SR_PRIV void sr_sw_limits_acquisition_start(struct sr_sw_limits *limits)
 	limits->samples_read = 0;
 	limits->frames_read = 0;
 	limits->start_time = g_get_monotonic_time();
+	limits->deadline = 0;
+	if (limits->limit_msec)
+		limits->deadline = limits->start_time + limits->limit_msec;
+}
+
+/* Convert the time limit to a samples count, using the samplerate. */
+static uint64_t msec_limit_samples(const struct sr_sw_limits *limits)
+{
+	uint64_t usecs, rate;
+
+	usecs = limits->limit_msec;
+	rate = limits->samplerate;
+
+	/* Avoid overflows for long durations at high rates. */
+	return (usecs / 1000000) * rate + (usecs % 1000000) * rate / 1000000;
 }
 
 /**
@@ -151,11 +170,14 @@ SR_PRIV gboolean sr_sw_limits_check(struct sr_sw_limits *limits)
 		}
 	}
 
-	if (limits->limit_msec && limits->start_time) {
-		guint64 now;
-		now = g_get_monotonic_time();
-		if (now > limits->start_time &&
-			now - limits->start_time > limits->limit_msec) {
+	if (limits->limit_msec && limits->samplerate) {
+		if (limits->samples_read >= msec_limit_samples(limits)) {
+			sr_dbg("Requested sampling time (%" PRIu64
+			       "ms) reached.", limits->limit_msec / 1000);
+			return TRUE;
+		}
+	} else if (limits->deadline) {
+		if ((uint64_t)g_get_monotonic_time() > limits->deadline) {
 			sr_dbg("Requested sampling time (%" PRIu64
 			       "ms) reached.", limits->limit_msec / 1000);
 			return TRUE;
@@ -279,3 +301,60 @@ SR_PRIV void sr_sw_limits_update_frames_read(struct sr_sw_limits *limits,
 {
 	limits->frames_read += frames_read;
 }
+
+/**
+ * Set the samplerate for the conversion of time limits
+ *
+ * Drivers which know the rate at which they produce samples can have
+ * a time limit (SR_CONF_LIMIT_MSEC) enforced as a samples count. This
+ * makes the enforcement exact, and lets sr_sw_limits_check() and
+ * sr_sw_limits_samples_budget() avoid timing syscalls. A rate of 0
+ * (the default) keeps checking time limits against the clock.
+ *
+ * @param limits software limits instance
+ * @param samplerate the samplerate in Hz
+ */
+SR_PRIV void sr_sw_limits_set_samplerate(struct sr_sw_limits *limits,
+	uint64_t samplerate)
+{
+	limits->samplerate = samplerate;
+}
+
+/**
+ * Get the number of samples which may still get submitted
+ *
+ * Lets drivers clamp whole buffers up front, instead of checking the
+ * limits after every sample. Considers the samples limit, the frames
+ * limit (no more samples once it was reached), and the time limit when
+ * a samplerate was set with @ref sr_sw_limits_set_samplerate(). Does not
+ * read the clock, time limits without a samplerate are only enforced
+ * by @ref sr_sw_limits_check().
+ *
+ * @param limits software limits instance
+ *
+ * @returns The number of samples until a limit is reached, UINT64_MAX
+ *          when no applicable limit is configured.
+ */
+SR_PRIV uint64_t sr_sw_limits_samples_budget(const struct sr_sw_limits *limits)
+{
+	uint64_t budget, total;
+
+	budget = UINT64_MAX;
+
+	if (limits->limit_samples) {
+		total = limits->limit_samples;
+		budget = MIN(budget, total > limits->samples_read
+			? total - limits->samples_read : 0);
+	}
+
+	if (limits->limit_msec && limits->samplerate) {
+		total = msec_limit_samples(limits);
+		budget = MIN(budget, total > limits->samples_read
+			? total - limits->samples_read : 0);
+	}
+
+	if (limits->limit_frames && limits->frames_read >= limits->limit_frames)
+		budget = 0;
+
+	return budget;
+}
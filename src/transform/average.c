@@ -0,0 +1,213 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "transform/average"
+
+struct channel_state {
+	float *history;
+	uint64_t pos;
+	uint64_t fill;
+	double sum;
+};
+
+struct context {
+	uint64_t length;
+	/* Filter state per channel (struct sr_channel *). */
+	GHashTable *channels;
+	/* Output packet, valid until the next packet gets received. */
+	float *buffer;
+	size_t buffer_size;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+};
+
+static void channel_state_free(void *data)
+{
+	struct channel_state *cs;
+
+	cs = data;
+	g_free(cs->history);
+	g_free(cs);
+}
+
+/*
+ * Boxcar FIR filter over the last 'length' samples, in place. Keeps a
+ * running sum which gets recomputed from the history on every wrap of
+ * the ring, so that rounding errors cannot accumulate over long runs.
+ * Before the history is filled, the average of the samples seen so far
+ * is used.
+ */
+static void moving_average(struct channel_state *cs, uint64_t length,
+	float *data, size_t count)
+{
+	size_t i;
+	uint64_t j;
+	float value;
+
+	for (i = 0; i < count; i++) {
+		value = data[i];
+		cs->sum += value - cs->history[cs->pos];
+		cs->history[cs->pos] = value;
+		if (++cs->pos == length) {
+			cs->pos = 0;
+			cs->sum = 0;
+			for (j = 0; j < length; j++)
+				cs->sum += cs->history[j];
+		}
+		if (cs->fill < length)
+			cs->fill++;
+		data[i] = cs->sum / cs->fill;
+	}
+}
+
+static int init(struct sr_transform *t, GHashTable *options)
+{
+	struct context *ctx;
+
+	if (!t || !t->sdi || !options)
+		return SR_ERR_ARG;
+
+	t->priv = ctx = g_malloc0(sizeof(struct context));
+
+	ctx->length = g_variant_get_uint64(g_hash_table_lookup(options, "length"));
+	if (!ctx->length) {
+		sr_err("Invalid filter length 0.");
+		g_free(ctx);
+		t->priv = NULL;
+		return SR_ERR_ARG;
+	}
+	ctx->channels = g_hash_table_new_full(g_direct_hash,
+		g_direct_equal, NULL, channel_state_free);
+
+	return SR_OK;
+}
+
+static int receive(const struct sr_transform *t,
+		struct sr_datafeed_packet *packet_in,
+		struct sr_datafeed_packet **packet_out)
+{
+	struct context *ctx;
+	const struct sr_datafeed_analog *analog;
+	struct channel_state *cs;
+	void *key;
+	int ret;
+
+	if (!t || !t->sdi || !packet_in || !packet_out)
+		return SR_ERR_ARG;
+	ctx = t->priv;
+
+	*packet_out = packet_in;
+
+	switch (packet_in->type) {
+	case SR_DF_HEADER:
+		g_hash_table_remove_all(ctx->channels);
+		break;
+	case SR_DF_ANALOG:
+		analog = packet_in->payload;
+		if (g_slist_length(analog->meaning->channels) != 1) {
+			sr_spew("Not filtering multi-channel packet.");
+			break;
+		}
+		key = analog->meaning->channels->data;
+		cs = g_hash_table_lookup(ctx->channels, key);
+		if (!cs) {
+			cs = g_malloc0(sizeof(*cs));
+			cs->history = g_malloc0(ctx->length * sizeof(float));
+			g_hash_table_insert(ctx->channels, key, cs);
+		}
+
+		if (ctx->buffer_size < analog->num_samples) {
+			g_free(ctx->buffer);
+			ctx->buffer = g_malloc(analog->num_samples * sizeof(float));
+			ctx->buffer_size = analog->num_samples;
+		}
+		ret = sr_analog_to_float(analog, ctx->buffer);
+		if (ret != SR_OK)
+			return ret;
+		moving_average(cs, ctx->length, ctx->buffer, analog->num_samples);
+
+		/* Emit the filtered values as native floats. */
+		ctx->encoding = *analog->encoding;
+		ctx->encoding.unitsize = sizeof(float);
+		ctx->encoding.is_signed = TRUE;
+		ctx->encoding.is_float = TRUE;
+#ifdef WORDS_BIGENDIAN
+		ctx->encoding.is_bigendian = TRUE;
+#else
+		ctx->encoding.is_bigendian = FALSE;
+#endif
+		sr_rational_set(&ctx->encoding.scale, 1, 1);
+		sr_rational_set(&ctx->encoding.offset, 0, 1);
+		ctx->analog = *analog;
+		ctx->analog.data = ctx->buffer;
+		ctx->analog.encoding = &ctx->encoding;
+		ctx->packet.type = SR_DF_ANALOG;
+		ctx->packet.payload = &ctx->analog;
+		*packet_out = &ctx->packet;
+		break;
+	default:
+		sr_spew("Unsupported packet type %d, ignoring.", packet_in->type);
+		break;
+	}
+
+	return SR_OK;
+}
+
+static int cleanup(struct sr_transform *t)
+{
+	struct context *ctx;
+
+	if (!t || !t->sdi)
+		return SR_ERR_ARG;
+	ctx = t->priv;
+
+	g_hash_table_destroy(ctx->channels);
+	g_free(ctx->buffer);
+	g_free(ctx);
+	t->priv = NULL;
+
+	return SR_OK;
+}
+
+static struct sr_option options[] = {
+	{ "length", "Length", "Number of samples to average over", NULL, NULL },
+	ALL_ZERO
+};
+
+static const struct sr_option *get_options(void)
+{
+	if (!options[0].def)
+		options[0].def = g_variant_ref_sink(g_variant_new_uint64(8));
+
+	return options;
+}
+
+SR_PRIV struct sr_transform_module transform_average = {
+	.id = "average",
+	.name = "Moving average",
+	.desc = "Smooth analog values with a moving average filter",
+	.options = get_options,
+	.init = init,
+	.receive = receive,
+	.cleanup = cleanup,
+};
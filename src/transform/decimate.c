@@ -0,0 +1,281 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "transform/decimate"
+
+struct context {
+	uint64_t factor;
+	/* Number of logic samples to drop before the next one is kept. */
+	uint64_t logic_skip;
+	/* Same for analog data, per channel (struct sr_channel *). */
+	GHashTable *analog_skip;
+	/* Output packet, valid until the next packet gets received. */
+	uint8_t *buffer;
+	size_t buffer_size;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	struct sr_datafeed_analog analog;
+	/* Copy of the last META packet, with the samplerate adjusted. */
+	struct sr_datafeed_packet meta_packet;
+	struct sr_datafeed_meta meta;
+};
+
+/*
+ * Copy every factor-th item of 'in' to 'out', starting at item 'skip'.
+ * Specialized loops for the common item sizes avoid the memcpy() call
+ * per item. These are scalar loops, the gather from every factor-th
+ * item does not lend itself to vectorization.
+ */
+#define DECIMATE_LOOP(type) do { \
+	const type *src = in; \
+	type *dst = out; \
+	for (i = skip; i < count; i += factor) \
+		dst[kept++] = src[i]; \
+} while (0)
+
+static size_t decimate(const void *in, void *out, size_t count,
+	size_t unitsize, uint64_t factor, uint64_t *skip_io)
+{
+	const uint8_t *src8;
+	uint8_t *dst8;
+	uint64_t skip, i;
+	size_t kept;
+
+	skip = *skip_io;
+	kept = 0;
+	switch (unitsize) {
+	case sizeof(uint8_t):
+		DECIMATE_LOOP(uint8_t);
+		break;
+	case sizeof(uint16_t):
+		DECIMATE_LOOP(uint16_t);
+		break;
+	case sizeof(uint32_t):
+		DECIMATE_LOOP(uint32_t);
+		break;
+	case sizeof(uint64_t):
+		DECIMATE_LOOP(uint64_t);
+		break;
+	default:
+		src8 = in;
+		dst8 = out;
+		for (i = skip; i < count; i += factor)
+			memcpy(&dst8[kept++ * unitsize], &src8[i * unitsize], unitsize);
+		break;
+	}
+	/* Carry the phase over to the next packet. */
+	*skip_io = i - count;
+
+	return kept;
+}
+
+static uint8_t *output_buffer(struct context *ctx, size_t size)
+{
+	if (ctx->buffer_size < size) {
+		g_free(ctx->buffer);
+		ctx->buffer = g_malloc(size);
+		ctx->buffer_size = size;
+	}
+
+	return ctx->buffer;
+}
+
+/*
+ * Number of items kept from a packet of 'count' items, when the first
+ * one gets kept at index 'skip'.
+ */
+static size_t decimated_count(size_t count, uint64_t factor, uint64_t skip)
+{
+	if (skip >= count)
+		return 0;
+
+	return (count - skip - 1) / factor + 1;
+}
+
+static int init(struct sr_transform *t, GHashTable *options)
+{
+	struct context *ctx;
+
+	if (!t || !t->sdi || !options)
+		return SR_ERR_ARG;
+
+	t->priv = ctx = g_malloc0(sizeof(struct context));
+
+	ctx->factor = g_variant_get_uint64(g_hash_table_lookup(options, "factor"));
+	if (!ctx->factor) {
+		sr_err("Invalid decimation factor 0.");
+		g_free(ctx);
+		t->priv = NULL;
+		return SR_ERR_ARG;
+	}
+	ctx->analog_skip = g_hash_table_new_full(g_direct_hash,
+		g_direct_equal, NULL, g_free);
+
+	return SR_OK;
+}
+
+static int receive(const struct sr_transform *t,
+		struct sr_datafeed_packet *packet_in,
+		struct sr_datafeed_packet **packet_out)
+{
+	struct context *ctx;
+	const struct sr_datafeed_meta *meta;
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	struct sr_config *src;
+	GVariant *data;
+	GSList *l;
+	void *key;
+	uint64_t *skip;
+	size_t unitsize, count;
+	uint8_t *buffer;
+
+	if (!t || !t->sdi || !packet_in || !packet_out)
+		return SR_ERR_ARG;
+	ctx = t->priv;
+
+	*packet_out = packet_in;
+	if (ctx->factor == 1)
+		return SR_OK;
+
+	switch (packet_in->type) {
+	case SR_DF_HEADER:
+		ctx->logic_skip = 0;
+		g_hash_table_remove_all(ctx->analog_skip);
+		break;
+	case SR_DF_META:
+		/*
+		 * Downstream consumers must see the reduced samplerate. The
+		 * META packet belongs to the sender, send a copy.
+		 */
+		meta = packet_in->payload;
+		g_slist_free_full(ctx->meta.config, (GDestroyNotify)sr_config_free);
+		ctx->meta.config = NULL;
+		for (l = meta->config; l; l = l->next) {
+			src = l->data;
+			if (src->key == SR_CONF_SAMPLERATE)
+				data = g_variant_new_uint64(
+					g_variant_get_uint64(src->data) / ctx->factor);
+			else
+				data = src->data;
+			ctx->meta.config = g_slist_append(ctx->meta.config,
+				sr_config_new(src->key, data));
+		}
+		ctx->meta_packet.type = SR_DF_META;
+		ctx->meta_packet.payload = &ctx->meta;
+		*packet_out = &ctx->meta_packet;
+		break;
+	case SR_DF_LOGIC:
+		logic = packet_in->payload;
+		if (!logic->unitsize)
+			break;
+		count = logic->length / logic->unitsize;
+		buffer = output_buffer(ctx, logic->unitsize *
+			decimated_count(count, ctx->factor, ctx->logic_skip));
+		count = decimate(logic->data, buffer, count, logic->unitsize,
+			ctx->factor, &ctx->logic_skip);
+		if (!count) {
+			*packet_out = NULL;
+			break;
+		}
+		ctx->logic = *logic;
+		ctx->logic.length = count * logic->unitsize;
+		ctx->logic.data = buffer;
+		ctx->packet.type = SR_DF_LOGIC;
+		ctx->packet.payload = &ctx->logic;
+		*packet_out = &ctx->packet;
+		break;
+	case SR_DF_ANALOG:
+		analog = packet_in->payload;
+		if (!analog->meaning->channels)
+			break;
+		key = analog->meaning->channels->data;
+		skip = g_hash_table_lookup(ctx->analog_skip, key);
+		if (!skip) {
+			skip = g_malloc0(sizeof(*skip));
+			g_hash_table_insert(ctx->analog_skip, key, skip);
+		}
+		/* Interleaved channels get decimated as a whole. */
+		unitsize = analog->encoding->unitsize;
+		unitsize *= g_slist_length(analog->meaning->channels);
+		buffer = output_buffer(ctx, unitsize *
+			decimated_count(analog->num_samples, ctx->factor, *skip));
+		count = decimate(analog->data, buffer, analog->num_samples,
+			unitsize, ctx->factor, skip);
+		if (!count) {
+			*packet_out = NULL;
+			break;
+		}
+		ctx->analog = *analog;
+		ctx->analog.num_samples = count;
+		ctx->analog.data = buffer;
+		ctx->packet.type = SR_DF_ANALOG;
+		ctx->packet.payload = &ctx->analog;
+		*packet_out = &ctx->packet;
+		break;
+	default:
+		sr_spew("Unsupported packet type %d, ignoring.", packet_in->type);
+		break;
+	}
+
+	return SR_OK;
+}
+
+static int cleanup(struct sr_transform *t)
+{
+	struct context *ctx;
+
+	if (!t || !t->sdi)
+		return SR_ERR_ARG;
+	ctx = t->priv;
+
+	g_hash_table_destroy(ctx->analog_skip);
+	g_slist_free_full(ctx->meta.config, (GDestroyNotify)sr_config_free);
+	g_free(ctx->buffer);
+	g_free(ctx);
+	t->priv = NULL;
+
+	return SR_OK;
+}
+
+static struct sr_option options[] = {
+	{ "factor", "Factor", "Keep one of this many samples", NULL, NULL },
+	ALL_ZERO
+};
+
+static const struct sr_option *get_options(void)
+{
+	if (!options[0].def)
+		options[0].def = g_variant_ref_sink(g_variant_new_uint64(1));
+
+	return options;
+}
+
+SR_PRIV struct sr_transform_module transform_decimate = {
+	.id = "decimate",
+	.name = "Decimate",
+	.desc = "Reduce the samplerate of logic and analog data by an integer factor",
+	.options = get_options,
+	.init = init,
+	.receive = receive,
+	.cleanup = cleanup,
+};
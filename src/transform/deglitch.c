@@ -0,0 +1,223 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "transform/deglitch"
+
+/*
+ * A change of a logic channel only gets accepted after the new level was
+ * seen for 'length' consecutive samples. Shorter pulses are suppressed.
+ * Accepted edges get reported at the sample where they became stable,
+ * i.e. all edges are delayed by (length - 1) samples.
+ */
+
+#define MAX_UNITSIZE sizeof(uint64_t)
+
+struct context {
+	uint64_t length;
+	gboolean started;
+	/* The accepted (output) levels. */
+	uint64_t state;
+	/* Channels which differ from the accepted level. */
+	uint64_t pending;
+	/* Number of samples the new level was seen, per pending channel. */
+	uint64_t count[64];
+	/* Output packet, valid until the next packet gets received. */
+	uint8_t *buffer;
+	size_t buffer_size;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+};
+
+static inline uint64_t read_sample(const uint8_t *p, size_t unitsize)
+{
+	uint64_t value;
+
+	value = 0;
+	while (unitsize--)
+		value = (value << 8) | p[unitsize];
+
+	return value;
+}
+
+static inline void write_sample(uint8_t *p, size_t unitsize, uint64_t value)
+{
+	size_t i;
+
+	for (i = 0; i < unitsize; i++) {
+		p[i] = value & 0xff;
+		value >>= 8;
+	}
+}
+
+static void deglitch(struct context *ctx, const uint8_t *data, uint8_t *out,
+	size_t count, size_t unitsize)
+{
+	uint64_t sample, diff, bits, mask;
+	size_t i;
+	int bit;
+
+	if (!ctx->started && count) {
+		ctx->state = read_sample(data, unitsize);
+		ctx->started = TRUE;
+	}
+
+	for (i = 0; i < count; i++, data += unitsize, out += unitsize) {
+		sample = read_sample(data, unitsize);
+		diff = sample ^ ctx->state;
+		/* Fast path: steady signal, pass it on. */
+		if (!diff && !ctx->pending) {
+			memcpy(out, data, unitsize);
+			continue;
+		}
+
+		/* Channels which went back to the accepted level. */
+		ctx->pending &= diff;
+		/* Channels which start to differ now. */
+		bits = diff & ~ctx->pending;
+		while (bits) {
+			bit = bit_lowest_u64(bits);
+			bits &= bits - 1;
+			ctx->count[bit] = 0;
+		}
+		ctx->pending = diff;
+
+		/* Only walk the channels which are in transition. */
+		bits = ctx->pending;
+		while (bits) {
+			bit = bit_lowest_u64(bits);
+			mask = 1ULL << bit;
+			bits &= bits - 1;
+			if (++ctx->count[bit] >= ctx->length) {
+				ctx->state ^= mask;
+				ctx->pending &= ~mask;
+			}
+		}
+
+		write_sample(out, unitsize, ctx->state);
+	}
+}
+
+static int init(struct sr_transform *t, GHashTable *options)
+{
+	struct context *ctx;
+
+	if (!t || !t->sdi || !options)
+		return SR_ERR_ARG;
+
+	t->priv = ctx = g_malloc0(sizeof(struct context));
+
+	ctx->length = g_variant_get_uint64(g_hash_table_lookup(options, "length"));
+	if (!ctx->length) {
+		sr_err("Invalid minimum pulse length 0.");
+		g_free(ctx);
+		t->priv = NULL;
+		return SR_ERR_ARG;
+	}
+
+	return SR_OK;
+}
+
+static int receive(const struct sr_transform *t,
+		struct sr_datafeed_packet *packet_in,
+		struct sr_datafeed_packet **packet_out)
+{
+	struct context *ctx;
+	const struct sr_datafeed_logic *logic;
+
+	if (!t || !t->sdi || !packet_in || !packet_out)
+		return SR_ERR_ARG;
+	ctx = t->priv;
+
+	*packet_out = packet_in;
+	if (ctx->length == 1)
+		return SR_OK;
+
+	switch (packet_in->type) {
+	case SR_DF_HEADER:
+		ctx->started = FALSE;
+		ctx->pending = 0;
+		break;
+	case SR_DF_LOGIC:
+		logic = packet_in->payload;
+		if (!logic->unitsize || logic->unitsize > MAX_UNITSIZE) {
+			sr_spew("Not filtering logic data of unitsize %u.",
+				logic->unitsize);
+			break;
+		}
+		if (ctx->buffer_size < logic->length) {
+			g_free(ctx->buffer);
+			ctx->buffer = g_malloc(logic->length);
+			ctx->buffer_size = logic->length;
+		}
+		deglitch(ctx, logic->data, ctx->buffer,
+			logic->length / logic->unitsize, logic->unitsize);
+		ctx->logic = *logic;
+		ctx->logic.data = ctx->buffer;
+		ctx->packet.type = SR_DF_LOGIC;
+		ctx->packet.payload = &ctx->logic;
+		*packet_out = &ctx->packet;
+		break;
+	default:
+		sr_spew("Unsupported packet type %d, ignoring.", packet_in->type);
+		break;
+	}
+
+	return SR_OK;
+}
+
+static int cleanup(struct sr_transform *t)
+{
+	struct context *ctx;
+
+	if (!t || !t->sdi)
+		return SR_ERR_ARG;
+	ctx = t->priv;
+
+	g_free(ctx->buffer);
+	g_free(ctx);
+	t->priv = NULL;
+
+	return SR_OK;
+}
+
+static struct sr_option options[] = {
+	{ "length", "Length", "Minimum number of samples a level must be stable", NULL, NULL },
+	ALL_ZERO
+};
+
+static const struct sr_option *get_options(void)
+{
+	if (!options[0].def)
+		options[0].def = g_variant_ref_sink(g_variant_new_uint64(2));
+
+	return options;
+}
+
+SR_PRIV struct sr_transform_module transform_deglitch = {
+	.id = "deglitch",
+	.name = "Deglitch",
+	.desc = "Suppress logic pulses shorter than a minimum length",
+	.options = get_options,
+	.init = init,
+	.receive = receive,
+	.cleanup = cleanup,
+};
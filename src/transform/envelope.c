@@ -0,0 +1,249 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "transform/envelope"
+
+/* State of an incomplete block, carried over to the next packet. */
+struct channel_state {
+	uint64_t fill;
+	float min;
+	float max;
+};
+
+struct context {
+	uint64_t factor;
+	/* Block state per channel (struct sr_channel *). */
+	GHashTable *channels;
+	/* Output packet, valid until the next packet gets received. */
+	float *buffer;
+	size_t buffer_size;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	/* Copy of the last META packet, with the samplerate adjusted. */
+	struct sr_datafeed_packet meta_packet;
+	struct sr_datafeed_meta meta;
+};
+
+/*
+ * Reduce each block of 'factor' input values to its minimum and its
+ * maximum, in this order. The output may start one value before the
+ * input in the same buffer: a block which was carried over from the
+ * previous packet completes after a single input value but yields two,
+ * every further block consumes at least as many values as it yields.
+ * Returns the number of output values.
+ */
+static size_t envelope(struct channel_state *cs, uint64_t factor,
+	const float *in, float *out, size_t count)
+{
+	size_t i, num;
+	float value, min, max;
+	uint64_t fill;
+
+	min = cs->min;
+	max = cs->max;
+	fill = cs->fill;
+	num = 0;
+	for (i = 0; i < count; i++) {
+		value = in[i];
+		if (!fill || value < min)
+			min = value;
+		if (!fill || value > max)
+			max = value;
+		if (++fill == factor) {
+			out[num++] = min;
+			out[num++] = max;
+			fill = 0;
+		}
+	}
+	cs->min = min;
+	cs->max = max;
+	cs->fill = fill;
+
+	return num;
+}
+
+static int init(struct sr_transform *t, GHashTable *options)
+{
+	struct context *ctx;
+
+	if (!t || !t->sdi || !options)
+		return SR_ERR_ARG;
+
+	t->priv = ctx = g_malloc0(sizeof(struct context));
+
+	ctx->factor = g_variant_get_uint64(g_hash_table_lookup(options, "factor"));
+	if (ctx->factor < 2) {
+		sr_err("Invalid reduction factor %" PRIu64 ".", ctx->factor);
+		g_free(ctx);
+		t->priv = NULL;
+		return SR_ERR_ARG;
+	}
+	ctx->channels = g_hash_table_new_full(g_direct_hash,
+		g_direct_equal, NULL, g_free);
+
+	return SR_OK;
+}
+
+static int receive(const struct sr_transform *t,
+		struct sr_datafeed_packet *packet_in,
+		struct sr_datafeed_packet **packet_out)
+{
+	struct context *ctx;
+	const struct sr_datafeed_meta *meta;
+	const struct sr_datafeed_analog *analog;
+	struct channel_state *cs;
+	struct sr_config *src;
+	GVariant *data;
+	GSList *l;
+	void *key;
+	size_t count;
+	int ret;
+
+	if (!t || !t->sdi || !packet_in || !packet_out)
+		return SR_ERR_ARG;
+	ctx = t->priv;
+
+	*packet_out = packet_in;
+
+	switch (packet_in->type) {
+	case SR_DF_HEADER:
+		g_hash_table_remove_all(ctx->channels);
+		break;
+	case SR_DF_META:
+		/*
+		 * Each block of 'factor' samples becomes a min/max pair. The
+		 * META packet belongs to the sender, send a copy.
+		 */
+		meta = packet_in->payload;
+		g_slist_free_full(ctx->meta.config, (GDestroyNotify)sr_config_free);
+		ctx->meta.config = NULL;
+		for (l = meta->config; l; l = l->next) {
+			src = l->data;
+			if (src->key == SR_CONF_SAMPLERATE)
+				data = g_variant_new_uint64(
+					g_variant_get_uint64(src->data) * 2 / ctx->factor);
+			else
+				data = src->data;
+			ctx->meta.config = g_slist_append(ctx->meta.config,
+				sr_config_new(src->key, data));
+		}
+		ctx->meta_packet.type = SR_DF_META;
+		ctx->meta_packet.payload = &ctx->meta;
+		*packet_out = &ctx->meta_packet;
+		break;
+	case SR_DF_ANALOG:
+		analog = packet_in->payload;
+		if (g_slist_length(analog->meaning->channels) != 1) {
+			sr_spew("Not reducing multi-channel packet.");
+			break;
+		}
+		key = analog->meaning->channels->data;
+		cs = g_hash_table_lookup(ctx->channels, key);
+		if (!cs) {
+			cs = g_malloc0(sizeof(*cs));
+			g_hash_table_insert(ctx->channels, key, cs);
+		}
+
+		/* Keep one spare value in front of the input, see above. */
+		if (ctx->buffer_size < analog->num_samples + 1) {
+			g_free(ctx->buffer);
+			ctx->buffer_size = analog->num_samples + 1;
+			ctx->buffer = g_malloc(ctx->buffer_size * sizeof(float));
+		}
+		ret = sr_analog_to_float(analog, ctx->buffer + 1);
+		if (ret != SR_OK)
+			return ret;
+		count = envelope(cs, ctx->factor, ctx->buffer + 1, ctx->buffer,
+			analog->num_samples);
+		if (!count) {
+			*packet_out = NULL;
+			break;
+		}
+
+		/* Emit the min/max pairs as native floats. */
+		ctx->encoding = *analog->encoding;
+		ctx->encoding.unitsize = sizeof(float);
+		ctx->encoding.is_signed = TRUE;
+		ctx->encoding.is_float = TRUE;
+#ifdef WORDS_BIGENDIAN
+		ctx->encoding.is_bigendian = TRUE;
+#else
+		ctx->encoding.is_bigendian = FALSE;
+#endif
+		sr_rational_set(&ctx->encoding.scale, 1, 1);
+		sr_rational_set(&ctx->encoding.offset, 0, 1);
+		ctx->analog = *analog;
+		ctx->analog.data = ctx->buffer;
+		ctx->analog.num_samples = count;
+		ctx->analog.encoding = &ctx->encoding;
+		ctx->packet.type = SR_DF_ANALOG;
+		ctx->packet.payload = &ctx->analog;
+		*packet_out = &ctx->packet;
+		break;
+	default:
+		sr_spew("Unsupported packet type %d, ignoring.", packet_in->type);
+		break;
+	}
+
+	return SR_OK;
+}
+
+static int cleanup(struct sr_transform *t)
+{
+	struct context *ctx;
+
+	if (!t || !t->sdi)
+		return SR_ERR_ARG;
+	ctx = t->priv;
+
+	g_hash_table_destroy(ctx->channels);
+	g_slist_free_full(ctx->meta.config, (GDestroyNotify)sr_config_free);
+	g_free(ctx->buffer);
+	g_free(ctx);
+	t->priv = NULL;
+
+	return SR_OK;
+}
+
+static struct sr_option options[] = {
+	{ "factor", "Factor", "Number of samples to reduce to one min/max pair", NULL, NULL },
+	ALL_ZERO
+};
+
+static const struct sr_option *get_options(void)
+{
+	if (!options[0].def)
+		options[0].def = g_variant_ref_sink(g_variant_new_uint64(16));
+
+	return options;
+}
+
+SR_PRIV struct sr_transform_module transform_envelope = {
+	.id = "envelope",
+	.name = "Envelope",
+	.desc = "Reduce analog values to min/max pairs (peak detection)",
+	.options = get_options,
+	.init = init,
+	.receive = receive,
+	.cleanup = cleanup,
+};
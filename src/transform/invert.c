@@ -24,18 +24,43 @@
 
 #define LOG_PREFIX "transform/invert"
 
+struct context {
+	/* Output packet, valid until the next packet gets received. */
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+};
+
+static int init(struct sr_transform *t, GHashTable *options)
+{
+	(void)options;
+
+	if (!t || !t->sdi)
+		return SR_ERR_ARG;
+
+	t->priv = g_malloc0(sizeof(struct context));
+
+	return SR_OK;
+}
+
 static int receive(const struct sr_transform *t,
 		struct sr_datafeed_packet *packet_in,
 		struct sr_datafeed_packet **packet_out)
 {
+	struct context *ctx;
 	const struct sr_datafeed_logic *logic;
 	const struct sr_datafeed_analog *analog;
+	struct sr_rational one;
 	uint8_t *b;
-	int64_t p;
-	uint64_t i, j, q;
+	uint64_t i, j;
+	int ret;
 
 	if (!t || !t->sdi || !packet_in || !packet_out)
 		return SR_ERR_ARG;
+	ctx = t->priv;
+
+	/* Return the in-place-modified packet, unless replaced below. */
+	*packet_out = packet_in;
 
 	switch (packet_in->type) {
 	case SR_DF_LOGIC:
@@ -50,20 +75,44 @@ static int receive(const struct sr_transform *t,
 		break;
 	case SR_DF_ANALOG:
 		analog = packet_in->payload;
-		p = analog->encoding->scale.p;
-		q = analog->encoding->scale.q;
-		if (q > INT64_MAX)
-			return SR_ERR;
-		analog->encoding->scale.p = (p < 0) ? -q : q;
-		analog->encoding->scale.q = (p < 0) ? -p : p;
+		/*
+		 * Use the inverse of the encoding's linear map: instead of
+		 * raw * scale + offset, emit (raw - offset) / scale, i.e.
+		 * scale 1 / scale and offset -offset / scale. Work on a
+		 * copy, the sender may reuse its packet and encoding.
+		 */
+		ctx->encoding = *analog->encoding;
+		sr_rational_set(&one, 1, 1);
+		ret = sr_rational_div(&ctx->encoding.scale,
+			&one, &analog->encoding->scale);
+		if (ret != SR_OK)
+			return ret;
+		ret = sr_rational_div(&ctx->encoding.offset,
+			&analog->encoding->offset, &analog->encoding->scale);
+		if (ret != SR_OK)
+			return ret;
+		ctx->encoding.offset.p = -ctx->encoding.offset.p;
+		ctx->analog = *analog;
+		ctx->analog.encoding = &ctx->encoding;
+		ctx->packet.type = SR_DF_ANALOG;
+		ctx->packet.payload = &ctx->analog;
+		*packet_out = &ctx->packet;
 		break;
 	default:
 		sr_spew("Unsupported packet type %d, ignoring.", packet_in->type);
 		break;
 	}
 
-	/* Return the in-place-modified packet. */
-	*packet_out = packet_in;
+	return SR_OK;
+}
+
+static int cleanup(struct sr_transform *t)
+{
+	if (!t || !t->sdi)
+		return SR_ERR_ARG;
+
+	g_free(t->priv);
+	t->priv = NULL;
 
 	return SR_OK;
 }
@@ -73,7 +122,7 @@ SR_PRIV struct sr_transform_module transform_invert = {
 	.name = "Invert",
 	.desc = "Invert values",
 	.options = NULL,
-	.init = NULL,
+	.init = init,
 	.receive = receive,
-	.cleanup = NULL,
+	.cleanup = cleanup,
 };
@@ -26,6 +26,10 @@
 
 struct context {
 	struct sr_rational factor;
+	/* Output packet, valid until the next packet gets received. */
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
 };
 
 static int init(struct sr_transform *t, GHashTable *options)
@@ -49,25 +53,43 @@ static int receive(const struct sr_transform *t,
 {
 	struct context *ctx;
 	const struct sr_datafeed_analog *analog;
+	int ret;
 
 	if (!t || !t->sdi || !packet_in || !packet_out)
 		return SR_ERR_ARG;
 	ctx = t->priv;
 
+	/* Pass through anything that is not analog data. */
+	*packet_out = packet_in;
+
 	switch (packet_in->type) {
 	case SR_DF_ANALOG:
 		analog = packet_in->payload;
-		analog->encoding->scale.p *= ctx->factor.p;
-		analog->encoding->scale.q *= ctx->factor.q;
+		/*
+		 * The value is raw * scale + offset, so both terms get
+		 * scaled. Work on a copy of the encoding: the sender may
+		 * reuse its packet, and must not see it scaled again.
+		 */
+		ctx->encoding = *analog->encoding;
+		ret = sr_rational_mult(&ctx->encoding.scale,
+			&analog->encoding->scale, &ctx->factor);
+		if (ret != SR_OK)
+			return ret;
+		ret = sr_rational_mult(&ctx->encoding.offset,
+			&analog->encoding->offset, &ctx->factor);
+		if (ret != SR_OK)
+			return ret;
+		ctx->analog = *analog;
+		ctx->analog.encoding = &ctx->encoding;
+		ctx->packet.type = SR_DF_ANALOG;
+		ctx->packet.payload = &ctx->analog;
+		*packet_out = &ctx->packet;
 		break;
 	default:
 		sr_spew("Unsupported packet type %d, ignoring.", packet_in->type);
 		break;
 	}
 
-	/* Return the in-place-modified packet. */
-	*packet_out = packet_in;
-
 	return SR_OK;
 }
 
@@ -555,6 +555,61 @@ SR_PRIV int usb_get_port_path(libusb_device *dev, char *path, int path_len)
 	return SR_OK;
 }
 
+/**
+ * Get a fingerprint of a USB device for the identification cache.
+ *
+ * Combines the port path, the VID:PID and the serial number string
+ * descriptor. Only devices with a serial number can be told apart from
+ * another unit of the same model plugged into the same port, so there
+ * is no fingerprint for devices without one.
+ *
+ * @param[in] dev The USB device.
+ * @param[in] hdl An open handle of the device, or NULL to have the serial
+ *                number read through a temporary one.
+ * @param[out] id Buffer for the fingerprint.
+ * @param[in] id_len The size of @p id.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_NA The device has no serial number.
+ * @retval SR_ERR Failed to read the device's descriptors.
+ */
+SR_PRIV int usb_get_idcache_id(libusb_device *dev,
+		libusb_device_handle *hdl, char *id, int id_len)
+{
+	struct libusb_device_descriptor des;
+	libusb_device_handle *tmp_hdl;
+	unsigned char serial_num[64];
+	char path[64];
+	int ret;
+
+	ret = libusb_get_device_descriptor(dev, &des);
+	if (ret != 0)
+		return SR_ERR;
+	if (!des.iSerialNumber)
+		return SR_ERR_NA;
+	ret = usb_get_port_path(dev, path, sizeof(path));
+	if (ret != SR_OK)
+		return ret;
+
+	tmp_hdl = NULL;
+	if (!hdl) {
+		if (libusb_open(dev, &tmp_hdl) != 0)
+			return SR_ERR;
+		hdl = tmp_hdl;
+	}
+	ret = libusb_get_string_descriptor_ascii(hdl, des.iSerialNumber,
+		serial_num, sizeof(serial_num));
+	if (tmp_hdl)
+		libusb_close(tmp_hdl);
+	if (ret <= 0)
+		return ret < 0 ? SR_ERR : SR_ERR_NA;
+
+	snprintf(id, id_len, "%s/%04x.%04x/%s", path,
+		des.idVendor, des.idProduct, serial_num);
+
+	return SR_OK;
+}
+
 /**
  * Check the USB configuration to determine if this device has a given
  * manufacturer and product string.
@@ -598,3 +653,197 @@ SR_PRIV gboolean usb_match_manuf_prod(libusb_device *dev,
 
 	return ret;
 }
+
+/* Upper limit for the size of a single transfer. */
+#define USB_STREAM_MAX_SIZE	(4 * 1024 * 1024)
+/* Completions in time (per queued transfer) before transfers shrink. */
+#define USB_STREAM_CALM		8
+
+static size_t usb_stream_align(const struct sr_usb_stream *stream, size_t size)
+{
+	size = MAX(size, 1);
+
+	return (size + stream->granularity - 1)
+		/ stream->granularity * stream->granularity;
+}
+
+/* Hand the stream's counters to the session's device statistics. */
+static void usb_stream_stats_update(const struct sr_usb_stream *stream)
+{
+	struct sr_usb_stream_stats stats;
+
+	if (!stream->sdi)
+		return;
+	stats = stream->stats;
+	stats.size = stream->size;
+	stats.depth = stream->depth;
+	sr_session_dev_usb_stats_update(stream->sdi, &stats);
+}
+
+/**
+ * Setup the sizing of a stream's bulk transfers.
+ *
+ * Transfers start out with 10ms worth of data each, and the number of
+ * transfers is chosen to cover the requested queue time. At runtime
+ * the transfers may shrink to 2ms or grow to 100ms worth of data.
+ *
+ * @param[out] stream The stream to setup.
+ * @param[in] sdi The device, its session gets the stream's statistics.
+ * @param[in] bytes_per_ms The data rate of the stream.
+ * @param[in] granularity Transfer sizes are multiples of this (bulk
+ *                        packet size, or the device's data block size).
+ * @param[in] queue_ms The amount of data to keep in flight, in ms.
+ * @param[in] max_depth The maximum number of transfers in flight.
+ *
+ * @private
+ */
+SR_PRIV void sr_usb_stream_init(struct sr_usb_stream *stream,
+		const struct sr_dev_inst *sdi,
+		uint64_t bytes_per_ms, size_t granularity,
+		unsigned int queue_ms, unsigned int max_depth)
+{
+	uint64_t depth;
+
+	memset(stream, 0, sizeof(*stream));
+	stream->sdi = sdi;
+	stream->bytes_per_ms = MAX(bytes_per_ms, 1);
+	stream->granularity = MAX(granularity, 1);
+
+	stream->size = usb_stream_align(stream, 10 * stream->bytes_per_ms);
+	stream->min_size = usb_stream_align(stream, 2 * stream->bytes_per_ms);
+	stream->max_size = usb_stream_align(stream,
+		MIN(100 * stream->bytes_per_ms, USB_STREAM_MAX_SIZE));
+	stream->max_size = MAX(stream->max_size, stream->size);
+
+	depth = (queue_ms * stream->bytes_per_ms + stream->size - 1)
+		/ stream->size;
+	stream->depth = CLAMP(depth, 1, MAX(max_depth, 1));
+}
+
+/**
+ * Get the timeout for the stream's transfers, in ms.
+ *
+ * Covers the time it takes to fill all transfers in flight, with a
+ * headroom of 25%.
+ *
+ * @private
+ */
+SR_PRIV unsigned int sr_usb_stream_timeout(const struct sr_usb_stream *stream)
+{
+	uint64_t timeout;
+
+	timeout = stream->size * stream->depth / stream->bytes_per_ms;
+	timeout += timeout / 4;
+
+	return MAX(timeout, 1);
+}
+
+/**
+ * Account for a completed transfer, and adjust the transfer size.
+ *
+ * Must be called from the transfer callback before the data gets
+ * processed, so that slow consumers show up as late completions of
+ * the next transfer.
+ *
+ * @private
+ */
+SR_PRIV void sr_usb_stream_completed(struct sr_usb_stream *stream,
+		const struct libusb_transfer *transfer)
+{
+	int64_t now_us, dt_us, fill_us, jitter_us;
+
+	if (!transfer->actual_length) {
+		stream->stats.empty_transfers++;
+		usb_stream_stats_update(stream);
+		return;
+	}
+	stream->stats.transfers++;
+
+	now_us = g_get_monotonic_time();
+	fill_us = (int64_t)transfer->length * 1000 / stream->bytes_per_ms;
+	if (stream->last_us) {
+		dt_us = now_us - stream->last_us;
+		jitter_us = dt_us - fill_us;
+		stream->stats.jitter_max_us = MAX(stream->stats.jitter_max_us,
+			jitter_us);
+		if (dt_us > fill_us * stream->depth * 3 / 4) {
+			/* Most of the queue may be full already. Buffer more. */
+			stream->stats.near_overruns++;
+			stream->calm = 0;
+			if (stream->size < stream->max_size) {
+				stream->size = MIN(stream->max_size,
+					usb_stream_align(stream, stream->size * 2));
+				stream->stats.resizes++;
+				sr_dbg("Late completion (%" PRId64 "us), transfer size now %zu.",
+					dt_us, stream->size);
+			}
+		} else if (jitter_us < fill_us / 2) {
+			/* In time. Shrink transfers after a while to reduce latency. */
+			if (++stream->calm >= USB_STREAM_CALM * stream->depth
+					&& stream->size > stream->min_size) {
+				stream->size = MAX(stream->min_size,
+					usb_stream_align(stream, stream->size / 2));
+				stream->calm = 0;
+				stream->stats.resizes++;
+				sr_spew("Transfer size now %zu.", stream->size);
+			}
+		} else {
+			stream->calm = 0;
+		}
+	}
+	stream->last_us = now_us;
+	usb_stream_stats_update(stream);
+}
+
+/**
+ * Resubmit a stream's transfer, using the current transfer size.
+ *
+ * The transfer's buffer gets replaced when it needs to grow. It must
+ * come from the stream's pool if it has one, or must have been
+ * allocated with g_malloc() or one of its variants otherwise.
+ *
+ * @return The libusb_submit_transfer() result.
+ *
+ * @private
+ */
+SR_PRIV int sr_usb_stream_resubmit(struct sr_usb_stream *stream,
+		struct libusb_transfer *transfer)
+{
+	unsigned char *buf;
+
+	if ((size_t)transfer->length < stream->size) {
+		if (stream->pool) {
+			buf = sr_buffer_pool_get(stream->pool, stream->size);
+			if (buf)
+				sr_buffer_pool_put(stream->pool, transfer->buffer);
+		} else {
+			buf = g_try_realloc(transfer->buffer, stream->size);
+		}
+		if (buf) {
+			transfer->buffer = buf;
+			transfer->length = stream->size;
+		}
+	} else {
+		transfer->length = stream->size;
+	}
+	transfer->timeout = sr_usb_stream_timeout(stream);
+
+	return libusb_submit_transfer(transfer);
+}
+
+/**
+ * Log the statistics of a stream, typically at the end of an acquisition.
+ *
+ * @private
+ */
+SR_PRIV void sr_usb_stream_log_stats(const struct sr_usb_stream *stream)
+{
+	const struct sr_usb_stream_stats *stats;
+
+	stats = &stream->stats;
+	sr_dbg("USB stream: %" PRIu64 " transfers, %" PRIu64 " empty, %"
+		PRIu64 " near overruns, %" PRIu64 " resizes, max jitter %"
+		PRId64 "us, final size %zu x %u.", stats->transfers,
+		stats->empty_transfers, stats->near_overruns, stats->resizes,
+		stats->jitter_max_us, stream->size, stream->depth);
+}
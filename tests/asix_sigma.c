@@ -0,0 +1,279 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+#include "hardware/asix-sigma/protocol.h"
+#include "lib.h"
+
+/*
+ * Replay synthesized sample memory content through the SIGMA driver's
+ * DRAM decoder. Each capture gets decoded twice, once with the block
+ * path and once event by event, and both must submit the same samples
+ * and put trigger markers at the same positions.
+ */
+#define REPLAY_LINES		3
+#define REPLAY_LAST_EVENTS	200
+/* Line 1, cluster 14, event 2. */
+#define REPLAY_TRIGGER_POS	((1 << ROW_SHIFT) + 100)
+#define REPLAY_LIMIT		5000
+
+struct replay_result {
+	GByteArray *logic;
+	GArray *triggers;
+};
+
+static void replay_datafeed_in(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct replay_result *res;
+	const struct sr_datafeed_logic *logic;
+	uint64_t pos;
+
+	(void)sdi;
+
+	res = cb_data;
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		fail_unless(logic->unitsize == sizeof(uint16_t),
+			"Unexpected unitsize %u.", logic->unitsize);
+		g_byte_array_append(res->logic, logic->data, logic->length);
+		break;
+	case SR_DF_TRIGGER:
+		pos = res->logic->len / sizeof(uint16_t);
+		g_array_append_val(res->triggers, pos);
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * Fill DRAM lines with random sample data. Now and then the timestamp
+ * skips ahead like it does when the device RLE compresses idle input.
+ * Returns the number of events which the decoder has to submit for the
+ * clusters up to the stop position, including those of the gaps.
+ */
+static size_t replay_lines_fill(struct sigma_dram_line *lines, GRand *rand)
+{
+	struct sigma_dram_cluster *cl;
+	size_t line, cluster, evt, clusters, events;
+	uint16_t ts;
+
+	clusters = (REPLAY_LINES - 1) * CLUSTERS_PER_ROW;
+	clusters += (REPLAY_LAST_EVENTS + EVENTS_PER_CLUSTER - 1) /
+		EVENTS_PER_CLUSTER;
+	events = (REPLAY_LINES - 1) * EVENTS_PER_ROW + REPLAY_LAST_EVENTS;
+
+	ts = g_rand_int(rand);
+	for (line = 0; line < REPLAY_LINES; line++) {
+		for (cluster = 0; cluster < CLUSTERS_PER_ROW; cluster++) {
+			cl = &lines[line].cluster[cluster];
+			if ((line || cluster) && !g_rand_int_range(rand, 0, 4)) {
+				evt = g_rand_int_range(rand, 1, 1000);
+				ts += evt;
+				if (clusters)
+					events += evt;
+			}
+			if (clusters)
+				clusters--;
+			write_u16le((uint8_t *)&cl->timestamp, ts);
+			for (evt = 0; evt < EVENTS_PER_CLUSTER; evt++)
+				write_u16le((uint8_t *)&cl->samples[evt],
+					g_rand_int(rand));
+			ts += EVENTS_PER_CLUSTER;
+		}
+	}
+
+	return events;
+}
+
+static void replay_run(struct sr_dev_inst *sdi,
+	const struct sigma_dram_line *lines, uint32_t triggerpos,
+	uint8_t modestatus, gboolean per_event, struct replay_result *res)
+{
+	struct sr_session *session;
+	uint32_t stoppos;
+	int ret;
+
+	res->logic = g_byte_array_new();
+	res->triggers = g_array_new(FALSE, FALSE, sizeof(uint64_t));
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, replay_datafeed_in, res);
+	sdi->session = session;
+
+	stoppos = ((REPLAY_LINES - 1) << ROW_SHIFT) + REPLAY_LAST_EVENTS;
+	ret = sigma_replay_capture(sdi, lines, stoppos, triggerpos,
+		modestatus, per_event);
+	fail_unless(ret == SR_OK, "sigma_replay_capture() failed: %d.", ret);
+
+	sdi->session = NULL;
+	sr_session_destroy(session);
+}
+
+static void replay_result_free(struct replay_result *res)
+{
+	g_byte_array_free(res->logic, TRUE);
+	g_array_free(res->triggers, TRUE);
+}
+
+static void replay_compare(const struct replay_result *block,
+	const struct replay_result *events, size_t spe)
+{
+	size_t i, len;
+
+	len = MIN(block->logic->len, events->logic->len);
+	for (i = 0; i < len; i += sizeof(uint16_t)) {
+		if (memcmp(&block->logic->data[i], &events->logic->data[i],
+				sizeof(uint16_t)))
+			break;
+	}
+	fail_unless(i == len && block->logic->len == events->logic->len,
+		"%zu samples/event: block path differs at sample %zu "
+		"(%u vs. %u bytes).", spe, i / sizeof(uint16_t),
+		block->logic->len, events->logic->len);
+
+	fail_unless(block->triggers->len == events->triggers->len,
+		"%zu samples/event: %u vs. %u trigger markers.", spe,
+		block->triggers->len, events->triggers->len);
+	for (i = 0; i < block->triggers->len; i++) {
+		fail_unless(g_array_index(block->triggers, uint64_t, i) ==
+			g_array_index(events->triggers, uint64_t, i),
+			"%zu samples/event: trigger at %" PRIu64 " vs. %"
+			PRIu64 ".", spe,
+			g_array_index(block->triggers, uint64_t, i),
+			g_array_index(events->triggers, uint64_t, i));
+	}
+}
+
+/*
+ * Replay the capture of all three samplerate dependent memory layouts:
+ * one sample per event, and 2x8 and 4x4 interleaved samples.
+ */
+static void replay_check(uint16_t risingmask, uint16_t fallingmask,
+	uint64_t limit, size_t num_triggers)
+{
+	static const size_t channels[] = { 16, 8, 4 };
+	struct sr_dev_inst *sdi;
+	struct dev_context *devc;
+	struct sigma_dram_line *lines;
+	struct replay_result block, events;
+	GVariant *data;
+	GRand *rand;
+	uint32_t triggerpos;
+	uint8_t modestatus;
+	size_t i, spe, count;
+
+	lines = g_malloc0(REPLAY_LINES * sizeof(*lines));
+	rand = g_rand_new_with_seed(0x516a);
+	sdi = g_malloc0(sizeof(*sdi));
+	devc = g_malloc0(sizeof(*devc));
+	sdi->priv = devc;
+
+	for (i = 0; i < ARRAY_SIZE(channels); i++) {
+		count = replay_lines_fill(lines, rand);
+		spe = 16 / channels[i];
+		devc->interp.num_channels = channels[i];
+		devc->interp.samples_per_event = spe;
+
+		sr_sw_limits_init(&devc->limit.config);
+		if (limit) {
+			data = g_variant_new_uint64(limit);
+			sr_sw_limits_config_set(&devc->limit.config,
+				SR_CONF_LIMIT_SAMPLES, data);
+			g_variant_unref(data);
+		}
+
+		devc->use_triggers = risingmask || fallingmask;
+		devc->trigger.risingmask = risingmask;
+		devc->trigger.fallingmask = fallingmask;
+		triggerpos = devc->use_triggers ? REPLAY_TRIGGER_POS : ~0;
+		modestatus = devc->use_triggers ? RMR_TRIGGERED : 0;
+
+		replay_run(sdi, lines, triggerpos, modestatus, FALSE, &block);
+		replay_run(sdi, lines, triggerpos, modestatus, TRUE, &events);
+
+		if (limit)
+			count = MIN(count * spe, limit);
+		else
+			count *= spe;
+		fail_unless(events.logic->len == count * sizeof(uint16_t),
+			"%zu samples/event: got %u samples, expected %zu.",
+			spe, events.logic->len / (unsigned)sizeof(uint16_t),
+			count);
+		fail_unless(events.triggers->len == num_triggers,
+			"%zu samples/event: got %u trigger markers.",
+			spe, events.triggers->len);
+		replay_compare(&block, &events, spe);
+
+		replay_result_free(&block);
+		replay_result_free(&events);
+	}
+
+	g_free(devc);
+	g_free(sdi);
+	g_rand_free(rand);
+	g_free(lines);
+}
+
+/* Check RLE gaps and deinterlacing, without trigger supervision. */
+START_TEST(test_sigma_replay)
+{
+	replay_check(0, 0, 0, 0);
+}
+END_TEST
+
+/* Check that the block path stops at the samples limit, too. */
+START_TEST(test_sigma_replay_limit)
+{
+	replay_check(0, 0, REPLAY_LIMIT, 0);
+}
+END_TEST
+
+/*
+ * Check the clusters around the trigger position. A rising edge on the
+ * first channel is found by the software check. A condition which can
+ * never match has the marker forced at the hardware provided position.
+ */
+START_TEST(test_sigma_replay_trigger)
+{
+	replay_check(1 << 0, 0, 0, 1);
+	replay_check(1 << 0, 1 << 0, 0, 1);
+}
+END_TEST
+
+Suite *suite_asix_sigma(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("asix-sigma");
+
+	tc = tcase_create("replay");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_sigma_replay);
+	tcase_add_test(tc, test_sigma_replay_limit);
+	tcase_add_test(tc, test_sigma_replay_trigger);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
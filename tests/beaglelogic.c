@@ -0,0 +1,357 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/*
+ * A mock BeagleLogic TCP server. It answers the text commands of the
+ * driver, and streams 16bit samples (all channels are enabled) when
+ * the capture gets started. The data starts with a single byte, which
+ * does not complete a sample. The rest comes in bursts of small odd
+ * sized pieces, which the driver should drain in few reads, and which
+ * split samples across reads.
+ */
+#define MOCK_BYTES		48001
+#define MOCK_PIECE		101
+#define MOCK_BURST		32
+#define MOCK_BUFFERSIZE		(32 * 1024 * 1024)
+
+#define LIMIT_SAMPLES		20000
+
+struct mock_bl {
+	int listen_fd;
+	uint16_t port;
+	/* Close the connection after the data, instead of waiting. */
+	gboolean eof;
+	/* Number of data pieces sent. */
+	int pieces;
+};
+
+static uint8_t received[MOCK_BYTES];
+static size_t received_len;
+static int logic_packets;
+static gboolean have_header, have_end;
+
+static uint8_t mock_byte(size_t offset)
+{
+	uint16_t sample;
+
+	sample = offset / 2;
+	return (offset & 1) ? sample >> 8 : sample & 0xff;
+}
+
+static void mock_reply(int fd, const char *text)
+{
+	char *line;
+
+	line = g_strdup_printf("%s\n", text);
+	send(fd, line, strlen(line), MSG_NOSIGNAL);
+	g_free(line);
+}
+
+static void mock_send_samples(struct mock_bl *mock, int fd)
+{
+	uint8_t buf[MOCK_BYTES];
+	size_t i, len;
+	int burst;
+
+	for (i = 0; i < MOCK_BYTES; i++)
+		buf[i] = mock_byte(i);
+
+	send(fd, buf, 1, MSG_NOSIGNAL);
+	mock->pieces = 1;
+	g_usleep(30000);
+	burst = 0;
+	for (i = 1; i < MOCK_BYTES; i += len) {
+		len = MIN(MOCK_PIECE, MOCK_BYTES - i);
+		if (send(fd, buf + i, len, MSG_NOSIGNAL) < 0)
+			break;
+		mock->pieces++;
+		if (++burst == MOCK_BURST) {
+			burst = 0;
+			g_usleep(10000);
+		}
+	}
+	if (mock->eof)
+		shutdown(fd, SHUT_WR);
+}
+
+static gboolean mock_get_line(int fd, char *line, size_t size)
+{
+	size_t len;
+	char c;
+
+	len = 0;
+	while (recv(fd, &c, 1, 0) == 1) {
+		if (c == '\n') {
+			line[len] = '\0';
+			return TRUE;
+		}
+		if (len < size - 1)
+			line[len++] = c;
+	}
+
+	return FALSE;
+}
+
+static gpointer mock_bl_thread(gpointer data)
+{
+	struct mock_bl *mock;
+	char line[64], *value;
+	int conn, fd;
+
+	mock = data;
+
+	/* One connection for the scan, one for the acquisition. */
+	for (conn = 0; conn < 2; conn++) {
+		fd = accept(mock->listen_fd, NULL, NULL);
+		if (fd < 0)
+			break;
+		while (mock_get_line(fd, line, sizeof(line))) {
+			value = strchr(line, ' ');
+			if (value) {
+				/* All settings get accepted. */
+				mock_reply(fd, "OK");
+			} else if (!strcmp(line, "version")) {
+				mock_reply(fd, "BeagleLogic 1.0");
+			} else if (!strcmp(line, "samplerate")) {
+				mock_reply(fd, "100000000");
+			} else if (!strcmp(line, "sampleunit")) {
+				mock_reply(fd, "0");
+			} else if (!strcmp(line, "memalloc")) {
+				mock_reply(fd, G_STRINGIFY(MOCK_BUFFERSIZE));
+			} else if (!strcmp(line, "bufunitsize")) {
+				mock_reply(fd, "4194304");
+			} else if (!strcmp(line, "triggerflags")) {
+				mock_reply(fd, "1");
+			} else if (!strcmp(line, "get")) {
+				mock_send_samples(mock, fd);
+			}
+		}
+		close(fd);
+	}
+
+	return NULL;
+}
+
+static void mock_bl_listen(struct mock_bl *mock)
+{
+	struct sockaddr_in addr;
+	socklen_t len;
+	int ret;
+
+	mock->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	fail_unless(mock->listen_fd >= 0, "Cannot create socket.");
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	ret = bind(mock->listen_fd, (struct sockaddr *)&addr, sizeof(addr));
+	fail_unless(ret == 0, "Cannot bind socket.");
+	ret = listen(mock->listen_fd, 1);
+	fail_unless(ret == 0, "Cannot listen on socket.");
+
+	len = sizeof(addr);
+	getsockname(mock->listen_fd, (struct sockaddr *)&addr, &len);
+	mock->port = ntohs(addr.sin_port);
+}
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+
+	(void)sdi;
+	(void)cb_data;
+
+	switch (packet->type) {
+	case SR_DF_HEADER:
+		have_header = TRUE;
+		break;
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		fail_unless(logic->unitsize == 2);
+		fail_unless(logic->length % logic->unitsize == 0,
+			"Partial sample in a packet of %" PRIu64 " bytes.",
+			logic->length);
+		fail_unless(received_len + logic->length <= sizeof(received));
+		memcpy(received + received_len, logic->data, logic->length);
+		received_len += logic->length;
+		logic_packets++;
+		break;
+	case SR_DF_END:
+		have_end = TRUE;
+		break;
+	default:
+		break;
+	}
+}
+
+static struct sr_dev_driver *driver_find(const char *name)
+{
+	struct sr_dev_driver **drivers;
+	int i;
+
+	drivers = sr_driver_list(srtest_ctx);
+	for (i = 0; drivers && drivers[i]; i++) {
+		if (!strcmp(drivers[i]->name, name))
+			return drivers[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * Run an acquisition from the mock server. A 'limit' of 0 keeps the
+ * device in continuous mode, the mock then ends it by closing the
+ * connection.
+ */
+static void bl_run(uint64_t limit, struct mock_bl *mock)
+{
+	struct sr_dev_driver *driver;
+	struct sr_dev_inst *sdi;
+	struct sr_session *session;
+	struct sr_config *src;
+	GThread *thread;
+	GSList *options, *devices;
+	char *conn;
+	int ret;
+
+	driver = driver_find("beaglelogic");
+	ret = sr_driver_init(srtest_ctx, driver);
+	fail_unless(ret == SR_OK, "Failed to init driver: %d.", ret);
+
+	mock->eof = !limit;
+	mock->pieces = 0;
+	mock_bl_listen(mock);
+	thread = g_thread_new("mock-beaglelogic", mock_bl_thread, mock);
+
+	conn = g_strdup_printf("tcp/127.0.0.1/%u", mock->port);
+	src = g_malloc0(sizeof(*src));
+	src->key = SR_CONF_CONN;
+	src->data = g_variant_ref_sink(g_variant_new_string(conn));
+	options = g_slist_append(NULL, src);
+	devices = sr_driver_scan(driver, options);
+	fail_unless(g_slist_length(devices) == 1, "Mock device not found.");
+	sdi = devices->data;
+
+	ret = sr_dev_open(sdi);
+	fail_unless(ret == SR_OK, "Failed to open device: %d.", ret);
+	if (limit) {
+		ret = sr_config_set(sdi, NULL, SR_CONF_LIMIT_SAMPLES,
+			g_variant_new_uint64(limit));
+		fail_unless(ret == SR_OK, "Failed to set sample limit: %d.", ret);
+	}
+
+	received_len = 0;
+	logic_packets = 0;
+	have_header = have_end = FALSE;
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_dev_add(session, sdi);
+	sr_session_datafeed_callback_add(session, datafeed_in, NULL);
+	ret = sr_session_start(session);
+	fail_unless(ret == SR_OK, "Failed to start session: %d.", ret);
+	ret = sr_session_run(session);
+	fail_unless(ret == SR_OK, "Failed to run session: %d.", ret);
+
+	sr_dev_close(sdi);
+	g_thread_join(thread);
+	close(mock->listen_fd);
+	sr_session_destroy(session);
+
+	g_slist_free(devices);
+	g_slist_free(options);
+	g_variant_unref(src->data);
+	g_free(src);
+	g_free(conn);
+}
+
+static void bl_check(size_t expected, const struct mock_bl *mock)
+{
+	size_t i;
+
+	fail_unless(have_header && have_end, "Missing header or end packet.");
+	fail_unless(received_len == expected,
+		"Received %zu bytes, expected %zu.", received_len, expected);
+	for (i = 0; i < received_len; i++)
+		fail_unless(received[i] == mock_byte(i),
+			"Byte %zu mismatch.", i);
+	fail_unless(logic_packets > 1, "Samples were not streamed.");
+	fail_unless(logic_packets < mock->pieces,
+		"%d packets for %d pieces, reads were not batched.",
+		logic_packets, mock->pieces);
+}
+
+/*
+ * Check that the sample limit ends the acquisition, and that neither
+ * the initial short read nor samples split across reads do.
+ */
+START_TEST(test_beaglelogic_tcp_limit)
+{
+	struct mock_bl mock;
+
+	if (!driver_find("beaglelogic"))
+		return;
+
+	bl_run(LIMIT_SAMPLES, &mock);
+	bl_check(LIMIT_SAMPLES * 2, &mock);
+}
+END_TEST
+
+/* Check that all complete samples get sent when the connection ends. */
+START_TEST(test_beaglelogic_tcp_eof)
+{
+	struct mock_bl mock;
+
+	if (!driver_find("beaglelogic"))
+		return;
+
+	bl_run(0, &mock);
+	bl_check(MOCK_BYTES - MOCK_BYTES % 2, &mock);
+}
+END_TEST
+
+Suite *suite_beaglelogic(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("beaglelogic");
+
+	tc = tcase_create("tcp");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_set_timeout(tc, 10);
+	tcase_add_test(tc, test_beaglelogic_tcp_limit);
+	tcase_add_test(tc, test_beaglelogic_tcp_eof);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,221 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+#include "lib.h"
+
+static void check_stats(const struct sr_buffer_pool *pool,
+		uint64_t hits, uint64_t misses, uint64_t releases,
+		size_t size, unsigned int num_free)
+{
+	struct sr_buffer_pool_stats stats;
+
+	fail_unless(sr_buffer_pool_stats_get(pool, &stats) == SR_OK);
+	fail_unless(stats.hits == hits, "%" PRIu64 " hits, expected %"
+		PRIu64 ".", stats.hits, hits);
+	fail_unless(stats.misses == misses, "%" PRIu64 " misses, expected %"
+		PRIu64 ".", stats.misses, misses);
+	fail_unless(stats.releases == releases, "%" PRIu64 " releases, "
+		"expected %" PRIu64 ".", stats.releases, releases);
+	fail_unless(stats.size == size, "Buffer size %zu, expected %zu.",
+		stats.size, size);
+	fail_unless(stats.num_free == num_free, "%u free buffers, "
+		"expected %u.", stats.num_free, num_free);
+}
+
+/* Check that buffers which were put back get handed out again. */
+START_TEST(test_reuse)
+{
+	struct sr_buffer_pool *pool;
+	uint8_t *a, *b, *c;
+
+	pool = sr_buffer_pool_new(NULL, 2);
+	fail_unless(pool != NULL);
+	check_stats(pool, 0, 0, 0, 0, 0);
+
+	a = sr_buffer_pool_get(pool, 1000);
+	fail_unless(a != NULL);
+	fail_unless((uintptr_t)a % SR_BUFFER_POOL_ALIGN == 0,
+		"Buffer %p is not aligned.", a);
+	memset(a, 0x55, 1000);
+	check_stats(pool, 0, 1, 0, 1000, 0);
+
+	sr_buffer_pool_put(pool, a);
+	check_stats(pool, 0, 1, 0, 1000, 1);
+	b = sr_buffer_pool_get(pool, 1000);
+	fail_unless(b == a, "Buffer was not reused.");
+	check_stats(pool, 1, 1, 0, 1000, 0);
+
+	/* Smaller requests get a buffer of the pool's size. */
+	c = sr_buffer_pool_get(pool, 10);
+	fail_unless(c != NULL && c != b);
+	memset(c, 0xaa, 1000);
+	check_stats(pool, 1, 2, 0, 1000, 0);
+
+	sr_buffer_pool_put(pool, b);
+	sr_buffer_pool_put(pool, c);
+	check_stats(pool, 1, 2, 0, 1000, 2);
+	a = sr_buffer_pool_get(pool, 500);
+	b = sr_buffer_pool_get(pool, 1000);
+	fail_unless((a == c && b != c) || (b == c && a != c));
+	check_stats(pool, 3, 2, 0, 1000, 0);
+	sr_buffer_pool_put(pool, a);
+	sr_buffer_pool_put(pool, b);
+
+	sr_buffer_pool_free(pool);
+}
+END_TEST
+
+/* Check that at most max_free unused buffers are kept. */
+START_TEST(test_max_free)
+{
+	struct sr_buffer_pool *pool;
+	void *buf[3];
+	unsigned int i;
+
+	pool = sr_buffer_pool_new(NULL, 2);
+	for (i = 0; i < ARRAY_SIZE(buf); i++)
+		buf[i] = sr_buffer_pool_get(pool, 64);
+	check_stats(pool, 0, 3, 0, 64, 0);
+	for (i = 0; i < ARRAY_SIZE(buf); i++)
+		sr_buffer_pool_put(pool, buf[i]);
+	check_stats(pool, 0, 3, 1, 64, 2);
+
+	for (i = 0; i < ARRAY_SIZE(buf); i++)
+		buf[i] = sr_buffer_pool_get(pool, 64);
+	check_stats(pool, 2, 4, 1, 64, 0);
+	for (i = 0; i < ARRAY_SIZE(buf); i++)
+		sr_buffer_pool_put(pool, buf[i]);
+	check_stats(pool, 2, 4, 2, 64, 2);
+
+	sr_buffer_pool_free(pool);
+}
+END_TEST
+
+/* Check that a larger request grows the pool and drops smaller buffers. */
+START_TEST(test_grow)
+{
+	struct sr_buffer_pool *pool;
+	uint8_t *a, *b, *c;
+
+	pool = sr_buffer_pool_new(NULL, 4);
+	a = sr_buffer_pool_get(pool, 100);
+	b = sr_buffer_pool_get(pool, 100);
+	sr_buffer_pool_put(pool, b);
+	check_stats(pool, 0, 2, 0, 100, 1);
+
+	/* The unused small buffer is dropped, no hit. */
+	c = sr_buffer_pool_get(pool, 4000);
+	fail_unless(c != NULL);
+	memset(c, 0x55, 4000);
+	check_stats(pool, 0, 3, 0, 4000, 0);
+
+	/* The small buffer still in use is freed when put back. */
+	sr_buffer_pool_put(pool, a);
+	check_stats(pool, 0, 3, 1, 4000, 0);
+	sr_buffer_pool_put(pool, c);
+	check_stats(pool, 0, 3, 1, 4000, 1);
+	a = sr_buffer_pool_get(pool, 4000);
+	fail_unless(a == c, "Grown buffer was not reused.");
+	check_stats(pool, 1, 3, 1, 4000, 0);
+	sr_buffer_pool_put(pool, a);
+
+	sr_buffer_pool_free(pool);
+}
+END_TEST
+
+START_TEST(test_args)
+{
+	struct sr_buffer_pool *pool;
+	struct sr_buffer_pool_stats stats;
+
+	pool = sr_buffer_pool_new(NULL, 0);
+	fail_unless(sr_buffer_pool_stats_get(NULL, &stats) == SR_ERR_ARG);
+	fail_unless(sr_buffer_pool_stats_get(pool, NULL) == SR_ERR_ARG);
+	fail_unless(sr_buffer_pool_get(NULL, 100) == NULL);
+	sr_buffer_pool_put(pool, NULL);
+	check_stats(pool, 0, 0, 0, 0, 0);
+	sr_buffer_pool_free(pool);
+	sr_buffer_pool_free(NULL);
+}
+END_TEST
+
+/* Check that a device's pool shows up in its session statistics. */
+START_TEST(test_dev_stats)
+{
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	struct sr_buffer_pool *pool;
+	struct sr_dev_stats stats;
+	void *a, *b;
+
+	sr_session_new(srtest_ctx, &session);
+	sdi = g_malloc0(sizeof(*sdi));
+	sdi->session = session;
+	pool = sr_buffer_pool_new(sdi, 2);
+
+	/* Nothing gets counted before statistics are enabled. */
+	a = sr_buffer_pool_get(pool, 256);
+	fail_unless(sr_session_dev_stats_get(session, sdi, &stats) == SR_ERR_NA);
+
+	sr_session_stats_enable(session, TRUE);
+	sr_buffer_pool_put(pool, a);
+	a = sr_buffer_pool_get(pool, 256);
+	b = sr_buffer_pool_get(pool, 256);
+	fail_unless(sr_session_dev_stats_get(session, sdi, &stats) == SR_OK);
+	fail_unless(stats.pool.hits == 1 && stats.pool.misses == 2,
+		"%" PRIu64 " hits, %" PRIu64 " misses.",
+		stats.pool.hits, stats.pool.misses);
+	fail_unless(stats.pool.size == 256 && stats.pool.num_free == 0);
+	fail_unless(stats.packets == 0);
+
+	sr_buffer_pool_put(pool, a);
+	sr_buffer_pool_put(pool, b);
+	fail_unless(sr_session_dev_stats_get(session, sdi, &stats) == SR_OK);
+	fail_unless(stats.pool.num_free == 2);
+
+	sr_buffer_pool_free(pool);
+	g_free(sdi);
+	sr_session_destroy(session);
+}
+END_TEST
+
+Suite *suite_buffer_pool(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("buffer-pool");
+
+	tc = tcase_create("core");
+	tcase_add_test(tc, test_reuse);
+	tcase_add_test(tc, test_max_free);
+	tcase_add_test(tc, test_grow);
+	tcase_add_test(tc, test_args);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("stats");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_dev_stats);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -238,6 +238,69 @@ START_TEST(test_endian_write_inc)
 }
 END_TEST
 
+/* Two bytes per sample: D0 toggles every sample, D9 every 3 samples. */
+static void fill_logic(uint8_t *data, size_t count)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		data[2 * i] = i & 1;
+		data[2 * i + 1] = ((i / 3) & 1) << 1;
+	}
+}
+
+START_TEST(test_logic_bitplanes)
+{
+	uint8_t data[2 * 100];
+	uint64_t d0[2], d9[2], *planes[2];
+	unsigned int channels[2] = { 9, 0 };
+	size_t i;
+	int ret;
+
+	fill_logic(data, 100);
+	planes[0] = d9;
+	planes[1] = d0;
+	ret = sr_logic_to_bitplanes(data, 100, 2, channels, 2, planes);
+	fail_unless(ret == SR_OK);
+	for (i = 0; i < 100; i++) {
+		fail_unless(((d0[i / 64] >> (i % 64)) & 1) == (i & 1),
+			"D0 mismatch at sample %zu.", i);
+		fail_unless(((d9[i / 64] >> (i % 64)) & 1) == ((i / 3) & 1),
+			"D9 mismatch at sample %zu.", i);
+	}
+	fail_unless((d0[1] >> 36) == 0, "Unused bits are set.");
+
+	channels[0] = 16;
+	ret = sr_logic_to_bitplanes(data, 100, 2, channels, 2, planes);
+	fail_unless(ret == SR_ERR_ARG);
+}
+END_TEST
+
+START_TEST(test_bitplane_edges)
+{
+	uint8_t data[2 * 100];
+	uint64_t d9[2], edges[40], count, *planes[1];
+	unsigned int channels[1] = { 9 };
+	size_t i;
+
+	fill_logic(data, 100);
+	planes[0] = d9;
+	sr_logic_to_bitplanes(data, 100, 2, channels, 1, planes);
+
+	/* Transitions at samples 3, 6, ..., 99. */
+	count = sr_bitplane_edges(d9, 100, NULL, 0);
+	fail_unless(count == 33, "Counted %" PRIu64 " edges.", count);
+	count = sr_bitplane_edges(d9, 100, edges, 10);
+	fail_unless(count == 33);
+	for (i = 0; i < 10; i++)
+		fail_unless(edges[i] == 3 * (i + 1), "Edge %zu at %" PRIu64 ".",
+			i, edges[i]);
+	count = sr_bitplane_edges(d9, 99, edges, G_N_ELEMENTS(edges));
+	fail_unless(count == 32);
+	fail_unless(edges[31] == 96);
+}
+END_TEST
+
 Suite *suite_conv(void)
 {
 	Suite *s;
@@ -253,5 +316,10 @@ Suite *suite_conv(void)
 	tcase_add_test(tc, test_endian_write_inc);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("logic");
+	tcase_add_test(tc, test_logic_bitplanes);
+	tcase_add_test(tc, test_bitplane_edges);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
@@ -0,0 +1,500 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+/* Logic data received from the demo device during one acquisition. */
+static GByteArray *received;
+static int64_t trigger_pos;
+static gboolean have_end;
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+
+	(void)sdi;
+	(void)cb_data;
+
+	switch (packet->type) {
+	case SR_DF_TRIGGER:
+		trigger_pos = received->len;
+		break;
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		g_byte_array_append(received, logic->data, logic->length);
+		break;
+	case SR_DF_END:
+		have_end = TRUE;
+		break;
+	default:
+		break;
+	}
+}
+
+static struct sr_channel_group *logic_cg_get(const struct sr_dev_inst *sdi)
+{
+	struct sr_channel_group *cg;
+	GSList *l;
+
+	for (l = sr_dev_inst_channel_groups_get(sdi); l; l = l->next) {
+		cg = l->data;
+		if (!strcmp(cg->name, "Logic"))
+			return cg;
+	}
+	fail("No logic channel group.");
+
+	return NULL;
+}
+
+static void logic_cg_set(const struct sr_dev_inst *sdi, uint32_t key,
+	GVariant *data)
+{
+	int ret;
+
+	ret = sr_config_set(sdi, logic_cg_get(sdi), key, data);
+	fail_unless(ret == SR_OK, "Failed to set key %u: %d.", key, ret);
+}
+
+/* Run one acquisition, collect the logic data in 'received'. */
+static void demo_capture(struct sr_dev_inst *sdi, struct sr_trigger *trig)
+{
+	struct sr_session *session;
+	int ret;
+
+	if (received)
+		g_byte_array_free(received, TRUE);
+	received = g_byte_array_new();
+	trigger_pos = -1;
+	have_end = FALSE;
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_dev_add(session, sdi);
+	sr_session_datafeed_callback_add(session, datafeed_in, NULL);
+	if (trig)
+		sr_session_trigger_set(session, trig);
+	ret = sr_session_start(session);
+	fail_unless(ret == SR_OK, "Failed to start session: %d.", ret);
+	ret = sr_session_run(session);
+	fail_unless(ret == SR_OK, "Failed to run session: %d.", ret);
+	sr_session_destroy(session);
+
+	fail_unless(have_end, "Missing end packet.");
+}
+
+static void demo_teardown(void)
+{
+	if (received)
+		g_byte_array_free(received, TRUE);
+	received = NULL;
+	srtest_teardown();
+}
+
+/*
+ * Check that I2C messages are separated by a STOP condition and at least
+ * a bit time of a free bus (SCL and SDA high), also when the bus is
+ * always busy. SCL is on D0, SDA on D1.
+ */
+#define I2C_SAMPLES	20000
+#define I2C_BIT		20
+
+START_TEST(test_demo_i2c_idle)
+{
+	struct sr_dev_inst *sdi;
+	gboolean scl, sda, prev_scl, prev_sda, stopped;
+	size_t i, idle, starts;
+
+	sdi = srtest_demo_dev_new(8, 0, I2C_SAMPLES);
+	sr_config_set(sdi, NULL, SR_CONF_UNPACED, g_variant_new_boolean(TRUE));
+	logic_cg_set(sdi, SR_CONF_PATTERN_MODE, g_variant_new_string("i2c"));
+	logic_cg_set(sdi, SR_CONF_OUTPUT_FREQUENCY,
+		g_variant_new_double(SR_KHZ(200) / I2C_BIT));
+	logic_cg_set(sdi, SR_CONF_DUTY_CYCLE, g_variant_new_double(100.0));
+	demo_capture(sdi, NULL);
+	fail_unless(received->len == I2C_SAMPLES,
+		"Got %u samples.", received->len);
+
+	prev_scl = prev_sda = TRUE;
+	stopped = TRUE;
+	idle = I2C_BIT;
+	starts = 0;
+	for (i = 0; i < received->len; i++) {
+		scl = received->data[i] & 1;
+		sda = (received->data[i] >> 1) & 1;
+		if (scl && prev_scl && prev_sda && !sda) {
+			fail_unless(stopped, "START at %zu without a STOP.", i);
+			fail_unless(idle >= I2C_BIT,
+				"START at %zu after %zu idle samples.", i, idle);
+			stopped = FALSE;
+			starts++;
+		}
+		if (scl && prev_scl && !prev_sda && sda) {
+			stopped = TRUE;
+			idle = 0;
+		}
+		if (scl && sda)
+			idle++;
+		prev_scl = scl;
+		prev_sda = sda;
+	}
+	fail_unless(starts > 2, "Only %zu messages.", starts);
+
+	sr_dev_close(sdi);
+}
+END_TEST
+
+/*
+ * Check that CS# is deasserted for at least half a bit time between SPI
+ * messages, also when the bus is always busy, and that the clock idles
+ * low meanwhile. CLK is on D0, CS# on D3.
+ */
+#define SPI_SAMPLES	20000
+#define SPI_BIT		20
+
+START_TEST(test_demo_spi_cs)
+{
+	struct sr_dev_inst *sdi;
+	gboolean clk, cs, prev_cs;
+	size_t i, high, messages;
+
+	sdi = srtest_demo_dev_new(8, 0, SPI_SAMPLES);
+	sr_config_set(sdi, NULL, SR_CONF_UNPACED, g_variant_new_boolean(TRUE));
+	logic_cg_set(sdi, SR_CONF_PATTERN_MODE, g_variant_new_string("spi"));
+	logic_cg_set(sdi, SR_CONF_OUTPUT_FREQUENCY,
+		g_variant_new_double(SR_KHZ(200) / SPI_BIT));
+	logic_cg_set(sdi, SR_CONF_DUTY_CYCLE, g_variant_new_double(100.0));
+	demo_capture(sdi, NULL);
+	fail_unless(received->len == SPI_SAMPLES,
+		"Got %u samples.", received->len);
+
+	prev_cs = (received->data[0] >> 3) & 1;
+	high = 0;
+	messages = 0;
+	for (i = 0; i < received->len; i++) {
+		clk = received->data[i] & 1;
+		cs = (received->data[i] >> 3) & 1;
+		if (cs) {
+			fail_unless(!clk, "CLK high at %zu while CS# is high.", i);
+			high++;
+		}
+		if (prev_cs && !cs) {
+			fail_unless(high >= SPI_BIT / 2,
+				"CS# asserted at %zu after %zu samples high.",
+				i, high);
+			messages++;
+		}
+		if (!cs)
+			high = 0;
+		prev_cs = cs;
+	}
+	fail_unless(messages > 2, "Only %zu messages.", messages);
+
+	sr_dev_close(sdi);
+}
+END_TEST
+
+/*
+ * Soft trigger checks. The random pattern is the same for every new
+ * demo device, a capture without a trigger tells where a trigger must
+ * fire. Triggers which fully specify a sample and its predecessor can
+ * be placed at packet boundaries: in unpaced mode, the demo device
+ * sends TRIG_PACKET bytes per logic packet.
+ */
+#define TRIG_SAMPLES	40000
+#define TRIG_PACKET	4096
+#define TRIG_MATCHES	16
+
+struct trig_match {
+	int channel;
+	int match;
+};
+
+static struct sr_dev_inst *trig_dev_new(int num_logic, const char *pattern,
+	uint64_t capture_ratio)
+{
+	struct sr_dev_inst *sdi;
+
+	sdi = srtest_demo_dev_new(num_logic, 0, TRIG_SAMPLES);
+	sr_config_set(sdi, NULL, SR_CONF_UNPACED, g_variant_new_boolean(TRUE));
+	sr_config_set(sdi, NULL, SR_CONF_CAPTURE_RATIO,
+		g_variant_new_uint64(capture_ratio));
+	logic_cg_set(sdi, SR_CONF_PATTERN_MODE, g_variant_new_string(pattern));
+
+	return sdi;
+}
+
+static GByteArray *trig_reference(int num_logic, const char *pattern)
+{
+	struct sr_dev_inst *sdi;
+	GByteArray *ref;
+
+	sdi = trig_dev_new(num_logic, pattern, 0);
+	demo_capture(sdi, NULL);
+	sr_dev_close(sdi);
+	ref = received;
+	received = NULL;
+	fail_unless(ref->len == TRIG_SAMPLES * ((num_logic + 7) / 8),
+		"Got %u bytes.", ref->len);
+
+	return ref;
+}
+
+static int sample_bit(const GByteArray *ref, int unitsize, size_t n, int ch)
+{
+	return (ref->data[n * unitsize + ch / 8] >> (ch % 8)) & 1;
+}
+
+/* Sample by sample, like the trigger without the prefilter. */
+static int64_t ref_first_match(const GByteArray *ref, int unitsize,
+	const struct trig_match *m, int num)
+{
+	size_t n, count;
+	int i, bit, prev, ok;
+
+	count = ref->len / unitsize;
+	for (n = 0; n < count; n++) {
+		ok = TRUE;
+		for (i = 0; ok && i < num; i++) {
+			bit = sample_bit(ref, unitsize, n, m[i].channel);
+			prev = n ? sample_bit(ref, unitsize, n - 1, m[i].channel) : -1;
+			switch (m[i].match) {
+			case SR_TRIGGER_ZERO:
+				ok = !bit;
+				break;
+			case SR_TRIGGER_ONE:
+				ok = bit;
+				break;
+			case SR_TRIGGER_RISING:
+				ok = prev == 0 && bit;
+				break;
+			case SR_TRIGGER_FALLING:
+				ok = prev == 1 && !bit;
+				break;
+			case SR_TRIGGER_EDGE:
+				ok = prev >= 0 && prev != bit;
+				break;
+			}
+		}
+		if (ok)
+			return n;
+	}
+
+	return -1;
+}
+
+/* Match the levels of sample 'n', and its edges unless 'levels_only'. */
+static int trig_spec(const GByteArray *ref, int num_logic, size_t n,
+	gboolean levels_only, gboolean any_edge, struct trig_match *m)
+{
+	int ch, bit, prev, unitsize;
+
+	unitsize = (num_logic + 7) / 8;
+	for (ch = 0; ch < num_logic; ch++) {
+		bit = sample_bit(ref, unitsize, n, ch);
+		prev = n ? sample_bit(ref, unitsize, n - 1, ch) : bit;
+		m[ch].channel = ch;
+		if (levels_only || prev == bit)
+			m[ch].match = bit ? SR_TRIGGER_ONE : SR_TRIGGER_ZERO;
+		else if (any_edge)
+			m[ch].match = SR_TRIGGER_EDGE;
+		else
+			m[ch].match = bit ? SR_TRIGGER_RISING : SR_TRIGGER_FALLING;
+	}
+
+	return num_logic;
+}
+
+/*
+ * Find the first sample from 'start' on, in steps of 'step', where the
+ * fully specified trigger doesn't fire earlier.
+ */
+static size_t trig_find(const GByteArray *ref, int num_logic, size_t start,
+	size_t step, gboolean any_edge, struct trig_match *m)
+{
+	size_t n, count;
+	int num, unitsize;
+
+	unitsize = (num_logic + 7) / 8;
+	count = ref->len / unitsize;
+	for (n = start; n < count; n += step) {
+		num = trig_spec(ref, num_logic, n, FALSE, any_edge, m);
+		if (ref_first_match(ref, unitsize, m, num) == (int64_t)n)
+			return n;
+	}
+	fail("No trigger position found from %zu on.", start);
+
+	return 0;
+}
+
+/*
+ * Capture with the trigger, compare with the reference. The capture
+ * starts with the pre-trigger history, as much of it as there is.
+ */
+static void trig_check(const GByteArray *ref, int num_logic,
+	const char *pattern, uint64_t capture_ratio,
+	const struct trig_match *m, int num)
+{
+	struct sr_dev_inst *sdi;
+	struct sr_trigger *trig;
+	struct sr_trigger_stage *stage;
+	struct sr_channel *ch;
+	int64_t expected, pre;
+	size_t offset;
+	int i, unitsize;
+
+	unitsize = (num_logic + 7) / 8;
+	expected = ref_first_match(ref, unitsize, m, num);
+	fail_unless(expected >= 0, "Trigger never fires.");
+	pre = MIN(expected, (int64_t)(capture_ratio * TRIG_SAMPLES / 100));
+
+	sdi = trig_dev_new(num_logic, pattern, capture_ratio);
+	trig = sr_trigger_new(NULL);
+	stage = sr_trigger_stage_add(trig);
+	for (i = 0; i < num; i++) {
+		ch = g_slist_nth_data(sr_dev_inst_channels_get(sdi), m[i].channel);
+		sr_trigger_match_add(stage, ch, m[i].match, 0);
+	}
+	demo_capture(sdi, trig);
+	sr_dev_close(sdi);
+	sr_trigger_free(trig);
+
+	offset = (expected - pre) * unitsize;
+	fail_unless(trigger_pos == pre * unitsize,
+		"Trigger at byte %" PRId64 ", expected %" PRId64 " samples.",
+		trigger_pos, pre);
+	fail_unless(received->len > 0 && offset + received->len <= ref->len,
+		"Got %u bytes after sample %" PRId64 ".", received->len, expected);
+	fail_unless(!memcmp(received->data, ref->data + offset, received->len),
+		"Expected the trigger at sample %" PRId64 " (unitsize %d).",
+		expected, unitsize);
+}
+
+/*
+ * Check level and edge triggers at packet starts, packet ends and at
+ * offsets which are not a multiple of the eight samples which the
+ * prefilter checks at a time, for one and two byte samples.
+ */
+START_TEST(test_demo_trigger_prefilter)
+{
+	static const int num_logic[] = { 8, 16 };
+	static const struct trig_match single[][2] = {
+		{ { 3, SR_TRIGGER_EDGE }, { -1, 0 } },
+		{ { 0, SR_TRIGGER_RISING }, { 1, SR_TRIGGER_ONE } },
+		{ { 7, SR_TRIGGER_FALLING }, { 2, SR_TRIGGER_ZERO } },
+	};
+	struct trig_match m[TRIG_MATCHES];
+	GByteArray *ref;
+	size_t packet, n;
+	int i, j, num;
+
+	for (i = 0; i < (int)G_N_ELEMENTS(num_logic); i++) {
+		ref = trig_reference(num_logic[i], "random");
+		packet = TRIG_PACKET / ((num_logic[i] + 7) / 8);
+
+		/* Fully specified, at a packet start and end. */
+		n = trig_find(ref, num_logic[i], packet, packet, FALSE, m);
+		trig_check(ref, num_logic[i], "random", 0, m, num_logic[i]);
+		n = trig_find(ref, num_logic[i], packet - 1, packet, FALSE, m);
+		trig_check(ref, num_logic[i], "random", 0, m, num_logic[i]);
+		/* Unaligned, within a packet. */
+		n = trig_find(ref, num_logic[i], packet + 8 * 11 + 3, packet,
+			FALSE, m);
+		fail_unless(n % 8, "Aligned trigger position.");
+		trig_check(ref, num_logic[i], "random", 0, m, num_logic[i]);
+		/* With "any edge" matches. */
+		n = trig_find(ref, num_logic[i], 1003, 1, TRUE, m);
+		trig_check(ref, num_logic[i], "random", 0, m, num_logic[i]);
+
+		/* Levels only, also of the very first sample. */
+		num = trig_spec(ref, num_logic[i], 0, TRUE, FALSE, m);
+		trig_check(ref, num_logic[i], "random", 0, m, num);
+		num = trig_spec(ref, num_logic[i], 5003, TRUE, FALSE, m);
+		trig_check(ref, num_logic[i], "random", 0, m, num);
+
+		/* Single edges, matching all over the place. */
+		for (j = 0; j < (int)G_N_ELEMENTS(single); j++) {
+			num = single[j][1].channel < 0 ? 1 : 2;
+			trig_check(ref, num_logic[i], "random", 0,
+				single[j], num);
+		}
+
+		g_byte_array_free(ref, TRUE);
+	}
+}
+END_TEST
+
+/*
+ * Check the pre-trigger history, when the trigger fires before and
+ * after the history filled up. The random pattern's history gets
+ * copied, the periodic sigrok pattern's history refers to the demo
+ * device's pattern memory in unpaced mode.
+ */
+#define TRIG_RATIO	25
+
+START_TEST(test_demo_trigger_history)
+{
+	static const int num_logic[] = { 8, 16 };
+	static const struct trig_match early[] = {
+		{ 0, SR_TRIGGER_RISING }, { 1, SR_TRIGGER_ONE },
+	};
+	struct trig_match m[TRIG_MATCHES];
+	GByteArray *ref;
+	int i, num;
+
+	for (i = 0; i < (int)G_N_ELEMENTS(num_logic); i++) {
+		ref = trig_reference(num_logic[i], "random");
+		trig_check(ref, num_logic[i], "random", TRIG_RATIO,
+			early, G_N_ELEMENTS(early));
+		/* Late enough for the history to wrap around. */
+		trig_find(ref, num_logic[i], 3 * TRIG_PACKET + 5, 1, FALSE, m);
+		trig_check(ref, num_logic[i], "random", TRIG_RATIO,
+			m, num_logic[i]);
+		g_byte_array_free(ref, TRUE);
+
+		ref = trig_reference(num_logic[i], "sigrok");
+		num = trig_spec(ref, num_logic[i], 100, TRUE, FALSE, m);
+		trig_check(ref, num_logic[i], "sigrok", TRIG_RATIO, m, num);
+		g_byte_array_free(ref, TRUE);
+	}
+}
+END_TEST
+
+Suite *suite_demo(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("demo");
+
+	tc = tcase_create("pattern");
+	tcase_add_checked_fixture(tc, srtest_setup, demo_teardown);
+	tcase_add_test(tc, test_demo_i2c_idle);
+	tcase_add_test(tc, test_demo_spi_cs);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("trigger");
+	tcase_add_checked_fixture(tc, srtest_setup, demo_teardown);
+	tcase_add_test(tc, test_demo_trigger_prefilter);
+	tcase_add_test(tc, test_demo_trigger_history);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,168 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+#include "lib.h"
+
+#define USB_DEVS	2
+#define USB_LIMIT	10000
+/* How long the devices may take without the session's main loop. */
+#define USB_WAIT_US	(5 * G_USEC_PER_SEC)
+
+struct usb_feed {
+	const struct sr_dev_inst *sdi;
+	uint64_t packets;
+	uint64_t logic_samples;
+	gint have_end;
+};
+
+static struct {
+	GThread *session_thread;
+	gint on_session_thread;
+	struct usb_feed dev[USB_DEVS];
+} usb_feed;
+
+static struct usb_feed *usb_feed_get(const struct sr_dev_inst *sdi)
+{
+	int i;
+
+	for (i = 0; i < USB_DEVS; i++) {
+		if (usb_feed.dev[i].sdi == sdi)
+			return &usb_feed.dev[i];
+	}
+	fail("Packet from an unknown device.");
+
+	return NULL;
+}
+
+static void usb_datafeed_in(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+	struct usb_feed *uf;
+
+	(void)cb_data;
+
+	if (g_thread_self() == usb_feed.session_thread)
+		g_atomic_int_set(&usb_feed.on_session_thread, 1);
+	uf = usb_feed_get(sdi);
+	uf->packets++;
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		uf->logic_samples += logic->length / logic->unitsize;
+		break;
+	case SR_DF_END:
+		g_atomic_int_set(&uf->have_end, 1);
+		break;
+	default:
+		break;
+	}
+}
+
+static gboolean usb_feed_done(void)
+{
+	int i;
+
+	for (i = 0; i < USB_DEVS; i++) {
+		if (!g_atomic_int_get(&usb_feed.dev[i].have_end))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/*
+ * Run two devices which pose as USB devices on device threads. They
+ * share one thread, which must not be the session's: they finish their
+ * acquisitions before the session's main loop even runs.
+ */
+START_TEST(test_dev_threads_usb)
+{
+	struct sr_session *sess;
+	struct sr_dev_inst *sdi[USB_DEVS];
+	struct sr_pipeline_stats stats;
+	gint64 deadline;
+	int ret, i, inst_type;
+
+	memset(&usb_feed, 0, sizeof(usb_feed));
+	usb_feed.session_thread = g_thread_self();
+
+	sr_session_new(srtest_ctx, &sess);
+	for (i = 0; i < USB_DEVS; i++) {
+		sdi[i] = srtest_demo_dev_new(8, 0, USB_LIMIT);
+		inst_type = sdi[i]->inst_type;
+		sdi[i]->inst_type = SR_INST_USB;
+		usb_feed.dev[i].sdi = sdi[i];
+		sr_session_dev_add(sess, sdi[i]);
+	}
+	sr_session_datafeed_callback_add(sess, usb_datafeed_in, NULL);
+	ret = sr_session_dev_threads_set(sess, TRUE,
+		SR_DEV_THREAD_ROUND_ROBIN, 0);
+	fail_unless(ret == SR_OK, "sr_session_dev_threads_set() failed: %d.", ret);
+
+	ret = sr_session_start(sess);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	deadline = g_get_monotonic_time() + USB_WAIT_US;
+	while (!usb_feed_done() && g_get_monotonic_time() < deadline)
+		g_usleep(1000);
+	fail_unless(usb_feed_done(),
+		"USB devices did not finish without the session thread.");
+	ret = sr_session_run(sess);
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+
+	fail_unless(!g_atomic_int_get(&usb_feed.on_session_thread),
+		"Callback ran on the session thread.");
+	for (i = 0; i < USB_DEVS; i++) {
+		fail_unless(usb_feed.dev[i].logic_samples == USB_LIMIT,
+			"Device %d sent %" PRIu64 " logic samples.", i,
+			usb_feed.dev[i].logic_samples);
+		ret = sr_session_dev_queue_stats_get(sess, sdi[i], &stats);
+		fail_unless(ret == SR_OK, "No queue counters: %d.", ret);
+		fail_unless(stats.packets == usb_feed.dev[i].packets,
+			"Dispatched %" PRIu64 " of %" PRIu64 " packets.",
+			stats.packets, usb_feed.dev[i].packets);
+	}
+
+	sr_session_destroy(sess);
+	for (i = 0; i < USB_DEVS; i++) {
+		/* The demo device has no USB connection to be freed. */
+		sdi[i]->inst_type = inst_type;
+		sr_dev_close(sdi[i]);
+	}
+}
+END_TEST
+
+Suite *suite_dev_threads(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("dev-threads");
+
+	tc = tcase_create("usb");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_set_timeout(tc, 10);
+	tcase_add_test(tc, test_dev_threads_usb);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -19,6 +19,7 @@
 
 #include <config.h>
 #include <stdlib.h>
+#include <string.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
@@ -40,6 +41,50 @@ START_TEST(test_driver_init_all)
 }
 END_TEST
 
+/*
+ * Check whether concurrent scans merge their results in request order.
+ *
+ * Uses the demo driver (when available), which doesn't need hardware.
+ */
+START_TEST(test_driver_scan_concurrent)
+{
+	struct sr_dev_driver **drivers, *driver;
+	struct sr_scan_request requests[4];
+	GSList *devices, *instances, *l, *m;
+	unsigned int i;
+
+	driver = NULL;
+	drivers = sr_driver_list(srtest_ctx);
+	for (i = 0; drivers && drivers[i]; i++) {
+		if (strcmp(drivers[i]->name, "demo") == 0)
+			driver = drivers[i];
+	}
+	if (!driver)
+		return;
+	srtest_driver_init(srtest_ctx, driver);
+
+	for (i = 0; i < ARRAY_SIZE(requests); i++) {
+		requests[i].driver = driver;
+		requests[i].options = NULL;
+	}
+	devices = sr_driver_scan_concurrent(requests, ARRAY_SIZE(requests), 2, 0);
+	fail_unless(g_slist_length(devices) == ARRAY_SIZE(requests),
+		"Unexpected number of devices found.");
+
+	/* The driver's instance list must end with the same devices. */
+	instances = sr_dev_list(driver);
+	l = g_slist_nth(instances,
+		g_slist_length(instances) - ARRAY_SIZE(requests));
+	for (m = devices; m; m = m->next, l = l->next) {
+		fail_unless(l != NULL && l->data == m->data,
+			"Instance list does not match scan results.");
+		fail_unless(sr_dev_inst_driver_get(m->data) == driver,
+			"Device has wrong driver.");
+	}
+	g_slist_free(devices);
+}
+END_TEST
+
 /*
  * Check whether setting a samplerate works.
  *
@@ -70,6 +115,7 @@ Suite *suite_driver_all(void)
 	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
 	tcase_add_test(tc, test_driver_available);
 	tcase_add_test(tc, test_driver_init_all);
+	tcase_add_test(tc, test_driver_scan_concurrent);
 	// TODO: Currently broken.
 	// tcase_add_test(tc, test_config_get_set_samplerate);
 	suite_add_tcase(s, tc);
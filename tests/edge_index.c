@@ -0,0 +1,142 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+#define NUM_SAMPLES 1000
+
+/*
+ * D0 toggles every 3 samples, D1 is high from sample 500 on, D2 stays
+ * low. The samples get split into packets which end in the middle of
+ * a level, and right at a transition.
+ */
+static struct sr_edge_index *build_index(void)
+{
+	struct sr_edge_index *idx;
+	struct sr_datafeed_logic logic;
+	static uint8_t data[NUM_SAMPLES];
+	const size_t splits[] = { 0, 299, 500, 501, NUM_SAMPLES };
+	size_t i;
+
+	for (i = 0; i < NUM_SAMPLES; i++)
+		data[i] = ((i / 3) & 1) | (i >= 500 ? 2 : 0);
+
+	idx = sr_edge_index_new(3);
+	fail_unless(idx != NULL);
+	logic.unitsize = 1;
+	for (i = 0; i + 1 < G_N_ELEMENTS(splits); i++) {
+		logic.data = data + splits[i];
+		logic.length = splits[i + 1] - splits[i];
+		fail_unless(sr_edge_index_append(idx, &logic) == SR_OK);
+	}
+	fail_unless(sr_edge_index_num_samples(idx) == NUM_SAMPLES);
+
+	return idx;
+}
+
+static void check_index(const struct sr_edge_index *idx)
+{
+	uint64_t edge, count;
+
+	fail_unless(sr_edge_index_next(idx, 0, 0, &edge) == SR_OK);
+	fail_unless(edge == 3);
+	fail_unless(sr_edge_index_next(idx, 0, 3, &edge) == SR_OK);
+	fail_unless(edge == 6);
+	fail_unless(sr_edge_index_next(idx, 0, 299, &edge) == SR_OK);
+	fail_unless(edge == 300, "Edge at %" PRIu64 ".", edge);
+	fail_unless(sr_edge_index_next(idx, 0, 999, &edge) == SR_ERR_NA);
+	fail_unless(sr_edge_index_prev(idx, 0, 999, &edge) == SR_OK);
+	fail_unless(edge == 996);
+	fail_unless(sr_edge_index_prev(idx, 0, NUM_SAMPLES, &edge) == SR_OK);
+	fail_unless(edge == 999);
+	fail_unless(sr_edge_index_prev(idx, 0, 3, &edge) == SR_ERR_NA);
+
+	fail_unless(sr_edge_index_next(idx, 1, 0, &edge) == SR_OK);
+	fail_unless(edge == 500);
+	fail_unless(sr_edge_index_next(idx, 1, 500, &edge) == SR_ERR_NA);
+	fail_unless(sr_edge_index_prev(idx, 1, 501, &edge) == SR_OK);
+	fail_unless(edge == 500);
+	fail_unless(sr_edge_index_next(idx, 2, 0, &edge) == SR_ERR_NA);
+
+	/* Transitions at 3, 6, ..., 999. */
+	fail_unless(sr_edge_index_count(idx, 0, 0, NUM_SAMPLES, &count) == SR_OK);
+	fail_unless(count == 333, "Counted %" PRIu64 " edges.", count);
+	fail_unless(sr_edge_index_count(idx, 0, 3, 9, &count) == SR_OK);
+	fail_unless(count == 2);
+	fail_unless(sr_edge_index_count(idx, 1, 0, 500, &count) == SR_OK);
+	fail_unless(count == 0);
+	fail_unless(sr_edge_index_count(idx, 0, 9, 3, &count) == SR_ERR_ARG);
+
+	fail_unless(sr_edge_index_next(idx, 3, 0, &edge) == SR_ERR_ARG);
+}
+
+/* Check the queries over an index which was built from several packets. */
+START_TEST(test_query)
+{
+	struct sr_edge_index *idx;
+
+	idx = build_index();
+	check_index(idx);
+	sr_edge_index_free(idx);
+}
+END_TEST
+
+/* Check that an index survives serialization, and that bad data is refused. */
+START_TEST(test_serialize)
+{
+	struct sr_edge_index *idx, *copy;
+	uint8_t *data;
+	size_t size;
+	int ret;
+
+	idx = build_index();
+	ret = sr_edge_index_serialize(idx, &data, &size);
+	fail_unless(ret == SR_OK);
+	sr_edge_index_free(idx);
+
+	ret = sr_edge_index_deserialize(data, size, &copy);
+	fail_unless(ret == SR_OK);
+	fail_unless(sr_edge_index_num_samples(copy) == NUM_SAMPLES);
+	check_index(copy);
+	sr_edge_index_free(copy);
+
+	ret = sr_edge_index_deserialize(data, size - 1, &copy);
+	fail_unless(ret == SR_ERR_DATA);
+	data[0] = 'X';
+	ret = sr_edge_index_deserialize(data, size, &copy);
+	fail_unless(ret == SR_ERR_DATA);
+	g_free(data);
+}
+END_TEST
+
+Suite *suite_edge_index(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("edge-index");
+
+	tc = tcase_create("core");
+	tcase_add_test(tc, test_query);
+	tcase_add_test(tc, test_serialize);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,51 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+/*
+ * Test suites which need access to library internals. This program
+ * links against the static library, see Makefile.am.
+ */
+int main(void)
+{
+	int ret;
+	Suite *s;
+	SRunner *srunner;
+
+	s = suite_create("internalsuite");
+	srunner = srunner_create(s);
+
+	/* Add all testsuites to the master suite. */
+	srunner_add_suite(srunner, suite_buffer_pool());
+#ifdef HAVE_HW_DEMO
+	srunner_add_suite(srunner, suite_dev_threads());
+#endif
+#ifdef HAVE_HW_ASIX_SIGMA
+	srunner_add_suite(srunner, suite_asix_sigma());
+#endif
+
+	srunner_run_all(srunner, CK_VERBOSE);
+	ret = srunner_ntests_failed(srunner);
+	srunner_free(srunner);
+
+	return (ret == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,283 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+/*
+ * A mock IPDBG logic analyzer, serving a TCP connection like a JTAG
+ * bridge would. It answers the ID and bus width requests, and sends
+ * its whole sample memory (8 channels, 2^10 samples) in small chunks
+ * when the capture gets started.
+ */
+#define MOCK_DATA_WIDTH		8
+#define MOCK_ADDR_WIDTH		10
+#define MOCK_SAMPLES		(1 << MOCK_ADDR_WIDTH)
+#define MOCK_CHUNK		100
+
+#define LIMIT_SAMPLES		800
+#define CAPTURE_RATIO		50
+
+struct mock_la {
+	int listen_fd;
+	uint16_t port;
+};
+
+static uint8_t received[MOCK_SAMPLES];
+static size_t received_len;
+static int logic_packets;
+static int64_t trigger_pos;
+static gboolean have_header, have_end;
+
+static void mock_send_u32(int fd, uint32_t value)
+{
+	uint8_t buf[4];
+
+	buf[0] = value & 0xff;
+	buf[1] = (value >> 8) & 0xff;
+	buf[2] = (value >> 16) & 0xff;
+	buf[3] = (value >> 24) & 0xff;
+	send(fd, buf, sizeof(buf), 0);
+}
+
+static void mock_send_samples(int fd)
+{
+	uint8_t buf[MOCK_SAMPLES];
+	size_t i, len;
+
+	for (i = 0; i < MOCK_SAMPLES; i++)
+		buf[i] = i & 0xff;
+
+	/* Dribble the data, so the driver needs several rounds. */
+	for (i = 0; i < MOCK_SAMPLES; i += len) {
+		len = MIN(MOCK_CHUNK, MOCK_SAMPLES - i);
+		send(fd, buf + i, len, 0);
+		g_usleep(2000);
+	}
+}
+
+static gpointer mock_la_thread(gpointer data)
+{
+	struct mock_la *mock;
+	uint8_t cmd;
+	gboolean escaped;
+	int conn, fd;
+
+	mock = data;
+
+	/* One connection for the scan, one for the acquisition. */
+	for (conn = 0; conn < 2; conn++) {
+		fd = accept(mock->listen_fd, NULL, NULL);
+		if (fd < 0)
+			break;
+		escaped = FALSE;
+		while (recv(fd, &cmd, 1, 0) == 1) {
+			if (escaped) {
+				escaped = FALSE;
+				continue;
+			}
+			switch (cmd) {
+			case 0x55:
+				escaped = TRUE;
+				break;
+			case 0xbb:
+				send(fd, "IDBG", 4, 0);
+				break;
+			case 0xaa:
+				mock_send_u32(fd, MOCK_DATA_WIDTH);
+				mock_send_u32(fd, MOCK_ADDR_WIDTH);
+				break;
+			case 0xfe:
+				mock_send_samples(fd);
+				break;
+			}
+		}
+		close(fd);
+	}
+
+	return NULL;
+}
+
+static void mock_la_listen(struct mock_la *mock)
+{
+	struct sockaddr_in addr;
+	socklen_t len;
+	int ret;
+
+	mock->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	fail_unless(mock->listen_fd >= 0, "Cannot create socket.");
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	ret = bind(mock->listen_fd, (struct sockaddr *)&addr, sizeof(addr));
+	fail_unless(ret == 0, "Cannot bind socket.");
+	ret = listen(mock->listen_fd, 1);
+	fail_unless(ret == 0, "Cannot listen on socket.");
+
+	len = sizeof(addr);
+	getsockname(mock->listen_fd, (struct sockaddr *)&addr, &len);
+	mock->port = ntohs(addr.sin_port);
+}
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+
+	(void)sdi;
+	(void)cb_data;
+
+	switch (packet->type) {
+	case SR_DF_HEADER:
+		have_header = TRUE;
+		break;
+	case SR_DF_TRIGGER:
+		trigger_pos = received_len;
+		break;
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		fail_unless(logic->unitsize == 1);
+		fail_unless(received_len + logic->length <= sizeof(received));
+		memcpy(received + received_len, logic->data, logic->length);
+		received_len += logic->length;
+		logic_packets++;
+		break;
+	case SR_DF_END:
+		have_end = TRUE;
+		break;
+	default:
+		break;
+	}
+}
+
+static struct sr_dev_driver *driver_find(const char *name)
+{
+	struct sr_dev_driver **drivers;
+	int i;
+
+	drivers = sr_driver_list(srtest_ctx);
+	for (i = 0; drivers && drivers[i]; i++) {
+		if (!strcmp(drivers[i]->name, name))
+			return drivers[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * Check that samples get forwarded while they arrive, that the sample
+ * limit gets applied, and that the trigger marker is put in place.
+ */
+START_TEST(test_ipdbg_la_stream)
+{
+	struct sr_dev_driver *driver;
+	struct sr_dev_inst *sdi;
+	struct sr_session *session;
+	struct sr_config *src;
+	struct mock_la mock;
+	GThread *thread;
+	GSList *options, *devices;
+	char *conn;
+	size_t i;
+	int ret;
+
+	driver = driver_find("ipdbg-la");
+	if (!driver)
+		return;
+	ret = sr_driver_init(srtest_ctx, driver);
+	fail_unless(ret == SR_OK, "Failed to init driver: %d.", ret);
+
+	mock_la_listen(&mock);
+	thread = g_thread_new("mock-ipdbg", mock_la_thread, &mock);
+
+	conn = g_strdup_printf("tcp/127.0.0.1/%u", mock.port);
+	src = g_malloc0(sizeof(*src));
+	src->key = SR_CONF_CONN;
+	src->data = g_variant_ref_sink(g_variant_new_string(conn));
+	options = g_slist_append(NULL, src);
+	devices = sr_driver_scan(driver, options);
+	fail_unless(g_slist_length(devices) == 1, "Mock device not found.");
+	sdi = devices->data;
+
+	ret = sr_dev_open(sdi);
+	fail_unless(ret == SR_OK, "Failed to open device: %d.", ret);
+	ret = sr_config_set(sdi, NULL, SR_CONF_LIMIT_SAMPLES,
+		g_variant_new_uint64(LIMIT_SAMPLES));
+	fail_unless(ret == SR_OK, "Failed to set sample limit: %d.", ret);
+	ret = sr_config_set(sdi, NULL, SR_CONF_CAPTURE_RATIO,
+		g_variant_new_uint64(CAPTURE_RATIO));
+	fail_unless(ret == SR_OK, "Failed to set capture ratio: %d.", ret);
+
+	received_len = 0;
+	logic_packets = 0;
+	trigger_pos = -1;
+	have_header = have_end = FALSE;
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_dev_add(session, sdi);
+	sr_session_datafeed_callback_add(session, datafeed_in, NULL);
+	ret = sr_session_start(session);
+	fail_unless(ret == SR_OK, "Failed to start session: %d.", ret);
+	ret = sr_session_run(session);
+	fail_unless(ret == SR_OK, "Failed to run session: %d.", ret);
+
+	sr_dev_close(sdi);
+	g_thread_join(thread);
+	close(mock.listen_fd);
+	sr_session_destroy(session);
+
+	fail_unless(have_header && have_end, "Missing header or end packet.");
+	fail_unless(received_len == LIMIT_SAMPLES,
+		"Received %zu samples, expected %d.", received_len, LIMIT_SAMPLES);
+	for (i = 0; i < received_len; i++)
+		fail_unless(received[i] == (i & 0xff),
+			"Sample %zu mismatch.", i);
+	fail_unless(logic_packets > 1, "Samples were not streamed.");
+	fail_unless(trigger_pos == (LIMIT_SAMPLES - 1) * CAPTURE_RATIO / 100,
+		"Trigger at %" PRId64 ".", trigger_pos);
+
+	g_slist_free(devices);
+	g_slist_free(options);
+	g_variant_unref(src->data);
+	g_free(src);
+	g_free(conn);
+}
+END_TEST
+
+Suite *suite_ipdbg_la(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("ipdbg-la");
+
+	tc = tcase_create("stream");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_ipdbg_la_stream);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
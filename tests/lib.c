@@ -142,6 +142,46 @@ void srtest_check_samplerate(struct sr_context *sr_ctx, const char *drivername,
 		    drivername, s);
 }
 
+/*
+ * Scan and open a new demo device with the given number of channels,
+ * limited to the given number of samples. The driver keeps ownership.
+ */
+struct sr_dev_inst *srtest_demo_dev_new(int num_logic, int num_analog,
+	uint64_t limit_samples)
+{
+	struct sr_dev_driver *driver;
+	struct sr_dev_inst *sdi;
+	struct sr_config src[2];
+	GSList *options, *devices;
+	int ret;
+
+	driver = srtest_driver_get("demo");
+	if (!driver->context)
+		srtest_driver_init(srtest_ctx, driver);
+
+	src[0].key = SR_CONF_NUM_LOGIC_CHANNELS;
+	src[0].data = g_variant_ref_sink(g_variant_new_int32(num_logic));
+	src[1].key = SR_CONF_NUM_ANALOG_CHANNELS;
+	src[1].data = g_variant_ref_sink(g_variant_new_int32(num_analog));
+	options = g_slist_append(NULL, &src[0]);
+	options = g_slist_append(options, &src[1]);
+	devices = sr_driver_scan(driver, options);
+	g_slist_free(options);
+	g_variant_unref(src[0].data);
+	g_variant_unref(src[1].data);
+	fail_unless(g_slist_length(devices) == 1, "Demo device not found.");
+	sdi = devices->data;
+	g_slist_free(devices);
+
+	ret = sr_dev_open(sdi);
+	fail_unless(ret == SR_OK, "Failed to open demo device: %d.", ret);
+	ret = sr_config_set(sdi, NULL, SR_CONF_LIMIT_SAMPLES,
+		g_variant_new_uint64(limit_samples));
+	fail_unless(ret == SR_OK, "Failed to set sample limit: %d.", ret);
+
+	return sdi;
+}
+
 GArray *srtest_get_enabled_logic_channels(const struct sr_dev_inst *sdi)
 {
 	struct sr_channel *ch;
@@ -39,6 +39,9 @@ uint64_t srtest_get_samplerate(struct sr_dev_driver *driver);
 void srtest_check_samplerate(struct sr_context *sr_ctx, const char *drivername,
 			     uint64_t samplerate);
 
+struct sr_dev_inst *srtest_demo_dev_new(int num_logic, int num_analog,
+	uint64_t limit_samples);
+
 GArray *srtest_get_enabled_logic_channels(const struct sr_dev_inst *sdi);
 
 Suite *suite_core(void);
@@ -54,5 +57,16 @@ Suite *suite_device(void);
 Suite *suite_trigger(void);
 Suite *suite_analog(void);
 Suite *suite_conv(void);
+Suite *suite_edge_index(void);
+Suite *suite_ipdbg_la(void);
+Suite *suite_beaglelogic(void);
+Suite *suite_scpi(void);
+Suite *suite_demo(void);
+Suite *suite_srzip(void);
+
+/* Suites of the tests/internal program. */
+Suite *suite_buffer_pool(void);
+Suite *suite_dev_threads(void);
+Suite *suite_asix_sigma(void);
 
 #endif
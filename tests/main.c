@@ -46,6 +46,12 @@ int main(void)
 	srunner_add_suite(srunner, suite_trigger());
 	srunner_add_suite(srunner, suite_analog());
 	srunner_add_suite(srunner, suite_conv());
+	srunner_add_suite(srunner, suite_edge_index());
+	srunner_add_suite(srunner, suite_ipdbg_la());
+	srunner_add_suite(srunner, suite_beaglelogic());
+	srunner_add_suite(srunner, suite_scpi());
+	srunner_add_suite(srunner, suite_demo());
+	srunner_add_suite(srunner, suite_srzip());
 
 	srunner_run_all(srunner, CK_VERBOSE);
 	ret = srunner_ntests_failed(srunner);
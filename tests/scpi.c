@@ -0,0 +1,279 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <check.h>
+#include <glib/gstdio.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+/*
+ * A mock SCPI multimeter on a raw TCP connection. It answers *IDN?,
+ * *OPC? and *STB? (unless "no_stb" is set), and counts the identification
+ * and status queries. A "dead" instrument accepts the connection and
+ * hangs up right away.
+ */
+#define MOCK_IDN	"Agilent Technologies,34410A,MY12345678,2.35-2.35-0.09-46-09"
+
+/* Scans done by the test, one connection each. */
+#define MOCK_SCANS	6
+
+struct mock_scpi {
+	int listen_fd;
+	uint16_t port;
+	GMutex mutex;
+	gboolean dead;
+	gboolean no_stb;
+	int idn_count;
+	int stb_count;
+};
+
+static void mock_scpi_serve(struct mock_scpi *mock, int fd)
+{
+	char buf[256], *line, *end;
+	size_t fill;
+	ssize_t len;
+	const char *reply;
+
+	fill = 0;
+	while ((len = recv(fd, buf + fill, sizeof(buf) - 1 - fill, 0)) > 0) {
+		fill += len;
+		buf[fill] = '\0';
+		line = buf;
+		while ((end = strchr(line, '\n'))) {
+			*end = '\0';
+			g_strstrip(line);
+			reply = NULL;
+			g_mutex_lock(&mock->mutex);
+			if (!strcmp(line, "*IDN?")) {
+				mock->idn_count++;
+				reply = MOCK_IDN "\n";
+			} else if (!strcmp(line, "*STB?")) {
+				mock->stb_count++;
+				if (!mock->no_stb)
+					reply = "0\n";
+			} else if (!strcmp(line, "*OPC?")) {
+				reply = "1\n";
+			}
+			g_mutex_unlock(&mock->mutex);
+			if (reply)
+				send(fd, reply, strlen(reply), 0);
+			line = end + 1;
+		}
+		fill = strlen(line);
+		memmove(buf, line, fill);
+	}
+}
+
+static gpointer mock_scpi_thread(gpointer data)
+{
+	struct mock_scpi *mock;
+	gboolean dead;
+	int conn, fd;
+
+	mock = data;
+
+	for (conn = 0; conn < MOCK_SCANS; conn++) {
+		fd = accept(mock->listen_fd, NULL, NULL);
+		if (fd < 0)
+			break;
+		g_mutex_lock(&mock->mutex);
+		dead = mock->dead;
+		g_mutex_unlock(&mock->mutex);
+		if (!dead)
+			mock_scpi_serve(mock, fd);
+		close(fd);
+	}
+
+	return NULL;
+}
+
+static void mock_scpi_listen(struct mock_scpi *mock)
+{
+	struct sockaddr_in addr;
+	socklen_t len;
+	int ret;
+
+	mock->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	fail_unless(mock->listen_fd >= 0, "Cannot create socket.");
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	ret = bind(mock->listen_fd, (struct sockaddr *)&addr, sizeof(addr));
+	fail_unless(ret == 0, "Cannot bind socket.");
+	ret = listen(mock->listen_fd, 1);
+	fail_unless(ret == 0, "Cannot listen on socket.");
+
+	len = sizeof(addr);
+	getsockname(mock->listen_fd, (struct sockaddr *)&addr, &len);
+	mock->port = ntohs(addr.sin_port);
+}
+
+static struct sr_dev_driver *driver_find(const char *name)
+{
+	struct sr_dev_driver **drivers;
+	int i;
+
+	drivers = sr_driver_list(srtest_ctx);
+	for (i = 0; drivers && drivers[i]; i++) {
+		if (!strcmp(drivers[i]->name, name))
+			return drivers[i];
+	}
+
+	return NULL;
+}
+
+static guint mock_scan(struct sr_dev_driver *driver, GSList *options)
+{
+	GSList *devices;
+	guint count;
+
+	devices = sr_driver_scan(driver, options);
+	count = g_slist_length(devices);
+	g_slist_free(devices);
+
+	return count;
+}
+
+static void mock_counts(struct mock_scpi *mock, int *idn, int *stb)
+{
+	g_mutex_lock(&mock->mutex);
+	*idn = mock->idn_count;
+	*stb = mock->stb_count;
+	g_mutex_unlock(&mock->mutex);
+}
+
+/*
+ * A TCP connection doesn't identify the instrument. Check that a cached
+ * IDN response is only used after the instrument answered a status query,
+ * that it is dropped when nothing answers, and that instruments without
+ * *STB? are identified by *IDN? each time.
+ */
+START_TEST(test_scpi_idcache)
+{
+	struct sr_dev_driver *driver;
+	struct sr_config *src;
+	struct mock_scpi mock;
+	GThread *thread;
+	GSList *options;
+	char *conn, *cachefile;
+	int fd, ret, idn, stb;
+
+	driver = driver_find("scpi-dmm");
+	if (!driver)
+		return;
+	ret = sr_driver_init(srtest_ctx, driver);
+	fail_unless(ret == SR_OK, "Failed to init driver: %d.", ret);
+
+	/* Writes to the hung up connection must fail, not kill the test. */
+	signal(SIGPIPE, SIG_IGN);
+
+	fd = g_file_open_tmp("sigrok-idcache-XXXXXX", &cachefile, NULL);
+	fail_unless(fd >= 0, "Cannot create cache file.");
+	close(fd);
+	ret = sr_idcache_enable(cachefile);
+	fail_unless(ret == SR_OK, "Failed to enable cache: %d.", ret);
+	sr_idcache_remove_all();
+
+	memset(&mock, 0, sizeof(mock));
+	g_mutex_init(&mock.mutex);
+	mock_scpi_listen(&mock);
+	thread = g_thread_new("mock-scpi", mock_scpi_thread, &mock);
+
+	conn = g_strdup_printf("tcp-raw/127.0.0.1/%u", mock.port);
+	src = g_malloc0(sizeof(*src));
+	src->key = SR_CONF_CONN;
+	src->data = g_variant_ref_sink(g_variant_new_string(conn));
+	options = g_slist_append(NULL, src);
+
+	/* Cache miss, the instrument gets identified. */
+	fail_unless(mock_scan(driver, options) == 1, "Mock device not found.");
+	mock_counts(&mock, &idn, &stb);
+	fail_unless(idn == 1 && stb == 0, "IDN %d, STB %d after miss.", idn, stb);
+
+	/* Cache hit, only the status gets queried. */
+	fail_unless(mock_scan(driver, options) == 1, "Cached device not found.");
+	mock_counts(&mock, &idn, &stb);
+	fail_unless(idn == 1 && stb == 1, "IDN %d, STB %d after hit.", idn, stb);
+
+	/* No answer, no device despite the cache entry. */
+	g_mutex_lock(&mock.mutex);
+	mock.dead = TRUE;
+	g_mutex_unlock(&mock.mutex);
+	fail_unless(mock_scan(driver, options) == 0, "Dead device was found.");
+
+	/* The entry was dropped, the instrument gets identified again. */
+	g_mutex_lock(&mock.mutex);
+	mock.dead = FALSE;
+	g_mutex_unlock(&mock.mutex);
+	fail_unless(mock_scan(driver, options) == 1, "Mock device not found.");
+	mock_counts(&mock, &idn, &stb);
+	fail_unless(idn == 2 && stb == 1, "IDN %d, STB %d after drop.", idn, stb);
+
+	/* No status, the instrument gets identified and marked. */
+	g_mutex_lock(&mock.mutex);
+	mock.no_stb = TRUE;
+	g_mutex_unlock(&mock.mutex);
+	fail_unless(mock_scan(driver, options) == 1, "Mock device not found.");
+	mock_counts(&mock, &idn, &stb);
+	fail_unless(idn == 3 && stb == 2, "IDN %d, STB %d without status.",
+		idn, stb);
+
+	/* Marked instruments skip the status query. */
+	fail_unless(mock_scan(driver, options) == 1, "Mock device not found.");
+	mock_counts(&mock, &idn, &stb);
+	fail_unless(idn == 4 && stb == 2, "IDN %d, STB %d when marked.",
+		idn, stb);
+
+	g_thread_join(thread);
+	close(mock.listen_fd);
+	g_mutex_clear(&mock.mutex);
+
+	sr_idcache_disable();
+	g_unlink(cachefile);
+	g_free(cachefile);
+
+	g_slist_free(options);
+	g_variant_unref(src->data);
+	g_free(src);
+	g_free(conn);
+}
+END_TEST
+
+Suite *suite_scpi(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("scpi");
+
+	tc = tcase_create("idcache");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_set_timeout(tc, 10);
+	tcase_add_test(tc, test_scpi_idcache);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
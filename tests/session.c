@@ -19,6 +19,7 @@
 
 #include <config.h>
 #include <stdlib.h>
+#include <string.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
@@ -185,6 +186,642 @@ START_TEST(test_session_trigger_get_null)
 }
 END_TEST
 
+/*
+ * Datafeed counters for sessions which run demo devices. Callbacks may
+ * run on worker threads, the test thread only reads the counters after
+ * the session stopped.
+ */
+#define DEMO_LIMIT	10000
+#define MAX_DEVS	2
+/* Logic packets of 4096 samples, per device. */
+#define THREADS_PACKETS	32
+#define THREADS_LIMIT	(THREADS_PACKETS * 4096)
+
+struct feed_dev {
+	const struct sr_dev_inst *sdi;
+	uint64_t packets;
+	uint64_t bytes;
+	uint64_t logic_samples;
+	uint64_t analog_samples;
+	gboolean have_header;
+	gboolean have_end;
+	gboolean after_end;
+	/* Type and number of samples of each packet, in delivery order. */
+	uint64_t seq[64];
+	unsigned int num_seq;
+};
+
+static struct {
+	GThread *thread;
+	gboolean other_thread;
+	uint64_t packets;
+	unsigned int delay_us;
+	/* Send times (with a session as cb_data), and whether they went back. */
+	int64_t last_time;
+	gboolean time_reversed;
+	/* The device index of each logic packet, in delivery order. */
+	unsigned int order[MAX_DEVS * THREADS_PACKETS];
+	unsigned int num_order;
+	/* How often the device changed from one packet to the next. */
+	const struct sr_dev_inst *last_sdi;
+	unsigned int switches;
+	struct feed_dev dev[MAX_DEVS];
+} feed;
+
+static void feed_reset(void)
+{
+	memset(&feed, 0, sizeof(feed));
+}
+
+static struct feed_dev *feed_dev_get(const struct sr_dev_inst *sdi)
+{
+	int i;
+
+	for (i = 0; i < MAX_DEVS; i++) {
+		if (!feed.dev[i].sdi)
+			feed.dev[i].sdi = sdi;
+		if (feed.dev[i].sdi == sdi)
+			return &feed.dev[i];
+	}
+	fail("Too many devices.");
+
+	return NULL;
+}
+
+static void datafeed_count(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	struct feed_dev *fd;
+	int64_t time;
+	uint64_t samples;
+
+	if (feed.thread && feed.thread != g_thread_self())
+		feed.other_thread = TRUE;
+	feed.thread = g_thread_self();
+	feed.packets++;
+	fd = feed_dev_get(sdi);
+	if (feed.last_sdi && feed.last_sdi != sdi)
+		feed.switches++;
+	feed.last_sdi = sdi;
+	if (cb_data && sr_session_packet_time_get(cb_data, &time) == SR_OK) {
+		if (time < feed.last_time)
+			feed.time_reversed = TRUE;
+		feed.last_time = time;
+	}
+	fd->packets++;
+	if (fd->have_end)
+		fd->after_end = TRUE;
+
+	samples = 0;
+	switch (packet->type) {
+	case SR_DF_HEADER:
+		fd->have_header = TRUE;
+		break;
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		samples = logic->length / logic->unitsize;
+		fd->logic_samples += samples;
+		fd->bytes += logic->length;
+		if (feed.num_order < G_N_ELEMENTS(feed.order))
+			feed.order[feed.num_order++] = fd - feed.dev;
+		if (feed.delay_us)
+			g_usleep(feed.delay_us);
+		break;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		samples = analog->num_samples;
+		fd->analog_samples += samples;
+		fd->bytes += analog->num_samples * analog->encoding->unitsize;
+		break;
+	case SR_DF_END:
+		fd->have_end = TRUE;
+		break;
+	default:
+		break;
+	}
+
+	if (fd->num_seq < G_N_ELEMENTS(fd->seq))
+		fd->seq[fd->num_seq++] = (uint64_t)packet->type << 32 | samples;
+}
+
+static void session_run_all(struct sr_session *sess)
+{
+	int ret;
+
+	ret = sr_session_start(sess);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	ret = sr_session_run(sess);
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+}
+
+/* Check that a device sent all of its data, framed by header and end. */
+static void feed_dev_check(const struct sr_dev_inst *sdi, uint64_t limit,
+	int num_analog)
+{
+	struct feed_dev *fd;
+
+	fd = feed_dev_get(sdi);
+	fail_unless(fd->have_header && fd->have_end,
+		"Missing header or end packet.");
+	fail_unless(!fd->after_end, "Packets after the end packet.");
+	fail_unless(fd->logic_samples == limit,
+		"Got %" PRIu64 " logic samples.", fd->logic_samples);
+	fail_unless(fd->analog_samples == limit * num_analog,
+		"Got %" PRIu64 " analog samples.", fd->analog_samples);
+}
+
+/* Check that pipeline counters only exist after the session ran. */
+START_TEST(test_session_pipeline)
+{
+	int ret;
+	struct sr_session *sess;
+	struct sr_pipeline_stats stats;
+
+	sr_session_new(srtest_ctx, &sess);
+	ret = sr_session_pipeline_set(sess, TRUE, 0);
+	fail_unless(ret == SR_OK, "sr_session_pipeline_set() failed: %d.", ret);
+	/* No counters before the session ran. */
+	ret = sr_session_pipeline_stats_get(sess,
+		SR_PIPELINE_STAGE_TRANSFORM, &stats);
+	fail_unless(ret == SR_ERR_NA);
+	ret = sr_session_pipeline_stats_get(sess, (enum sr_pipeline_stage)42, &stats);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_session_pipeline_set(sess, FALSE, 0);
+	fail_unless(ret == SR_OK, "sr_session_pipeline_set() failed: %d.", ret);
+	sr_session_destroy(sess);
+}
+END_TEST
+
+/*
+ * Run a demo device with the pipeline enabled. The callback is slower
+ * than the device, so that the small queues fill up and hold back the
+ * sender, without losing or reordering packets.
+ */
+START_TEST(test_session_pipeline_run)
+{
+	int ret, stage;
+	struct sr_session *sess;
+	struct sr_dev_inst *sdi;
+	struct sr_pipeline_stats stats;
+
+	sdi = srtest_demo_dev_new(8, 1, DEMO_LIMIT);
+	sr_session_new(srtest_ctx, &sess);
+	sr_session_dev_add(sess, sdi);
+	sr_session_datafeed_callback_add(sess, datafeed_count, NULL);
+	ret = sr_session_pipeline_set(sess, TRUE, 2);
+	fail_unless(ret == SR_OK, "sr_session_pipeline_set() failed: %d.", ret);
+
+	feed_reset();
+	feed.delay_us = 5000;
+	session_run_all(sess);
+
+	fail_unless(feed.thread && feed.thread != g_thread_self(),
+		"Callback did not run on a worker thread.");
+	feed_dev_check(sdi, DEMO_LIMIT, 1);
+	for (stage = 0; stage <= SR_PIPELINE_STAGE_CALLBACK; stage++) {
+		ret = sr_session_pipeline_stats_get(sess, stage, &stats);
+		fail_unless(ret == SR_OK, "No counters for stage %d.", stage);
+		fail_unless(stats.packets == feed.packets,
+			"Stage %d processed %" PRIu64 " of %" PRIu64 " packets.",
+			stage, stats.packets, feed.packets);
+		fail_unless(stats.queue_depth == 0, "Queue not drained.");
+		fail_unless(stats.queue_depth_max >= 1 &&
+			stats.queue_depth_max <= 2,
+			"Queue depth %" PRIu64 " exceeds the limit.",
+			stats.queue_depth_max);
+	}
+	/* The callback stage's queue was full while the callback slept. */
+	sr_session_pipeline_stats_get(sess, SR_PIPELINE_STAGE_CALLBACK, &stats);
+	fail_unless(stats.queue_depth_max == 2, "Callback queue never filled.");
+
+	/* Without the pipeline, the callback runs on the session's thread. */
+	ret = sr_session_pipeline_set(sess, FALSE, 0);
+	fail_unless(ret == SR_OK, "sr_session_pipeline_set() failed: %d.", ret);
+	feed_reset();
+	session_run_all(sess);
+	fail_unless(feed.thread == g_thread_self(),
+		"Callback ran on another thread.");
+	feed_dev_check(sdi, DEMO_LIMIT, 1);
+
+	sr_session_destroy(sess);
+	sr_dev_close(sdi);
+}
+END_TEST
+
+/* Check sr_session_pipeline_*() with NULL arguments, must not segfault. */
+START_TEST(test_session_pipeline_bogus)
+{
+	int ret;
+	struct sr_session *sess;
+
+	ret = sr_session_pipeline_set(NULL, TRUE, 0);
+	fail_unless(ret == SR_ERR_ARG);
+	sr_session_new(srtest_ctx, &sess);
+	ret = sr_session_pipeline_stats_get(sess,
+		SR_PIPELINE_STAGE_CALLBACK, NULL);
+	fail_unless(ret == SR_ERR_ARG);
+	sr_session_destroy(sess);
+}
+END_TEST
+
+/*
+ * Check the arguments of sr_session_dev_threads_set(), and that there are
+ * no queue counters or packet times before the session ran.
+ */
+START_TEST(test_session_dev_threads)
+{
+	int ret;
+	int64_t time;
+	struct sr_session *sess;
+	struct sr_dev_inst *sdi;
+	struct sr_pipeline_stats stats;
+
+	sr_session_new(srtest_ctx, &sess);
+	ret = sr_session_dev_threads_set(sess, TRUE, SR_DEV_THREAD_BYTES, 0);
+	fail_unless(ret == SR_OK, "sr_session_dev_threads_set() failed: %d.", ret);
+	ret = sr_session_dev_threads_set(sess, TRUE,
+		(enum sr_dev_thread_policy)42, 0);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_session_dev_threads_set(NULL, TRUE, SR_DEV_THREAD_BYTES, 0);
+	fail_unless(ret == SR_ERR_ARG);
+
+	/* No queue before the session ran. */
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	ret = sr_session_dev_queue_stats_get(sess, sdi, &stats);
+	fail_unless(ret == SR_ERR_NA);
+	ret = sr_session_dev_queue_stats_get(sess, sdi, NULL);
+	fail_unless(ret == SR_ERR_ARG);
+
+	/* Only available from within a datafeed callback. */
+	ret = sr_session_packet_time_get(sess, &time);
+	fail_unless(ret == SR_ERR_NA);
+	ret = sr_session_packet_time_get(sess, NULL);
+	fail_unless(ret == SR_ERR_ARG);
+
+	sr_session_destroy(sess);
+}
+END_TEST
+
+/*
+ * The longest run of logic packets from one device, while the other one
+ * also had packets to deliver: from the first packet of the device which
+ * started last, up to the last packet of the one which finished first.
+ */
+static unsigned int feed_max_run(void)
+{
+	unsigned int i, first, last, run, max_run;
+
+	first = 0;
+	while (first < feed.num_order && feed.order[first] == feed.order[0])
+		first++;
+	last = feed.num_order;
+	while (last > first
+			&& feed.order[last - 1] == feed.order[feed.num_order - 1])
+		last--;
+	fail_unless(first < last, "The devices did not take turns.");
+
+	max_run = run = 0;
+	for (i = first; i < last; i++) {
+		run = (i > first && feed.order[i] == feed.order[i - 1]) ? run + 1 : 1;
+		max_run = MAX(max_run, run);
+	}
+
+	return max_run;
+}
+
+/* Check the queue counters of a device after a run. */
+static void dev_queue_check(struct sr_session *sess,
+	const struct sr_dev_inst *sdi, size_t queue_size)
+{
+	struct sr_pipeline_stats stats;
+	struct feed_dev *fd;
+	int ret;
+
+	fd = feed_dev_get(sdi);
+	ret = sr_session_dev_queue_stats_get(sess, sdi, &stats);
+	fail_unless(ret == SR_OK, "No queue counters: %d.", ret);
+	fail_unless(stats.packets == fd->packets,
+		"Dispatched %" PRIu64 " of %" PRIu64 " packets.",
+		stats.packets, fd->packets);
+	fail_unless(stats.queue_depth == 0, "Queue not drained.");
+	fail_unless(stats.queue_depth_max <= queue_size,
+		"Queue depth %" PRIu64 " exceeds the limit.",
+		stats.queue_depth_max);
+}
+
+/*
+ * Run two demo devices on their own threads. The callback is slower than
+ * the devices, so their queues fill up and hold back the senders. Then
+ * the dispatcher takes turns as the policy says: one packet per device
+ * for round robin, up to 64 KiB per device for SR_DEV_THREAD_BYTES.
+ */
+START_TEST(test_session_dev_threads_run)
+{
+	static const enum sr_dev_thread_policy policies[] = {
+		SR_DEV_THREAD_ROUND_ROBIN, SR_DEV_THREAD_BYTES,
+	};
+	int ret, i;
+	unsigned int p, max_run;
+	struct sr_session *sess;
+	struct sr_dev_inst *sdi[MAX_DEVS];
+	struct sr_pipeline_stats stats;
+
+	sr_session_new(srtest_ctx, &sess);
+	for (i = 0; i < MAX_DEVS; i++) {
+		sdi[i] = srtest_demo_dev_new(8, 0, THREADS_LIMIT);
+		ret = sr_config_set(sdi[i], NULL, SR_CONF_UNPACED,
+			g_variant_new_boolean(TRUE));
+		fail_unless(ret == SR_OK, "Failed to set unpaced mode: %d.", ret);
+		sr_session_dev_add(sess, sdi[i]);
+	}
+	sr_session_datafeed_callback_add(sess, datafeed_count, NULL);
+
+	for (p = 0; p < G_N_ELEMENTS(policies); p++) {
+		ret = sr_session_dev_threads_set(sess, TRUE, policies[p], 2);
+		fail_unless(ret == SR_OK,
+			"sr_session_dev_threads_set() failed: %d.", ret);
+		feed_reset();
+		feed.delay_us = 3000;
+		session_run_all(sess);
+
+		fail_unless(feed.thread && feed.thread != g_thread_self(),
+			"Callback did not run on the dispatcher thread.");
+		fail_unless(!feed.other_thread,
+			"Callback ran on more than one thread.");
+		for (i = 0; i < MAX_DEVS; i++) {
+			feed_dev_check(sdi[i], THREADS_LIMIT, 0);
+			dev_queue_check(sess, sdi[i], 2);
+			sr_session_dev_queue_stats_get(sess, sdi[i], &stats);
+			fail_unless(stats.queue_depth_max == 2,
+				"Queue of device %d never filled.", i);
+		}
+
+		/* 64 KiB are 16 packets of 4096 samples. */
+		max_run = feed_max_run();
+		if (policies[p] == SR_DEV_THREAD_ROUND_ROBIN)
+			fail_unless(max_run <= 2, "Round robin delivered "
+				"%u packets of one device in a row.", max_run);
+		else
+			fail_unless(max_run > 2 && max_run <= 16, "Byte "
+				"quantum delivered %u packets of one device "
+				"in a row.", max_run);
+	}
+
+	/*
+	 * Without back-pressure, the oldest packet goes first. The callback
+	 * gets the session to check the packet times.
+	 */
+	sr_session_datafeed_callback_remove_all(sess);
+	sr_session_datafeed_callback_add(sess, datafeed_count, sess);
+	ret = sr_session_dev_threads_set(sess, TRUE,
+		SR_DEV_THREAD_OLDEST_FIRST, 1000);
+	fail_unless(ret == SR_OK, "sr_session_dev_threads_set() failed: %d.", ret);
+	feed_reset();
+	feed.delay_us = 1000;
+	session_run_all(sess);
+	fail_unless(!feed.time_reversed, "Packets not in order of time.");
+	for (i = 0; i < MAX_DEVS; i++) {
+		feed_dev_check(sdi[i], THREADS_LIMIT, 0);
+		dev_queue_check(sess, sdi[i], 1000);
+		sr_session_dev_queue_stats_get(sess, sdi[i], &stats);
+		fail_unless(stats.queue_depth_max > 2,
+			"Queue of device %d did not grow.", i);
+	}
+
+	sr_session_destroy(sess);
+	for (i = 0; i < MAX_DEVS; i++)
+		sr_dev_close(sdi[i]);
+}
+END_TEST
+
+/*
+ * Check the arguments of sr_session_timestamps_set() and
+ * sr_session_merge_set(), and that there are no timestamps before the
+ * session ran.
+ */
+START_TEST(test_session_timeline)
+{
+	int ret;
+	int64_t timestamp;
+	struct sr_session *sess;
+
+	sr_session_new(srtest_ctx, &sess);
+	ret = sr_session_timestamps_set(sess, TRUE, TRUE);
+	fail_unless(ret == SR_OK, "sr_session_timestamps_set() failed: %d.", ret);
+	ret = sr_session_timestamps_set(NULL, TRUE, FALSE);
+	fail_unless(ret == SR_ERR_ARG);
+
+	ret = sr_session_merge_set(sess, TRUE, 1000000);
+	fail_unless(ret == SR_OK, "sr_session_merge_set() failed: %d.", ret);
+	/* Enabling needs a window. */
+	ret = sr_session_merge_set(sess, TRUE, 0);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_session_merge_set(sess, FALSE, 0);
+	fail_unless(ret == SR_OK, "sr_session_merge_set() failed: %d.", ret);
+
+	/* Only available from within a datafeed callback. */
+	ret = sr_session_packet_timestamp_get(sess, &timestamp);
+	fail_unless(ret == SR_ERR_NA);
+	ret = sr_session_packet_timestamp_get(sess, NULL);
+	fail_unless(ret == SR_ERR_ARG);
+
+	sr_session_destroy(sess);
+}
+END_TEST
+
+/*
+ * Merge two demo devices on one timeline. The demo device sends its analog
+ * samples in smaller packets than its logic samples, so its streams are
+ * not sent in time order. The merge stage interleaves the devices, but
+ * must deliver the packets of each device in the order they were sent.
+ */
+START_TEST(test_session_timeline_run)
+{
+	int ret, i;
+	unsigned int j;
+	struct sr_session *sess;
+	struct sr_dev_inst *sdi[MAX_DEVS];
+	struct feed_dev sent[MAX_DEVS], *fd;
+
+	sr_session_new(srtest_ctx, &sess);
+	for (i = 0; i < MAX_DEVS; i++) {
+		sdi[i] = srtest_demo_dev_new(8, 1, DEMO_LIMIT);
+		ret = sr_config_set(sdi[i], NULL, SR_CONF_UNPACED,
+			g_variant_new_boolean(TRUE));
+		fail_unless(ret == SR_OK, "Failed to set unpaced mode: %d.", ret);
+		sr_session_dev_add(sess, sdi[i]);
+	}
+	sr_session_datafeed_callback_add(sess, datafeed_count, NULL);
+
+	/* Without the merge stage, packets arrive the way they were sent. */
+	feed_reset();
+	session_run_all(sess);
+	for (i = 0; i < MAX_DEVS; i++) {
+		feed_dev_check(sdi[i], DEMO_LIMIT, 1);
+		sent[i] = *feed_dev_get(sdi[i]);
+		fail_unless(sent[i].num_seq < G_N_ELEMENTS(sent[i].seq),
+			"Too many packets to compare.");
+	}
+
+	ret = sr_session_merge_set(sess, TRUE, 1000000000);
+	fail_unless(ret == SR_OK, "sr_session_merge_set() failed: %d.", ret);
+	feed_reset();
+	session_run_all(sess);
+	fail_unless(feed.switches > MAX_DEVS - 1,
+		"The devices' packets were not interleaved.");
+	for (i = 0; i < MAX_DEVS; i++) {
+		feed_dev_check(sdi[i], DEMO_LIMIT, 1);
+		fd = feed_dev_get(sdi[i]);
+		fail_unless(fd->num_seq == sent[i].num_seq,
+			"Device %d: got %u of %u packets.", i,
+			fd->num_seq, sent[i].num_seq);
+		for (j = 0; j < fd->num_seq; j++)
+			fail_unless(fd->seq[j] == sent[i].seq[j],
+				"Device %d: packet %u out of order.", i, j);
+	}
+
+	sr_session_destroy(sess);
+	for (i = 0; i < MAX_DEVS; i++)
+		sr_dev_close(sdi[i]);
+}
+END_TEST
+
+/* Check that there are no statistics before anything was sent. */
+START_TEST(test_session_stats)
+{
+	int ret;
+	struct sr_session *sess;
+	struct sr_dev_stats stats;
+
+	sr_session_new(srtest_ctx, &sess);
+	ret = sr_session_stats_enable(sess, TRUE);
+	fail_unless(ret == SR_OK, "sr_session_stats_enable() failed: %d.", ret);
+	/* Nothing was sent yet. */
+	fail_unless(sr_session_stage_stats_get(sess) == NULL);
+	ret = sr_session_stats_reset(sess);
+	fail_unless(ret == SR_OK, "sr_session_stats_reset() failed: %d.", ret);
+	ret = sr_session_dev_stats_get(sess, NULL, &stats);
+	fail_unless(ret == SR_ERR_ARG);
+	sr_session_destroy(sess);
+}
+END_TEST
+
+/*
+ * Run a demo device with statistics enabled, the counters must match
+ * what the datafeed callback received.
+ */
+START_TEST(test_session_stats_run)
+{
+	int ret;
+	struct sr_session *sess;
+	struct sr_dev_inst *sdi;
+	struct sr_dev_stats stats;
+	struct sr_stage_stats *st;
+	struct feed_dev *fd;
+	GSList *list;
+	uint64_t calls;
+	int i;
+
+	sdi = srtest_demo_dev_new(8, 2, DEMO_LIMIT);
+	sr_session_new(srtest_ctx, &sess);
+	sr_session_dev_add(sess, sdi);
+	sr_session_datafeed_callback_add(sess, datafeed_count, NULL);
+	sr_session_stats_enable(sess, TRUE);
+
+	feed_reset();
+	session_run_all(sess);
+	feed_dev_check(sdi, DEMO_LIMIT, 2);
+	fd = feed_dev_get(sdi);
+
+	ret = sr_session_dev_stats_get(sess, sdi, &stats);
+	fail_unless(ret == SR_OK, "No device counters: %d.", ret);
+	fail_unless(stats.packets == fd->packets, "Counted %" PRIu64
+		" of %" PRIu64 " packets.", stats.packets, fd->packets);
+	fail_unless(stats.bytes == fd->bytes, "Counted %" PRIu64
+		" of %" PRIu64 " bytes.", stats.bytes, fd->bytes);
+	fail_unless(stats.samples == fd->logic_samples + fd->analog_samples,
+		"Counted %" PRIu64 " samples.", stats.samples);
+	fail_unless(stats.duration > 0 && stats.sample_rate > 0,
+		"No rates computed.");
+
+	/* A single datafeed callback, called for each packet. */
+	list = sr_session_stage_stats_get(sess);
+	fail_unless(g_slist_length(list) == 1, "Unexpected stages.");
+	st = list->data;
+	fail_unless(st->name == NULL && st->index == 0, "Not the callback.");
+	fail_unless(st->calls == fd->packets, "Counted %" PRIu64
+		" of %" PRIu64 " calls.", st->calls, fd->packets);
+	fail_unless(st->time_max <= st->time_total, "Inconsistent times.");
+	for (i = 0, calls = 0; i < SR_STATS_HISTOGRAM_BINS; i++)
+		calls += st->histogram[i];
+	fail_unless(calls == st->calls, "Histogram misses calls.");
+	g_slist_free_full(list, g_free);
+
+	ret = sr_session_stats_reset(sess);
+	fail_unless(ret == SR_OK, "sr_session_stats_reset() failed: %d.", ret);
+	ret = sr_session_dev_stats_get(sess, sdi, &stats);
+	fail_unless(ret == SR_ERR_NA, "Counters survived the reset.");
+	fail_unless(sr_session_stage_stats_get(sess) == NULL);
+
+	/* Nothing gets counted while disabled. */
+	sr_session_stats_enable(sess, FALSE);
+	feed_reset();
+	session_run_all(sess);
+	ret = sr_session_dev_stats_get(sess, sdi, &stats);
+	fail_unless(ret == SR_ERR_NA, "Counted while disabled.");
+
+	sr_session_destroy(sess);
+	sr_dev_close(sdi);
+}
+END_TEST
+
+/* Check whether sr_packet_copy() copies META and LOGIC payloads. */
+START_TEST(test_packet_copy)
+{
+	int ret;
+	uint8_t data[] = { 0x01, 0x02, 0x03, 0x04 };
+	struct sr_config src;
+	struct sr_datafeed_meta meta;
+	struct sr_datafeed_logic logic;
+	struct sr_datafeed_packet packet, *copy;
+	const struct sr_datafeed_meta *meta_copy;
+	const struct sr_datafeed_logic *logic_copy;
+
+	src.key = SR_CONF_SAMPLERATE;
+	src.data = g_variant_new_uint64(1000);
+	meta.config = g_slist_append(NULL, &src);
+	packet.type = SR_DF_META;
+	packet.payload = &meta;
+	ret = sr_packet_copy(&packet, &copy);
+	fail_unless(ret == SR_OK, "sr_packet_copy() failed: %d.", ret);
+	meta_copy = copy->payload;
+	fail_unless(g_slist_length(meta_copy->config) == 1);
+	sr_packet_free(copy);
+	g_slist_free(meta.config);
+	g_variant_unref(src.data);
+
+	logic.length = sizeof(data);
+	logic.unitsize = 2;
+	logic.data = data;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	ret = sr_packet_copy(&packet, &copy);
+	fail_unless(ret == SR_OK, "sr_packet_copy() failed: %d.", ret);
+	logic_copy = copy->payload;
+	fail_unless(logic_copy->length == sizeof(data));
+	fail_unless(!memcmp(logic_copy->data, data, sizeof(data)));
+	sr_packet_free(copy);
+
+	packet.type = SR_DF_FRAME_BEGIN;
+	packet.payload = NULL;
+	ret = sr_packet_copy(&packet, &copy);
+	fail_unless(ret == SR_OK, "sr_packet_copy() failed: %d.", ret);
+	sr_packet_free(copy);
+}
+END_TEST
+
 Suite *suite_session(void)
 {
 	Suite *s;
@@ -209,5 +846,23 @@ Suite *suite_session(void)
 	tcase_add_test(tc, test_session_trigger_get_null);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("pipeline");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_session_pipeline);
+	tcase_add_test(tc, test_session_pipeline_run);
+	tcase_add_test(tc, test_session_pipeline_bogus);
+	tcase_add_test(tc, test_session_dev_threads);
+	tcase_add_test(tc, test_session_dev_threads_run);
+	tcase_add_test(tc, test_session_timeline);
+	tcase_add_test(tc, test_session_timeline_run);
+	tcase_add_test(tc, test_packet_copy);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("stats");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_session_stats);
+	tcase_add_test(tc, test_session_stats_run);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
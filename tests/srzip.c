@@ -0,0 +1,609 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <unistd.h>
+#include <check.h>
+#include <glib/gstdio.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+/*
+ * Three frames of 8 logic channels. The second one is larger than an
+ * srzip chunk (4 MiB), so it continues in the second chunk, which also
+ * holds the third frame. Frames 1 and 3 have a trigger.
+ */
+static const uint64_t frame_samples[] = { 3000, 4 * 1024 * 1024, 5000 };
+static const int64_t frame_triggers[] = { 1200, -1, 10 };
+
+#define NUM_FRAMES	ARRAY_SIZE(frame_samples)
+
+/*
+ * One analog channel, in several encodings. The samples take more than
+ * one srzip chunk, except for 8 bits with compact_analog. The frames of
+ * the analog data put a chunk boundary into the second frame.
+ */
+#define ANALOG_SAMPLES	(3 * 1024 * 1024)
+#define ANALOG_PACKET	100000
+
+static const uint64_t analog_frames[] = {
+	1000, 2 * 1024 * 1024 + 5, ANALOG_SAMPLES - 1000 - (2 * 1024 * 1024 + 5),
+};
+
+struct analog_case {
+	const char *name;
+	uint8_t unitsize;
+	gboolean is_signed;
+	gboolean is_float;
+	struct sr_rational scale;
+	struct sr_rational offset;
+};
+
+static const struct analog_case analog_cases[] = {
+	{ "uint8", 1, FALSE, FALSE, { 1, 25 }, { -5, 1 } },
+	{ "int16", 2, TRUE, FALSE, { 1, 1000 }, { 0, 1 } },
+	{ "float", 4, TRUE, TRUE, { 1, 1 }, { 0, 1 } },
+};
+
+static char *filename;
+static uint8_t *samples;
+static uint64_t num_samples;
+/* Raw analog samples of the current case, and their values. */
+static uint8_t *analog_raw;
+static float *analog_values;
+
+/* Collected by the datafeed callback. */
+static GByteArray *received;
+static GArray *received_analog;
+static struct sr_analog_encoding analog_encoding;
+static gboolean analog_mixed;
+static GArray *triggers;
+static unsigned int frames_begun, frames_ended;
+static gboolean have_end;
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	int64_t pos;
+	guint len;
+	int ret;
+
+	(void)sdi;
+	(void)cb_data;
+
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		fail_unless(logic->unitsize == 1,
+			"Unexpected unit size %u.", logic->unitsize);
+		g_byte_array_append(received, logic->data, logic->length);
+		break;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		len = received_analog->len;
+		if (!len)
+			analog_encoding = *analog->encoding;
+		else if (analog->encoding->unitsize != analog_encoding.unitsize
+				|| analog->encoding->is_float != analog_encoding.is_float)
+			analog_mixed = TRUE;
+		g_array_set_size(received_analog, len + analog->num_samples);
+		ret = sr_analog_to_float(analog,
+			&g_array_index(received_analog, float, len));
+		fail_unless(ret == SR_OK, "sr_analog_to_float() error: %d.", ret);
+		break;
+	case SR_DF_TRIGGER:
+		pos = received->len;
+		g_array_append_val(triggers, pos);
+		break;
+	case SR_DF_FRAME_BEGIN:
+		fail_unless(frames_begun == frames_ended,
+			"Frame begins within a frame.");
+		frames_begun++;
+		break;
+	case SR_DF_FRAME_END:
+		frames_ended++;
+		break;
+	case SR_DF_END:
+		have_end = TRUE;
+		break;
+	default:
+		break;
+	}
+}
+
+static void output_send(const struct sr_output *o, int type,
+	const void *payload)
+{
+	struct sr_datafeed_packet packet;
+	GString *out;
+	int ret;
+
+	packet.type = type;
+	packet.payload = payload;
+	out = NULL;
+	ret = sr_output_send(o, &packet, &out);
+	fail_unless(ret == SR_OK, "sr_output_send() error: %d.", ret);
+	if (out)
+		g_string_free(out, TRUE);
+}
+
+static void output_logic(const struct sr_output *o, uint64_t start,
+	uint64_t count)
+{
+	struct sr_datafeed_logic logic;
+
+	logic.length = count;
+	logic.unitsize = 1;
+	logic.data = samples + start;
+	output_send(o, SR_DF_LOGIC, &logic);
+}
+
+/*
+ * Write the samples to an srzip file. With 'framed', they are sent as
+ * NUM_FRAMES frames, otherwise without any frame or trigger packets.
+ */
+static void write_session(gboolean framed)
+{
+	const struct sr_output *o;
+	struct sr_dev_inst *sdi;
+	uint64_t start, split;
+	size_t i;
+
+	sdi = srtest_demo_dev_new(8, 0, num_samples);
+	o = sr_output_new(sr_output_find("srzip"), NULL, sdi, filename);
+	fail_unless(o != NULL, "Failed to create srzip output.");
+
+	output_send(o, SR_DF_HEADER, NULL);
+	for (i = start = 0; i < NUM_FRAMES; start += frame_samples[i++]) {
+		if (framed)
+			output_send(o, SR_DF_FRAME_BEGIN, NULL);
+		split = frame_triggers[i] >= 0 ?
+			(uint64_t)frame_triggers[i] : frame_samples[i] / 2;
+		output_logic(o, start, split);
+		if (framed && frame_triggers[i] >= 0)
+			output_send(o, SR_DF_TRIGGER, NULL);
+		output_logic(o, start + split, frame_samples[i] - split);
+		if (framed)
+			output_send(o, SR_DF_FRAME_END, NULL);
+	}
+	output_send(o, SR_DF_END, NULL);
+
+	sr_output_free(o);
+	sr_dev_close(sdi);
+}
+
+static void analog_encoding_set(const struct analog_case *c,
+	struct sr_analog_encoding *encoding)
+{
+	memset(encoding, 0, sizeof(*encoding));
+	encoding->unitsize = c->unitsize;
+	encoding->is_signed = c->is_signed;
+	encoding->is_float = c->is_float;
+	encoding->is_bigendian = G_BYTE_ORDER == G_BIG_ENDIAN;
+	encoding->digits = 3;
+	encoding->is_digits_decimal = TRUE;
+	encoding->scale = c->scale;
+	encoding->offset = c->offset;
+}
+
+/* Generate slowly changing samples with some noise, in host byte order. */
+static void analog_generate(const struct analog_case *c)
+{
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	uint32_t state, noise;
+	uint8_t u8;
+	int16_t i16;
+	float f;
+	uint64_t i;
+	int ret;
+
+	g_free(analog_raw);
+	g_free(analog_values);
+	analog_raw = g_malloc(ANALOG_SAMPLES * c->unitsize);
+	analog_values = g_malloc(ANALOG_SAMPLES * sizeof(float));
+
+	state = 1;
+	for (i = 0; i < ANALOG_SAMPLES; i++) {
+		state = state * 1103515245 + 12345;
+		noise = (state >> 16) & 7;
+		if (c->is_float) {
+			f = (float)(i % 10000) / 100 - 50 + noise / 8.0f;
+			memcpy(analog_raw + i * 4, &f, sizeof(f));
+		} else if (c->unitsize == 2) {
+			i16 = (int)(i / 16 % 40000) - 20000 + (int)noise;
+			memcpy(analog_raw + i * 2, &i16, sizeof(i16));
+		} else {
+			u8 = i / 256 % 200 + noise;
+			analog_raw[i] = u8;
+		}
+	}
+
+	/* The values as seen by the session, before they get stored. */
+	memset(&analog, 0, sizeof(analog));
+	analog.data = analog_raw;
+	analog.num_samples = ANALOG_SAMPLES;
+	analog.encoding = &encoding;
+	analog.meaning = &meaning;
+	analog.spec = &spec;
+	analog_encoding_set(c, &encoding);
+	ret = sr_analog_to_float(&analog, analog_values);
+	fail_unless(ret == SR_OK, "sr_analog_to_float() error: %d.", ret);
+}
+
+static void output_analog(const struct sr_output *o,
+	const struct analog_case *c, struct sr_channel *ch,
+	uint64_t start, uint64_t count)
+{
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+
+	memset(&analog, 0, sizeof(analog));
+	memset(&meaning, 0, sizeof(meaning));
+	memset(&spec, 0, sizeof(spec));
+	analog_encoding_set(c, &encoding);
+	meaning.mq = SR_MQ_VOLTAGE;
+	meaning.unit = SR_UNIT_VOLT;
+	meaning.channels = g_slist_append(NULL, ch);
+	analog.data = analog_raw + start * c->unitsize;
+	analog.num_samples = count;
+	analog.encoding = &encoding;
+	analog.meaning = &meaning;
+	analog.spec = &spec;
+	output_send(o, SR_DF_ANALOG, &analog);
+	g_slist_free(meaning.channels);
+}
+
+/*
+ * Write the analog samples of a case to an srzip file, as frames
+ * of analog_frames[] with 'framed'.
+ */
+static void write_analog(const struct analog_case *c, gboolean compact,
+	gboolean framed)
+{
+	const struct sr_output *o;
+	struct sr_dev_inst *sdi;
+	struct sr_channel *ch;
+	GHashTable *options;
+	uint64_t start, end, count;
+	size_t i;
+
+	analog_generate(c);
+	sdi = srtest_demo_dev_new(0, 1, ANALOG_SAMPLES);
+	ch = sr_dev_inst_channels_get(sdi)->data;
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("compact_analog"),
+		g_variant_ref_sink(g_variant_new_boolean(compact)));
+	o = sr_output_new(sr_output_find("srzip"), options, sdi, filename);
+	g_hash_table_destroy(options);
+	fail_unless(o != NULL, "Failed to create srzip output.");
+
+	output_send(o, SR_DF_HEADER, NULL);
+	for (i = start = 0; start < ANALOG_SAMPLES; i++) {
+		end = framed ? start + analog_frames[i] : ANALOG_SAMPLES;
+		if (framed)
+			output_send(o, SR_DF_FRAME_BEGIN, NULL);
+		for (; start < end; start += count) {
+			count = MIN(end - start, ANALOG_PACKET);
+			output_analog(o, c, ch, start, count);
+		}
+		if (framed)
+			output_send(o, SR_DF_FRAME_END, NULL);
+	}
+	output_send(o, SR_DF_END, NULL);
+
+	sr_output_free(o);
+	sr_dev_close(sdi);
+}
+
+/* Replay a session file, or one frame of it. Returns the start result. */
+static int replay(uint64_t frame)
+{
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	GSList *devlist;
+	int ret;
+
+	g_byte_array_set_size(received, 0);
+	g_array_set_size(received_analog, 0);
+	analog_mixed = FALSE;
+	g_array_set_size(triggers, 0);
+	frames_begun = frames_ended = 0;
+	have_end = FALSE;
+
+	ret = sr_session_load(srtest_ctx, filename, &session);
+	fail_unless(ret == SR_OK, "Failed to load session file: %d.", ret);
+	devlist = NULL;
+	sr_session_dev_list(session, &devlist);
+	fail_unless(g_slist_length(devlist) == 1, "No session device.");
+	sdi = devlist->data;
+	g_slist_free(devlist);
+	if (frame) {
+		ret = sr_config_set(sdi, NULL, SR_CONF_CAPTURE_FRAME,
+			g_variant_new_uint64(frame));
+		fail_unless(ret == SR_OK, "Cannot select frame: %d.", ret);
+	}
+
+	sr_session_datafeed_callback_add(session, datafeed_in, NULL);
+	ret = sr_session_start(session);
+	if (ret == SR_OK) {
+		fail_unless(sr_session_run(session) == SR_OK);
+		fail_unless(have_end, "Missing end packet.");
+	}
+	sr_session_destroy(session);
+
+	return ret;
+}
+
+static void srzip_setup(void)
+{
+	uint32_t state;
+	uint64_t i;
+	int fd;
+
+	srtest_setup();
+
+	fd = g_file_open_tmp("sigrok-srzip-XXXXXX.sr", &filename, NULL);
+	fail_unless(fd >= 0, "Cannot create session file.");
+	close(fd);
+
+	for (i = num_samples = 0; i < NUM_FRAMES; i++)
+		num_samples += frame_samples[i];
+	samples = g_malloc(num_samples);
+	state = 1;
+	for (i = 0; i < num_samples; i++) {
+		state = state * 1103515245 + 12345;
+		samples[i] = state >> 16;
+	}
+
+	received = g_byte_array_new();
+	received_analog = g_array_new(FALSE, FALSE, sizeof(float));
+	triggers = g_array_new(FALSE, FALSE, sizeof(int64_t));
+}
+
+static void srzip_teardown(void)
+{
+	g_array_free(triggers, TRUE);
+	g_array_free(received_analog, TRUE);
+	g_byte_array_free(received, TRUE);
+	g_free(analog_values);
+	g_free(analog_raw);
+	analog_values = NULL;
+	analog_raw = NULL;
+	g_free(samples);
+	g_unlink(filename);
+	g_free(filename);
+	srtest_teardown();
+}
+
+/* Check that the frame index reads back as written. */
+START_TEST(test_frames_index)
+{
+	struct sr_frame_info *frames;
+	size_t num_frames, i;
+	uint64_t start;
+	int ret;
+
+	write_session(TRUE);
+	ret = sr_session_frames_load(filename, &frames, &num_frames);
+	fail_unless(ret == SR_OK, "Failed to load frame index: %d.", ret);
+	fail_unless(num_frames == NUM_FRAMES, "Got %zu frames.", num_frames);
+	for (i = start = 0; i < NUM_FRAMES; start += frame_samples[i++]) {
+		fail_unless(frames[i].timestamp > 0);
+		fail_unless(!i || frames[i].timestamp >= frames[i - 1].timestamp);
+		fail_unless(frames[i].logic_offset == start,
+			"Frame %zu starts at %" PRIu64 ".", i + 1,
+			frames[i].logic_offset);
+		fail_unless(frames[i].logic_samples == frame_samples[i],
+			"Frame %zu has %" PRIu64 " samples.", i + 1,
+			frames[i].logic_samples);
+		fail_unless(frames[i].analog_offset == 0);
+		fail_unless(frames[i].analog_samples == 0);
+		fail_unless(frames[i].trigger_offset == frame_triggers[i],
+			"Frame %zu trigger at %" PRId64 ".", i + 1,
+			frames[i].trigger_offset);
+	}
+	g_free(frames);
+
+	/* Without frame selection, the whole capture gets replayed. */
+	fail_unless(replay(0) == SR_OK);
+	fail_unless(received->len == num_samples,
+		"Got %u samples.", received->len);
+	fail_unless(!memcmp(received->data, samples, num_samples));
+	fail_unless(frames_begun == 0 && triggers->len == 0);
+}
+END_TEST
+
+/* Replay each frame on its own, including the one spanning two chunks. */
+START_TEST(test_frames_replay)
+{
+	uint64_t start;
+	size_t i;
+
+	write_session(TRUE);
+	for (i = start = 0; i < NUM_FRAMES; start += frame_samples[i++]) {
+		fail_unless(replay(i + 1) == SR_OK,
+			"Failed to replay frame %zu.", i + 1);
+		fail_unless(frames_begun == 1 && frames_ended == 1,
+			"Frame %zu: %u begin, %u end packets.", i + 1,
+			frames_begun, frames_ended);
+		fail_unless(received->len == frame_samples[i],
+			"Frame %zu: got %u samples.", i + 1, received->len);
+		fail_unless(!memcmp(received->data, samples + start,
+			frame_samples[i]), "Frame %zu: data mismatch.", i + 1);
+		if (frame_triggers[i] < 0) {
+			fail_unless(triggers->len == 0,
+				"Frame %zu: unexpected trigger.", i + 1);
+			continue;
+		}
+		fail_unless(triggers->len == 1 && g_array_index(triggers,
+			int64_t, 0) == frame_triggers[i],
+			"Frame %zu: trigger missing or misplaced.", i + 1);
+	}
+}
+END_TEST
+
+START_TEST(test_frames_out_of_range)
+{
+	write_session(TRUE);
+	fail_unless(replay(NUM_FRAMES + 1) != SR_OK,
+		"Replay of a missing frame started.");
+	fail_unless(received->len == 0);
+}
+END_TEST
+
+START_TEST(test_frames_none)
+{
+	struct sr_frame_info *frames;
+	size_t num_frames;
+	int ret;
+
+	write_session(FALSE);
+	ret = sr_session_frames_load(filename, &frames, &num_frames);
+	fail_unless(ret == SR_ERR_NA, "Unexpected frame index: %d.", ret);
+	fail_unless(replay(1) != SR_OK, "Frame replay without an index.");
+
+	fail_unless(replay(0) == SR_OK);
+	fail_unless(received->len == num_samples,
+		"Got %u samples.", received->len);
+	fail_unless(!memcmp(received->data, samples, num_samples));
+}
+END_TEST
+
+/* Check that the replayed analog values match those which were written. */
+static void analog_check(const struct analog_case *c, uint64_t start,
+	uint64_t count)
+{
+	fail_unless(received_analog->len == count,
+		"%s: got %u of %" PRIu64 " samples.", c->name,
+		received_analog->len, count);
+	fail_unless(!memcmp(received_analog->data, analog_values + start,
+		count * sizeof(float)), "%s: analog data mismatch.", c->name);
+	fail_unless(!analog_mixed, "%s: encoding changed.", c->name);
+}
+
+/*
+ * Round-trip the analog samples of each encoding with compact_analog.
+ * Integers get replayed in their original encoding, so they convert to
+ * the very same values.
+ */
+START_TEST(test_analog_compact)
+{
+	const struct analog_case *c;
+
+	c = &analog_cases[_i];
+	write_analog(c, TRUE, FALSE);
+	fail_unless(replay(0) == SR_OK, "%s: replay failed.", c->name);
+	analog_check(c, 0, ANALOG_SAMPLES);
+	fail_unless(analog_encoding.unitsize == c->unitsize
+		&& analog_encoding.is_float == c->is_float,
+		"%s: replayed as %u bytes, float %d.", c->name,
+		analog_encoding.unitsize, analog_encoding.is_float);
+	if (!c->is_float)
+		fail_unless(analog_encoding.scale.p == c->scale.p
+			&& analog_encoding.scale.q == c->scale.q
+			&& analog_encoding.offset.p == c->offset.p
+			&& analog_encoding.offset.q == c->offset.q,
+			"%s: scale or offset lost.", c->name);
+}
+END_TEST
+
+/* Files without compact_analog keep version 2, with floats. */
+START_TEST(test_analog_version2)
+{
+	const struct analog_case *c;
+
+	c = &analog_cases[_i];
+	write_analog(c, FALSE, FALSE);
+	fail_unless(replay(0) == SR_OK, "%s: replay failed.", c->name);
+	analog_check(c, 0, ANALOG_SAMPLES);
+	fail_unless(analog_encoding.is_float && analog_encoding.unitsize == 4,
+		"%s: not replayed as float.", c->name);
+}
+END_TEST
+
+/*
+ * Replay each frame of compact analog data. Seeking takes the decoded
+ * size of each chunk from the chunk headers.
+ */
+START_TEST(test_analog_compact_frames)
+{
+	const struct analog_case *c;
+	struct sr_frame_info *frames;
+	size_t num_frames, i;
+	uint64_t start;
+	int ret;
+
+	c = &analog_cases[_i];
+	write_analog(c, TRUE, TRUE);
+	ret = sr_session_frames_load(filename, &frames, &num_frames);
+	fail_unless(ret == SR_OK, "Failed to load frame index: %d.", ret);
+	fail_unless(num_frames == ARRAY_SIZE(analog_frames),
+		"Got %zu frames.", num_frames);
+	for (i = start = 0; i < num_frames; start += analog_frames[i++]) {
+		fail_unless(frames[i].analog_offset == start
+			&& frames[i].analog_samples == analog_frames[i],
+			"%s: frame %zu misplaced.", c->name, i + 1);
+	}
+	g_free(frames);
+
+	for (i = start = 0; i < num_frames; start += analog_frames[i++]) {
+		fail_unless(replay(i + 1) == SR_OK,
+			"%s: failed to replay frame %zu.", c->name, i + 1);
+		fail_unless(frames_begun == 1 && frames_ended == 1);
+		analog_check(c, start, analog_frames[i]);
+	}
+}
+END_TEST
+
+Suite *suite_srzip(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("srzip");
+
+	tc = tcase_create("frames");
+	tcase_add_checked_fixture(tc, srzip_setup, srzip_teardown);
+	tcase_set_timeout(tc, 30);
+	tcase_add_test(tc, test_frames_index);
+	tcase_add_test(tc, test_frames_replay);
+	tcase_add_test(tc, test_frames_out_of_range);
+	tcase_add_test(tc, test_frames_none);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("analog");
+	tcase_add_checked_fixture(tc, srzip_setup, srzip_teardown);
+	tcase_set_timeout(tc, 30);
+	tcase_add_loop_test(tc, test_analog_compact,
+		0, ARRAY_SIZE(analog_cases));
+	tcase_add_loop_test(tc, test_analog_version2,
+		0, ARRAY_SIZE(analog_cases));
+	tcase_add_loop_test(tc, test_analog_compact_frames,
+		0, ARRAY_SIZE(analog_cases));
+	suite_add_tcase(s, tc);
+
+	return s;
+}
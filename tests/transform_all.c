@@ -18,7 +18,9 @@
  */
 
 #include <config.h>
+#include <math.h>
 #include <stdlib.h>
+#include <string.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
@@ -96,6 +98,657 @@ START_TEST(test_transform_options)
 }
 END_TEST
 
+/*
+ * The numeric transforms get checked against plain reference versions.
+ * Synthetic data is fed through the "binary" and "raw_analog" input
+ * modules in chunks of odd sizes, so that packet boundaries fall into
+ * the middle of decimation phases, filter windows and pulses.
+ */
+#define DSP_SAMPLES	4099
+#define DSP_SAMPLERATE	SR_MHZ(1)
+#define DSP_FORMAT	"S16_LE (-32768..32767)"
+
+static const size_t dsp_chunks[] = { 13, 1, 6, 7, 8, 333, 1000, 511 };
+
+struct dsp_stage {
+	const char *id;
+	/* NULL for modules without options. */
+	const char *option;
+	uint64_t value;
+	/* Denominator of a rational option, 0 for integer options. */
+	uint64_t q;
+};
+
+struct dsp_result {
+	GByteArray *logic;
+	GArray *analog;
+	unsigned int packets;
+	uint64_t samplerate;
+};
+
+static uint32_t dsp_rand(uint32_t *state)
+{
+	*state = *state * 1103515245 + 12345;
+
+	return *state >> 16;
+}
+
+/* Logic data with pulses of 1 to 6 samples on every channel. */
+static uint8_t *dsp_logic_data(size_t count, size_t unitsize)
+{
+	uint8_t *data;
+	uint32_t state;
+	size_t i, run;
+	unsigned int ch;
+	int level;
+
+	data = g_malloc0(count * unitsize);
+	state = 1;
+	for (ch = 0; ch < unitsize * 8; ch++) {
+		level = 0;
+		run = 0;
+		for (i = 0; i < count; i++) {
+			if (!run) {
+				run = 1 + dsp_rand(&state) % 6;
+				level = !level;
+			}
+			if (level)
+				data[i * unitsize + ch / 8] |= 1 << (ch % 8);
+			run--;
+		}
+	}
+
+	return data;
+}
+
+/* Little endian S16 data, and the same values as float. */
+static uint8_t *dsp_analog_data(size_t count, float *values)
+{
+	uint8_t *data;
+	uint32_t state;
+	int16_t value;
+	size_t i;
+
+	data = g_malloc(count * 2);
+	state = 1;
+	for (i = 0; i < count; i++) {
+		value = (int16_t)(dsp_rand(&state) % 40001) - 20000;
+		data[i * 2] = (uint16_t)value & 0xff;
+		data[i * 2 + 1] = (uint16_t)value >> 8;
+		values[i] = value;
+	}
+
+	return data;
+}
+
+static void dsp_datafeed_in(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct dsp_result *res;
+	const struct sr_datafeed_meta *meta;
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	struct sr_config *src;
+	GSList *l;
+	guint len;
+	int ret;
+
+	(void)sdi;
+	res = cb_data;
+
+	switch (packet->type) {
+	case SR_DF_META:
+		meta = packet->payload;
+		for (l = meta->config; l; l = l->next) {
+			src = l->data;
+			if (src->key == SR_CONF_SAMPLERATE)
+				res->samplerate = g_variant_get_uint64(src->data);
+		}
+		break;
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		g_byte_array_append(res->logic, logic->data, logic->length);
+		res->packets++;
+		break;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		len = res->analog->len;
+		g_array_set_size(res->analog, len + analog->num_samples);
+		ret = sr_analog_to_float(analog,
+			&g_array_index(res->analog, float, len));
+		fail_unless(ret == SR_OK, "Cannot convert analog data: %d.", ret);
+		res->packets++;
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * Run 'len' bytes of data through the input module and the transform
+ * chain, collect what reaches the datafeed callback. 'format' selects
+ * the sample format of the raw_analog input module.
+ */
+static void dsp_run(const char *input, const char *format, int numchannels,
+	const uint8_t *data, size_t len,
+	const struct dsp_stage *stages, size_t num_stages,
+	struct dsp_result *res)
+{
+	const struct sr_input_module *imod;
+	const struct sr_transform_module *tmod;
+	const struct sr_transform *t[4];
+	struct sr_input *in;
+	struct sr_dev_inst *sdi;
+	struct sr_session *session;
+	GHashTable *opts;
+	GString *buf;
+	size_t i, offset, n;
+	int ret;
+
+	fail_unless(num_stages <= ARRAY_SIZE(t));
+
+	res->logic = g_byte_array_new();
+	res->analog = g_array_new(FALSE, FALSE, sizeof(float));
+	res->packets = 0;
+	res->samplerate = 0;
+
+	opts = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+		(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(opts, "numchannels",
+		g_variant_ref_sink(g_variant_new_int32(numchannels)));
+	g_hash_table_insert(opts, "samplerate",
+		g_variant_ref_sink(g_variant_new_uint64(DSP_SAMPLERATE)));
+	if (format)
+		g_hash_table_insert(opts, "format",
+			g_variant_ref_sink(g_variant_new_string(format)));
+	imod = sr_input_find(input);
+	fail_unless(imod != NULL, "Input module '%s' not found.", input);
+	in = sr_input_new(imod, opts);
+	fail_unless(in != NULL, "Failed to create input instance.");
+	g_hash_table_destroy(opts);
+	sdi = sr_input_dev_inst_get(in);
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_dev_add(session, sdi);
+	sr_session_datafeed_callback_add(session, dsp_datafeed_in, res);
+
+	for (i = 0; i < num_stages; i++) {
+		tmod = sr_transform_find(stages[i].id);
+		fail_unless(tmod != NULL, "Transform '%s' not found.",
+			stages[i].id);
+		opts = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+			(GDestroyNotify)g_variant_unref);
+		if (stages[i].option && stages[i].q)
+			g_hash_table_insert(opts, (char *)stages[i].option,
+				g_variant_ref_sink(g_variant_new("(xt)",
+				(int64_t)stages[i].value, stages[i].q)));
+		else if (stages[i].option)
+			g_hash_table_insert(opts, (char *)stages[i].option,
+				g_variant_ref_sink(g_variant_new_uint64(stages[i].value)));
+		t[i] = sr_transform_new(tmod, opts, sdi);
+		fail_unless(t[i] != NULL, "Failed to create '%s' transform.",
+			stages[i].id);
+		g_hash_table_destroy(opts);
+	}
+
+	for (i = offset = 0; offset < len; i++, offset += n) {
+		n = i < ARRAY_SIZE(dsp_chunks) ? dsp_chunks[i] : len;
+		n = MIN(n, len - offset);
+		buf = g_string_new_len((const gchar *)data + offset, n);
+		ret = sr_input_send(in, buf);
+		fail_unless(ret == SR_OK, "sr_input_send() error: %d.", ret);
+		g_string_free(buf, TRUE);
+	}
+	ret = sr_input_end(in);
+	fail_unless(ret == SR_OK, "sr_input_end() error: %d.", ret);
+
+	for (i = 0; i < num_stages; i++)
+		sr_transform_free(t[i]);
+	sr_session_destroy(session);
+	sr_input_free(in);
+}
+
+static void dsp_result_free(struct dsp_result *res)
+{
+	g_byte_array_free(res->logic, TRUE);
+	g_array_free(res->analog, TRUE);
+}
+
+static void dsp_check_floats(const struct dsp_result *res,
+	const float *expected, size_t count)
+{
+	size_t i;
+	float value;
+
+	fail_unless(res->analog->len == count,
+		"Got %u values, expected %zu.", res->analog->len, count);
+	for (i = 0; i < count; i++) {
+		value = g_array_index(res->analog, float, i);
+		fail_unless(fabs(value - expected[i]) <=
+			1e-4 * MAX(1.0, fabs(expected[i])),
+			"Value %zu is %f, expected %f.", i, value, expected[i]);
+	}
+}
+
+static size_t ref_decimate(const uint8_t *in, size_t count, size_t unitsize,
+	uint64_t factor, uint8_t *out)
+{
+	size_t i, kept;
+
+	for (i = kept = 0; i < count; i += factor, kept++)
+		memcpy(&out[kept * unitsize], &in[i * unitsize], unitsize);
+
+	return kept;
+}
+
+static void ref_average(const float *in, size_t count, uint64_t length,
+	float *out)
+{
+	size_t i, j, n;
+	double sum;
+
+	for (i = 0; i < count; i++) {
+		n = MIN(i + 1, length);
+		for (j = 0, sum = 0; j < n; j++)
+			sum += in[i - j];
+		out[i] = sum / n;
+	}
+}
+
+static size_t ref_envelope(const float *in, size_t count, uint64_t factor,
+	float *out)
+{
+	size_t i, j, num;
+	float min, max;
+
+	num = 0;
+	for (i = 0; i + factor <= count; i += factor) {
+		min = max = in[i];
+		for (j = 1; j < factor; j++) {
+			min = MIN(min, in[i + j]);
+			max = MAX(max, in[i + j]);
+		}
+		out[num++] = min;
+		out[num++] = max;
+	}
+
+	return num;
+}
+
+static void ref_deglitch(const uint8_t *in, size_t count, size_t unitsize,
+	uint64_t length, uint8_t *out)
+{
+	unsigned int ch, run;
+	size_t i;
+	int level, state;
+
+	for (ch = 0; ch < unitsize * 8; ch++) {
+		state = in[ch / 8] >> (ch % 8) & 1;
+		run = 0;
+		for (i = 0; i < count; i++) {
+			level = in[i * unitsize + ch / 8] >> (ch % 8) & 1;
+			if (level == state)
+				run = 0;
+			else if (++run >= length) {
+				state = level;
+				run = 0;
+			}
+			out[i * unitsize + ch / 8] &= ~(1 << (ch % 8));
+			out[i * unitsize + ch / 8] |= state << (ch % 8);
+		}
+	}
+}
+
+/* Check decimation of logic data of several unit sizes, and of analog data. */
+START_TEST(test_transform_decimate)
+{
+	static const struct dsp_stage stage = { "decimate", "factor", 7 };
+	static const int numchannels[] = { 8, 12, 40 };
+	struct dsp_result res;
+	uint8_t *data, *expected;
+	float *values, *fexpected;
+	size_t i, unitsize, count, kept;
+
+	for (i = 0; i < ARRAY_SIZE(numchannels); i++) {
+		unitsize = (numchannels[i] + 7) / 8;
+		data = dsp_logic_data(DSP_SAMPLES, unitsize);
+		expected = g_malloc(DSP_SAMPLES * unitsize);
+		kept = ref_decimate(data, DSP_SAMPLES, unitsize,
+			stage.value, expected);
+		dsp_run("binary", NULL, numchannels[i], data,
+			DSP_SAMPLES * unitsize, &stage, 1, &res);
+		fail_unless(res.packets > 1, "Data was not split into packets.");
+		fail_unless(res.samplerate == DSP_SAMPLERATE / stage.value,
+			"Samplerate %" PRIu64 " not reduced.", res.samplerate);
+		fail_unless(res.logic->len == kept * unitsize,
+			"Got %u bytes, expected %zu.", res.logic->len,
+			kept * unitsize);
+		fail_unless(!memcmp(res.logic->data, expected, kept * unitsize),
+			"Decimated logic data mismatch (unitsize %zu).", unitsize);
+		dsp_result_free(&res);
+		g_free(expected);
+		g_free(data);
+	}
+
+	values = g_malloc(DSP_SAMPLES * sizeof(float));
+	fexpected = g_malloc(DSP_SAMPLES * sizeof(float));
+	data = dsp_analog_data(DSP_SAMPLES, values);
+	count = ref_decimate((uint8_t *)values, DSP_SAMPLES, sizeof(float),
+		stage.value, (uint8_t *)fexpected);
+	dsp_run("raw_analog", DSP_FORMAT, 1, data, DSP_SAMPLES * 2,
+		&stage, 1, &res);
+	fail_unless(res.packets > 1, "Data was not split into packets.");
+	dsp_check_floats(&res, fexpected, count);
+	dsp_result_free(&res);
+	g_free(data);
+	g_free(fexpected);
+	g_free(values);
+}
+END_TEST
+
+/* Check the moving average, also while its window is not filled yet. */
+START_TEST(test_transform_average)
+{
+	static const struct dsp_stage stages[] = {
+		{ "average", "length", 1 },
+		{ "average", "length", 5 },
+		{ "average", "length", 64 },
+	};
+	struct dsp_result res;
+	uint8_t *data;
+	float *values, *expected;
+	size_t i;
+
+	values = g_malloc(DSP_SAMPLES * sizeof(float));
+	expected = g_malloc(DSP_SAMPLES * sizeof(float));
+	data = dsp_analog_data(DSP_SAMPLES, values);
+	for (i = 0; i < ARRAY_SIZE(stages); i++) {
+		ref_average(values, DSP_SAMPLES, stages[i].value, expected);
+		dsp_run("raw_analog", DSP_FORMAT, 1, data, DSP_SAMPLES * 2,
+			&stages[i], 1, &res);
+		fail_unless(res.packets > 1, "Data was not split into packets.");
+		dsp_check_floats(&res, expected, DSP_SAMPLES);
+		dsp_result_free(&res);
+	}
+	g_free(data);
+	g_free(expected);
+	g_free(values);
+}
+END_TEST
+
+/* Check min/max pairs, blocks span packets and the last one is partial. */
+START_TEST(test_transform_envelope)
+{
+	static const struct dsp_stage stages[] = {
+		{ "envelope", "factor", 2 },
+		{ "envelope", "factor", 7 },
+		{ "envelope", "factor", 1000 },
+	};
+	struct dsp_result res;
+	uint8_t *data;
+	float *values, *expected;
+	size_t i, count;
+
+	values = g_malloc(DSP_SAMPLES * sizeof(float));
+	expected = g_malloc(DSP_SAMPLES * sizeof(float));
+	data = dsp_analog_data(DSP_SAMPLES, values);
+	for (i = 0; i < ARRAY_SIZE(stages); i++) {
+		count = ref_envelope(values, DSP_SAMPLES, stages[i].value,
+			expected);
+		dsp_run("raw_analog", DSP_FORMAT, 1, data, DSP_SAMPLES * 2,
+			&stages[i], 1, &res);
+		fail_unless(res.samplerate ==
+			DSP_SAMPLERATE * 2 / stages[i].value,
+			"Samplerate %" PRIu64 " not adjusted.", res.samplerate);
+		dsp_check_floats(&res, expected, count);
+		dsp_result_free(&res);
+	}
+	g_free(data);
+	g_free(expected);
+	g_free(values);
+}
+END_TEST
+
+/* Check pulse suppression, pulses span packets. */
+START_TEST(test_transform_deglitch)
+{
+	static const struct dsp_stage stages[] = {
+		{ "deglitch", "length", 2 },
+		{ "deglitch", "length", 3 },
+		{ "deglitch", "length", 6 },
+	};
+	static const int numchannels[] = { 8, 12 };
+	struct dsp_result res;
+	uint8_t *data, *expected;
+	size_t i, j, unitsize, len;
+
+	for (i = 0; i < ARRAY_SIZE(numchannels); i++) {
+		unitsize = (numchannels[i] + 7) / 8;
+		len = DSP_SAMPLES * unitsize;
+		data = dsp_logic_data(DSP_SAMPLES, unitsize);
+		expected = g_malloc(len);
+		for (j = 0; j < ARRAY_SIZE(stages); j++) {
+			ref_deglitch(data, DSP_SAMPLES, unitsize,
+				stages[j].value, expected);
+			dsp_run("binary", NULL, numchannels[i], data, len,
+				&stages[j], 1, &res);
+			fail_unless(res.packets > 1,
+				"Data was not split into packets.");
+			fail_unless(res.logic->len == len,
+				"Got %u bytes, expected %zu.", res.logic->len, len);
+			fail_unless(!memcmp(res.logic->data, expected, len),
+				"Deglitched data mismatch (unitsize %zu, length %"
+				PRIu64 ").", unitsize, stages[j].value);
+			dsp_result_free(&res);
+		}
+		g_free(expected);
+		g_free(data);
+	}
+}
+END_TEST
+
+/* Check a chain of transforms, each one sees its predecessor's output. */
+START_TEST(test_transform_chain)
+{
+	static const struct dsp_stage stages[] = {
+		{ "decimate", "factor", 3 },
+		{ "average", "length", 5 },
+		{ "envelope", "factor", 9 },
+	};
+	struct dsp_result res;
+	uint8_t *data;
+	float *values, *decimated, *averaged, *expected;
+	size_t count;
+
+	values = g_malloc(DSP_SAMPLES * sizeof(float));
+	decimated = g_malloc(DSP_SAMPLES * sizeof(float));
+	averaged = g_malloc(DSP_SAMPLES * sizeof(float));
+	expected = g_malloc(DSP_SAMPLES * sizeof(float));
+	data = dsp_analog_data(DSP_SAMPLES, values);
+	count = ref_decimate((uint8_t *)values, DSP_SAMPLES, sizeof(float),
+		stages[0].value, (uint8_t *)decimated);
+	ref_average(decimated, count, stages[1].value, averaged);
+	count = ref_envelope(averaged, count, stages[2].value, expected);
+
+	dsp_run("raw_analog", DSP_FORMAT, 1, data, DSP_SAMPLES * 2,
+		stages, ARRAY_SIZE(stages), &res);
+	fail_unless(res.samplerate == DSP_SAMPLERATE / 3 * 2 / 9,
+		"Samplerate %" PRIu64 " not adjusted.", res.samplerate);
+	dsp_check_floats(&res, expected, count);
+	dsp_result_free(&res);
+
+	g_free(data);
+	g_free(expected);
+	g_free(averaged);
+	g_free(decimated);
+	g_free(values);
+}
+END_TEST
+
+/*
+ * Scale and invert the analog values of an 8-bit format with a non-zero
+ * offset, as sent by the scope drivers. The raw_analog input module
+ * sends the same encoding in every packet, the transforms must not
+ * apply to it more than once.
+ */
+START_TEST(test_transform_encoding)
+{
+#define SCALE	{ "scale", "factor", 3, 2 }
+#define INVERT	{ "invert", NULL, 0, 0 }
+	static const struct {
+		struct dsp_stage stages[2];
+		size_t num_stages;
+	} chains[] = {
+		{ { SCALE }, 1 },
+		{ { INVERT }, 1 },
+		{ { SCALE, INVERT }, 2 },
+		{ { INVERT, SCALE }, 2 },
+	};
+#undef SCALE
+#undef INVERT
+	/* "U8 (0..1)": value = raw / 255 - 1 / 2 */
+	const double s = 1.0 / 255, o = -0.5, f = 1.5;
+	struct dsp_result res;
+	uint8_t *data;
+	float *expected;
+	double raw;
+	size_t i, j;
+	uint32_t state;
+
+	data = g_malloc(DSP_SAMPLES);
+	expected = g_malloc(DSP_SAMPLES * sizeof(float));
+	state = 1;
+	for (i = 0; i < DSP_SAMPLES; i++)
+		data[i] = dsp_rand(&state);
+
+	for (i = 0; i < ARRAY_SIZE(chains); i++) {
+		for (j = 0; j < DSP_SAMPLES; j++) {
+			raw = data[j];
+			if (i == 0)
+				expected[j] = (raw * s + o) * f;
+			else if (i == 1)
+				expected[j] = (raw - o) / s;
+			else if (i == 2)
+				expected[j] = (raw - o * f) / (s * f);
+			else
+				expected[j] = (raw - o) / s * f;
+		}
+		dsp_run("raw_analog", "U8 (0..1)", 1, data, DSP_SAMPLES,
+			chains[i].stages, chains[i].num_stages, &res);
+		fail_unless(res.packets > 1, "Data was not split into packets.");
+		dsp_check_floats(&res, expected, DSP_SAMPLES);
+		dsp_result_free(&res);
+	}
+
+	g_free(expected);
+	g_free(data);
+}
+END_TEST
+
+/*
+ * Run a demo device in unpaced mode through one transform module, or
+ * none if 'id' is NULL. The demo device keeps sending the same pattern
+ * memory, transforms which modify their input must not change it.
+ */
+#define DEMO_SAMPLES	50000
+
+static void demo_run(struct sr_dev_inst *sdi, const char *id,
+	const char *option, GVariant *value, struct dsp_result *res)
+{
+	const struct sr_transform_module *tmod;
+	const struct sr_transform *t;
+	struct sr_session *session;
+	GHashTable *opts;
+	int ret;
+
+	res->logic = g_byte_array_new();
+	res->analog = g_array_new(FALSE, FALSE, sizeof(float));
+	res->packets = 0;
+	res->samplerate = 0;
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_dev_add(session, sdi);
+	sr_session_datafeed_callback_add(session, dsp_datafeed_in, res);
+
+	t = NULL;
+	if (id) {
+		tmod = sr_transform_find(id);
+		fail_unless(tmod != NULL, "Transform '%s' not found.", id);
+		opts = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+			(GDestroyNotify)g_variant_unref);
+		if (option)
+			g_hash_table_insert(opts, (char *)option,
+				g_variant_ref_sink(value));
+		t = sr_transform_new(tmod, opts, sdi);
+		fail_unless(t != NULL, "Failed to create '%s' transform.", id);
+		g_hash_table_destroy(opts);
+	}
+
+	ret = sr_session_start(session);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	ret = sr_session_run(session);
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+
+	if (t)
+		sr_transform_free(t);
+	sr_session_destroy(session);
+}
+
+START_TEST(test_transform_demo_pattern)
+{
+	struct sr_dev_inst *sdi;
+	struct dsp_result ref, res;
+	uint8_t *expected;
+	float *fexpected;
+	size_t i, count;
+	int ret;
+
+	sdi = srtest_demo_dev_new(8, 1, DEMO_SAMPLES);
+	ret = sr_config_set(sdi, NULL, SR_CONF_UNPACED,
+		g_variant_new_boolean(TRUE));
+	fail_unless(ret == SR_OK, "Failed to set unpaced mode: %d.", ret);
+
+	demo_run(sdi, NULL, NULL, NULL, &ref);
+	fail_unless(ref.logic->len == DEMO_SAMPLES,
+		"Got %u logic bytes.", ref.logic->len);
+	fail_unless(ref.analog->len == DEMO_SAMPLES,
+		"Got %u analog values.", ref.analog->len);
+
+	/* Logic data gets inverted in place. */
+	expected = g_malloc(DEMO_SAMPLES);
+	for (i = 0; i < DEMO_SAMPLES; i++)
+		expected[i] = ~ref.logic->data[i];
+	demo_run(sdi, "invert", NULL, NULL, &res);
+	fail_unless(res.logic->len == DEMO_SAMPLES &&
+		!memcmp(res.logic->data, expected, DEMO_SAMPLES),
+		"Inverted logic data mismatch.");
+	dsp_result_free(&res);
+
+	/* Logic and analog data get compacted in place. */
+	count = ref_decimate(ref.logic->data, DEMO_SAMPLES, 1, 3, expected);
+	fexpected = g_malloc(DEMO_SAMPLES * sizeof(float));
+	demo_run(sdi, "decimate", "factor", g_variant_new_uint64(3), &res);
+	fail_unless(res.logic->len == count &&
+		!memcmp(res.logic->data, expected, count),
+		"Decimated logic data mismatch.");
+	count = ref_decimate((uint8_t *)ref.analog->data, DEMO_SAMPLES,
+		sizeof(float), 3, (uint8_t *)fexpected);
+	dsp_check_floats(&res, fexpected, count);
+	dsp_result_free(&res);
+
+	/* The analog encoding gets modified in place. */
+	for (i = 0; i < DEMO_SAMPLES; i++)
+		fexpected[i] = 2 * g_array_index(ref.analog, float, i);
+	demo_run(sdi, "scale", "factor", g_variant_new("(xt)", 2, 1), &res);
+	dsp_check_floats(&res, fexpected, DEMO_SAMPLES);
+	dsp_result_free(&res);
+
+	g_free(fexpected);
+	g_free(expected);
+	dsp_result_free(&ref);
+}
+END_TEST
+
 Suite *suite_transform_all(void)
 {
 	Suite *s;
@@ -112,5 +765,20 @@ Suite *suite_transform_all(void)
 	tcase_add_test(tc, test_transform_options);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("dsp");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_transform_decimate);
+	tcase_add_test(tc, test_transform_average);
+	tcase_add_test(tc, test_transform_envelope);
+	tcase_add_test(tc, test_transform_deglitch);
+	tcase_add_test(tc, test_transform_chain);
+	tcase_add_test(tc, test_transform_encoding);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("demo");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_transform_demo_pattern);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
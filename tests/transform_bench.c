@@ -0,0 +1,234 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Throughput of transform module chains on synthetic data.
+ *
+ *   tests/transform_bench logic|analog <megasamples> <id>[:<option>=<value>]...
+ *
+ * e.g. "tests/transform_bench analog 64 decimate:factor=4 envelope". The
+ * data is fed through the "binary" (16 channels) or "raw_analog" (S16)
+ * input module in packets of PACKET_SIZE bytes. Reports the time spent in
+ * each transform module, as measured by the session's stage statistics.
+ * Rates are given in input samples, also for stages behind a decimation.
+ *
+ * Not part of "make check", build with "make tests/transform_bench".
+ */
+
+#include <config.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+
+#define PACKET_SIZE	(64 * 1024)
+#define MAX_STAGES	8
+
+static uint64_t samples_out;
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+
+	(void)sdi;
+	(void)cb_data;
+
+	if (packet->type == SR_DF_LOGIC) {
+		logic = packet->payload;
+		samples_out += logic->length / logic->unitsize;
+	} else if (packet->type == SR_DF_ANALOG) {
+		analog = packet->payload;
+		samples_out += analog->num_samples;
+	}
+}
+
+/* One packet worth of data: short and long pulses, or a noisy sine. */
+static void fill_packet(uint8_t *buf, gboolean is_logic, uint64_t *pos)
+{
+	size_t i;
+	uint16_t value;
+
+	for (i = 0; i < PACKET_SIZE / 2; i++, (*pos)++) {
+		if (is_logic)
+			value = (*pos ^ (*pos >> 3)) & 0xffff;
+		else
+			value = (int16_t)(sin(*pos * 0.001) * 20000
+				+ (int)(*pos * 7919 % 301) - 150);
+		buf[i * 2] = value & 0xff;
+		buf[i * 2 + 1] = value >> 8;
+	}
+}
+
+static const struct sr_transform *add_stage(struct sr_dev_inst *sdi,
+	const char *spec)
+{
+	const struct sr_transform_module *tmod;
+	const struct sr_transform *t;
+	const struct sr_option **opts;
+	GHashTable *options;
+	GVariant *value;
+	char **tokens, **kv;
+	int i, j;
+
+	tokens = g_strsplit_set(spec, ":,", 0);
+	tmod = sr_transform_find(tokens[0]);
+	if (!tmod) {
+		fprintf(stderr, "Unknown transform module '%s'.\n", tokens[0]);
+		g_strfreev(tokens);
+		return NULL;
+	}
+
+	/* Values are parsed by the type of the option's default. */
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		(GDestroyNotify)g_variant_unref);
+	opts = sr_transform_options_get(tmod);
+	for (i = 1; tokens[i]; i++) {
+		kv = g_strsplit(tokens[i], "=", 2);
+		value = NULL;
+		if (kv[1] && opts) {
+			for (j = 0; opts[j]; j++) {
+				if (strcmp(opts[j]->id, kv[0]))
+					continue;
+				if (g_variant_is_of_type(opts[j]->def, G_VARIANT_TYPE_UINT64))
+					value = g_variant_new_uint64(g_ascii_strtoull(kv[1], NULL, 10));
+				else if (g_variant_is_of_type(opts[j]->def, G_VARIANT_TYPE_BOOLEAN))
+					value = g_variant_new_boolean(!strcmp(kv[1], "1"));
+				else
+					value = g_variant_new_string(kv[1]);
+			}
+		}
+		if (!value) {
+			fprintf(stderr, "Invalid option '%s' for '%s'.\n",
+				tokens[i], tokens[0]);
+			g_strfreev(kv);
+			continue;
+		}
+		g_hash_table_insert(options, g_strdup(kv[0]),
+			g_variant_ref_sink(value));
+		g_strfreev(kv);
+	}
+	sr_transform_options_free(opts);
+
+	t = sr_transform_new(tmod, options, sdi);
+	g_hash_table_destroy(options);
+	g_strfreev(tokens);
+
+	return t;
+}
+
+int main(int argc, char **argv)
+{
+	struct sr_context *ctx;
+	const struct sr_input_module *imod;
+	const struct sr_transform *stages[MAX_STAGES];
+	struct sr_input *in;
+	struct sr_dev_inst *sdi;
+	struct sr_session *session;
+	struct sr_stage_stats *st;
+	GHashTable *options;
+	GSList *stats, *l;
+	GString *buf;
+	GTimer *timer;
+	gboolean is_logic;
+	uint64_t samples, pos;
+	double elapsed;
+	int i, num_stages;
+
+	if (argc < 3 || (strcmp(argv[1], "logic") && strcmp(argv[1], "analog"))) {
+		fprintf(stderr, "Usage: %s logic|analog <megasamples> "
+			"<id>[:<option>=<value>]...\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	is_logic = !strcmp(argv[1], "logic");
+	samples = g_ascii_strtoull(argv[2], NULL, 10) * 1000 * 1000;
+
+	if (sr_init(&ctx) != SR_OK)
+		return EXIT_FAILURE;
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+		(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, "numchannels",
+		g_variant_ref_sink(g_variant_new_int32(is_logic ? 16 : 1)));
+	g_hash_table_insert(options, "samplerate",
+		g_variant_ref_sink(g_variant_new_uint64(SR_MHZ(100))));
+	if (!is_logic)
+		g_hash_table_insert(options, "format", g_variant_ref_sink(
+			g_variant_new_string("S16_LE (-32768..32767)")));
+	imod = sr_input_find(is_logic ? "binary" : "raw_analog");
+	in = imod ? sr_input_new(imod, options) : NULL;
+	g_hash_table_destroy(options);
+	if (!in) {
+		fprintf(stderr, "Cannot create input.\n");
+		sr_exit(ctx);
+		return EXIT_FAILURE;
+	}
+	sdi = sr_input_dev_inst_get(in);
+
+	sr_session_new(ctx, &session);
+	sr_session_dev_add(session, sdi);
+	sr_session_datafeed_callback_add(session, datafeed_in, NULL);
+	sr_session_stats_enable(session, TRUE);
+
+	num_stages = 0;
+	for (i = 3; i < argc && num_stages < MAX_STAGES; i++) {
+		stages[num_stages] = add_stage(sdi, argv[i]);
+		if (stages[num_stages])
+			num_stages++;
+	}
+
+	buf = g_string_sized_new(PACKET_SIZE);
+	g_string_set_size(buf, PACKET_SIZE);
+	timer = g_timer_new();
+	g_timer_stop(timer);
+	for (pos = 0; pos < samples; ) {
+		fill_packet((uint8_t *)buf->str, is_logic, &pos);
+		g_timer_continue(timer);
+		sr_input_send(in, buf);
+		g_timer_stop(timer);
+	}
+	g_timer_continue(timer);
+	sr_input_end(in);
+	g_timer_stop(timer);
+	elapsed = g_timer_elapsed(timer, NULL);
+
+	printf("%" PRIu64 " samples in, %" PRIu64 " out, %.3f s, %.1f MS/s\n",
+		pos, samples_out, elapsed, pos / elapsed / 1e6);
+	stats = sr_session_stage_stats_get(session);
+	for (l = stats; l; l = l->next) {
+		st = l->data;
+		if (!st->name)
+			continue;
+		printf("  %-10s %8" PRIu64 " calls %10.3f ms %8.1f MS/s\n",
+			st->name, st->calls, st->time_total / 1e3,
+			st->time_total ? pos / (double)st->time_total : 0.0);
+	}
+	g_slist_free_full(stats, g_free);
+
+	g_timer_destroy(timer);
+	g_string_free(buf, TRUE);
+	for (i = 0; i < num_stages; i++)
+		sr_transform_free(stages[i]);
+	sr_session_destroy(session);
+	sr_input_free(in);
+	sr_exit(ctx);
+
+	return EXIT_SUCCESS;
+}